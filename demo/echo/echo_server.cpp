@@ -13,9 +13,10 @@ int main() {
         }
         if (ret.first) {
           client_conn->WriteToWriteBuffer(client_conn->ReadAsString());
-          client_conn->Send();
           client_conn->ClearReadBuffer();
         }
+        // 可写事件到达时继续发送上次没发完的数据
+        client_conn->Send();
       })
       .Begin();
   return 0;
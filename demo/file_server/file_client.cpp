@@ -47,11 +47,19 @@ class File_Client {
       int file_size = file.tellg();
       file.seekg(0, std::ios::beg);
 
+      // 以http PUT上传，服务器边收边写盘
+      auto slash = filename.find_last_of('/');
+      std::string request_head = "PUT /" + ((slash == std::string::npos) ? filename : filename.substr(slash + 1)) +
+                                 " HTTP/1.1\r\n"
+                                 "Connection: Keep-Alive\r\n"
+                                 "Content-Length: " +
+                                 std::to_string(file_size) + "\r\n\r\n";
+      send(fd, request_head.data(), request_head.size(), 0);
       int send_size = 0;
       // std::cout << "file :" << filename << ", size : " << file_size << std::endl;
       while (send_size < file_size) {
         memset(buf, 0, sizeof(buf));
-        int bufferSize = (file_size - send_size) < BUFSIZ + 1 ? (file_size - send_size) : BUFSIZ + 1;
+        int bufferSize = (file_size - send_size) < BUF_SIZE ? (file_size - send_size) : BUF_SIZE;
         file.read(buf, bufferSize);
         send(fd, buf, bufferSize, 0);
         send_size += bufferSize;
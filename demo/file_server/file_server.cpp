@@ -1,12 +1,125 @@
 #include <fstream>
-#include <map>
-#include <set>
+#include <memory>
 #include <string>
 #include <vector>
 #include "core/next_server.h"
+#include "http/body_decoder.h"
+#include "http/header_table.h"
 #include "http/http_utils.h"
+#include "http/request.h"
+#include "http/request_parser.h"
+#include "http/response.h"
 
-#define BUF_SIZE 2048
+/**
+ * 上传文件的服务器，客户端以 PUT/POST /filename 上传文件
+ * 请求体(Content-Length或chunked)到达即写入磁盘，不在读缓冲区中累积
+ */
+namespace {
+
+/* 每个连接上的上传状态 */
+struct UploadState {
+  Next::Http::RequestParser parser;
+  std::unique_ptr<Next::Http::Request> request;
+  Next::Http::BodyDecoder body;
+  std::ofstream file;
+};
+
+auto GetUploadState(Next::Connection *client_conn) -> UploadState & {
+  auto &context = client_conn->GetContext();
+  if (!context.has_value()) {
+    context = std::make_shared<UploadState>();
+  }
+  return **std::any_cast<std::shared_ptr<UploadState>>(&context);
+}
+
+/* 只保留url中的文件名，避免写到当前目录之外 */
+auto ToUploadPath(const std::string &url) -> std::string {
+  auto name = url.substr(url.find_last_of('/') + 1);
+  if (name.empty() || name == "." || name == "..") {
+    return {};
+  }
+  return "./" + name;
+}
+
+void Respond(Next::Connection *client_conn, const std::string &status, bool should_close) {
+  std::vector<unsigned char> response_buf;
+  Next::Http::Response response{status, should_close, std::nullopt};
+  response.Serialize(response_buf);
+  client_conn->WriteToWriteBuffer(std::move(response_buf));
+  client_conn->Send();
+}
+
+/* 处理缓冲区中的上传请求，返回false时连接已被删除 */
+auto HandleUpload(Next::Connection *client_conn) -> bool {
+  using Next::Http::BodyStatus;
+  using Next::Http::Method;
+  using Next::Http::ParseStatus;
+  auto &state = GetUploadState(client_conn);
+  while (true) {
+    if (state.request == nullptr) {
+      if (state.parser.Parse(client_conn->ReadAsStringView()) == ParseStatus::INCOMPLETE) {
+        return true;
+      }
+      state.request = std::make_unique<Next::Http::Request>(state.parser);
+      client_conn->ConsumeReadBuffer(state.parser.Consumed());
+      state.parser.Reset();
+      const auto &request = *state.request;
+      auto path = ToUploadPath(request.GetResourceUrl());
+      if (!request.IsValid() || path.empty()) {
+        Respond(client_conn, Next::Http::RESPONSE_BAD_REQUEST, true);
+        client_conn->GetLooper()->DeleteConnection(client_conn->GetFd());
+        return false;
+      }
+      if (request.GetMethod() != Method::PUT && request.GetMethod() != Method::POST) {
+        auto response = Next::Http::Response::Make405Response("PUT, POST");
+        std::vector<unsigned char> response_buf;
+        response.Serialize(response_buf);
+        client_conn->WriteToWriteBuffer(std::move(response_buf));
+        client_conn->Send();
+        client_conn->GetLooper()->DeleteConnection(client_conn->GetFd());
+        return false;
+      }
+      state.file.open(path, std::ios::binary | std::ios::trunc);
+      if (!state.file.is_open()) {
+        std::cerr << "Failed to open file for writing: " << path << std::endl;
+        Respond(client_conn, Next::Http::RESPONSE_NOT_FOUND, true);
+        client_conn->GetLooper()->DeleteConnection(client_conn->GetFd());
+        return false;
+      }
+      state.body = request.MakeBodyDecoder();
+      if (request.ExpectContinue() && !state.body.IsComplete()) {
+        client_conn->WriteToWriteBuffer(Next::Http::CONTINUE_RESPONSE);
+        client_conn->Send();
+      }
+    }
+    // 每段请求体到达就写入文件，随后从读缓冲区丢弃
+    auto status = state.body.Decode(client_conn->ReadAsStringView(), [&](std::string_view data) {
+      state.file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    });
+    if (status == BodyStatus::ERROR) {
+      state.file.close();
+      Respond(client_conn, Next::Http::RESPONSE_BAD_REQUEST, true);
+      client_conn->GetLooper()->DeleteConnection(client_conn->GetFd());
+      return false;
+    }
+    client_conn->ConsumeReadBuffer(state.body.Consumed());
+    if (status == BodyStatus::INCOMPLETE) {
+      return true;
+    }
+    state.file.close();
+    bool should_close = state.request->ShouldClose();
+    std::cout << "File received: " << state.request->GetResourceUrl() << ", " << state.body.GetReceived()
+              << " bytes" << std::endl;
+    state.request.reset();
+    Respond(client_conn, Next::Http::RESPONSE_CREATED, should_close);
+    if (should_close) {
+      client_conn->GetLooper()->DeleteConnection(client_conn->GetFd());
+      return false;
+    }
+  }
+}
+
+}  // namespace
 
 int main(int argc, char *argv[]) {
   Next::NetAddress address{"0.0.0.0", 10080};
@@ -20,26 +133,9 @@ int main(int argc, char *argv[]) {
           return;
         }
         if (read) {
-          char buffer[BUF_SIZE + 1] = {0};
-          const char *message = "File received\n";
-
-          std::ofstream outFile("./ReceivedFile.txt", std::ios::binary);
-          if (!outFile.is_open()) {
-            std::cerr << "Failed to open file for writing.\n";
-            client_conn->GetLooper()->DeleteConnection(client_conn->GetFd());
-            return;
-          }
-          // std::cout << client_conn->GetReadBufferSize() << std::endl;
-          // std::cout << client_conn->ReadAsString().c_str() << std::endl;
-
-          outFile.write(client_conn->ReadAsString().c_str(), read);
-
-          client_conn->WriteToWriteBuffer(message);
-          client_conn->Send();
-          client_conn->ClearReadBuffer();
-          outFile.close();
+          HandleUpload(client_conn);
         }
       })
       .Begin();
   return 0;
-}
\ No newline at end of file
+}
@@ -1,11 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+
+#include "next_cgi.h"
+
 int add(int a, int b) {
     return a + b;
 }
 
-int main(int argc, char* argv[]) {
+static int add_main(int argc, char* argv[]) {
     if (argc != 3) {
         printf("usage: add(int a, int b) takes 2 parameters\n");
         return 1;
@@ -14,4 +17,9 @@ int main(int argc, char* argv[]) {
     int v2 = atoi(argv[2]);
     printf("cgi program add(%d, %d) = %d\n", v1, v2, add(v1, v2));
     return 0;
-}
\ No newline at end of file
+}
+
+// 可以由服务器的CgiWorkerPool作为常驻worker运行
+int main(int argc, char* argv[]) {
+    return next_cgi_main(argc, argv, add_main);
+}
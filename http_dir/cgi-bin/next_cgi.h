@@ -0,0 +1,128 @@
+/**
+ * 让cgi程序可以作为常驻worker运行，由服务器的CgiWorkerPool预先启动并反复使用，不必每个请求fork一次
+ * 用法: 把原来的main改名为handler，main中 return next_cgi_main(argc, argv, handler);
+ * 普通方式启动时直接调用一次handler，环境变量NEXT_CGI_WORKER存在时fd 0是连到服务器的unix socket，
+ * 循环读取请求帧，每个请求的参数作为argv调用handler，handler写到stdout的内容作为响应发回
+ * handler不能调用exit，否则worker退出，服务器把请求当作失败并重启worker
+ *
+ * 帧格式与src/include/http/cgi_worker_pool.h一致:
+ * 类型(1字节) 保留(3字节) 负载长度(4字节，网络字节序) 负载
+ * ARGS: 服务器发出的请求，负载是以'\0'结尾的各个参数
+ * STDOUT: 一段输出
+ * END: 请求结束，负载是handler的返回值(4字节，网络字节序)
+ */
+#ifndef NEXT_CGI_H
+#define NEXT_CGI_H
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NEXT_CGI_ARGS 1
+#define NEXT_CGI_STDOUT 2
+#define NEXT_CGI_END 3
+#define NEXT_CGI_HEADER_SIZE 8
+#define NEXT_CGI_MAX_ARGS 64
+#define NEXT_CGI_MAX_FRAME_SIZE (1024 * 1024)
+#define NEXT_CGI_STDOUT_CHUNK (16 * 1024)
+
+static int next_cgi_read_full(int fd, void *buf, size_t size) {
+    char *p = (char *)buf;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int next_cgi_write_full(int fd, const void *buf, size_t size) {
+    const char *p = (const char *)buf;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int next_cgi_write_frame(int fd, int type, const void *payload, uint32_t size) {
+    unsigned char header[NEXT_CGI_HEADER_SIZE] = {0};
+    uint32_t length = htonl(size);
+    header[0] = (unsigned char)type;
+    memcpy(header + 4, &length, sizeof length);
+    if (next_cgi_write_full(fd, header, sizeof header) != 0) {
+        return -1;
+    }
+    return next_cgi_write_full(fd, payload, size);
+}
+
+static int next_cgi_main(int argc, char *argv[], int (*handler)(int argc, char *argv[])) {
+    if (getenv("NEXT_CGI_WORKER") == NULL) {
+        return handler(argc, argv);
+    }
+    char *payload = NULL;
+    for (;;) {
+        unsigned char header[NEXT_CGI_HEADER_SIZE];
+        uint32_t length;
+        // 服务器关闭连接时退出
+        if (next_cgi_read_full(STDIN_FILENO, header, sizeof header) != 0) {
+            break;
+        }
+        memcpy(&length, header + 4, sizeof length);
+        length = ntohl(length);
+        if (header[0] != NEXT_CGI_ARGS || length > NEXT_CGI_MAX_FRAME_SIZE) {
+            break;
+        }
+        payload = (char *)realloc(payload, length + 1);
+        if (payload == NULL || next_cgi_read_full(STDIN_FILENO, payload, length) != 0) {
+            break;
+        }
+        payload[length] = '\0';
+
+        // argv[0]仍是程序名，之后是本次请求的参数
+        char *request_argv[NEXT_CGI_MAX_ARGS + 2];
+        int request_argc = 0;
+        request_argv[request_argc++] = argv[0];
+        for (uint32_t pos = 0; pos < length && request_argc <= NEXT_CGI_MAX_ARGS; pos += strlen(payload + pos) + 1) {
+            request_argv[request_argc++] = payload + pos;
+        }
+        request_argv[request_argc] = NULL;
+
+        // handler的输出先写到内存，再按帧发出
+        char *output = NULL;
+        size_t output_size = 0;
+        FILE *saved_stdout = stdout;
+        stdout = open_memstream(&output, &output_size);
+        if (stdout == NULL) {
+            stdout = saved_stdout;
+            break;
+        }
+        uint32_t status = htonl((uint32_t)handler(request_argc, request_argv));
+        fclose(stdout);
+        stdout = saved_stdout;
+
+        int failed = 0;
+        for (size_t sent = 0; sent < output_size && !failed; sent += NEXT_CGI_STDOUT_CHUNK) {
+            size_t chunk = output_size - sent < NEXT_CGI_STDOUT_CHUNK ? output_size - sent : NEXT_CGI_STDOUT_CHUNK;
+            failed = next_cgi_write_frame(STDIN_FILENO, NEXT_CGI_STDOUT, output + sent, (uint32_t)chunk);
+        }
+        free(output);
+        if (failed || next_cgi_write_frame(STDIN_FILENO, NEXT_CGI_END, &status, sizeof status) != 0) {
+            break;
+        }
+    }
+    free(payload);
+    return 0;
+}
+
+#endif
@@ -8,10 +8,12 @@
 
 namespace Next {
 
-Acceptor::Acceptor(Looper *listener, std::vector<Looper *> reactors, NetAddress server_address)
-    : reactors_(std::move(reactors)) {
+Acceptor::Acceptor(Looper *listener, std::vector<Looper *> reactors, NetAddress server_address,
+                   SocketOptions socket_options)
+    : reactors_(std::move(reactors)), socket_options_(socket_options) {
   auto acceptor_sock = std::make_unique<Socket>();
   acceptor_sock->Bind(server_address, true);
+  acceptor_sock->ApplyListenerOptions(socket_options_);
   acceptor_sock->Listen();
   acceptor_conn_ = std::make_unique<Connection>(std::move(acceptor_sock));
   acceptor_conn_->SetEvents(POLL_READ);  // not edge-trigger for listener
@@ -32,8 +34,11 @@ void Acceptor::BaseAcceptCallback(Connection *server_conn) {
   }
   auto client_sock = std::make_unique<Socket>(accept_fd);
   client_sock->SetNonBlocking();
+  // 选项已在监听socket上验证过，个别连接设置失败时照常服务
+  client_sock->ApplyConnectionOptions(socket_options_);
   auto client_conn = std::make_unique<Connection>(std::move(client_sock));
-  client_conn->SetEvents(POLL_READ | POLL_ET);  // edge-trigger for client
+  // edge-trigger for client，ET下只有发送缓冲区从满变为可写时才有写事件，用于继续发送没发完的数据
+  client_conn->SetEvents(POLL_READ | POLL_WRITE | POLL_ET);
   client_conn->SetCallback(GetCustomHandleCallback());
 
   int idx = rand() % reactors_.size();
@@ -72,4 +77,6 @@ auto Acceptor::GetCustomHandleCallback() const noexcept -> std::function<void(Co
 }
 
 auto Acceptor::GetAcceptorConnection() noexcept -> Connection * { return acceptor_conn_.get(); }
+
+auto Acceptor::GetSocketOptions() const noexcept -> const SocketOptions & { return socket_options_; }
 }  // namespace Next
\ No newline at end of file
@@ -14,7 +14,11 @@ void Buffer::Append(const std::string &new_string_data) {
 }
 
 void Buffer::Append(std::vector<unsigned char> &&new_buf_data) {
-
+  if (buf_.empty()) {
+    // 缓冲区为空时直接接管对方的内存，不再拷贝
+    buf_.swap(new_buf_data);
+    return;
+  }
   buf_.insert(buf_.end(), std::make_move_iterator(new_buf_data.begin()),
               std::make_move_iterator(new_buf_data.end()));
 }
@@ -41,6 +45,14 @@ auto Buffer::FindAndPopTill(const std::string &target)
   return ret;
 }
 
+void Buffer::Consume(size_t size) noexcept {
+  if (size >= buf_.size()) {
+    buf_.clear();
+    return;
+  }
+  buf_.erase(buf_.begin(), buf_.begin() + size);
+}
+
 auto Buffer::Size() const noexcept -> size_t { return buf_.size(); }
 
 auto Buffer::Capacity() const noexcept -> size_t { return buf_.capacity(); }
@@ -1,6 +1,8 @@
 #include "core/cache.h"
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <functional>
 #include <utility>
 
 namespace Next {
@@ -16,22 +18,35 @@ auto GetTimeUtc() noexcept -> uint64_t {
 Cache::CacheNode::CacheNode() noexcept { UpdataTimeStamp(); }
 Cache::CacheNode::CacheNode(std::string identifier,
                             const std::vector<unsigned char> &data)
-    : identifier_(std::move(identifier)), data_(data) {
+    : identifier_(std::move(identifier)),
+      data_(std::make_shared<const std::vector<unsigned char>>(data)) {
+  UpdataTimeStamp();
+}
+Cache::CacheNode::CacheNode(std::string identifier, SharedBlock data) noexcept
+    : identifier_(std::move(identifier)), data_(std::move(data)) {
   UpdataTimeStamp();
 }
 void Cache::CacheNode::SetIdentifier(const std::string &identifier) {
   identifier_ = identifier;
 }
 void Cache::CacheNode::SetData(const std::vector<unsigned char> &data) {
-  data_ = data;
+  data_ = std::make_shared<const std::vector<unsigned char>>(data);
 }
 void Cache::CacheNode::Serialize(std::vector<unsigned char> &destination) {
-  size_t resource_size = data_.size();
+  if (data_ == nullptr) {
+    return;
+  }
+  size_t resource_size = data_->size();
   size_t buffer_old_size = destination.size();
   destination.reserve(resource_size + buffer_old_size);
-  destination.insert(destination.end(), data_.begin(), data_.end());
+  destination.insert(destination.end(), data_->begin(), data_->end());
+}
+auto Cache::CacheNode::GetData() const noexcept -> const SharedBlock & {
+  return data_;
+}
+auto Cache::CacheNode::Size() const noexcept -> size_t {
+  return data_ == nullptr ? 0 : data_->size();
 }
-auto Cache::CacheNode::Size() const noexcept -> size_t { return data_.size(); }
 void Cache::CacheNode::UpdataTimeStamp() noexcept {
   last_access_ = GetTimeUtc();
 }
@@ -39,76 +54,168 @@ auto Cache::CacheNode::GetTimeStamp() const noexcept -> uint64_t {
   return last_access_;
 }
 
-Cache::Cache(size_t capacity) noexcept
-    : capacity_(capacity), header_(std::make_unique<CacheNode>()),
-      tailer_(std::make_unique<CacheNode>()) {
+Cache::Segment::Segment() noexcept
+    : header_(std::make_shared<CacheNode>()),
+      tailer_(std::make_shared<CacheNode>()) {
   header_->next_ = tailer_.get();
   tailer_->prev_ = header_.get();
 }
 
+Cache::Cache(size_t capacity, size_t segments) : capacity_(capacity) {
+  segments = std::max<size_t>(segments, 1);
+  segments_.reserve(segments);
+  for (size_t i = 0; i < segments; i++) {
+    segments_.push_back(std::make_unique<Segment>());
+  }
+}
+
 auto Cache::GetOccupancy() const noexcept -> size_t { return occupancy_; }
 auto Cache::GetCapacity() const noexcept -> size_t { return capacity_; }
+auto Cache::GetSegmentCount() const noexcept -> size_t {
+  return segments_.size();
+}
+
+auto Cache::SegmentOf(const std::string &url) noexcept -> Segment & {
+  return *segments_[std::hash<std::string>{}(url) % segments_.size()];
+}
 
 auto Cache::TryLoad(const std::string &resource_url,
                     std::vector<unsigned char> &destination) -> bool {
-  std::shared_lock<std::shared_mutex> lock(mtx_);
-  auto iter = mapping_.find(resource_url);
-  if (iter != mapping_.end()) {
-    iter->second->Serialize(destination);
-    RemoveFromList(iter->second);
-    AppendToListTail(iter->second);
-    iter->second->UpdataTimeStamp();
-    return true;
+  auto &segment = SegmentOf(resource_url);
+  std::unique_lock<std::mutex> lock(segment.mtx_);
+  auto node = Touch(segment, resource_url);
+  if (node == nullptr) {
+    return false;
   }
-  return false;
+  node->Serialize(destination);
+  return true;
 }
 
 auto Cache::TryInsert(const std::string &resource_url,
                       const std::vector<unsigned char> &source) -> bool {
-  std::shared_lock<std::shared_mutex> lock(mtx_);
-  auto iter = mapping_.find(resource_url);
-  if (iter != mapping_.end()) {
+  return TryInsertShared(
+      resource_url, std::make_shared<const std::vector<unsigned char>>(source));
+}
+
+auto Cache::TryLoadShared(const std::string &resource_url) -> SharedBlock {
+  auto &segment = SegmentOf(resource_url);
+  std::unique_lock<std::mutex> lock(segment.mtx_);
+  auto node = Touch(segment, resource_url);
+  return node == nullptr ? nullptr : node->GetData();
+}
+
+// 先放入所在的分段，再在不持有锁时淘汰，同一时间最多只持有一个分段的锁
+// 并发插入时占用可能短暂超出容量，随后的淘汰会把它降回预算之内
+auto Cache::TryInsertShared(const std::string &resource_url,
+                            SharedBlock source, uint64_t ttl_ms) -> bool {
+  if (source == nullptr) {
     return false;
   }
-  auto source_size = source.size();
+  auto source_size = source->size();
   if (source_size > capacity_) {
     return false;
   }
-  while (!mapping_.empty() && (capacity_ - occupancy_) < source_size) {
-    EvictOne();
+  auto &segment = SegmentOf(resource_url);
+  {
+    std::unique_lock<std::mutex> lock(segment.mtx_);
+    if (segment.mapping_.find(resource_url) != segment.mapping_.end()) {
+      return false;
+    }
+    auto node = std::make_shared<CacheNode>(resource_url, std::move(source));
+    if (ttl_ms != 0) {
+      node->expires_at_ = node->last_access_ + ttl_ms;
+    }
+    node->tick_ = ++clock_;
+    AppendToListTail(segment, node);
+    segment.mapping_.emplace(resource_url, std::move(node));
+    occupancy_ += source_size;
+  }
+  while (occupancy_ > capacity_ && EvictOne()) {
   }
-  auto node = std::make_shared<CacheNode>(resource_url, source);
-  AppendToListTail(node);
-  occupancy_ += source_size;
-  mapping_.emplace(resource_url, node);
   return true;
 }
 
 void Cache::Clear() {
-  header_->next_ = tailer_.get();
-  tailer_->prev_ = header_.get();
-  mapping_.clear();
-  occupancy_ = 0;
+  for (auto &segment : segments_) {
+    std::unique_lock<std::mutex> lock(segment->mtx_);
+    while (!segment->mapping_.empty()) {
+      Remove(*segment, segment->mapping_.begin());
+    }
+  }
 }
 
-void Cache::EvictOne() noexcept {
-  // lru策略，第一个是最久未使用的。
-  auto *first_node = header_->next_;
-  auto resource_size = first_node->Size();
-  auto iter = mapping_.find(first_node->identifier_); // friend
-  assert(iter != mapping_.end());
+auto Cache::Touch(Segment &segment, const std::string &url) noexcept
+    -> std::shared_ptr<CacheNode> {
+  auto iter = segment.mapping_.find(url);
+  if (iter == segment.mapping_.end()) {
+    return nullptr;
+  }
+  auto expires_at = iter->second->expires_at_;
+  if (expires_at != 0 && GetTimeUtc() >= expires_at) {
+    Remove(segment, iter);
+    return nullptr;
+  }
   RemoveFromList(iter->second);
-  mapping_.erase(iter);
-  occupancy_ -= resource_size;
+  AppendToListTail(segment, iter->second);
+  iter->second->UpdataTimeStamp();
+  iter->second->tick_ = ++clock_;
+  return iter->second;
 }
 
-void Cache::EvictOneByUrl(const std::string& url) noexcept {
-  auto iter = mapping_.find(url); // friend
-  assert(iter != mapping_.end());
-  auto resource_size = iter->second->Size();
+void Cache::Remove(
+    Segment &segment,
+    std::unordered_map<std::string, std::shared_ptr<CacheNode>>::iterator
+        iter) noexcept {
+  occupancy_ -= iter->second->Size();
   RemoveFromList(iter->second);
-  mapping_.erase(iter);
-  occupancy_ -= resource_size;
+  segment.mapping_.erase(iter);
+}
+
+auto Cache::EvictOne() noexcept -> bool {
+  // lru策略，每个分段的第一个是它最久未使用的，其中序号最小的是全局最久未使用的
+  Segment *victim = nullptr;
+  uint64_t oldest = 0;
+  for (auto &segment : segments_) {
+    std::unique_lock<std::mutex> lock(segment->mtx_);
+    auto *first_node = segment->header_->next_;
+    if (first_node != segment->tailer_.get() &&
+        (victim == nullptr || first_node->tick_ < oldest)) {
+      victim = segment.get();
+      oldest = first_node->tick_;
+    }
+  }
+  if (victim == nullptr) {
+    return false;
+  }
+  // 比较之后头部可能已被访问或删除，这时淘汰它新的头部，仍然能降低占用
+  std::unique_lock<std::mutex> lock(victim->mtx_);
+  auto *first_node = victim->header_->next_;
+  if (first_node == victim->tailer_.get()) {
+    return true;
+  }
+  auto iter = victim->mapping_.find(first_node->identifier_); // friend
+  assert(iter != victim->mapping_.end());
+  Remove(*victim, iter);
+  return true;
+}
+
+void Cache::EvictOneByUrl(const std::string& url) noexcept {
+  auto &segment = SegmentOf(url);
+  std::unique_lock<std::mutex> lock(segment.mtx_);
+  auto iter = segment.mapping_.find(url);
+  assert(iter != segment.mapping_.end());
+  Remove(segment, iter);
+}
+
+auto Cache::Erase(const std::string &url) noexcept -> bool {
+  auto &segment = SegmentOf(url);
+  std::unique_lock<std::mutex> lock(segment.mtx_);
+  auto iter = segment.mapping_.find(url);
+  if (iter == segment.mapping_.end()) {
+    return false;
+  }
+  Remove(segment, iter);
+  return true;
 }
 
 void Cache::RemoveFromList(const std::shared_ptr<CacheNode> &node) noexcept {
@@ -118,12 +225,13 @@ void Cache::RemoveFromList(const std::shared_ptr<CacheNode> &node) noexcept {
   node_prev->next_ = node_next;
   node_next->prev_ = node_prev;
 }
-void Cache::AppendToListTail(const std::shared_ptr<CacheNode> &node) noexcept {
+void Cache::AppendToListTail(Segment &segment,
+                             const std::shared_ptr<CacheNode> &node) noexcept {
   auto *node_ptr = node.get();
-  auto *node_prev = tailer_->prev_;
+  auto *node_prev = segment.tailer_->prev_;
   node_prev->next_ = node_ptr;
-  tailer_->prev_ = node_ptr;
+  segment.tailer_->prev_ = node_ptr;
   node_ptr->prev_ = node_prev;
-  node_ptr->next_ = tailer_.get();
+  node_ptr->next_ = segment.tailer_.get();
 }
 } // namespace Next
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "core/concurrency_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "core/timer.h"
+
+namespace Next {
+
+// 长期/短期延迟指数平均的样本窗口
+static constexpr double LONG_WINDOW = 600;
+static constexpr double SHORT_WINDOW = 10;
+// 短期延迟在长期延迟的这个倍数内不认为发生了排队
+static constexpr double TOLERANCE = 1.5;
+static constexpr double SMOOTHING = 0.2;
+static constexpr double MIN_GRADIENT = 0.5;
+
+ConcurrencyLimiter::Permit::Permit(ConcurrencyLimiter *limiter, uint64_t start) noexcept
+    : limiter_(limiter), start_(start) {}
+
+ConcurrencyLimiter::Permit::Permit(Permit &&other) noexcept : limiter_(other.limiter_), start_(other.start_) {
+  other.limiter_ = nullptr;
+}
+
+auto ConcurrencyLimiter::Permit::operator=(Permit &&other) noexcept -> Permit & {
+  std::swap(limiter_, other.limiter_);
+  std::swap(start_, other.start_);
+  return *this;
+}
+
+ConcurrencyLimiter::Permit::~Permit() {
+  if (limiter_ != nullptr) {
+    auto now = NowSinceEpoch2();
+    limiter_->Release(now > start_ ? now - start_ : 0);
+  }
+}
+
+auto ConcurrencyLimiter::Permit::IsGranted() const noexcept -> bool { return limiter_ != nullptr; }
+
+ConcurrencyLimiter::ConcurrencyLimiter(int initial_limit, int min_limit, int max_limit) noexcept
+    : min_limit_(min_limit),
+      max_limit_(max_limit),
+      estimated_limit_(std::clamp(initial_limit, min_limit, max_limit)),
+      limit_(std::clamp(initial_limit, min_limit, max_limit)) {}
+
+auto ConcurrencyLimiter::TryAcquire() noexcept -> bool {
+  int current = in_flight_.load();
+  do {
+    if (current >= limit_.load()) {
+      rejected_++;
+      return false;
+    }
+  } while (!in_flight_.compare_exchange_weak(current, current + 1));
+  return true;
+}
+
+void ConcurrencyLimiter::Release(uint64_t latency) noexcept {
+  // 归还前的并发数用于判断是否是应用本身负载不足
+  int in_flight = in_flight_.fetch_sub(1);
+  Update(latency, in_flight);
+}
+
+auto ConcurrencyLimiter::TryAcquirePermit() noexcept -> Permit { return TryAcquirePermit(NowSinceEpoch2()); }
+
+auto ConcurrencyLimiter::TryAcquirePermit(uint64_t arrival) noexcept -> Permit {
+  return TryAcquire() ? Permit(this, arrival) : Permit();
+}
+
+auto ConcurrencyLimiter::GetLimit() const noexcept -> int { return limit_.load(); }
+
+auto ConcurrencyLimiter::GetInFlight() const noexcept -> int { return in_flight_.load(); }
+
+auto ConcurrencyLimiter::GetRejected() const noexcept -> uint64_t { return rejected_.load(); }
+
+void ConcurrencyLimiter::Update(uint64_t latency, int in_flight) noexcept {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto sample = static_cast<double>(std::max<uint64_t>(latency, 1));
+  if (long_latency_ == 0) {
+    long_latency_ = sample;
+    short_latency_ = sample;
+  }
+  long_latency_ += (sample - long_latency_) / LONG_WINDOW;
+  short_latency_ += (sample - short_latency_) / SHORT_WINDOW;
+  // 负载下降后长期延迟远高于短期延迟，加速让基准回落
+  if (long_latency_ > 2 * short_latency_) {
+    long_latency_ *= 0.95;
+  }
+  double gradient = std::clamp(TOLERANCE * long_latency_ / short_latency_, MIN_GRADIENT, 1.0);
+  // 并发远低于上限时说明不了上限偏小，不再探测性地增加，否则空闲时上限会一直涨到max_limit_；
+  // 但排队的延迟照样收缩上限，每个reactor同时只处理一个请求，并发数本身很难接近上限
+  double probe = in_flight < estimated_limit_ / 2 ? 0 : std::sqrt(estimated_limit_);
+  double new_limit = estimated_limit_ * gradient + probe;
+  estimated_limit_ = estimated_limit_ * (1 - SMOOTHING) + new_limit * SMOOTHING;
+  estimated_limit_ = std::clamp(estimated_limit_, static_cast<double>(min_limit_), static_cast<double>(max_limit_));
+  limit_ = static_cast<int>(estimated_limit_);
+}
+
+}  // namespace Next
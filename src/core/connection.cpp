@@ -1,5 +1,10 @@
 #include "core/connection.h"
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include "log/logger.h"
 namespace Next {
 Connection::Connection(std::unique_ptr<Socket> socket)
@@ -27,7 +32,9 @@ auto Connection::FindAndPopTill(const std::string &target) -> std::optional<std:
 }
 
 auto Connection::GetReadBufferSize() const noexcept -> size_t { return read_buffer_->Size(); }
-auto Connection::GetWriteBufferSize() const noexcept -> size_t { return write_buffer_->Size(); }
+auto Connection::GetWriteBufferSize() const noexcept -> size_t {
+  return write_buffer_->Size() - write_offset_ + shared_bytes_;
+}
 
 void Connection::WriteToReadBuffer(const unsigned char *buf, size_t size) { read_buffer_->Append(buf, size); }
 void Connection::WriteToReadBuffer(const std::string &str) { read_buffer_->Append(str); }
@@ -37,6 +44,24 @@ void Connection::WriteToWriteBuffer(const std::string &str) { write_buffer_->App
 void Connection::WriteToWriteBuffer(std::vector<unsigned char> &&other_buf) {
   write_buffer_->Append(std::move(other_buf));
 }
+void Connection::WriteToWriteBuffer(SharedBlock block, size_t offset, size_t length) {
+  if (length == 0) {
+    return;
+  }
+  shared_bytes_ += length;
+  shared_slices_.push_back({write_buffer_->Size(), std::move(block), nullptr, offset, length});
+}
+void Connection::WriteToWriteBuffer(SharedFile file, size_t offset, size_t length) {
+  if (length == 0) {
+    return;
+  }
+  shared_bytes_ += length;
+  shared_slices_.push_back({write_buffer_->Size(), nullptr, std::move(file), offset, length});
+}
+void Connection::WriteToWriteBuffer(SharedBlock block) {
+  auto size = block->size();
+  WriteToWriteBuffer(std::move(block), 0, size);
+}
 
 auto Connection::Read() const noexcept -> const unsigned char * { return read_buffer_->Data(); }
 auto Connection::ReadAsString() const noexcept -> std::string {
@@ -44,6 +69,9 @@ auto Connection::ReadAsString() const noexcept -> std::string {
   return {string_view.begin(), string_view.end()};
 }
 
+auto Connection::ReadAsStringView() const noexcept -> std::string_view { return read_buffer_->ToStringView(); }
+void Connection::ConsumeReadBuffer(size_t size) noexcept { read_buffer_->Consume(size); }
+
 /* return std::pair<How many bytes read, whether the client exits> */
 auto Connection::Recv() -> std::pair<ssize_t, bool> {
   int from_fd = GetFd();
@@ -72,29 +100,111 @@ auto Connection::Recv() -> std::pair<ssize_t, bool> {
   }
   return {read, false};
 }
-void Connection::Send() {
-  ssize_t curr_write = 0;
-  ssize_t write;
-  const ssize_t to_write = GetWriteBufferSize();
-  const unsigned char *buf = write_buffer_->Data();
-  while (curr_write < to_write) {
-    write = send(GetFd(), buf + curr_write, to_write - curr_write, 0);
-    if (write < 0) {
-      // 这三种不是错误
-      if (errno != EINTR || errno != EAGAIN || errno != EWOULDBLOCK) {
-        LOG_ERROR("Error in Connection::Send()");
+auto Connection::Send() -> bool {
+  std::vector<iovec> iov;
+  while (GetWriteBufferSize() > 0) {
+    ssize_t written;
+    if (!shared_slices_.empty() && shared_slices_.front().position_ == write_offset_ &&
+        shared_slices_.front().file_ != nullptr) {
+      // 文件区间用sendfile发送，文件内容不经过用户态
+      const auto &slice = shared_slices_.front();
+      auto file_offset = static_cast<off_t>(slice.offset_);
+      written = sendfile(GetFd(), slice.file_->GetFd(), &file_offset, slice.length_);
+      if (written == 0) {
+        // 文件在发送期间被截断
+        LOG_ERROR("Connection::Send(): file is shorter than expected");
         ClearWriteBuffer();
-        return;
+        return false;
+      }
+    } else {
+      GatherIovecs(iov);
+      written = writev(GetFd(), iov.data(), static_cast<int>(iov.size()));
+    }
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // 发送缓冲区已满，剩余的数据等可写事件
+        return true;
+      }
+      LOG_ERROR("Error in Connection::Send()");
+      ClearWriteBuffer();
+      return false;
+    }
+    ConsumeWritten(static_cast<size_t>(written));
+  }
+  return true;
+}
+
+/* 按写入顺序把待发送的写缓冲区各段和共享数据块组装成iovec，遇到文件区间或者达到IOV_MAX时停止 */
+void Connection::GatherIovecs(std::vector<iovec> &iov) {
+  iov.clear();
+  auto *data = const_cast<unsigned char *>(write_buffer_->Data());
+  size_t position = write_offset_;
+  for (const auto &slice : shared_slices_) {
+    if (slice.position_ > position) {
+      iov.push_back({data + position, slice.position_ - position});
+      position = slice.position_;
+    }
+    if (slice.file_ != nullptr || iov.size() >= IOV_MAX - 1) {
+      return;
+    }
+    iov.push_back({const_cast<unsigned char *>(slice.block_->data() + slice.offset_), slice.length_});
+  }
+  if (write_buffer_->Size() > position) {
+    iov.push_back({data + position, write_buffer_->Size() - position});
+  }
+}
+
+/* 丢弃已经发出的written个字节，写缓冲区只移动偏移，全部发完时才清空 */
+void Connection::ConsumeWritten(size_t written) {
+  while (written > 0) {
+    if (!shared_slices_.empty() && shared_slices_.front().position_ == write_offset_) {
+      auto &slice = shared_slices_.front();
+      auto step = std::min(written, slice.length_);
+      slice.offset_ += step;
+      slice.length_ -= step;
+      shared_bytes_ -= step;
+      written -= step;
+      if (slice.length_ == 0) {
+        shared_slices_.pop_front();
       }
-      write = 0;
+      continue;
     }
-    curr_write += write;
+    auto end = shared_slices_.empty() ? write_buffer_->Size() : shared_slices_.front().position_;
+    auto step = std::min(written, end - write_offset_);
+    write_offset_ += step;
+    written -= step;
+  }
+  if (GetWriteBufferSize() == 0) {
+    ClearWriteBuffer();
   }
-  ClearWriteBuffer();
 }
+
 void Connection::ClearReadBuffer() noexcept { read_buffer_->Clear(); }
-void Connection::ClearWriteBuffer() noexcept { write_buffer_->Clear(); }
+void Connection::ClearWriteBuffer() noexcept {
+  write_buffer_->Clear();
+  write_offset_ = 0;
+  shared_slices_.clear();
+  shared_bytes_ = 0;
+}
 
 void Connection::SetLooper(Looper *looper) noexcept { owner_looper_ = looper; }
 auto Connection::GetLooper() noexcept -> Looper * { return owner_looper_; }
+
+void Connection::SetContext(std::any context) { context_ = std::move(context); }
+auto Connection::GetContext() noexcept -> std::any & { return context_; }
+
+auto Connection::GetOffloadState() const noexcept -> OffloadState { return offload_state_; }
+
+void Connection::SetOffloadState(OffloadState state) noexcept { offload_state_ = state; }
+
+auto Connection::DeferIfOffloaded() noexcept -> bool {
+  auto expected = OffloadState::RUNNING;
+  if (offload_state_.compare_exchange_strong(expected, OffloadState::DEFERRED)) {
+    return true;
+  }
+  return expected == OffloadState::DEFERRED;
+}
 }  // namespace Next
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "core/fd_cache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+
+namespace Next {
+
+OpenFile::OpenFile(int fd) noexcept : fd_(fd) {}
+
+OpenFile::~OpenFile() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+auto OpenFile::Open(const std::string &path) -> SharedFile {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return nullptr;
+  }
+  return std::make_shared<const OpenFile>(fd);
+}
+
+auto OpenFile::GetFd() const noexcept -> int { return fd_; }
+
+FdCache::FdCache(size_t capacity) : shard_capacity_(std::max<size_t>(1, capacity / FD_CACHE_SHARD_COUNT)) {}
+
+auto FdCache::Find(const std::string &path) -> SharedFile {
+  auto &shard = GetShard(path);
+  std::lock_guard<std::mutex> lock(shard.mtx_);
+  auto iter = shard.mapping_.find(path);
+  if (iter == shard.mapping_.end()) {
+    return nullptr;
+  }
+  shard.lru_.splice(shard.lru_.begin(), shard.lru_, iter->second);
+  return iter->second->second;
+}
+
+auto FdCache::Insert(const std::string &path, SharedFile file) -> SharedFile {
+  auto &shard = GetShard(path);
+  SharedFile evicted;
+  std::lock_guard<std::mutex> lock(shard.mtx_);
+  auto iter = shard.mapping_.find(path);
+  if (iter != shard.mapping_.end()) {
+    shard.lru_.splice(shard.lru_.begin(), shard.lru_, iter->second);
+    return iter->second->second;
+  }
+  if (shard.mapping_.size() >= shard_capacity_) {
+    // 淘汰最久未使用的，在释放锁之后、没有传输引用它时关闭fd
+    evicted = std::move(shard.lru_.back().second);
+    shard.mapping_.erase(shard.lru_.back().first);
+    shard.lru_.pop_back();
+  }
+  shard.lru_.emplace_front(path, std::move(file));
+  shard.mapping_.emplace(path, shard.lru_.begin());
+  return shard.lru_.front().second;
+}
+
+auto FdCache::Erase(const std::string &path) -> bool {
+  auto &shard = GetShard(path);
+  SharedFile erased;
+  std::lock_guard<std::mutex> lock(shard.mtx_);
+  auto iter = shard.mapping_.find(path);
+  if (iter == shard.mapping_.end()) {
+    return false;
+  }
+  erased = std::move(iter->second->second);
+  shard.lru_.erase(iter->second);
+  shard.mapping_.erase(iter);
+  return true;
+}
+
+auto FdCache::Size() const -> size_t {
+  size_t size = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mtx_);
+    size += shard.mapping_.size();
+  }
+  return size;
+}
+
+auto FdCache::GetCapacity() const noexcept -> size_t { return shard_capacity_ * FD_CACHE_SHARD_COUNT; }
+
+auto FdCache::GetShard(const std::string &path) -> Shard & {
+  return shards_[std::hash<std::string>{}(path) % FD_CACHE_SHARD_COUNT];
+}
+
+}  // namespace Next
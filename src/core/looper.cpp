@@ -1,5 +1,10 @@
 #include "core/looper.h"
 
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
 #include "core/acceptor.h"
 #include "core/connection.h"
 #include "core/poller.h"
@@ -13,26 +18,43 @@ Looper::Looper(uint64_t timer_expiration)
   if (use_timer_) {
     poller_->AddConnection(timer_.GetTimerConnection());
   }
+  // eventfd用于其他线程向本looper投递任务时唤醒epoll_wait
+  int wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd < 0) {
+    LOG_FATAL("Looper() : eventfd fails");
+    exit(EXIT_FAILURE);
+  }
+  wakeup_conn_ = std::make_unique<Connection>(std::make_unique<Socket>(wakeup_fd));
+  wakeup_conn_->SetEvents(POLL_READ | POLL_ET);
+  wakeup_conn_->SetCallback([this](Connection *) { HandleWakeup(); });
+  poller_->AddConnection(wakeup_conn_.get());
+}
+
+// 连接先于watcher销毁，它们的析构函数可能还要移除watcher
+Looper::~Looper() {
+  std::map<int, std::unique_ptr<Connection>> connections;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    connections.swap(connections_);
+  }
+  connections.clear();
+  ReleaseRetired();
 }
 
 // 通过poller_->Poll获取epoll中就绪的事件对应的connection，然后执行他们的回调conn->GetCallback()();
 void Looper::Loop() {
   while (!exit_) {
-    auto ready_connections = poller_->Poll(TIMEOUT);
-    Connection *timer_conn = nullptr;
-
-    for (auto &conn : ready_connections) {
-      if (conn == timer_.GetTimerConnection()) {
-        timer_conn = conn;
-        continue;
-      }
-      conn->GetCallback()();
-    }
-
-    if (timer_conn != nullptr) {
-      timer_conn->GetCallback()();
+    Dispatch(poller_->Poll(TIMEOUT));
+    if (max_spin_budget_ != 0) {
+      BusyPoll();
     }
   }
+  // 退出时输出自旋统计，便于评估busy poll的CPU开销是否换来了足够的命中
+  if (spin_time_ != 0) {
+    LOG_INFO("looper busy poll spun " + std::to_string(GetSpinTime() / 1000) + " us, caught " +
+             std::to_string(GetSpinHits()) + " events while spinning, final budget " +
+             std::to_string(GetSpinBudget()) + " us");
+  }
 }
 
 void Looper::AddAcceptor(Connection *acceptor_conn) {
@@ -45,15 +67,7 @@ void Looper::AddConnection(std::unique_ptr<Connection> new_conn) {
   poller_->AddConnection(new_conn.get());
   int fd = new_conn->GetFd();
   connections_.insert({fd, std::move(new_conn)});
-  if (use_timer_) {
-    auto singletimer =
-        timer_.AddSingleTimer(timer_expiration_, [this, fd = fd]() {
-          LOG_INFO("client fd =" + std::to_string(fd) +
-                   "has expired and will be kicked out");
-          DeleteConnection(fd);
-        });
-    timers_mapping_.insert({fd, singletimer});
-  }
+  AddTimer(fd);
 }
 
 auto Looper::RefreshConnection(int fd) noexcept -> bool {
@@ -65,7 +79,7 @@ auto Looper::RefreshConnection(int fd) noexcept -> bool {
   if (use_timer_ && it != timers_mapping_.end()) {
     auto new_timer = timer_.RefreshSingleTimer(it->second, timer_expiration_);
     if (new_timer != nullptr) {
-      timers_mapping_.insert({fd, new_timer});
+      it->second = new_timer;
     }
     return true;
   }
@@ -78,9 +92,14 @@ auto Looper::DeleteConnection(int fd) noexcept -> bool {
   if (it == connections_.end()) {
     return false;
   }
+  // fd可能还被其他进程持有(例如fork出的子进程)，关闭它不一定能把它移出epoll
+  // 正在offload的连接定时器已被挂起
+  bool offloaded = it->second->GetOffloadState() != Connection::OffloadState::NONE;
+  poller_->RemoveConnection(it->second.get());
+  retired_.push_back(std::move(it->second));
   connections_.erase(it);
   // 再删除这个连接对应的timer
-  if (use_timer_) {
+  if (use_timer_ && !offloaded) {
     auto timer_it = timers_mapping_.find(fd);
     if (timer_it != timers_mapping_.end()) {
       timer_.RemoveSingleTimer(timer_it->second);
@@ -93,5 +112,237 @@ auto Looper::DeleteConnection(int fd) noexcept -> bool {
   return true;
 }
 
+void Looper::AddWatcher(std::unique_ptr<Connection> watcher) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  poller_->AddConnection(watcher.get());
+  int fd = watcher->GetFd();
+  watchers_[fd] = std::move(watcher);
+}
+
+auto Looper::RemoveWatcher(int fd) noexcept -> bool {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto it = watchers_.find(fd);
+  if (it == watchers_.end()) {
+    return false;
+  }
+  poller_->RemoveConnection(it->second.get());
+  retired_.push_back(std::move(it->second));
+  watchers_.erase(it);
+  return true;
+}
+
+void Looper::RunInLoop(std::function<void()> task) {
+  {
+    std::unique_lock<std::mutex> lock(task_mtx_);
+    pending_tasks_.push_back(std::move(task));
+  }
+  uint64_t one = 1;
+  if (write(wakeup_conn_->GetFd(), &one, sizeof one) != sizeof one) {
+    LOG_ERROR("Looper: RunInLoop() fails to wake up the looper");
+  }
+}
+
+void Looper::SetOffloadPool(ThreadPool *offload_pool) noexcept { offload_pool_ = offload_pool; }
+
+void Looper::Offload(int fd, std::function<void()> job, std::function<void(Connection *)> on_complete) {
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+      LOG_ERROR("Looper: Offload() the fd " + std::to_string(fd) + " not in connections_");
+      return;
+    }
+    it->second->SetOffloadState(Connection::OffloadState::RUNNING);
+    SuspendTimer(fd);
+  }
+  auto task = [this, fd, job = std::move(job), on_complete = std::move(on_complete)]() {
+    try {
+      job();
+    } catch (const std::exception &e) {
+      LOG_ERROR("Looper: Offload() job throws: " + std::string(e.what()));
+    }
+    RunInLoop([this, fd, on_complete]() { CompleteOffload(fd, on_complete); });
+  };
+  if (offload_pool_ == nullptr) {
+    task();
+    return;
+  }
+  offload_pool_->SubmitTask(std::move(task));
+}
+
+auto Looper::IsOffloaded(int fd) noexcept -> bool {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto it = connections_.find(fd);
+  return it != connections_.end() && it->second->GetOffloadState() != Connection::OffloadState::NONE;
+}
+
 void Looper::Exit() noexcept { exit_ = true; }
-} // namespace Next
\ No newline at end of file
+
+// 调用者需持有mtx_
+void Looper::AddTimer(int fd) {
+  if (!use_timer_) {
+    return;
+  }
+  auto singletimer = timer_.AddSingleTimer(timer_expiration_, [this, fd = fd]() {
+    LOG_INFO("client fd =" + std::to_string(fd) + "has expired and will be kicked out");
+    DeleteConnection(fd);
+  });
+  timers_mapping_[fd] = singletimer;
+}
+
+// 调用者需持有mtx_
+void Looper::SuspendTimer(int fd) {
+  if (!use_timer_) {
+    return;
+  }
+  auto timer_it = timers_mapping_.find(fd);
+  if (timer_it != timers_mapping_.end()) {
+    timer_.RemoveSingleTimer(timer_it->second);
+    timers_mapping_.erase(timer_it);
+  }
+}
+
+void Looper::CompleteOffload(int fd, const std::function<void(Connection *)> &on_complete) {
+  Connection *conn = nullptr;
+  bool deferred = false;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto conn_it = connections_.find(fd);
+    if (conn_it == connections_.end() ||
+        conn_it->second->GetOffloadState() == Connection::OffloadState::NONE) {
+      LOG_WARNING("Looper: the fd " + std::to_string(fd) + " is gone before its offloaded job completes");
+      return;
+    }
+    conn = conn_it->second.get();
+    deferred = conn->GetOffloadState() == Connection::OffloadState::DEFERRED;
+    conn->SetOffloadState(Connection::OffloadState::NONE);
+    AddTimer(fd);
+  }
+  on_complete(conn);
+  // on_complete可能再次Offload或者删除了连接，只有连接仍然空闲时才补上被推迟的事件
+  if (!deferred) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (connections_.find(fd) == connections_.end()) {
+      return;
+    }
+    if (conn->GetOffloadState() != Connection::OffloadState::NONE) {
+      conn->SetOffloadState(Connection::OffloadState::DEFERRED);
+      return;
+    }
+  }
+  conn->GetCallback()();
+}
+
+void Looper::HandleWakeup() {
+  uint64_t count;
+  if (read(wakeup_conn_->GetFd(), &count, sizeof count) != sizeof count) {
+    LOG_ERROR("Looper: HandleWakeup() read from wakeup fd doesn't get a byte of 8");
+  }
+}
+
+void Looper::SetBusyPoll(uint64_t max_spin_us) noexcept {
+  max_spin_budget_ = max_spin_us;
+  spin_budget_ = max_spin_us;
+}
+
+auto Looper::GetSpinTime() const noexcept -> uint64_t { return spin_time_; }
+
+auto Looper::GetSpinHits() const noexcept -> uint64_t { return spin_hits_; }
+
+auto Looper::GetSpinBudget() const noexcept -> uint64_t { return spin_budget_; }
+
+auto Looper::GetEventTime() const noexcept -> uint64_t { return event_time_; }
+
+void Looper::Dispatch(const std::vector<Connection *> &ready_connections) {
+  Connection *timer_conn = nullptr;
+  event_time_ = NowSinceEpoch2();
+
+  for (auto &conn : ready_connections) {
+    if (conn == timer_.GetTimerConnection()) {
+      timer_conn = conn;
+      continue;
+    }
+    if (IsRetired(conn)) {
+      continue;
+    }
+    // job执行期间到达的事件先记下，等job完成后再处理，状态在连接上，不需要加锁
+    if (conn->DeferIfOffloaded()) {
+      continue;
+    }
+    conn->GetCallback()();
+  }
+
+  if (timer_conn != nullptr) {
+    timer_conn->GetCallback()();
+  }
+
+  RunPendingTasks();
+  ReleaseRetired();
+}
+
+auto Looper::IsRetired(Connection *conn) noexcept -> bool {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return std::any_of(retired_.begin(), retired_.end(),
+                     [conn](const std::unique_ptr<Connection> &retired) { return retired.get() == conn; });
+}
+
+// 在锁外销毁，析构时可能再删除其他watcher
+void Looper::ReleaseRetired() {
+  while (true) {
+    std::vector<std::unique_ptr<Connection>> retired;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      if (retired_.empty()) {
+        return;
+      }
+      retired.swap(retired_);
+    }
+    retired.clear();
+  }
+}
+
+// 处理完一批事件后不立即阻塞，先用0超时的Poll自旋，负载高时下一个请求大概率在预算内到达
+// 自旋时间只统计空转的部分，不包括处理自旋期间捕获事件的时间
+void Looper::BusyPoll() {
+  uint64_t max_budget = max_spin_budget_;
+  uint64_t min_budget = std::min(MIN_SPIN_BUDGET, max_budget);
+  uint64_t budget = std::clamp<uint64_t>(spin_budget_, min_budget, max_budget);
+  uint64_t spin_start = NowSinceEpoch2();
+  uint64_t deadline = spin_start + budget * 1000;
+  while (!exit_ && max_spin_budget_ != 0) {
+    auto ready_connections = poller_->Poll(0);
+    uint64_t now = NowSinceEpoch2();
+    if (!ready_connections.empty()) {
+      spin_hits_++;
+      spin_time_ += now - spin_start;
+      // 自旋有收获，说明负载足够，放宽预算
+      budget = std::min(budget * 2, max_budget);
+      Dispatch(ready_connections);
+      spin_start = NowSinceEpoch2();
+      deadline = spin_start + budget * 1000;
+      continue;
+    }
+    if (now >= deadline) {
+      spin_time_ += now - spin_start;
+      // 空转到期，收紧预算
+      budget = std::max(budget / 2, min_budget);
+      break;
+    }
+  }
+  spin_budget_ = budget;
+}
+
+void Looper::RunPendingTasks() {
+  std::vector<std::function<void()>> tasks;
+  {
+    std::unique_lock<std::mutex> lock(task_mtx_);
+    tasks.swap(pending_tasks_);
+  }
+  for (auto &task : tasks) {
+    task();
+  }
+}
+}  // namespace Next
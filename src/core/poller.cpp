@@ -38,6 +38,12 @@ void Poller::AddConnection(Connection *conn) {
     }
 }
 
+void Poller::RemoveConnection(Connection *conn) {
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->GetFd(), nullptr) == -1) {
+        perror("Poller: epoll_ctl del error");
+    }
+}
+
 auto Poller::Poll(int timeout) -> std::vector<Connection *> {
     std::vector<Connection *> events_happen;
     // timeout 参数传 -1 意味着无限期等待，直到至少一个监视的文件描述符上发生了一个事件
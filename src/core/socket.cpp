@@ -1,5 +1,7 @@
 #include "core/socket.h"
 #include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <cassert>
@@ -68,7 +70,8 @@ void Socket::Listen() {
 
 auto Socket::Accept(NetAddress &client_addr) -> int {
   assert(fd_ != -1 && "cannot Accept with invaild fd");
-  int clien_fd = accept(fd_, client_addr.ToSockaddr(), client_addr.getSocklen());
+  // close-on-exec，cgi子进程不会继承客户端连接
+  int clien_fd = accept4(fd_, client_addr.ToSockaddr(), client_addr.getSocklen(), SOCK_CLOEXEC);
   if (clien_fd == -1) {
     // 高压力下，accept可能会失败，但服务器不能因为这个失败终止掉。
     LOG_WARNING("Socket: Accept() error");
@@ -96,9 +99,9 @@ void Socket::SetNonBlocking() {
 
 void Socket::CreateByProtocol(Protocol protocol) {
   if (protocol == Protocol::Ipv4) {
-    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
   } else {
-    fd_ = socket(AF_INET6, SOCK_STREAM, 0);
+    fd_ = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
   }
   if (fd_ == -1) {
     LOG_ERROR("Socket: socket() error");
@@ -111,4 +114,92 @@ auto Socket::GetAttr() -> int {
   return fcntl(fd_, F_GETFL);
 }
 
+void Socket::SetNoDelay(bool on) { SetIntOption(IPPROTO_TCP, TCP_NODELAY, on ? 1 : 0, "SetNoDelay"); }
+
+auto Socket::GetNoDelay() const -> bool { return GetIntOption(IPPROTO_TCP, TCP_NODELAY, "GetNoDelay") != 0; }
+
+void Socket::SetDeferAccept(int seconds) { SetIntOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds, "SetDeferAccept"); }
+
+auto Socket::GetDeferAccept() const -> int { return GetIntOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, "GetDeferAccept"); }
+
+void Socket::SetFastOpen(int queue_length) { SetIntOption(IPPROTO_TCP, TCP_FASTOPEN, queue_length, "SetFastOpen"); }
+
+auto Socket::GetFastOpen() const -> int { return GetIntOption(IPPROTO_TCP, TCP_FASTOPEN, "GetFastOpen"); }
+
+void Socket::SetSendBufferSize(int size) { SetIntOption(SOL_SOCKET, SO_SNDBUF, size, "SetSendBufferSize"); }
+
+auto Socket::GetSendBufferSize() const -> int { return GetIntOption(SOL_SOCKET, SO_SNDBUF, "GetSendBufferSize"); }
+
+void Socket::SetRecvBufferSize(int size) { SetIntOption(SOL_SOCKET, SO_RCVBUF, size, "SetRecvBufferSize"); }
+
+auto Socket::GetRecvBufferSize() const -> int { return GetIntOption(SOL_SOCKET, SO_RCVBUF, "GetRecvBufferSize"); }
+
+void Socket::SetBusyPoll(int usecs) { SetIntOption(SOL_SOCKET, SO_BUSY_POLL, usecs, "SetBusyPoll"); }
+
+auto Socket::GetBusyPoll() const -> int { return GetIntOption(SOL_SOCKET, SO_BUSY_POLL, "GetBusyPoll"); }
+
+void Socket::ApplyListenerOptions(const SocketOptions &options) {
+  if (options.tcp_nodelay) {
+    SetNoDelay(true);
+  }
+  if (options.defer_accept > 0) {
+    SetDeferAccept(options.defer_accept);
+  }
+  if (options.fast_open > 0) {
+    SetFastOpen(options.fast_open);
+  }
+  if (options.send_buffer_size > 0) {
+    SetSendBufferSize(options.send_buffer_size);
+  }
+  if (options.recv_buffer_size > 0) {
+    SetRecvBufferSize(options.recv_buffer_size);
+  }
+  if (options.busy_poll > 0) {
+    SetBusyPoll(options.busy_poll);
+  }
+}
+
+auto Socket::ApplyConnectionOptions(const SocketOptions &options) -> bool {
+  bool applied = true;
+  if (options.tcp_nodelay) {
+    applied = TrySetIntOption(IPPROTO_TCP, TCP_NODELAY, 1, "SetNoDelay") && applied;
+  }
+  if (options.send_buffer_size > 0) {
+    applied = TrySetIntOption(SOL_SOCKET, SO_SNDBUF, options.send_buffer_size, "SetSendBufferSize") && applied;
+  }
+  if (options.recv_buffer_size > 0) {
+    applied = TrySetIntOption(SOL_SOCKET, SO_RCVBUF, options.recv_buffer_size, "SetRecvBufferSize") && applied;
+  }
+  if (options.busy_poll > 0) {
+    applied = TrySetIntOption(SOL_SOCKET, SO_BUSY_POLL, options.busy_poll, "SetBusyPoll") && applied;
+  }
+  return applied;
+}
+
+void Socket::SetIntOption(int level, int option_name, int value, const char *caller) {
+  if (!TrySetIntOption(level, option_name, value, caller)) {
+    throw std::logic_error("Socket: " + std::string(caller) + "() error");
+  }
+}
+
+auto Socket::TrySetIntOption(int level, int option_name, int value, const char *caller) -> bool {
+  assert(fd_ != -1 && "cannot set socket option with invaild fd");
+  if (setsockopt(fd_, level, option_name, &value, sizeof value) == -1) {
+    LOG_ERROR("Socket: " + std::string(caller) + "() error");
+    return false;
+  }
+  return true;
+}
+
+auto Socket::GetIntOption(int level, int option_name, const char *caller) const -> int {
+  assert(fd_ != -1 && "cannot get socket option with invaild fd");
+  int value = 0;
+  socklen_t len = sizeof value;
+  if (getsockopt(fd_, level, option_name, &value, &len) == -1) {
+    LOG_ERROR("Socket: " + std::string(caller) + "() error");
+    throw std::logic_error("Socket: " + std::string(caller) + "() error");
+  }
+  return value;
+}
+
 }  // namespace Next
@@ -1,32 +1,25 @@
 #include "core/thread_pool.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace Next {
-ThreadPool::ThreadPool(int size) {
+
+// 自旋等待时让出流水线资源给同核的超线程
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+ThreadPool::ThreadPool(int size, size_t queue_capacity)
+    : tasks_(queue_capacity), spin_limit_(std::thread::hardware_concurrency() > 1 ? SPIN_BEFORE_PARK : 0) {
   size = std::max(size, MIN_NUM_THREADS_IN_POOL);
   for (int i = 0; i < size; i++) {
-    threads_.emplace_back([this]() {
-      while (true) {
-        std::function<void()> next_task;
-        {
-          std::unique_lock<std::mutex> lock(mtx_);
-          // wait 函数首先会评估谓词函数，如果谓词返回 true，则表示条件已满足，wait 函数将不会阻塞当前线程，直接返回。
-          /**
-           * 如果谓词返回 false，则 wait 函数会自动释放锁，并阻塞当前线程，直到其他线程在相同的 std::condition_variable
-           * 对象上调用 notify_one 或 notify_all。一旦当前线程被唤醒（无论是由于通知还是因为spurious wakeups），wait
-           * 函数会再次自动获取锁，并重新评估谓词。只有当谓词评估为 true 时，wait
-           * 才会返回，这确保了在返回前条件已经满足。
-           */
-          cv_.wait(lock, [this]() { return exit_ || !tasks_.empty(); });
-          if (exit_ && tasks_.empty()) {
-            return;
-          }
-
-          next_task = tasks_.front();
-          tasks_.pop();
-        }
-        next_task();
-      }
-    });
+    threads_.emplace_back([this]() { WorkerLoop(); });
   }
 }
 
@@ -41,8 +34,90 @@ ThreadPool::~ThreadPool() {
 
 void ThreadPool::Exit() {
   exit_ = true;
-  cv_.notify_all();  // 唤醒阻塞在cv.wait的所有线程
+  WakeUp(true);  // 唤醒阻塞在cv.wait的所有线程
 }
 
 auto ThreadPool::GetSize() const noexcept -> size_t { return threads_.size(); }
-}  // namespace Next
\ No newline at end of file
+
+void ThreadPool::Enqueue(std::function<void()> &&task) {
+  if (tasks_.TryPush(std::move(task))) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mtx_);
+  overflow_tasks_.push(std::move(task));
+  overflow_size_++;
+}
+
+auto ThreadPool::TryDequeue(std::function<void()> &task) -> bool {
+  if (tasks_.TryPop(task)) {
+    return true;
+  }
+  if (overflow_size_.load() == 0) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (overflow_tasks_.empty()) {
+    return false;
+  }
+  task = std::move(overflow_tasks_.front());
+  overflow_tasks_.pop();
+  overflow_size_--;
+  return true;
+}
+
+auto ThreadPool::HasTask() const noexcept -> bool { return tasks_.SizeApprox() > 0 || overflow_size_.load() > 0; }
+
+/**
+ * 生产者入队后检查sleepers_，worker在检查队列前先增加sleepers_，
+ * 二者都是顺序一致的原子操作，所以至少有一方能看到对方，不会丢失唤醒
+ * 没有worker在park时生产者不需要碰mtx_
+ */
+void ThreadPool::WakeUp(bool all) {
+  if (sleepers_.load() == 0) {
+    return;
+  }
+  { std::unique_lock<std::mutex> lock(mtx_); }
+  if (all) {
+    cv_.notify_all();
+  } else {
+    cv_.notify_one();
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  std::function<void()> next_task;
+  while (true) {
+    bool got_task = false;
+    // 先自旋一段时间，突发的小任务不需要付出park/unpark的代价
+    for (int i = 0; i < spin_limit_; i++) {
+      if (TryDequeue(next_task)) {
+        got_task = true;
+        break;
+      }
+      if (exit_) {
+        break;
+      }
+      CpuRelax();
+    }
+    if (!got_task && TryDequeue(next_task)) {
+      got_task = true;
+    }
+    if (!got_task) {
+      std::unique_lock<std::mutex> lock(mtx_);
+      sleepers_++;
+      // wait 函数首先会评估谓词函数，如果谓词返回 true，则表示条件已满足，wait 函数将不会阻塞当前线程，直接返回。
+      cv_.wait(lock, [this]() { return exit_ || HasTask(); });
+      sleepers_--;
+      lock.unlock();
+      if (!TryDequeue(next_task)) {
+        if (exit_ && !HasTask()) {
+          return;
+        }
+        continue;
+      }
+    }
+    next_task();
+    next_task = nullptr;
+  }
+}
+}  // namespace Next
@@ -0,0 +1,151 @@
+#include "http/body_decoder.h"
+#include <algorithm>
+
+namespace Next::Http {
+
+/* chunk大小最多15个十六进制位，避免溢出 */
+static constexpr size_t MAX_CHUNK_SIZE_DIGITS = 15;
+
+static constexpr auto HexValue(char c) noexcept -> int {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+auto BodyDecoder::MakeContentLengthDecoder(size_t content_length) noexcept -> BodyDecoder {
+  BodyDecoder decoder;
+  decoder.remaining_ = content_length;
+  decoder.state_ = (content_length == 0) ? State::DONE : State::FIXED;
+  return decoder;
+}
+
+auto BodyDecoder::MakeChunkedDecoder() noexcept -> BodyDecoder {
+  BodyDecoder decoder;
+  decoder.state_ = State::CHUNK_SIZE;
+  return decoder;
+}
+
+auto BodyDecoder::Decode(std::string_view data, const BodyCallback &on_data) -> BodyStatus {
+  consumed_ = 0;
+  if (error_ != nullptr) {
+    return BodyStatus::ERROR;
+  }
+  size_t pos = 0;
+  while (pos < data.size() && state_ != State::DONE) {
+    if (state_ == State::FIXED || state_ == State::CHUNK_DATA) {
+      // 数据部分整段交出，不逐字节处理
+      auto length = static_cast<size_t>(std::min<uint64_t>(remaining_, data.size() - pos));
+      on_data(data.substr(pos, length));
+      pos += length;
+      received_ += length;
+      remaining_ -= length;
+      if (remaining_ == 0) {
+        state_ = (state_ == State::FIXED) ? State::DONE : State::CHUNK_DATA_CR;
+      }
+      continue;
+    }
+    char c = data[pos];
+    if (++line_bytes_ > MAX_CHUNK_LINE_SIZE) {
+      return Fail("Chunk line is too long");
+    }
+    switch (state_) {
+      case State::CHUNK_SIZE:
+        if (int value = HexValue(c); value >= 0) {
+          if (++chunk_size_digits_ > MAX_CHUNK_SIZE_DIGITS) {
+            return Fail("Chunk size is too large");
+          }
+          remaining_ = (remaining_ << 4U) | static_cast<uint64_t>(value);
+        } else if (chunk_size_digits_ == 0) {
+          return Fail("Missing chunk size");
+        } else if (c == '\r') {
+          state_ = State::CHUNK_SIZE_LF;
+        } else if (c == ';' || c == ' ' || c == '\t') {
+          state_ = State::CHUNK_EXTENSION;
+        } else {
+          return Fail("Invalid chunk size");
+        }
+        break;
+      case State::CHUNK_EXTENSION:
+        // 忽略chunk扩展
+        if (c == '\r') {
+          state_ = State::CHUNK_SIZE_LF;
+        } else if (c == '\n') {
+          return Fail("Chunk size line is not ended with \r\n");
+        }
+        break;
+      case State::CHUNK_SIZE_LF:
+        if (c != '\n') {
+          return Fail("Chunk size line is not ended with \r\n");
+        }
+        line_bytes_ = 0;
+        chunk_size_digits_ = 0;
+        // 大小为0的chunk表示请求体结束，后面是可选的trailer
+        state_ = (remaining_ == 0) ? State::TRAILER_LINE_START : State::CHUNK_DATA;
+        break;
+      case State::CHUNK_DATA_CR:
+        if (c != '\r') {
+          return Fail("Chunk data is not ended with \r\n");
+        }
+        state_ = State::CHUNK_DATA_LF;
+        break;
+      case State::CHUNK_DATA_LF:
+        if (c != '\n') {
+          return Fail("Chunk data is not ended with \r\n");
+        }
+        line_bytes_ = 0;
+        state_ = State::CHUNK_SIZE;
+        break;
+      case State::TRAILER_LINE_START:
+        state_ = (c == '\r') ? State::TRAILER_END_LF : State::TRAILER_LINE;
+        break;
+      case State::TRAILER_LINE:
+        if (c == '\r') {
+          state_ = State::TRAILER_LINE_LF;
+        }
+        break;
+      case State::TRAILER_LINE_LF:
+        if (c != '\n') {
+          return Fail("Trailer line is not ended with \r\n");
+        }
+        line_bytes_ = 0;
+        state_ = State::TRAILER_LINE_START;
+        break;
+      case State::TRAILER_END_LF:
+        if (c != '\n') {
+          return Fail("Chunked body is not ended with \r\n\r\n");
+        }
+        state_ = State::DONE;
+        break;
+      case State::FIXED:
+      case State::CHUNK_DATA:
+      case State::DONE:
+        break;
+    }
+    pos++;
+  }
+  consumed_ = pos;
+  return (state_ == State::DONE) ? BodyStatus::COMPLETE : BodyStatus::INCOMPLETE;
+}
+
+auto BodyDecoder::Consumed() const noexcept -> size_t { return consumed_; }
+
+auto BodyDecoder::GetReceived() const noexcept -> size_t { return received_; }
+
+auto BodyDecoder::IsComplete() const noexcept -> bool { return state_ == State::DONE; }
+
+auto BodyDecoder::GetError() const noexcept -> const char * { return error_; }
+
+auto BodyDecoder::Fail(const char *reason) noexcept -> BodyStatus {
+  error_ = reason;
+  consumed_ = 0;
+  return BodyStatus::ERROR;
+}
+
+}  // namespace Next::Http
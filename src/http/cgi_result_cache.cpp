@@ -0,0 +1,180 @@
+#include "http/cgi_result_cache.h"
+
+#include <algorithm>
+
+#include "core/looper.h"
+
+namespace Next::Http {
+
+CgiResultCache::CgiResultCache(size_t capacity) noexcept : cache_(capacity) {}
+
+void CgiResultCache::SetTtl(const std::string &program, uint64_t ttl_ms) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (ttl_ms == 0) {
+    ttls_.erase(program);
+    return;
+  }
+  ttls_[program] = ttl_ms;
+}
+
+auto CgiResultCache::GetTtl(const std::string &program) -> uint64_t {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto iter = ttls_.find(program);
+  return iter == ttls_.end() ? 0 : iter->second;
+}
+
+// 程序路径和各个参数都以'\0'分隔，参数中不会出现'\0'，不同的调用不会得到同一个key
+auto CgiResultCache::MakeKey(const std::string &program, const std::vector<std::string> &arguments) -> std::string {
+  std::string key = program;
+  for (const auto &argument : arguments) {
+    key.push_back('\0');
+    key.append(argument);
+  }
+  return key;
+}
+
+auto CgiResultCache::Lookup(const std::string &key) -> SharedBlock {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return cache_.TryLoadShared(key);
+}
+
+auto CgiResultCache::Join(const std::string &key, Looper *looper, OnResult on_result, bool &leader) -> SharedBlock {
+  std::unique_lock<std::mutex> lock(mtx_);
+  leader = false;
+  if (auto result = cache_.TryLoadShared(key); result != nullptr) {
+    return result;
+  }
+  auto flight = flights_.find(key);
+  if (flight == flights_.end()) {
+    flights_.emplace(key, std::vector<Waiter>{});
+    leader = true;
+    return nullptr;
+  }
+  flight->second.push_back({looper, std::move(on_result)});
+  coalesced_++;
+  return nullptr;
+}
+
+void CgiResultCache::Complete(const std::string &key, SharedBlock result, uint64_t ttl_ms) {
+  std::vector<Waiter> waiters;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto flight = flights_.find(key);
+    if (flight != flights_.end()) {
+      waiters = std::move(flight->second);
+      flights_.erase(flight);
+    }
+    if (result != nullptr && ttl_ms != 0) {
+      cache_.TryInsertShared(key, result, ttl_ms);
+    }
+  }
+  for (auto &waiter : waiters) {
+    waiter.looper_->RunInLoop([on_result = std::move(waiter.on_result_), result]() { on_result(result); });
+  }
+}
+
+auto CgiResultCache::GetCapacity() const noexcept -> size_t { return cache_.GetCapacity(); }
+
+auto CgiResultCache::GetOccupancy() noexcept -> size_t {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return cache_.GetOccupancy();
+}
+
+auto CgiResultCache::GetCoalescedCount() const noexcept -> uint64_t { return coalesced_; }
+
+CgiCachedStream::CgiCachedStream(std::shared_ptr<CgiResultCache> cache, std::string key, uint64_t ttl_ms,
+                                 StreamFactory factory) noexcept
+    : cache_(std::move(cache)),
+      key_(std::move(key)),
+      ttl_ms_(ttl_ms),
+      factory_(std::move(factory)),
+      alive_(std::make_shared<bool>(true)) {}
+
+CgiCachedStream::~CgiCachedStream() {
+  *alive_ = false;
+  if (leading_) {
+    // 输出没有读完，排队的调用重新加入
+    Complete(nullptr);
+  }
+}
+
+auto CgiCachedStream::Start(Looper *looper, std::function<void()> on_readable) -> bool {
+  looper_ = looper;
+  on_readable_ = std::move(on_readable);
+  return Join();
+}
+
+auto CgiCachedStream::Join() -> bool {
+  bool leader;
+  auto on_result = [this, alive = alive_](SharedBlock result) {
+    if (!*alive) {
+      return;
+    }
+    if (result != nullptr) {
+      result_ = std::move(result);
+    } else if (!Join()) {
+      failed_ = true;
+    }
+    on_readable_();
+  };
+  result_ = cache_->Join(key_, looper_, std::move(on_result), leader);
+  if (!leader) {
+    return true;
+  }
+  leading_ = true;
+  inner_ = factory_();
+  if (inner_ == nullptr || !inner_->Start(looper_, on_readable_)) {
+    Complete(nullptr);
+    return false;
+  }
+  return true;
+}
+
+void CgiCachedStream::Complete(SharedBlock result) {
+  leading_ = false;
+  cache_->Complete(key_, std::move(result), ttl_ms_);
+}
+
+auto CgiCachedStream::Read(std::string &out, size_t max_size) -> StreamStatus {
+  if (failed_) {
+    return StreamStatus::ERROR;
+  }
+  if (result_ != nullptr) {
+    auto size = std::min(max_size, result_->size() - result_offset_);
+    if (size == 0) {
+      return StreamStatus::END;
+    }
+    out.append(result_->begin() + static_cast<ptrdiff_t>(result_offset_),
+               result_->begin() + static_cast<ptrdiff_t>(result_offset_ + size));
+    result_offset_ += size;
+    return StreamStatus::DATA;
+  }
+  if (inner_ == nullptr) {
+    // 等待领头的调用
+    return StreamStatus::PENDING;
+  }
+  auto size = out.size();
+  auto status = inner_->Read(out, max_size);
+  if (!leading_) {
+    // 已经放弃缓存，只是把输出转发出去
+    return status;
+  }
+  if (status == StreamStatus::ERROR) {
+    Complete(nullptr);
+    return status;
+  }
+  // END也可能带着最后一段输出
+  output_.append(out, size, std::string::npos);
+  if (output_.size() > cache_->GetCapacity()) {
+    // 放不进缓存，让排队的调用各自运行
+    output_.clear();
+    output_.shrink_to_fit();
+    Complete(nullptr);
+  } else if (status == StreamStatus::END) {
+    Complete(std::make_shared<const std::vector<unsigned char>>(output_.begin(), output_.end()));
+    output_.clear();
+  }
+  return status;
+}
+
+}  // namespace Next::Http
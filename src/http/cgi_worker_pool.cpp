@@ -0,0 +1,322 @@
+#include "http/cgi_worker_pool.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+
+#include "core/connection.h"
+#include "core/looper.h"
+#include "core/poller.h"
+#include "core/socket.h"
+#include "http/cgier.h"
+#include "log/logger.h"
+
+namespace Next::Http {
+
+/* 每次从worker的socket读取的最大字节数 */
+static constexpr size_t CGI_READ_CHUNK = 64 * 1024;
+
+void AppendCgiFrame(CgiFrameType type, std::string_view payload, std::string &out) {
+  char header[CGI_FRAME_HEADER_SIZE] = {};
+  header[0] = static_cast<char>(type);
+  uint32_t length = htonl(static_cast<uint32_t>(payload.size()));
+  memcpy(header + 4, &length, sizeof length);
+  out.append(header, sizeof header);
+  out.append(payload);
+}
+
+CgiWorkerPool::CgiWorkerPool(std::string program, size_t size, size_t max_queue)
+    : program_(std::move(program)), max_queue_(max_queue) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  for (size_t i = 0; i < size; i++) {
+    workers_.push_back(std::make_unique<Worker>());
+    if (!StartWorker(*workers_.back())) {
+      LOG_ERROR("CgiWorkerPool: fail to start worker for " + program_);
+    }
+  }
+}
+
+CgiWorkerPool::~CgiWorkerPool() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  for (auto &worker : workers_) {
+    StopWorker(*worker);
+  }
+}
+
+auto CgiWorkerPool::Acquire(Looper *looper, OnAcquired on_acquired, bool &rejected) -> Worker * {
+  std::unique_lock<std::mutex> lock(mtx_);
+  rejected = false;
+  bool any_busy = false;
+  for (auto &worker : workers_) {
+    if (worker->busy_) {
+      any_busy = true;
+      continue;
+    }
+    if (!IsHealthy(*worker) && !RestartWorker(*worker)) {
+      continue;
+    }
+    worker->busy_ = true;
+    return worker.get();
+  }
+  // 没有正在处理请求的worker时排队也等不到
+  if (!any_busy || waiters_.size() >= max_queue_) {
+    rejected = true;
+    return nullptr;
+  }
+  waiters_.push_back({looper, std::move(on_acquired)});
+  return nullptr;
+}
+
+void CgiWorkerPool::Release(Worker *worker, bool healthy) {
+  std::vector<Waiter> handed;
+  bool usable;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    usable = healthy || RestartWorker(*worker);
+    if (usable && !waiters_.empty()) {
+      // 直接交给排在最前面的请求，worker保持忙碌
+      handed.push_back(std::move(waiters_.front()));
+      waiters_.pop_front();
+    } else {
+      worker->busy_ = false;
+    }
+    // 最后一个忙碌的worker也无法重启时，排队的请求都失败
+    if (!usable && std::none_of(workers_.begin(), workers_.end(), [](auto &w) { return w->busy_; })) {
+      std::move(waiters_.begin(), waiters_.end(), std::back_inserter(handed));
+      waiters_.clear();
+    }
+  }
+  for (auto &waiter : handed) {
+    Worker *given = usable ? worker : nullptr;
+    usable = false;
+    waiter.looper_->RunInLoop(
+        [on_acquired = std::move(waiter.on_acquired_), given]() { on_acquired(given); });
+  }
+}
+
+auto CgiWorkerPool::IsSaturated() noexcept -> bool {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return waiters_.size() >= max_queue_;
+}
+
+auto CgiWorkerPool::GetProgram() const noexcept -> const std::string & { return program_; }
+
+auto CgiWorkerPool::GetSize() const noexcept -> size_t { return workers_.size(); }
+
+auto CgiWorkerPool::GetIdleCount() noexcept -> size_t {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return std::count_if(workers_.begin(), workers_.end(), [](auto &worker) { return !worker->busy_; });
+}
+
+auto CgiWorkerPool::GetQueueLength() noexcept -> size_t {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return waiters_.size();
+}
+
+auto CgiWorkerPool::GetRestartCount() const noexcept -> uint64_t { return restarts_; }
+
+auto CgiWorkerPool::StartWorker(Worker &worker) -> bool {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == -1) {
+    return false;
+  }
+  // worker通过socket回复，直接写到stdout的内容丢弃到/dev/null
+  char *argv[] = {const_cast<char *>(program_.c_str()), nullptr};
+  char *envp[] = {const_cast<char *>(CGI_WORKER_ENV), nullptr};
+  pid_t pid = SpawnProcess(program_.c_str(), argv, envp, fds[1], -1);
+  close(fds[1]);
+  if (pid == -1) {
+    close(fds[0]);
+    return false;
+  }
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  worker.pid_ = pid;
+  worker.fd_ = fds[0];
+  return true;
+}
+
+void CgiWorkerPool::StopWorker(Worker &worker) {
+  if (worker.fd_ != -1) {
+    close(worker.fd_);
+    worker.fd_ = -1;
+  }
+  if (worker.pid_ > 0) {
+    kill(worker.pid_, SIGKILL);
+    waitpid(worker.pid_, nullptr, 0);
+    worker.pid_ = -1;
+  }
+}
+
+auto CgiWorkerPool::RestartWorker(Worker &worker) -> bool {
+  StopWorker(worker);
+  restarts_++;
+  if (!StartWorker(worker)) {
+    LOG_ERROR("CgiWorkerPool: fail to restart worker for " + program_);
+    return false;
+  }
+  return true;
+}
+
+// 空闲的worker在等待下一个请求，socket可读(多余的输出或者EOF)或者挂断都说明它不能再用
+auto CgiWorkerPool::IsHealthy(const Worker &worker) -> bool {
+  if (worker.pid_ <= 0 || worker.fd_ == -1) {
+    return false;
+  }
+  struct pollfd pfd {
+    worker.fd_, POLLIN, 0
+  };
+  return poll(&pfd, 1, 0) == 0;
+}
+
+CgiWorkerStream::CgiWorkerStream(std::shared_ptr<CgiWorkerPool> pool, std::vector<std::string> arguments) noexcept
+    : pool_(std::move(pool)), arguments_(std::move(arguments)), alive_(std::make_shared<bool>(true)) {}
+
+CgiWorkerStream::~CgiWorkerStream() {
+  *alive_ = false;
+  if (worker_ != nullptr) {
+    // 响应没有读完，worker可能还在输出
+    Finish(false);
+  }
+}
+
+auto CgiWorkerStream::Start(Looper *looper, std::function<void()> on_readable) -> bool {
+  looper_ = looper;
+  on_readable_ = std::move(on_readable);
+  bool rejected;
+  auto on_acquired = [this, alive = alive_, pool = pool_](CgiWorkerPool::Worker *worker) {
+    if (!*alive) {
+      if (worker != nullptr) {
+        pool->Release(worker, true);
+      }
+      return;
+    }
+    if (worker == nullptr || !Begin(worker)) {
+      failed_ = true;
+    }
+    on_readable_();
+  };
+  auto *worker = pool_->Acquire(looper, std::move(on_acquired), rejected);
+  if (rejected) {
+    return false;
+  }
+  return worker == nullptr || Begin(worker);
+}
+
+auto CgiWorkerStream::Begin(CgiWorkerPool::Worker *worker) -> bool {
+  worker_ = worker;
+  std::string arguments;
+  for (const auto &argument : arguments_) {
+    arguments.append(argument).push_back('\0');
+  }
+  std::string request;
+  AppendCgiFrame(CgiFrameType::ARGS, arguments, request);
+  // 空闲worker的socket发送缓冲区是空的，请求一次就能写完
+  if (send(worker->fd_, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+    Finish(false);
+    return false;
+  }
+  watch_fd_ = fcntl(worker->fd_, F_DUPFD_CLOEXEC, 0);
+  if (watch_fd_ == -1) {
+    Finish(false);
+    return false;
+  }
+  auto watcher = std::make_unique<Connection>(std::make_unique<Socket>(watch_fd_));
+  watcher->SetEvents(POLL_READ | POLL_ET);
+  watcher->SetCallback([on_readable = on_readable_](Connection *) { on_readable(); });
+  looper_->AddWatcher(std::move(watcher));
+  return true;
+}
+
+void CgiWorkerStream::Finish(bool healthy) {
+  if (watch_fd_ != -1) {
+    looper_->RemoveWatcher(watch_fd_);
+    watch_fd_ = -1;
+  }
+  pool_->Release(worker_, healthy);
+  worker_ = nullptr;
+}
+
+auto CgiWorkerStream::Read(std::string &out, size_t max_size) -> StreamStatus {
+  if (failed_) {
+    return StreamStatus::ERROR;
+  }
+  if (ended_) {
+    return StreamStatus::END;
+  }
+  if (worker_ == nullptr) {
+    // 还在排队
+    return StreamStatus::PENDING;
+  }
+  size_t produced = 0;
+  while (true) {
+    auto available = input_.size() - input_offset_;
+    // 当前STDOUT帧剩余的负载直接作为响应体，一个大帧可以分几次读出
+    if (stdout_remaining_ > 0 && available > 0) {
+      auto size = std::min({stdout_remaining_, available, max_size - produced});
+      out.append(input_, input_offset_, size);
+      input_offset_ += size;
+      stdout_remaining_ -= size;
+      produced += size;
+      if (produced == max_size) {
+        return StreamStatus::DATA;
+      }
+      continue;
+    }
+    if (stdout_remaining_ == 0 && available >= CGI_FRAME_HEADER_SIZE) {
+      const char *header = input_.data() + input_offset_;
+      auto type = static_cast<CgiFrameType>(header[0]);
+      uint32_t length;
+      memcpy(&length, header + 4, sizeof length);
+      length = ntohl(length);
+      if (length > CGI_MAX_FRAME_SIZE || (type != CgiFrameType::STDOUT && type != CgiFrameType::END)) {
+        LOG_WARNING("CgiWorkerStream: protocol error from " + pool_->GetProgram());
+        Finish(false);
+        failed_ = true;
+        return StreamStatus::ERROR;
+      }
+      if (type == CgiFrameType::STDOUT) {
+        input_offset_ += CGI_FRAME_HEADER_SIZE;
+        stdout_remaining_ = length;
+        continue;
+      }
+      if (available >= CGI_FRAME_HEADER_SIZE + length) {
+        input_offset_ += CGI_FRAME_HEADER_SIZE + length;
+        ended_ = true;
+        // END之后还有数据说明worker不守协议
+        Finish(input_offset_ == input_.size());
+        return StreamStatus::END;
+      }
+    }
+    if (produced > 0) {
+      return StreamStatus::DATA;
+    }
+    input_.erase(0, input_offset_);
+    input_offset_ = 0;
+    auto size = input_.size();
+    input_.resize(size + CGI_READ_CHUNK);
+    ssize_t read_size;
+    while ((read_size = read(worker_->fd_, input_.data() + size, CGI_READ_CHUNK)) == -1 && errno == EINTR) {
+    }
+    input_.resize(size + std::max<ssize_t>(read_size, 0));
+    if (read_size > 0) {
+      continue;
+    }
+    if (read_size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return StreamStatus::PENDING;
+    }
+    // worker在请求中途退出
+    LOG_WARNING("CgiWorkerStream: worker of " + pool_->GetProgram() + " exits in the middle of a request");
+    Finish(false);
+    failed_ = true;
+    return StreamStatus::ERROR;
+  }
+}
+
+}  // namespace Next::Http
@@ -1,15 +1,64 @@
 #include "http/cgier.h"
+#include "core/connection.h"
+#include "core/looper.h"
+#include "core/poller.h"
+#include "core/socket.h"
 #include "http/http_utils.h"
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <csignal>
 #include <cstring>
 #include <fcntl.h>
-#include <sstream>
+#include <spawn.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
-#include <thread>
 #include <unistd.h>
 namespace Next::Http {
 
+/* 阻塞运行cgi程序时每次从管道读取的字节数 */
+static constexpr size_t CGI_READ_SIZE = 4096;
+
+auto SpawnProcess(const char *program, char *const argv[], char *const envp[],
+                  int stdin_fd, int stdout_fd) -> pid_t {
+  // glibc的posix_spawn用clone(CLONE_VM|CLONE_VFORK)实现，子进程共享地址空间直到execve
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attr);
+  // dup2得到的fd不带close-on-exec，其他fd都是close-on-exec的，不会被继承
+  if (stdin_fd != -1) {
+    posix_spawn_file_actions_adddup2(&actions, stdin_fd, STDIN_FILENO);
+  }
+  if (stdout_fd != -1) {
+    posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+  }
+  // 服务器忽略了SIGPIPE，cgi程序应当按默认方式处理
+  sigset_t default_signals;
+  sigemptyset(&default_signals);
+  sigaddset(&default_signals, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attr, &default_signals);
+  sigset_t empty_mask;
+  sigemptyset(&empty_mask);
+  posix_spawnattr_setsigmask(&attr, &empty_mask);
+  posix_spawnattr_setflags(&attr,
+                           POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+  pid_t pid;
+  int error = posix_spawn(&pid, program, &actions, &attr, argv, envp);
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return pid;
+}
+
 Cgier::Cgier(const std::string &path,
              const std::vector<std::string> &arguments) noexcept
     : cgi_program_path_(path), cgi_arguments_(arguments), valid_(true) {}
@@ -20,6 +69,10 @@ auto Cgier::GetPath() const noexcept -> std::string {
   return cgi_program_path_;
 }
 
+auto Cgier::GetArguments() const noexcept -> const std::vector<std::string> & {
+  return cgi_arguments_;
+}
+
 auto Cgier::ParseCgier(const std::string &resource_url) noexcept -> Cgier {
   if (resource_url.empty() || !IsCgiRequest(resource_url)) {
     return MakeInvalidCgier();
@@ -38,63 +91,58 @@ auto Cgier::MakeInvalidCgier() noexcept -> Cgier {
   return invalid_cgier;
 }
 
-// 创建子进程运行cgi程序，通过父子进程间共享文件来进行结果的传递
+// 创建子进程运行cgi程序，通过管道取回结果，不经过磁盘上的临时文件
 auto Cgier::Run() -> std::vector<unsigned char> {
   assert(valid_);
   std::vector<unsigned char> cgi_result;
-
-  std::stringstream ssr;
-  ssr << CGI_PREFIX << UNDERSCORE << std::this_thread::get_id() << ".txt";
-  std::string shared_file_name = ssr.str();
-  int fd = open(shared_file_name.c_str(), O_RDWR | O_APPEND | O_CREAT,
-                READ_WRITE_PERMISSION);
-  if (fd == -1) {
-    std::string error = "fail to create/open the file" + shared_file_name;
-    return {error.begin(), error.end()};
-  }
-
-  pid_t pid = fork();
+  int read_fd;
+  pid_t pid = Spawn(read_fd);
   if (pid == -1) {
-    std::string error = "fail to fork()" + shared_file_name;
+    std::string error = "fail to spawn " + cgi_program_path_;
     return {error.begin(), error.end()};
   }
 
-  if (pid == 0) {
-    // 子进程
-    // 将cgi程序的stdout重定向到文件
-    dup2(fd, STDOUT_FILENO);
-    close(fd);
-
-    char **cgi_argv = BuildArgumentList();
-    // 加载可执行cgi程序
-    if (execve(cgi_program_path_.c_str(), cgi_argv, nullptr) < 0) {
-      // execve执行失败才能执行到这
-      perror("fail to execve()");
-      FreeArgumentList(cgi_argv);
-      exit(1); // 退出子进程
-    }
-  } else {
-    // 父进程
-    close(fd);
-    int status;
-    // 等待子进程退出，回收子进程
-    if (waitpid(pid, &status, 0) == -1) {
-      std::string error = "fail to harvest child process by waitpid()";
-      return {error.begin(), error.end()};
+  unsigned char buf[CGI_READ_SIZE];
+  ssize_t read_size;
+  while ((read_size = read(read_fd, buf, sizeof buf)) != 0) {
+    if (read_size > 0) {
+      cgi_result.insert(cgi_result.end(), buf, buf + read_size);
+    } else if (errno != EINTR) {
+      break;
     }
-
-    // 从共享文件中加载cgi程序的结果
-    LoadFile(shared_file_name, cgi_result);
-    // 删除文件
-    DeleteFile(shared_file_name);
+  }
+  close(read_fd);
+  // 等待子进程退出，回收子进程
+  if (waitpid(pid, nullptr, 0) == -1) {
+    std::string error = "fail to harvest child process by waitpid()";
+    return {error.begin(), error.end()};
   }
   return cgi_result;
 }
 
-// 根据cgi_arguments_构建cgi程序的命令行参数argv[]
+auto Cgier::Spawn(int &read_fd) -> pid_t {
+  assert(valid_);
+  // 两端都是close-on-exec，同时启动的其他子进程不会继承管道，本程序退出时读端就能读到EOF
+  int pipe_fds[2];
+  if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+    return -1;
+  }
+  char **cgi_argv = BuildArgumentList();
+  char *cgi_envp[] = {nullptr};
+  pid_t pid = SpawnProcess(cgi_program_path_.c_str(), cgi_argv, cgi_envp, -1,
+                           pipe_fds[1]);
+  FreeArgumentList(cgi_argv);
+  close(pipe_fds[1]);
+  if (pid == -1) {
+    close(pipe_fds[0]);
+    return -1;
+  }
+  read_fd = pipe_fds[0];
+  return pid;
+}
+
+// 根据cgi_arguments_构建cgi程序的命令行参数argv[]，没有参数时也包含argv[0]
 auto Cgier::BuildArgumentList() -> char ** {
-  if (cgi_arguments_.empty())
-    return nullptr;
   char **cgi_argv = (char **)calloc(cgi_arguments_.size() + 2, sizeof(char *));
   cgi_argv[0] = (char *)calloc(cgi_program_path_.size() + 1, sizeof(char));
   memcpy(cgi_argv[0], cgi_program_path_.c_str(), cgi_program_path_.size());
@@ -118,4 +166,107 @@ void Cgier::FreeArgumentList(char **arg_list) {
   }
 }
 
-} // namespace Next::Http
\ No newline at end of file
+/**
+ * 在looper上通过pidfd等待子进程退出并回收它，返回的标志在回收后置为true
+ * 内核不支持pidfd(5.3之前)时返回nullptr，由调用者自己回收
+ */
+static auto ReapOnExit(Looper *looper, pid_t pid) -> std::shared_ptr<bool> {
+#ifdef SYS_pidfd_open
+  // pidfd默认就是close-on-exec的
+  int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+  if (pidfd == -1) {
+    return nullptr;
+  }
+  auto exited = std::make_shared<bool>(false);
+  auto reaper = std::make_unique<Connection>(std::make_unique<Socket>(pidfd));
+  // 子进程退出后pidfd一直可读，用水平触发
+  reaper->SetEvents(POLL_READ);
+  reaper->SetCallback([looper, pid, exited](Connection *conn) {
+    waitpid(pid, nullptr, WNOHANG);
+    *exited = true;
+    looper->RemoveWatcher(conn->GetFd());
+  });
+  looper->AddWatcher(std::move(reaper));
+  return exited;
+#else
+  return nullptr;
+#endif
+}
+
+CgiStream::CgiStream(Cgier cgier) noexcept : cgier_(std::move(cgier)) {}
+
+CgiStream::~CgiStream() {
+  if (read_fd_ != -1) {
+    CloseOutput();
+  }
+  if (pid_ <= 0) {
+    return;
+  }
+  // 输出没有读完，程序可能还在运行，已被looper回收的pid可能已经属于别的进程
+  if (exited_ == nullptr) {
+    kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+  } else if (!*exited_) {
+    kill(pid_, SIGKILL);
+  }
+}
+
+auto CgiStream::Start(Looper *looper, std::function<void()> on_readable)
+    -> bool {
+  pid_ = cgier_.Spawn(read_fd_);
+  if (pid_ == -1) {
+    return false;
+  }
+  // 只有读端是非阻塞的，子进程写满管道时阻塞等待
+  fcntl(read_fd_, F_SETFL, fcntl(read_fd_, F_GETFL) | O_NONBLOCK);
+  looper_ = looper;
+  auto output = std::make_unique<Connection>(std::make_unique<Socket>(read_fd_));
+  output->SetEvents(POLL_READ | POLL_ET);
+  output->SetCallback(
+      [on_readable = std::move(on_readable)](Connection *) { on_readable(); });
+  looper->AddWatcher(std::move(output));
+  exited_ = ReapOnExit(looper, pid_);
+  return true;
+}
+
+auto CgiStream::Read(std::string &out, size_t max_size) -> StreamStatus {
+  if (pid_ == -1 && read_fd_ == -1) {
+    pid_ = cgier_.Spawn(read_fd_);
+    if (pid_ == -1) {
+      return StreamStatus::ERROR;
+    }
+  }
+  if (read_fd_ == -1) {
+    return StreamStatus::END;
+  }
+  auto size = out.size();
+  out.resize(size + max_size);
+  ssize_t read_size;
+  while ((read_size = read(read_fd_, out.data() + size, max_size)) == -1 &&
+         errno == EINTR) {
+  }
+  out.resize(size + std::max<ssize_t>(read_size, 0));
+  if (read_size > 0) {
+    return StreamStatus::DATA;
+  }
+  if (read_size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return StreamStatus::PENDING;
+  }
+  CloseOutput();
+  // 管道已读完，程序已经或者即将退出，关闭了输出的程序不再被杀死
+  pid_t pid = pid_;
+  pid_ = 0;
+  if (exited_ == nullptr && waitpid(pid, nullptr, 0) == -1) {
+    return StreamStatus::ERROR;
+  }
+  return read_size == -1 ? StreamStatus::ERROR : StreamStatus::END;
+}
+
+void CgiStream::CloseOutput() {
+  if (looper_ == nullptr || !looper_->RemoveWatcher(read_fd_)) {
+    close(read_fd_);
+  }
+  read_fd_ = -1;
+}
+
+} // namespace Next::Http
@@ -0,0 +1,150 @@
+#include "http/content_coding.h"
+
+#include <zlib.h>
+#include <climits>
+
+#include "http/http_utils.h"
+
+namespace Next::Http {
+
+/* q值按千分之一的整数表示，1表示为1000 */
+static constexpr int MAX_QVALUE = 1000;
+
+/* zlib的窗口大小，加16时输出gzip格式的头和尾 */
+static constexpr int ZLIB_WINDOW_BITS = 15;
+static constexpr int GZIP_WINDOW_BITS = ZLIB_WINDOW_BITS + 16;
+static constexpr int ZLIB_MEM_LEVEL = 8;
+
+/* 文本以外可压缩的类型，其余按 "text/" 前缀判断 */
+static constexpr std::string_view COMPRESSIBLE_MIMES[] = {
+    "application/javascript", "application/json", "application/xml", "application/wasm", "image/svg+xml",
+};
+
+/* 解析 "q=0.5" 这样的参数，不是q参数时返回-1，格式错误按0处理 */
+static auto ParseQValue(std::string_view param) noexcept -> int {
+  param = TrimView(param);
+  if (param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') || param[1] != '=') {
+    return -1;
+  }
+  auto value = TrimView(param.substr(2));
+  if (value.empty() || (value[0] != '0' && value[0] != '1')) {
+    return 0;
+  }
+  int qvalue = (value[0] - '0') * MAX_QVALUE;
+  if (value.size() > 1) {
+    if (value[1] != '.' || value.size() > 5) {
+      return 0;
+    }
+    int scale = MAX_QVALUE / 10;
+    for (size_t i = 2; i < value.size(); i++, scale /= 10) {
+      if (value[i] < '0' || value[i] > '9') {
+        return 0;
+      }
+      qvalue += (value[i] - '0') * scale;
+    }
+  }
+  return qvalue > MAX_QVALUE ? 0 : qvalue;
+}
+
+auto NegotiateContentCoding(std::string_view accept_encoding) noexcept -> ContentCoding {
+  // -1表示没有出现，"*" 给未出现的编码一个q值
+  int gzip = -1;
+  int deflate = -1;
+  int any = -1;
+  while (!accept_encoding.empty()) {
+    auto comma = accept_encoding.find(',');
+    auto element = accept_encoding.substr(0, comma);
+    accept_encoding = comma == std::string_view::npos ? std::string_view() : accept_encoding.substr(comma + 1);
+    auto semicolon = element.find(';');
+    auto token = TrimView(element.substr(0, semicolon));
+    int qvalue = MAX_QVALUE;
+    while (semicolon != std::string_view::npos) {
+      element = element.substr(semicolon + 1);
+      semicolon = element.find(';');
+      if (auto parsed = ParseQValue(element.substr(0, semicolon)); parsed >= 0) {
+        qvalue = parsed;
+      }
+    }
+    if (EqualsIgnoreCase(token, "gzip") || EqualsIgnoreCase(token, "x-gzip")) {
+      gzip = qvalue;
+    } else if (EqualsIgnoreCase(token, "deflate")) {
+      deflate = qvalue;
+    } else if (token == "*") {
+      any = qvalue;
+    }
+  }
+  gzip = gzip < 0 ? any : gzip;
+  deflate = deflate < 0 ? any : deflate;
+  if (gzip <= 0 && deflate <= 0) {
+    return ContentCoding::IDENTITY;
+  }
+  return gzip >= deflate ? ContentCoding::GZIP : ContentCoding::DEFLATE;
+}
+
+auto ContentCodingToken(ContentCoding coding) noexcept -> std::string_view {
+  switch (coding) {
+    case ContentCoding::GZIP:
+      return "gzip";
+    case ContentCoding::DEFLATE:
+      return "deflate";
+    default:
+      return "identity";
+  }
+}
+
+auto IsCompressible(std::string_view mime, size_t size) noexcept -> bool {
+  if (size < MIN_COMPRESS_SIZE || size > MAX_COMPRESS_SIZE) {
+    return false;
+  }
+  if (mime.compare(0, 5, "text/") == 0) {
+    return true;
+  }
+  for (auto compressible : COMPRESSIBLE_MIMES) {
+    if (mime == compressible) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto ContentCodingETag(std::string_view etag, ContentCoding coding) -> std::string {
+  std::string variant(etag);
+  if (coding == ContentCoding::IDENTITY || variant.size() < 2 || variant.back() != '"') {
+    return variant;
+  }
+  variant.pop_back();
+  variant.push_back('-');
+  variant.append(ContentCodingToken(coding));
+  variant.push_back('"');
+  return variant;
+}
+
+auto Compress(const unsigned char *data, size_t size, ContentCoding coding, std::vector<unsigned char> &out)
+    -> bool {
+  if (coding == ContentCoding::IDENTITY || size > UINT_MAX) {
+    return false;
+  }
+  z_stream stream{};
+  int window_bits = coding == ContentCoding::GZIP ? GZIP_WINDOW_BITS : ZLIB_WINDOW_BITS;
+  if (deflateInit2(&stream, COMPRESSION_LEVEL, Z_DEFLATED, window_bits, ZLIB_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  // deflateBound给出的空间足够一次Z_FINISH完成
+  auto offset = out.size();
+  auto bound = deflateBound(&stream, static_cast<uLong>(size));
+  out.resize(offset + bound);
+  stream.next_in = const_cast<Bytef *>(data);
+  stream.avail_in = static_cast<uInt>(size);
+  stream.next_out = out.data() + offset;
+  stream.avail_out = static_cast<uInt>(bound);
+  int status = deflate(&stream, Z_FINISH);
+  out.resize(offset + stream.total_out);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    out.resize(offset);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace Next::Http
@@ -0,0 +1,265 @@
+#include "http/file_meta_cache.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <mutex>
+
+#include "http/http_utils.h"
+#include "log/logger.h"
+
+namespace Next::Http {
+
+static constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+                                       IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+/* 带 "//"、"." 或 ".." 的url可能和inotify给出的路径对不上，不缓存 */
+static auto IsCanonicalUrl(const std::string &url) noexcept -> bool {
+  if (url.empty() || url.front() != '/') {
+    return false;
+  }
+  for (size_t begin = 1; begin <= url.size(); begin++) {
+    auto end = url.find('/', begin);
+    if (end == std::string::npos) {
+      end = url.size();
+    }
+    std::string_view segment(url.data() + begin, end - begin);
+    if ((segment.empty() && end != url.size()) || segment == "." || segment == "..") {
+      return false;
+    }
+    begin = end;
+  }
+  return true;
+}
+
+static auto TrimTrailingSlash(std::string dir) -> std::string {
+  while (dir.size() > 1 && dir.back() == '/') {
+    dir.pop_back();
+  }
+  return dir;
+}
+
+static auto StatFile(const std::string &path) noexcept -> FileMeta {
+  FileMeta meta;
+  struct stat file_stat {};
+  if (stat(path.c_str(), &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+    meta.exists_ = true;
+    meta.size_ = static_cast<size_t>(file_stat.st_size);
+    meta.mtime_ = file_stat.st_mtime;
+    meta.mime_ = FileToMime(path);
+    auto mtime_ns = static_cast<uint64_t>(file_stat.st_mtim.tv_sec) * 1000000000 +
+                    static_cast<uint64_t>(file_stat.st_mtim.tv_nsec);
+    meta.etag_size_ = static_cast<uint8_t>(
+        FormatETag(static_cast<uint64_t>(file_stat.st_ino), meta.size_, mtime_ns, meta.etag_.data()));
+  }
+  return meta;
+}
+
+FileMetaCache::FileMetaCache(std::string serving_dir, size_t max_entries)
+    : serving_dir_(TrimTrailingSlash(std::move(serving_dir))), max_entries_(std::max<size_t>(max_entries, 1)) {
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (inotify_fd_ == -1 || wakeup_fd_ == -1) {
+    LOG_ERROR("FileMetaCache: inotify unavailable, metadata will not be cached");
+    return;
+  }
+  AddWatchRecursive("");
+  watcher_ = std::thread([this]() { WatchLoop(); });
+}
+
+FileMetaCache::~FileMetaCache() {
+  if (watcher_.joinable()) {
+    uint64_t one = 1;
+    [[maybe_unused]] auto written = write(wakeup_fd_, &one, sizeof(one));
+    watcher_.join();
+  }
+  if (inotify_fd_ != -1) {
+    close(inotify_fd_);
+  }
+  if (wakeup_fd_ != -1) {
+    close(wakeup_fd_);
+  }
+}
+
+auto FileMetaCache::Lookup(const std::string &url) -> FileMeta {
+  if (!IsWatching() || !IsCanonicalUrl(url)) {
+    return StatFile(serving_dir_ + url);
+  }
+  uint64_t generation;
+  {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    generation = generation_;
+    auto iter = entries_.find(url);
+    if (iter != entries_.end()) {
+      iter->second.last_used_.store(access_tick_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+      auto meta = iter->second.meta_;
+      meta.generation_ = generation;
+      return meta;
+    }
+  }
+  auto meta = StatFile(serving_dir_ + url);
+  meta.generation_ = generation;
+  if (!meta.exists_) {
+    return meta;
+  }
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  if (generation == generation_) {
+    if (entries_.size() >= max_entries_) {
+      EvictLocked();
+    }
+    entries_.try_emplace(url, meta, access_tick_.fetch_add(1, std::memory_order_relaxed));
+  }
+  return meta;
+}
+
+void FileMetaCache::OnInvalidate(InvalidateCallback callback) {
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  callbacks_.push_back(std::move(callback));
+}
+
+auto FileMetaCache::IsWatching() const noexcept -> bool { return watcher_.joinable(); }
+
+auto FileMetaCache::FillIfUnchanged(uint64_t generation, const std::function<void()> &fill) -> bool {
+  std::shared_lock<std::shared_mutex> lock(mtx_);
+  if (generation != generation_) {
+    return false;
+  }
+  fill();
+  return true;
+}
+
+auto FileMetaCache::GetServingDir() const noexcept -> const std::string & { return serving_dir_; }
+
+auto FileMetaCache::Size() const -> size_t {
+  std::shared_lock<std::shared_mutex> lock(mtx_);
+  return entries_.size();
+}
+
+void FileMetaCache::AddWatchRecursive(const std::string &relative_dir) {
+  int wd = inotify_add_watch(inotify_fd_, (serving_dir_ + relative_dir).c_str(), WATCH_MASK);
+  if (wd == -1) {
+    LOG_ERROR("FileMetaCache: fail to watch " + serving_dir_ + relative_dir);
+    return;
+  }
+  watch_dirs_[wd] = relative_dir;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(serving_dir_ + relative_dir, error)) {
+    if (entry.is_directory(error) && !entry.is_symlink(error)) {
+      AddWatchRecursive(relative_dir + "/" + entry.path().filename().string());
+    }
+  }
+}
+
+void FileMetaCache::WatchLoop() {
+  alignas(inotify_event) char events[16 * 1024];
+  pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wakeup_fd_, POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("FileMetaCache: poll() error");
+      return;
+    }
+    if ((fds[1].revents & POLLIN) != 0) {
+      return;
+    }
+    ssize_t length;
+    while ((length = read(inotify_fd_, events, sizeof(events))) > 0) {
+      HandleEvents(events, static_cast<size_t>(length));
+    }
+  }
+}
+
+void FileMetaCache::HandleEvents(const char *events, size_t length) {
+  for (size_t offset = 0; offset < length;) {
+    const auto *event = reinterpret_cast<const inotify_event *>(events + offset);
+    offset += sizeof(inotify_event) + event->len;
+    if ((event->mask & IN_Q_OVERFLOW) != 0) {
+      // 丢失了事件，无法知道哪些文件变了
+      InvalidateAll();
+      continue;
+    }
+    auto iter = watch_dirs_.find(event->wd);
+    if (iter == watch_dirs_.end()) {
+      continue;
+    }
+    if ((event->mask & IN_IGNORED) != 0) {
+      watch_dirs_.erase(iter);
+      continue;
+    }
+    if (event->len == 0) {
+      // 被监听的目录自身被删除或移动
+      Invalidate(iter->second, true);
+      continue;
+    }
+    auto url = iter->second + "/" + event->name;
+    bool is_directory = (event->mask & IN_ISDIR) != 0;
+    if (is_directory && (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+      AddWatchRecursive(url);
+    }
+    Invalidate(url, is_directory);
+  }
+}
+
+void FileMetaCache::Invalidate(const std::string &url, bool is_directory) {
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  generation_++;
+  if (!is_directory) {
+    entries_.erase(url);
+    for (const auto &callback : callbacks_) {
+      callback(serving_dir_ + url);
+    }
+    return;
+  }
+  // 目录下的所有文件
+  auto prefix = url + "/";
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    if (iter->first.compare(0, prefix.size(), prefix) == 0) {
+      for (const auto &callback : callbacks_) {
+        callback(serving_dir_ + iter->first);
+      }
+      iter = entries_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
+
+void FileMetaCache::InvalidateAll() {
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  generation_++;
+  for (const auto &[url, entry] : entries_) {
+    for (const auto &callback : callbacks_) {
+      callback(serving_dir_ + url);
+    }
+  }
+  entries_.clear();
+}
+
+// 一次淘汰1/8，找出分界的访问序号是O(n)的，分摊到之后的插入上
+void FileMetaCache::EvictLocked() {
+  std::vector<uint64_t> ticks;
+  ticks.reserve(entries_.size());
+  for (const auto &[url, entry] : entries_) {
+    ticks.push_back(entry.last_used_.load(std::memory_order_relaxed));
+  }
+  auto batch = std::max<size_t>(ticks.size() / 8, 1);
+  std::nth_element(ticks.begin(), ticks.begin() + static_cast<ptrdiff_t>(batch - 1), ticks.end());
+  auto threshold = ticks[batch - 1];
+  for (auto iter = entries_.begin(); iter != entries_.end() && batch > 0;) {
+    if (iter->second.last_used_.load(std::memory_order_relaxed) <= threshold) {
+      iter = entries_.erase(iter);
+      batch--;
+    } else {
+      ++iter;
+    }
+  }
+}
+
+}  // namespace Next::Http
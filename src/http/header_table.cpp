@@ -0,0 +1,187 @@
+#include "http/header_table.h"
+#include "http/header.h"
+#include "http/http_utils.h"
+
+namespace Next::Http {
+
+/* 按HeaderId的顺序排列的规范header名 */
+static constexpr std::array<std::string_view, WELL_KNOWN_HEADER_COUNT> WELL_KNOWN_HEADER_NAMES = {
+    "Server",
+    "Date",
+    "Connection",
+    "Content-Length",
+    "Content-Type",
+    "Content-Encoding",
+    "Transfer-Encoding",
+    "Cache-Control",
+    "ETag",
+    "Last-Modified",
+    "Accept-Ranges",
+    "Content-Range",
+    "Vary",
+    "Host",
+    "User-Agent",
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Expect",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "Range",
+    "Keep-Alive",
+    "Upgrade",
+    "HTTP2-Settings",
+    "Allow",
+};
+
+static constexpr char LIST_SEPARATOR[] = {", "};
+
+auto ToHeaderId(std::string_view key) noexcept -> HeaderId {
+  if (key.empty()) {
+    return HeaderId::UNKNOWN;
+  }
+  // 先用长度和首字母过滤，大多数候选不需要逐字节比较
+  const unsigned char first = static_cast<unsigned char>(key[0]) | 0x20U;
+  for (size_t i = 0; i < WELL_KNOWN_HEADER_COUNT; i++) {
+    const auto name = WELL_KNOWN_HEADER_NAMES[i];
+    if (name.size() == key.size() && (static_cast<unsigned char>(name[0]) | 0x20U) == first &&
+        EqualsIgnoreCase(name, key)) {
+      return static_cast<HeaderId>(i);
+    }
+  }
+  return HeaderId::UNKNOWN;
+}
+
+auto HeaderIdToName(HeaderId id) noexcept -> std::string_view {
+  if (id == HeaderId::UNKNOWN) {
+    return {};
+  }
+  return WELL_KNOWN_HEADER_NAMES[static_cast<size_t>(id)];
+}
+
+void HeaderTable::Add(HeaderId id, std::string_view value) {
+  if (id == HeaderId::UNKNOWN) {
+    return;
+  }
+  auto index = static_cast<size_t>(id);
+  if (Has(id)) {
+    known_values_[index].append(LIST_SEPARATOR).append(value);
+    return;
+  }
+  known_values_[index] = value;
+  present_ |= 1U << index;
+}
+
+void HeaderTable::Add(std::string_view key, std::string_view value) {
+  if (auto id = ToHeaderId(key); id != HeaderId::UNKNOWN) {
+    Add(id, value);
+    return;
+  }
+  if (auto *other = FindOther(key); other != nullptr) {
+    other->second.append(LIST_SEPARATOR).append(value);
+    return;
+  }
+  others_.emplace_back(std::string(key), std::string(value));
+}
+
+void HeaderTable::Set(HeaderId id, std::string value) {
+  if (id == HeaderId::UNKNOWN) {
+    return;
+  }
+  auto index = static_cast<size_t>(id);
+  known_values_[index] = std::move(value);
+  present_ |= 1U << index;
+}
+
+void HeaderTable::Set(std::string_view key, std::string value) {
+  if (auto id = ToHeaderId(key); id != HeaderId::UNKNOWN) {
+    Set(id, std::move(value));
+    return;
+  }
+  if (auto *other = FindOther(key); other != nullptr) {
+    other->second = std::move(value);
+    return;
+  }
+  others_.emplace_back(std::string(key), std::move(value));
+}
+
+auto HeaderTable::Get(HeaderId id) const noexcept -> std::optional<std::string_view> {
+  if (!Has(id)) {
+    return std::nullopt;
+  }
+  return known_values_[static_cast<size_t>(id)];
+}
+
+auto HeaderTable::Get(std::string_view key) const noexcept -> std::optional<std::string_view> {
+  if (auto id = ToHeaderId(key); id != HeaderId::UNKNOWN) {
+    return Get(id);
+  }
+  if (const auto *other = FindOther(key); other != nullptr) {
+    return other->second;
+  }
+  return std::nullopt;
+}
+
+auto HeaderTable::Has(HeaderId id) const noexcept -> bool {
+  return id != HeaderId::UNKNOWN && (present_ & (1U << static_cast<size_t>(id))) != 0;
+}
+
+auto HeaderTable::Has(std::string_view key) const noexcept -> bool { return Get(key).has_value(); }
+
+auto HeaderTable::Erase(HeaderId id) noexcept -> bool {
+  if (!Has(id)) {
+    return false;
+  }
+  auto index = static_cast<size_t>(id);
+  present_ &= ~(1U << index);
+  known_values_[index].clear();
+  return true;
+}
+
+auto HeaderTable::Size() const noexcept -> size_t {
+  return static_cast<size_t>(__builtin_popcount(present_)) + others_.size();
+}
+
+void HeaderTable::Clear() noexcept {
+  for (size_t i = 0; i < WELL_KNOWN_HEADER_COUNT; i++) {
+    known_values_[i].clear();
+  }
+  present_ = 0;
+  others_.clear();
+}
+
+auto HeaderTable::ToHeaders() const -> std::vector<Header> {
+  std::vector<Header> headers;
+  headers.reserve(Size());
+  ForEach([&](std::string_view key, std::string_view value) {
+    headers.emplace_back(std::string(key), std::string(value));
+  });
+  return headers;
+}
+
+void HeaderTable::Serialize(std::string &out) const {
+  ForEach([&](std::string_view key, std::string_view value) {
+    out.append(key).append(COLON).append(value).append(CRLF);
+  });
+}
+
+auto HeaderTable::FindOther(std::string_view key) noexcept -> std::pair<std::string, std::string> * {
+  for (auto &other : others_) {
+    if (EqualsIgnoreCase(other.first, key)) {
+      return &other;
+    }
+  }
+  return nullptr;
+}
+
+auto HeaderTable::FindOther(std::string_view key) const noexcept -> const std::pair<std::string, std::string> * {
+  for (const auto &other : others_) {
+    if (EqualsIgnoreCase(other.first, key)) {
+      return &other;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace Next::Http
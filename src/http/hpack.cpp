@@ -0,0 +1,486 @@
+#include "http/hpack.h"
+
+#include <algorithm>
+#include <array>
+
+namespace Next::Http {
+
+/* Huffman编码中EOS的编号，合法的数据中不会出现 */
+static constexpr size_t HUFFMAN_EOS = 256;
+static constexpr size_t HUFFMAN_SYMBOL_COUNT = 257;
+static constexpr size_t HUFFMAN_MAX_BITS = 30;
+
+struct HuffmanCode {
+  uint32_t code_;
+  uint8_t bits_;
+};
+
+/* RFC 7541附录B的Huffman编码表，按符号排列，码字右对齐 */
+static constexpr HuffmanCode HUFFMAN_CODES[HUFFMAN_SYMBOL_COUNT] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+    {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+    {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+    {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+    {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+    {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+    {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+    {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+    {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+    {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+    {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+    {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+    {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+    {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+    {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+    {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+    {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+    {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+    {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+    {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+    {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+};
+
+/**
+ * 这个Huffman码是规范的：同一长度的码字连续，并按符号值递增
+ * 解码时按位累积码字，每个长度只需比较一次范围即可得到符号
+ */
+struct HuffmanDecodeTable {
+  // 长度为i的第一个码字、码字个数以及它们在symbols_中的起始位置
+  std::array<uint32_t, HUFFMAN_MAX_BITS + 1> first_code_{};
+  std::array<uint32_t, HUFFMAN_MAX_BITS + 1> count_{};
+  std::array<uint32_t, HUFFMAN_MAX_BITS + 1> offset_{};
+  // 按(长度, 符号)排序的符号
+  std::array<uint16_t, HUFFMAN_SYMBOL_COUNT> symbols_{};
+
+  constexpr HuffmanDecodeTable() {
+    for (const auto &code : HUFFMAN_CODES) {
+      count_[code.bits_]++;
+    }
+    uint32_t offset = 0;
+    for (size_t bits = 1; bits <= HUFFMAN_MAX_BITS; bits++) {
+      offset_[bits] = offset;
+      offset += count_[bits];
+    }
+    std::array<uint32_t, HUFFMAN_MAX_BITS + 1> filled{};
+    for (size_t symbol = 0; symbol < HUFFMAN_SYMBOL_COUNT; symbol++) {
+      auto bits = HUFFMAN_CODES[symbol].bits_;
+      if (filled[bits] == 0) {
+        first_code_[bits] = HUFFMAN_CODES[symbol].code_;
+      }
+      symbols_[offset_[bits] + filled[bits]++] = static_cast<uint16_t>(symbol);
+    }
+  }
+};
+
+static constexpr HuffmanDecodeTable HUFFMAN_DECODE_TABLE{};
+
+/* RFC 7541附录A的静态表，下标0不使用 */
+static constexpr std::pair<std::string_view, std::string_view> STATIC_TABLE[] = {
+    {"", ""},
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+static constexpr size_t STATIC_TABLE_SIZE = std::size(STATIC_TABLE) - 1;
+
+/* 每个响应都不同的header，加入动态表只会挤掉有用的条目 */
+static constexpr std::string_view NOT_INDEXED_NAMES[] = {
+    "date", "content-length", "etag", "last-modified", "content-range",
+};
+
+/* 各种表示的首字节模式和整数前缀的位数 */
+static constexpr uint8_t INDEXED = 0x80;
+static constexpr uint8_t LITERAL_INCREMENTAL = 0x40;
+static constexpr uint8_t SIZE_UPDATE = 0x20;
+static constexpr uint8_t LITERAL_WITHOUT_INDEXING = 0x00;
+static constexpr uint8_t HUFFMAN_FLAG = 0x80;
+
+/* 整数最多占用的后续字节，足以表示任何合理的长度和索引，更长的视为溢出 */
+static constexpr size_t MAX_INTEGER_BYTES = 5;
+
+static void EncodeInteger(uint8_t first, int prefix_bits, size_t value, std::vector<unsigned char> &out) {
+  size_t max_prefix = (1U << prefix_bits) - 1;
+  if (value < max_prefix) {
+    out.push_back(static_cast<unsigned char>(first | value));
+    return;
+  }
+  out.push_back(static_cast<unsigned char>(first | max_prefix));
+  value -= max_prefix;
+  while (value >= 128) {
+    out.push_back(static_cast<unsigned char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(value));
+}
+
+static auto DecodeInteger(std::string_view block, size_t &pos, int prefix_bits, size_t &value) noexcept -> bool {
+  if (pos >= block.size()) {
+    return false;
+  }
+  size_t max_prefix = (1U << prefix_bits) - 1;
+  value = static_cast<uint8_t>(block[pos++]) & max_prefix;
+  if (value < max_prefix) {
+    return true;
+  }
+  for (size_t i = 0, shift = 0; i < MAX_INTEGER_BYTES; i++, shift += 7) {
+    if (pos >= block.size()) {
+      return false;
+    }
+    auto byte = static_cast<uint8_t>(block[pos++]);
+    value += static_cast<size_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void HuffmanEncode(std::string_view s, std::string &out) {
+  uint64_t bits = 0;
+  size_t bit_count = 0;
+  for (char c : s) {
+    const auto &code = HUFFMAN_CODES[static_cast<uint8_t>(c)];
+    bits = (bits << code.bits_) | code.code_;
+    bit_count += code.bits_;
+    while (bit_count >= 8) {
+      bit_count -= 8;
+      out.push_back(static_cast<char>(bits >> bit_count));
+    }
+  }
+  if (bit_count > 0) {
+    // 用EOS的高位(全1)填充
+    out.push_back(static_cast<char>((bits << (8 - bit_count)) | (0xff >> bit_count)));
+  }
+}
+
+auto HuffmanEncodedLength(std::string_view s) noexcept -> size_t {
+  size_t bits = 0;
+  for (char c : s) {
+    bits += HUFFMAN_CODES[static_cast<uint8_t>(c)].bits_;
+  }
+  return (bits + 7) / 8;
+}
+
+auto HuffmanDecode(std::string_view s, std::string &out) -> bool {
+  const auto &table = HUFFMAN_DECODE_TABLE;
+  uint32_t code = 0;
+  size_t bits = 0;
+  for (char c : s) {
+    for (int bit = 7; bit >= 0; bit--) {
+      code = (code << 1) | ((static_cast<uint8_t>(c) >> bit) & 1);
+      bits++;
+      if (bits > HUFFMAN_MAX_BITS) {
+        return false;
+      }
+      if (code - table.first_code_[bits] < table.count_[bits] && code >= table.first_code_[bits]) {
+        auto symbol = table.symbols_[table.offset_[bits] + code - table.first_code_[bits]];
+        if (symbol == HUFFMAN_EOS) {
+          return false;
+        }
+        out.push_back(static_cast<char>(symbol));
+        code = 0;
+        bits = 0;
+      }
+    }
+  }
+  // 剩余的填充不超过7位，且必须是EOS的前缀，即全为1
+  return bits <= 7 && code == (1U << bits) - 1;
+}
+
+HpackTable::HpackTable(size_t max_size) : max_size_(max_size) {}
+
+auto HpackTable::Get(size_t index) const noexcept -> const HeaderField * {
+  if (index == 0 || index > STATIC_TABLE_SIZE + entries_.size()) {
+    return nullptr;
+  }
+  if (index <= STATIC_TABLE_SIZE) {
+    // 静态表的条目在第一次使用时转换为HeaderField
+    static const auto static_fields = []() {
+      std::vector<HeaderField> fields;
+      for (const auto &[name, value] : STATIC_TABLE) {
+        fields.emplace_back(name, value);
+      }
+      return fields;
+    }();
+    return &static_fields[index];
+  }
+  return &entries_[index - STATIC_TABLE_SIZE - 1];
+}
+
+auto HpackTable::Find(std::string_view name, std::string_view value, bool &name_only) const noexcept -> size_t {
+  size_t name_index = 0;
+  for (size_t i = 1; i <= STATIC_TABLE_SIZE; i++) {
+    if (STATIC_TABLE[i].first == name) {
+      if (STATIC_TABLE[i].second == value) {
+        name_only = false;
+        return i;
+      }
+      name_index = name_index == 0 ? i : name_index;
+    }
+  }
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].first == name) {
+      if (entries_[i].second == value) {
+        name_only = false;
+        return STATIC_TABLE_SIZE + 1 + i;
+      }
+      name_index = name_index == 0 ? STATIC_TABLE_SIZE + 1 + i : name_index;
+    }
+  }
+  name_only = true;
+  return name_index;
+}
+
+void HpackTable::Insert(std::string_view name, std::string_view value) {
+  size_t entry_size = name.size() + value.size() + HPACK_ENTRY_OVERHEAD;
+  if (entry_size > max_size_) {
+    EvictTo(0);
+    return;
+  }
+  EvictTo(max_size_ - entry_size);
+  entries_.emplace_front(name, value);
+  size_ += entry_size;
+}
+
+void HpackTable::SetMaxSize(size_t max_size) {
+  max_size_ = max_size;
+  EvictTo(max_size_);
+}
+
+auto HpackTable::GetMaxSize() const noexcept -> size_t { return max_size_; }
+
+auto HpackTable::GetSize() const noexcept -> size_t { return size_; }
+
+auto HpackTable::GetEntryCount() const noexcept -> size_t { return entries_.size(); }
+
+void HpackTable::EvictTo(size_t size) {
+  while (size_ > size && !entries_.empty()) {
+    size_ -= entries_.back().first.size() + entries_.back().second.size() + HPACK_ENTRY_OVERHEAD;
+    entries_.pop_back();
+  }
+}
+
+HpackDecoder::HpackDecoder(size_t settings_table_size)
+    : table_(settings_table_size), settings_table_size_(settings_table_size) {}
+
+auto HpackDecoder::Decode(std::string_view block, std::vector<HeaderField> &headers) -> bool {
+  size_t pos = 0;
+  size_t list_size = 0;
+  bool field_seen = false;
+  while (pos < block.size()) {
+    auto first = static_cast<uint8_t>(block[pos]);
+    size_t index = 0;
+    if ((first & INDEXED) != 0) {
+      if (!DecodeInteger(block, pos, 7, index)) {
+        return false;
+      }
+      const auto *field = table_.Get(index);
+      if (field == nullptr) {
+        return false;
+      }
+      headers.push_back(*field);
+    } else if ((first & 0xe0) == SIZE_UPDATE) {
+      // 大小更新只能出现在块的开头
+      if (field_seen || !DecodeInteger(block, pos, 5, index) || index > settings_table_size_) {
+        return false;
+      }
+      table_.SetMaxSize(index);
+      continue;
+    } else {
+      // 不索引(0000)和永不索引(0001)的字面量对解码来说相同
+      bool incremental = (first & 0xc0) == LITERAL_INCREMENTAL;
+      if (!DecodeInteger(block, pos, incremental ? 6 : 4, index)) {
+        return false;
+      }
+      HeaderField field;
+      if (index != 0) {
+        const auto *indexed = table_.Get(index);
+        if (indexed == nullptr) {
+          return false;
+        }
+        field.first = indexed->first;
+      } else if (!DecodeString(block, pos, field.first)) {
+        return false;
+      }
+      if (!DecodeString(block, pos, field.second)) {
+        return false;
+      }
+      if (incremental) {
+        table_.Insert(field.first, field.second);
+      }
+      headers.push_back(std::move(field));
+    }
+    field_seen = true;
+    list_size += headers.back().first.size() + headers.back().second.size() + HPACK_ENTRY_OVERHEAD;
+    if (list_size > HPACK_MAX_HEADER_LIST_SIZE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto HpackDecoder::GetTable() const noexcept -> const HpackTable & { return table_; }
+
+auto HpackDecoder::DecodeString(std::string_view block, size_t &pos, std::string &out) -> bool {
+  if (pos >= block.size()) {
+    return false;
+  }
+  bool huffman = (static_cast<uint8_t>(block[pos]) & HUFFMAN_FLAG) != 0;
+  size_t length = 0;
+  if (!DecodeInteger(block, pos, 7, length) || length > block.size() - pos) {
+    return false;
+  }
+  auto data = block.substr(pos, length);
+  pos += length;
+  if (huffman) {
+    return HuffmanDecode(data, out);
+  }
+  out.assign(data);
+  return true;
+}
+
+void HpackEncoder::SetMaxTableSize(size_t max_size) {
+  // 对端允许更大的表时仍然只用默认大小，限制每个连接的内存
+  max_size = std::min(max_size, HPACK_DEFAULT_TABLE_SIZE);
+  if (max_size == table_.GetMaxSize() && !size_update_pending_) {
+    return;
+  }
+  pending_min_size_ = std::min(pending_min_size_, max_size);
+  size_update_pending_ = true;
+  table_.SetMaxSize(max_size);
+}
+
+void HpackEncoder::BeginBlock(std::vector<unsigned char> &out) {
+  if (!size_update_pending_) {
+    return;
+  }
+  // 两次块之间上限先减小再增大时，对端也必须先淘汰到最小值
+  if (pending_min_size_ < table_.GetMaxSize()) {
+    EncodeInteger(SIZE_UPDATE, 5, pending_min_size_, out);
+  }
+  EncodeInteger(SIZE_UPDATE, 5, table_.GetMaxSize(), out);
+  size_update_pending_ = false;
+  pending_min_size_ = SIZE_MAX;
+}
+
+void HpackEncoder::Encode(std::string_view name, std::string_view value, std::vector<unsigned char> &out) {
+  bool name_only = false;
+  auto index = table_.Find(name, value, name_only);
+  if (index != 0 && !name_only) {
+    EncodeInteger(INDEXED, 7, index, out);
+    return;
+  }
+  bool indexing =
+      std::find(std::begin(NOT_INDEXED_NAMES), std::end(NOT_INDEXED_NAMES), name) == std::end(NOT_INDEXED_NAMES);
+  if (indexing) {
+    EncodeInteger(LITERAL_INCREMENTAL, 6, index, out);
+  } else {
+    EncodeInteger(LITERAL_WITHOUT_INDEXING, 4, index, out);
+  }
+  if (index == 0) {
+    EncodeString(name, out);
+  }
+  EncodeString(value, out);
+  if (indexing) {
+    table_.Insert(name, value);
+  }
+}
+
+auto HpackEncoder::GetTable() const noexcept -> const HpackTable & { return table_; }
+
+void HpackEncoder::EncodeString(std::string_view s, std::vector<unsigned char> &out) {
+  auto huffman_length = HuffmanEncodedLength(s);
+  if (huffman_length >= s.size()) {
+    EncodeInteger(0, 7, s.size(), out);
+    out.insert(out.end(), s.begin(), s.end());
+    return;
+  }
+  EncodeInteger(HUFFMAN_FLAG, 7, huffman_length, out);
+  std::string encoded;
+  encoded.reserve(huffman_length);
+  HuffmanEncode(s, encoded);
+  out.insert(out.end(), encoded.begin(), encoded.end());
+}
+
+}  // namespace Next::Http
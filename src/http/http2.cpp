@@ -0,0 +1,767 @@
+#include "http/http2.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "http/http_utils.h"
+
+namespace Next::Http {
+
+/* 帧的标志位 */
+static constexpr uint8_t FLAG_END_STREAM = 0x1;
+static constexpr uint8_t FLAG_ACK = 0x1;
+static constexpr uint8_t FLAG_END_HEADERS = 0x4;
+static constexpr uint8_t FLAG_PADDED = 0x8;
+static constexpr uint8_t FLAG_PRIORITY = 0x20;
+
+/* SETTINGS的参数编号 */
+static constexpr uint16_t SETTINGS_HEADER_TABLE_SIZE = 0x1;
+static constexpr uint16_t SETTINGS_ENABLE_PUSH = 0x2;
+static constexpr uint16_t SETTINGS_MAX_CONCURRENT_STREAMS = 0x3;
+static constexpr uint16_t SETTINGS_INITIAL_WINDOW_SIZE = 0x4;
+static constexpr uint16_t SETTINGS_MAX_FRAME_SIZE = 0x5;
+static constexpr uint16_t SETTINGS_MAX_HEADER_LIST_SIZE = 0x6;
+static constexpr size_t SETTINGS_ENTRY_SIZE = 6;
+
+static constexpr size_t PRIORITY_SIZE = 5;
+static constexpr size_t PING_SIZE = 8;
+static constexpr size_t GOAWAY_MIN_SIZE = 8;
+static constexpr size_t WINDOW_UPDATE_SIZE = 4;
+static constexpr size_t RST_STREAM_SIZE = 4;
+static constexpr uint32_t STREAM_ID_MASK = 0x7fffffff;
+
+/* HTTP/2中禁止出现的逐跳header */
+static constexpr std::string_view CONNECTION_SPECIFIC_HEADERS[] = {
+    "connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade",
+};
+
+static auto ReadUint32(std::string_view data) noexcept -> uint32_t {
+  return (static_cast<uint32_t>(static_cast<uint8_t>(data[0])) << 24) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(data[1])) << 16) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(data[2])) << 8) |
+         static_cast<uint32_t>(static_cast<uint8_t>(data[3]));
+}
+
+static void AppendUint32(std::string &out, uint32_t value) {
+  out.push_back(static_cast<char>(value >> 24));
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+/* HTTP2-Settings的值是base64url编码且没有填充的，也接受标准base64的字符 */
+static auto DecodeBase64Url(std::string_view encoded, std::string &out) -> bool {
+  uint32_t bits = 0;
+  int bit_count = 0;
+  for (char c : encoded) {
+    int value;
+    if (c >= 'A' && c <= 'Z') {
+      value = c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+      value = c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+      value = c - '0' + 52;
+    } else if (c == '-' || c == '+') {
+      value = 62;
+    } else if (c == '_' || c == '/') {
+      value = 63;
+    } else if (c == '=') {
+      break;
+    } else {
+      return false;
+    }
+    bits = (bits << 6) | static_cast<uint32_t>(value);
+    bit_count += 6;
+    if (bit_count >= 8) {
+      bit_count -= 8;
+      out.push_back(static_cast<char>(bits >> bit_count));
+    }
+  }
+  return true;
+}
+
+auto IsHttp2Preface(std::string_view data) noexcept -> bool {
+  auto size = std::min(data.size(), HTTP2_CLIENT_PREFACE.size());
+  return data.substr(0, size) == HTTP2_CLIENT_PREFACE.substr(0, size);
+}
+
+Http2Session::Http2Session() : decoder_(HPACK_DEFAULT_TABLE_SIZE) {}
+
+void Http2Session::Start() {
+  std::string payload;
+  for (auto [id, value] : {std::pair<uint16_t, uint32_t>{SETTINGS_MAX_CONCURRENT_STREAMS, HTTP2_MAX_CONCURRENT_STREAMS},
+                           {SETTINGS_MAX_HEADER_LIST_SIZE, HPACK_MAX_HEADER_LIST_SIZE}}) {
+    payload.push_back(static_cast<char>(id >> 8));
+    payload.push_back(static_cast<char>(id));
+    AppendUint32(payload, value);
+  }
+  WriteFrameHeader(payload.size(), Http2FrameType::SETTINGS, 0, 0);
+  WriteBytes(payload.data(), payload.size());
+}
+
+auto Http2Session::StartUpgraded(std::string_view http2_settings, std::unique_ptr<Request> &request) -> bool {
+  std::string payload;
+  if (!DecodeBase64Url(TrimView(http2_settings), payload) || payload.size() % SETTINGS_ENTRY_SIZE != 0 ||
+      !ApplySettings(payload)) {
+    return false;
+  }
+  Start();
+  auto &stream = streams_[1];
+  stream.send_window_ = initial_window_size_;
+  stream.request_ = std::move(request);
+  stream.remote_closed_ = true;
+  last_stream_id_ = 1;
+  ready_.push_back(1);
+  return true;
+}
+
+auto Http2Session::Feed(std::string_view data) -> size_t {
+  if (closed_) {
+    return data.size();
+  }
+  size_t consumed = 0;
+  if (!preface_received_) {
+    if (!IsHttp2Preface(data)) {
+      ConnectionError(Http2Error::PROTOCOL_ERROR);
+      return data.size();
+    }
+    if (data.size() < HTTP2_CLIENT_PREFACE.size()) {
+      return 0;
+    }
+    preface_received_ = true;
+    consumed = HTTP2_CLIENT_PREFACE.size();
+  }
+  while (!closed_ && data.size() - consumed >= HTTP2_FRAME_HEADER_SIZE) {
+    auto head = data.substr(consumed, HTTP2_FRAME_HEADER_SIZE);
+    FrameHeader header{ReadUint32(head) >> 8, static_cast<Http2FrameType>(head[3]), static_cast<uint8_t>(head[4]),
+                       ReadUint32(head.substr(5)) & STREAM_ID_MASK};
+    // 我们没有通告更大的SETTINGS_MAX_FRAME_SIZE
+    if (header.length_ > HTTP2_DEFAULT_MAX_FRAME_SIZE) {
+      ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+      break;
+    }
+    if (data.size() - consumed - HTTP2_FRAME_HEADER_SIZE < header.length_) {
+      break;
+    }
+    auto payload = data.substr(consumed + HTTP2_FRAME_HEADER_SIZE, header.length_);
+    consumed += HTTP2_FRAME_HEADER_SIZE + header.length_;
+    // 客户端前言之后的第一个帧必须是SETTINGS
+    if (!settings_received_ && header.type_ != Http2FrameType::SETTINGS) {
+      ConnectionError(Http2Error::PROTOCOL_ERROR);
+      break;
+    }
+    HandleFrame(header, payload);
+  }
+  return closed_ ? data.size() : consumed;
+}
+
+auto Http2Session::NextRequest(uint32_t &stream_id, std::unique_ptr<Request> &request) -> bool {
+  while (!ready_.empty()) {
+    auto id = ready_.front();
+    ready_.pop_front();
+    auto iter = streams_.find(id);
+    // 期间被客户端重置的流直接跳过
+    if (iter != streams_.end() && iter->second.request_ != nullptr) {
+      stream_id = id;
+      request = std::move(iter->second.request_);
+      return true;
+    }
+  }
+  return false;
+}
+
+auto Http2Session::ReadBody(uint32_t stream_id, const BodyCallback &on_data) -> BodyStatus {
+  auto iter = streams_.find(stream_id);
+  if (closed_ || iter == streams_.end()) {
+    return BodyStatus::ERROR;
+  }
+  auto &stream = iter->second;
+  if (!stream.body_.empty()) {
+    on_data(stream.body_);
+    auto size = stream.body_.size();
+    stream.body_.clear();
+    ReleaseRecvWindow(stream_id, &stream, size);
+  }
+  return stream.remote_closed_ ? BodyStatus::COMPLETE : BodyStatus::INCOMPLETE;
+}
+
+void Http2Session::Submit(uint32_t stream_id, const Response &response, std::vector<BodySlice> body,
+                          bool end_stream) {
+  auto iter = streams_.find(stream_id);
+  if (closed_ || iter == streams_.end() || iter->second.responded_) {
+    return;
+  }
+  auto &stream = iter->second;
+  stream.responded_ = true;
+  stream.body_open_ = !end_stream;
+  if (!stream.body_.empty()) {
+    ReleaseRecvWindow(stream_id, &stream, stream.body_.size());
+    stream.body_.clear();
+  }
+  for (auto &slice : body) {
+    if (slice.length_ > 0) {
+      stream.pending_size_ += slice.length_;
+      stream.pending_.push_back(std::move(slice));
+    }
+  }
+  // 响应头：小写的header名，去掉HTTP/2中不允许的逐跳header，补上Date
+  std::vector<unsigned char> block;
+  encoder_.BeginBlock(block);
+  encoder_.Encode(":status", response.GetStatusCode(), block);
+  std::string name;
+  response.GetHeaderTable().ForEach([&](std::string_view key, std::string_view value) {
+    name.assign(key);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (std::find(std::begin(CONNECTION_SPECIFIC_HEADERS), std::end(CONNECTION_SPECIFIC_HEADERS), name) ==
+        std::end(CONNECTION_SPECIFIC_HEADERS)) {
+      encoder_.Encode(name, value, block);
+    }
+  });
+  encoder_.Encode("date", CachedHttpDate(), block);
+  // 超过对端最大帧大小的header块拆成HEADERS和若干CONTINUATION
+  end_stream = stream.pending_.empty() && !stream.body_open_;
+  size_t offset = 0;
+  do {
+    auto length = std::min<size_t>(block.size() - offset, max_frame_size_);
+    uint8_t flags = offset + length == block.size() ? FLAG_END_HEADERS : 0;
+    if (offset == 0) {
+      WriteFrameHeader(length, Http2FrameType::HEADERS, flags | (end_stream ? FLAG_END_STREAM : 0), stream_id);
+    } else {
+      WriteFrameHeader(length, Http2FrameType::CONTINUATION, flags, stream_id);
+    }
+    WriteBytes(block.data() + offset, length);
+    offset += length;
+  } while (offset < block.size());
+  if (end_stream) {
+    CloseStream(iter);
+    return;
+  }
+  Flush();
+}
+
+auto Http2Session::SubmitData(uint32_t stream_id, std::vector<BodySlice> body, bool end_stream) -> bool {
+  auto iter = streams_.find(stream_id);
+  if (closed_ || iter == streams_.end() || !iter->second.body_open_) {
+    return false;
+  }
+  auto &stream = iter->second;
+  for (auto &slice : body) {
+    if (slice.length_ > 0) {
+      stream.pending_size_ += slice.length_;
+      stream.pending_.push_back(std::move(slice));
+    }
+  }
+  stream.body_open_ = !end_stream;
+  if (end_stream && stream.pending_.empty()) {
+    // 之前的数据都已发出，用一个空的DATA帧结束流，它不占用流量控制窗口
+    WriteFrameHeader(0, Http2FrameType::DATA, FLAG_END_STREAM, stream_id);
+    CloseStream(iter);
+    return true;
+  }
+  Flush();
+  return true;
+}
+
+void Http2Session::AbortStream(uint32_t stream_id) {
+  if (!closed_ && streams_.find(stream_id) != streams_.end()) {
+    ResetStream(stream_id, Http2Error::INTERNAL_ERROR);
+  }
+}
+
+auto Http2Session::GetPendingSize(uint32_t stream_id) const noexcept -> size_t {
+  auto iter = streams_.find(stream_id);
+  return iter == streams_.end() ? 0 : iter->second.pending_size_;
+}
+
+auto Http2Session::TakeOutput() -> std::vector<BodySlice> {
+  std::vector<BodySlice> output;
+  output.swap(output_);
+  return output;
+}
+
+auto Http2Session::ShouldClose() const noexcept -> bool { return closed_ || (goaway_received_ && streams_.empty()); }
+
+auto Http2Session::GetStreamCount() const noexcept -> size_t { return streams_.size(); }
+
+auto Http2Session::HandleFrame(const FrameHeader &header, std::string_view payload) -> bool {
+  // header块必须连续，中间不能穿插其他帧
+  if (header_stream_id_ != 0 && header.type_ != Http2FrameType::CONTINUATION) {
+    return ConnectionError(Http2Error::PROTOCOL_ERROR);
+  }
+  switch (header.type_) {
+    case Http2FrameType::DATA:
+      return HandleData(header, payload);
+    case Http2FrameType::HEADERS:
+      return HandleHeaders(header, payload);
+    case Http2FrameType::CONTINUATION:
+      return HandleContinuation(header, payload);
+    case Http2FrameType::SETTINGS:
+      return HandleSettings(header, payload);
+    case Http2FrameType::WINDOW_UPDATE:
+      return HandleWindowUpdate(header, payload);
+    case Http2FrameType::PRIORITY:
+      // 不实现优先级，所有流轮流发送
+      if (header.stream_id_ == 0) {
+        return ConnectionError(Http2Error::PROTOCOL_ERROR);
+      }
+      if (payload.size() != PRIORITY_SIZE) {
+        return ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+      }
+      return true;
+    case Http2FrameType::RST_STREAM:
+      if (header.stream_id_ == 0 || header.stream_id_ > last_stream_id_) {
+        return ConnectionError(Http2Error::PROTOCOL_ERROR);
+      }
+      if (payload.size() != RST_STREAM_SIZE) {
+        return ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+      }
+      // 丢弃还没发出的响应体，正在处理的请求完成后Submit会被忽略
+      if (auto iter = streams_.find(header.stream_id_); iter != streams_.end()) {
+        EraseStream(iter);
+      }
+      return true;
+    case Http2FrameType::PING:
+      if (header.stream_id_ != 0) {
+        return ConnectionError(Http2Error::PROTOCOL_ERROR);
+      }
+      if (payload.size() != PING_SIZE) {
+        return ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+      }
+      if ((header.flags_ & FLAG_ACK) == 0) {
+        WriteFrameHeader(PING_SIZE, Http2FrameType::PING, FLAG_ACK, 0);
+        WriteBytes(payload.data(), payload.size());
+      }
+      return true;
+    case Http2FrameType::GOAWAY:
+      if (header.stream_id_ != 0) {
+        return ConnectionError(Http2Error::PROTOCOL_ERROR);
+      }
+      if (payload.size() < GOAWAY_MIN_SIZE) {
+        return ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+      }
+      // 完成已经开始的流之后关闭连接
+      goaway_received_ = true;
+      return true;
+    case Http2FrameType::PUSH_PROMISE:
+      // 客户端不能推送
+      return ConnectionError(Http2Error::PROTOCOL_ERROR);
+    default:
+      // 忽略未知类型的帧
+      return true;
+  }
+}
+
+auto Http2Session::HandleData(const FrameHeader &header, std::string_view payload) -> bool {
+  if (header.stream_id_ == 0) {
+    return ConnectionError(Http2Error::PROTOCOL_ERROR);
+  }
+  if (static_cast<int64_t>(payload.size()) > recv_window_) {
+    return ConnectionError(Http2Error::FLOW_CONTROL_ERROR);
+  }
+  if ((header.flags_ & FLAG_PADDED) != 0 &&
+      (payload.empty() || static_cast<uint8_t>(payload[0]) >= payload.size())) {
+    return ConnectionError(Http2Error::PROTOCOL_ERROR);
+  }
+  // 填充的部分同样计入流量控制
+  recv_window_ -= static_cast<int64_t>(payload.size());
+  auto iter = streams_.find(header.stream_id_);
+  if (iter == streams_.end() || iter->second.remote_closed_) {
+    if (header.stream_id_ > last_stream_id_) {
+      return ConnectionError(Http2Error::PROTOCOL_ERROR);
+    }
+    // 没有人会读取这些数据，立即归还连接窗口
+    ReleaseRecvWindow(header.stream_id_, nullptr, payload.size());
+    // 已经关闭的流上迟到的帧直接忽略，对端在收到我们的RST_STREAM之前可能已经发出，
+    // 只有对端已经结束的流上又收到DATA才是错误
+    if (iter != streams_.end()) {
+      ResetStream(header.stream_id_, Http2Error::STREAM_CLOSED);
+    }
+    return true;
+  }
+  auto &stream = iter->second;
+  if (static_cast<int64_t>(payload.size()) > stream.recv_window_) {
+    ReleaseRecvWindow(header.stream_id_, nullptr, payload.size());
+    ResetStream(header.stream_id_, Http2Error::FLOW_CONTROL_ERROR);
+    return true;
+  }
+  stream.recv_window_ -= static_cast<int64_t>(payload.size());
+  auto data = payload;
+  if ((header.flags_ & FLAG_PADDED) != 0) {
+    data = payload.substr(1, payload.size() - 1 - static_cast<uint8_t>(payload[0]));
+  }
+  if (stream.responded_) {
+    // 已经回复过的流不再读取请求体
+    data = {};
+  }
+  stream.body_.append(data);
+  ReleaseRecvWindow(header.stream_id_, &stream, payload.size() - data.size());
+  if ((header.flags_ & FLAG_END_STREAM) != 0) {
+    RemoteClosed(stream);
+  }
+  return true;
+}
+
+auto Http2Session::HandleHeaders(const FrameHeader &header, std::string_view payload) -> bool {
+  if (header.stream_id_ == 0 || header.stream_id_ % 2 == 0) {
+    return ConnectionError(Http2Error::PROTOCOL_ERROR);
+  }
+  if ((header.flags_ & FLAG_PADDED) != 0) {
+    if (payload.empty() || static_cast<uint8_t>(payload[0]) >= payload.size()) {
+      return ConnectionError(Http2Error::PROTOCOL_ERROR);
+    }
+    auto padding = static_cast<uint8_t>(payload[0]);
+    payload = payload.substr(1, payload.size() - 1 - padding);
+  }
+  if ((header.flags_ & FLAG_PRIORITY) != 0) {
+    if (payload.size() < PRIORITY_SIZE) {
+      return ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+    }
+    payload.remove_prefix(PRIORITY_SIZE);
+  }
+  header_block_.assign(payload);
+  header_stream_id_ = header.stream_id_;
+  header_end_stream_ = (header.flags_ & FLAG_END_STREAM) != 0;
+  if ((header.flags_ & FLAG_END_HEADERS) != 0) {
+    return EndHeaderBlock();
+  }
+  return true;
+}
+
+auto Http2Session::HandleContinuation(const FrameHeader &header, std::string_view payload) -> bool {
+  if (header_stream_id_ == 0 || header.stream_id_ != header_stream_id_) {
+    return ConnectionError(Http2Error::PROTOCOL_ERROR);
+  }
+  header_block_.append(payload);
+  // 压缩后的块已经超过解码后的上限，不必再等
+  if (header_block_.size() > HPACK_MAX_HEADER_LIST_SIZE) {
+    return ConnectionError(Http2Error::ENHANCE_YOUR_CALM);
+  }
+  if ((header.flags_ & FLAG_END_HEADERS) != 0) {
+    return EndHeaderBlock();
+  }
+  return true;
+}
+
+auto Http2Session::HandleSettings(const FrameHeader &header, std::string_view payload) -> bool {
+  if (header.stream_id_ != 0) {
+    return ConnectionError(Http2Error::PROTOCOL_ERROR);
+  }
+  if ((header.flags_ & FLAG_ACK) != 0) {
+    return payload.empty() ? true : ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+  }
+  if (payload.size() % SETTINGS_ENTRY_SIZE != 0) {
+    return ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+  }
+  if (!ApplySettings(payload)) {
+    return false;
+  }
+  settings_received_ = true;
+  WriteFrameHeader(0, Http2FrameType::SETTINGS, FLAG_ACK, 0);
+  // 初始窗口可能变大了
+  Flush();
+  return true;
+}
+
+auto Http2Session::HandleWindowUpdate(const FrameHeader &header, std::string_view payload) -> bool {
+  if (payload.size() != WINDOW_UPDATE_SIZE) {
+    return ConnectionError(Http2Error::FRAME_SIZE_ERROR);
+  }
+  auto increment = static_cast<int64_t>(ReadUint32(payload) & STREAM_ID_MASK);
+  if (header.stream_id_ == 0) {
+    if (increment == 0) {
+      return ConnectionError(Http2Error::PROTOCOL_ERROR);
+    }
+    send_window_ += increment;
+    if (send_window_ > HTTP2_MAX_WINDOW_SIZE) {
+      return ConnectionError(Http2Error::FLOW_CONTROL_ERROR);
+    }
+  } else {
+    auto iter = streams_.find(header.stream_id_);
+    if (iter == streams_.end()) {
+      // 已关闭的流可能还会收到WINDOW_UPDATE
+      return header.stream_id_ <= last_stream_id_ ? true : ConnectionError(Http2Error::PROTOCOL_ERROR);
+    }
+    if (increment == 0) {
+      ResetStream(header.stream_id_, Http2Error::PROTOCOL_ERROR);
+      return true;
+    }
+    iter->second.send_window_ += increment;
+    if (iter->second.send_window_ > HTTP2_MAX_WINDOW_SIZE) {
+      ResetStream(header.stream_id_, Http2Error::FLOW_CONTROL_ERROR);
+      return true;
+    }
+  }
+  Flush();
+  return true;
+}
+
+auto Http2Session::ApplySettings(std::string_view payload) -> bool {
+  for (size_t offset = 0; offset + SETTINGS_ENTRY_SIZE <= payload.size(); offset += SETTINGS_ENTRY_SIZE) {
+    auto id = static_cast<uint16_t>((static_cast<uint8_t>(payload[offset]) << 8) |
+                                    static_cast<uint8_t>(payload[offset + 1]));
+    auto value = ReadUint32(payload.substr(offset + 2));
+    switch (id) {
+      case SETTINGS_HEADER_TABLE_SIZE:
+        encoder_.SetMaxTableSize(value);
+        break;
+      case SETTINGS_ENABLE_PUSH:
+        if (value > 1) {
+          return ConnectionError(Http2Error::PROTOCOL_ERROR);
+        }
+        break;
+      case SETTINGS_INITIAL_WINDOW_SIZE: {
+        if (value > HTTP2_MAX_WINDOW_SIZE) {
+          return ConnectionError(Http2Error::FLOW_CONTROL_ERROR);
+        }
+        // 差值作用于所有已打开的流
+        auto delta = static_cast<int64_t>(value) - initial_window_size_;
+        for (auto &[stream_id, stream] : streams_) {
+          stream.send_window_ += delta;
+          if (stream.send_window_ > HTTP2_MAX_WINDOW_SIZE) {
+            return ConnectionError(Http2Error::FLOW_CONTROL_ERROR);
+          }
+        }
+        initial_window_size_ = value;
+        break;
+      }
+      case SETTINGS_MAX_FRAME_SIZE:
+        if (value < HTTP2_DEFAULT_MAX_FRAME_SIZE || value > HTTP2_MAX_FRAME_SIZE_LIMIT) {
+          return ConnectionError(Http2Error::PROTOCOL_ERROR);
+        }
+        max_frame_size_ = value;
+        break;
+      default:
+        // MAX_CONCURRENT_STREAMS限制的是我们发起的流，服务端不推送；其余未知参数忽略
+        break;
+    }
+  }
+  return true;
+}
+
+auto Http2Session::EndHeaderBlock() -> bool {
+  auto stream_id = header_stream_id_;
+  header_stream_id_ = 0;
+  std::vector<HeaderField> fields;
+  bool decoded = decoder_.Decode(header_block_, fields);
+  header_block_.clear();
+  if (!decoded) {
+    return ConnectionError(Http2Error::COMPRESSION_ERROR);
+  }
+  auto iter = streams_.find(stream_id);
+  if (iter != streams_.end()) {
+    // 已打开的流上的第二个header块是trailer，必须结束请求
+    if (iter->second.remote_closed_ || !header_end_stream_) {
+      ResetStream(stream_id, iter->second.remote_closed_ ? Http2Error::STREAM_CLOSED : Http2Error::PROTOCOL_ERROR);
+    } else {
+      RemoteClosed(iter->second);
+    }
+    return true;
+  }
+  if (stream_id <= last_stream_id_) {
+    // 已经关闭的流，例如被我们拒绝或重置过
+    ResetStream(stream_id, Http2Error::STREAM_CLOSED);
+    return true;
+  }
+  last_stream_id_ = stream_id;
+  if (streams_.size() >= HTTP2_MAX_CONCURRENT_STREAMS) {
+    ResetStream(stream_id, Http2Error::REFUSED_STREAM);
+    return true;
+  }
+  auto request = MakeRequest(fields);
+  if (request == nullptr) {
+    ResetStream(stream_id, Http2Error::PROTOCOL_ERROR);
+    return true;
+  }
+  auto &stream = streams_[stream_id];
+  stream.send_window_ = initial_window_size_;
+  stream.request_ = std::move(request);
+  stream.remote_closed_ = header_end_stream_;
+  ready_.push_back(stream_id);
+  return true;
+}
+
+auto Http2Session::MakeRequest(const std::vector<HeaderField> &fields) -> std::unique_ptr<Request> {
+  std::string_view method;
+  std::string_view path;
+  std::string_view authority;
+  bool has_scheme = false;
+  bool regular_seen = false;
+  std::vector<std::pair<std::string, std::string>> headers;
+  for (const auto &[name, value] : fields) {
+    if (name.empty()) {
+      return nullptr;
+    }
+    if (name.front() == ':') {
+      // 伪header必须在普通header之前，且每个只能出现一次
+      std::string_view *target = nullptr;
+      if (name == ":method") {
+        target = &method;
+      } else if (name == ":path") {
+        target = &path;
+      } else if (name == ":authority") {
+        target = &authority;
+      } else if (name == ":scheme" && !has_scheme) {
+        has_scheme = true;
+        continue;
+      }
+      if (regular_seen || target == nullptr || !target->empty()) {
+        return nullptr;
+      }
+      *target = value;
+      continue;
+    }
+    regular_seen = true;
+    bool has_upper = std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; });
+    bool connection_specific =
+        std::find(std::begin(CONNECTION_SPECIFIC_HEADERS), std::end(CONNECTION_SPECIFIC_HEADERS), name) !=
+        std::end(CONNECTION_SPECIFIC_HEADERS);
+    if (has_upper || connection_specific || (name == "te" && value != "trailers")) {
+      return nullptr;
+    }
+    headers.emplace_back(name, value);
+  }
+  if (method.empty() || path.empty() || !has_scheme) {
+    return nullptr;
+  }
+  if (!authority.empty() &&
+      std::none_of(headers.begin(), headers.end(), [](const auto &header) { return header.first == "host"; })) {
+    headers.emplace_back("host", authority);
+  }
+  return std::make_unique<Request>(method, path, headers);
+}
+
+void Http2Session::RemoteClosed(Stream &stream) {
+  stream.remote_closed_ = true;
+  // 流的接收窗口不会再用到，之后读走的字节只归还连接窗口
+  stream.recv_released_ = 0;
+}
+
+void Http2Session::ReleaseRecvWindow(uint32_t stream_id, Stream *stream, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  recv_released_ += static_cast<int64_t>(size);
+  if (recv_released_ >= HTTP2_DEFAULT_WINDOW_SIZE / 2) {
+    WriteWindowUpdate(0, recv_released_);
+    recv_window_ += recv_released_;
+    recv_released_ = 0;
+  }
+  if (stream == nullptr || stream->remote_closed_) {
+    return;
+  }
+  stream->recv_released_ += static_cast<int64_t>(size);
+  if (stream->recv_released_ >= HTTP2_DEFAULT_WINDOW_SIZE / 2) {
+    WriteWindowUpdate(stream_id, stream->recv_released_);
+    stream->recv_window_ += stream->recv_released_;
+    stream->recv_released_ = 0;
+  }
+}
+
+auto Http2Session::CloseStream(std::map<uint32_t, Stream>::iterator iter) -> std::map<uint32_t, Stream>::iterator {
+  if (!iter->second.remote_closed_) {
+    std::string payload;
+    AppendUint32(payload, static_cast<uint32_t>(Http2Error::NO_ERROR));
+    WriteFrameHeader(payload.size(), Http2FrameType::RST_STREAM, 0, iter->first);
+    WriteBytes(payload.data(), payload.size());
+  }
+  return EraseStream(iter);
+}
+
+auto Http2Session::EraseStream(std::map<uint32_t, Stream>::iterator iter) -> std::map<uint32_t, Stream>::iterator {
+  ReleaseRecvWindow(iter->first, nullptr, iter->second.body_.size());
+  return streams_.erase(iter);
+}
+
+void Http2Session::WriteWindowUpdate(uint32_t stream_id, int64_t increment) {
+  std::string payload;
+  AppendUint32(payload, static_cast<uint32_t>(increment));
+  WriteFrameHeader(WINDOW_UPDATE_SIZE, Http2FrameType::WINDOW_UPDATE, 0, stream_id);
+  WriteBytes(payload.data(), payload.size());
+}
+
+void Http2Session::Flush() {
+  bool progress = true;
+  while (progress && send_window_ > 0) {
+    progress = false;
+    // 每一轮每个流最多发一个帧，多个响应交错发出
+    for (auto iter = streams_.begin(); iter != streams_.end() && send_window_ > 0;) {
+      auto &stream = iter->second;
+      if (stream.pending_.empty() || stream.send_window_ <= 0) {
+        ++iter;
+        continue;
+      }
+      auto &front = stream.pending_.front();
+      auto length = std::min<size_t>({front.length_, max_frame_size_, static_cast<size_t>(stream.send_window_),
+                                      static_cast<size_t>(send_window_)});
+      bool last = length == front.length_ && stream.pending_.size() == 1 && !stream.body_open_;
+      WriteFrameHeader(length, Http2FrameType::DATA, last ? FLAG_END_STREAM : 0, iter->first);
+      if (length == front.length_) {
+        WriteSlice(std::move(front));
+        stream.pending_.pop_front();
+      } else {
+        WriteSlice(front.Sub(0, length));
+        front = front.Sub(length, front.length_ - length);
+      }
+      stream.pending_size_ -= length;
+      stream.send_window_ -= static_cast<int64_t>(length);
+      send_window_ -= static_cast<int64_t>(length);
+      progress = true;
+      iter = last ? CloseStream(iter) : std::next(iter);
+    }
+  }
+}
+
+auto Http2Session::ConnectionError(Http2Error error) -> bool {
+  if (closed_) {
+    return false;
+  }
+  std::string payload;
+  AppendUint32(payload, last_stream_id_);
+  AppendUint32(payload, static_cast<uint32_t>(error));
+  WriteFrameHeader(payload.size(), Http2FrameType::GOAWAY, 0, 0);
+  WriteBytes(payload.data(), payload.size());
+  closed_ = true;
+  streams_.clear();
+  ready_.clear();
+  return false;
+}
+
+void Http2Session::ResetStream(uint32_t stream_id, Http2Error error) {
+  std::string payload;
+  AppendUint32(payload, static_cast<uint32_t>(error));
+  WriteFrameHeader(payload.size(), Http2FrameType::RST_STREAM, 0, stream_id);
+  WriteBytes(payload.data(), payload.size());
+  if (auto iter = streams_.find(stream_id); iter != streams_.end()) {
+    EraseStream(iter);
+  }
+}
+
+void Http2Session::WriteFrameHeader(size_t length, Http2FrameType type, uint8_t flags, uint32_t stream_id) {
+  unsigned char head[HTTP2_FRAME_HEADER_SIZE] = {
+      static_cast<unsigned char>(length >> 16),    static_cast<unsigned char>(length >> 8),
+      static_cast<unsigned char>(length),          static_cast<unsigned char>(type),
+      flags,                                       static_cast<unsigned char>(stream_id >> 24),
+      static_cast<unsigned char>(stream_id >> 16), static_cast<unsigned char>(stream_id >> 8),
+      static_cast<unsigned char>(stream_id)};
+  WriteBytes(head, sizeof(head));
+}
+
+void Http2Session::WriteBytes(const void *data, size_t size) {
+  // 帧头等小块数据合并到同一个片段里
+  if (output_.empty() || output_.back().block_ != nullptr || output_.back().file_ != nullptr) {
+    output_.push_back(BodySlice::FromBytes({}));
+  }
+  auto &bytes = output_.back();
+  bytes.bytes_.append(static_cast<const char *>(data), size);
+  bytes.length_ = bytes.bytes_.size();
+}
+
+void Http2Session::WriteSlice(BodySlice slice) {
+  if (slice.block_ == nullptr && slice.file_ == nullptr) {
+    WriteBytes(slice.bytes_.data(), slice.bytes_.size());
+    return;
+  }
+  output_.push_back(std::move(slice));
+}
+
+}  // namespace Next::Http
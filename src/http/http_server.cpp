@@ -1,104 +1,1177 @@
+#include <algorithm>
+#include <charconv>
+
+#include "core/concurrency_limiter.h"
+#include "core/fd_cache.h"
 #include "core/next_server.h"
+#include "http/body_stream.h"
+#include "http/cgi_result_cache.h"
+#include "http/cgi_worker_pool.h"
 #include "http/cgier.h"
+#include "http/content_coding.h"
+#include "http/file_meta_cache.h"
 #include "http/header.h"
+#include "http/http2.h"
 #include "http/http_utils.h"
 #include "http/request.h"
+#include "http/request_parser.h"
 #include "http/response.h"
+#include "http/router.h"
 #include "log/logger.h"
 
 namespace Next::Http {
 
-void PrecessHttpRequest(const std::string &serving_dir,
-                        std::shared_ptr<Cache> &cache,
-                        Connection *client_conn) {
-  // ET模式，一次性读完所有数据
-  int from_fd = client_conn->GetFd();
-  auto [read, exit] = client_conn->Recv();
-  if (exit) {
-    client_conn->GetLooper()->DeleteConnection(from_fd);
-    // client_conn指针被释放，不应该再访问
-    LOG_INFO("client fd=" + std::to_string(from_fd) + "has exited");
+/* 所有reactor共享的http服务状态，生命周期与服务器相同 */
+struct HttpServerContext {
+  std::string serving_dir;
+  std::shared_ptr<Cache> cache;
+  std::shared_ptr<ConcurrencyLimiter> limiter;
+  // 缓存序列化好的完整静态响应，为空时不启用
+  std::shared_ptr<Cache> response_cache;
+  // 静态文件的元数据，文件变化时通过InvalidateCachedFile清理其他缓存
+  std::shared_ptr<FileMetaCache> file_meta;
+  // 静态文件已打开的fd
+  std::shared_ptr<FdCache> fd_cache;
+  // 进程内的处理函数，先于cgi和静态文件匹配，为空时不启用
+  std::shared_ptr<Router> router;
+  // 由常驻worker运行的cgi程序，按程序的完整路径查找，其余cgi程序每个请求fork一次
+  std::map<std::string, std::shared_ptr<CgiWorkerPool>> cgi_pools{};
+  // 登记过ttl的幂等cgi程序的输出缓存，为空时不启用
+  std::shared_ptr<CgiResultCache> cgi_cache{};
+};
+
+void ServeHttpRequests(const HttpServerContext &context,
+                       Connection *client_conn);
+
+void ServeHttp2(const HttpServerContext &context, Connection *client_conn);
+
+void PumpBodyStream(const HttpServerContext &context, Connection *client_conn);
+
+/**
+ * 等待请求体的路由调用，请求体每解码出一段交给response.on_body_，
+ * 收齐后由FinishRouteRequest调用response.on_body_end_并按它填写的内容回复
+ */
+struct PendingRoute {
+  RouteResponse response;
+  ConcurrencyLimiter::Permit permit;
+  bool should_close{true};
+  bool is_head{false};
+};
+
+/**
+ * 每个连接上跨多次读事件保存的解析状态
+ * 请求头不完整时下次从停下的位置继续，请求头完整后立即处理，请求体在之后的读事件中逐段解码
+ * 以客户端前言开始或者通过Upgrade: h2c升级的连接之后由http2处理
+ * 流式响应体和关闭连接的状态也跨越多次读写事件
+ */
+struct HttpConnectionState {
+  RequestParser parser;
+  std::unique_ptr<Request> request;
+  // 当前请求的请求体，解码完成之前不解析下一个请求
+  BodyDecoder body;
+  // 正在接收请求体的路由调用，为空时请求体解码后丢弃
+  std::unique_ptr<PendingRoute> route;
+  std::unique_ptr<Http2Session> http2;
+  // HTTP/2中正在接收请求体的路由调用，按流编号查找
+  std::map<uint32_t, std::unique_ptr<PendingRoute>> http2_routes;
+  // 还没有解析过任何请求，只有这时才检查HTTP/2的客户端前言
+  bool at_start{true};
+  // 正在发送的流式响应体，HTTP/1.1在它发完之前不处理后面的请求，HTTP/2不开始新的流
+  std::shared_ptr<BodyStream> stream;
+  ConcurrencyLimiter::Permit stream_permit;
+  // HTTP/2中流式响应所在的流
+  uint32_t stream_id{0};
+  // offload线程正在读取下一段
+  bool stream_reading{false};
+  // 非阻塞的流已在连接的looper上启动
+  bool stream_started{false};
+  // HTTP/1.1在流式响应发完后关闭连接
+  bool stream_should_close{false};
+  // 写缓冲区发完后关闭连接，之后到达的数据都被忽略
+  bool close_after_write{false};
+  // 最近一次读事件从poll返回的时刻，读缓冲区中的请求从这时起等待处理，计入并发限制器的延迟
+  uint64_t arrival{0};
+};
+
+auto GetConnectionState(Connection *client_conn) -> HttpConnectionState & {
+  auto &context = client_conn->GetContext();
+  if (!context.has_value()) {
+    context = std::make_shared<HttpConnectionState>();
+  }
+  return **std::any_cast<std::shared_ptr<HttpConnectionState>>(&context);
+}
+
+void EndBodyStream(HttpConnectionState &state) {
+  state.stream = nullptr;
+  state.stream_permit = ConcurrencyLimiter::Permit();
+  state.stream_id = 0;
+  state.stream_started = false;
+}
+
+/**
+ * 删除连接前先结束流式响应，连接要到looper本轮事件处理完才销毁，
+ * 在此之前到达的流的回调(例如cgi管道可读)不能再访问它
+ */
+void DeleteHttpConnection(Connection *client_conn) {
+  EndBodyStream(GetConnectionState(client_conn));
+  client_conn->GetLooper()->DeleteConnection(client_conn->GetFd());
+}
+
+/**
+ * 发出写缓冲区，发送出错时删除连接并返回false，client_conn不应再访问
+ * 对端暂时收不下的数据留在写缓冲区，可写事件到达后由PrecessHttpRequest继续发送
+ */
+auto FlushConnection(Connection *client_conn) -> bool {
+  if (client_conn->Send()) {
+    return true;
+  }
+  DeleteHttpConnection(client_conn);
+  return false;
+}
+
+/* 发出已排队的数据后关闭连接，对端暂时收不下时等写缓冲区发完再关闭，不会截断大的响应 */
+void CloseAfterWrite(Connection *client_conn) {
+  if (client_conn->Send() && client_conn->GetWriteBufferSize() > 0) {
+    GetConnectionState(client_conn).close_after_write = true;
     return;
   }
-  // 检察是否有http请求
-  bool no_more_parse = false;
-  std::optional<std::string> request_op =
-      client_conn->FindAndPopTill("\r\n\r\n");
-  while (request_op != std::nullopt) {
-    Request request{request_op.value()};
-    std::vector<unsigned char> response_buf;
-    if (!request.IsValid()) {
-      auto response = Response::Make400Response();
-      response.Serialize(response_buf);
-      no_more_parse = true;
-    } else {
-      std::string resource_full_path = serving_dir + request.GetResourceUrl();
-      //std::cout << "recv a http request, request path: " << resource_full_path << std::endl;
-      if (IsCgiRequest(resource_full_path)) {
-        // dynamic cgi request
-        Cgier cgier = Cgier::ParseCgier(resource_full_path);
-        if (!cgier.IsValid()) {
-          auto response = Response::Make400Response();
-          response.Serialize(response_buf);
-          no_more_parse = true;
-        } else {
-          auto cgi_program = cgier.GetPath();
-          if (!IsFileExists(cgi_program)) {
-            auto response = Response::Make404Response();
-            response.Serialize(response_buf);
-            no_more_parse = true;
-          } else {
-            auto cgi_result = cgier.Run();
-            auto response =
-                Response::Make200Response(request.ShouldClose(), std::nullopt);
-            response.ChangeHeader(HEADER_CONTENT_LENGTH,
-                                  std::to_string(cgi_result.size()));
-            no_more_parse = request.ShouldClose();
-            response.Serialize(response_buf);
-            // 加上响应体为cgi程序结果
-            response_buf.insert(response_buf.end(), cgi_result.begin(),
-                                cgi_result.end());
-          }
+  DeleteHttpConnection(client_conn);
+}
+
+/**
+ * 把一个响应放入写缓冲区，返回是否可以继续解析后续的请求
+ * 同一次读事件中流水线请求的响应累积在写缓冲区里，由ServeHttpRequests统一用一次send发出
+ * 需要关闭连接时发出已累积的响应，发完后关闭连接，返回false，client_conn不应再访问
+ */
+auto QueueHttpResponse(Connection *client_conn,
+                       std::vector<unsigned char> &&response_buf,
+                       bool no_more_parse) -> bool {
+  client_conn->WriteToWriteBuffer(std::move(response_buf));
+  if (no_more_parse) {
+    CloseAfterWrite(client_conn);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * 完整响应缓存的key，同一路径的GET/HEAD、keep-alive/close以及客户端接受的内容编码各自缓存一份
+ * 不可压缩的文件在各个编码下缓存的都是原文件的响应
+ */
+auto ResponseCacheKey(Method method, bool should_close, ContentCoding accepted,
+                      const std::string &resource_full_path) -> std::string {
+  static constexpr char CODING_TAGS[] = {'I', 'g', 'd'};
+  std::string key;
+  key.reserve(resource_full_path.size() + 3);
+  key.push_back(method == Method::HEAD ? 'H' : 'G');
+  key.push_back(should_close ? 'C' : 'K');
+  key.push_back(CODING_TAGS[static_cast<int>(accepted)]);
+  key.append(resource_full_path);
+  return key;
+}
+
+/* 压缩后的响应体在内容缓存中的key，与原文件的条目并存，每个资源只压缩一次 */
+auto EncodedCacheKey(const std::string &resource_full_path,
+                     ContentCoding coding) -> std::string {
+  std::string key(resource_full_path);
+  key.push_back(';');
+  key.append(ContentCodingToken(coding));
+  return key;
+}
+
+/**
+ * 发送缓存中的完整响应，块中不含Date
+ * 响应头部分和响应体都以共享块的切片排队，只有Date行写入写缓冲区
+ */
+void QueueCachedResponse(Connection *client_conn, const SharedBlock &block) {
+  static constexpr std::string_view HEADER_END = "\r\n\r\n";
+  std::string_view bytes(reinterpret_cast<const char *>(block->data()),
+                         block->size());
+  // 最后一个header行的CRLF之后插入Date
+  auto head_size = bytes.find(HEADER_END) + 2;
+  std::vector<unsigned char> date_buf;
+  Response::SerializeDateHeader(date_buf);
+  client_conn->WriteToWriteBuffer(block, 0, head_size);
+  client_conn->WriteToWriteBuffer(std::move(date_buf));
+  client_conn->WriteToWriteBuffer(block, head_size, block->size() - head_size);
+}
+
+/**
+ * 文件变化后删除它在fd缓存、文件内容缓存(包括压缩后的版本)和完整响应缓存中的所有条目
+ * 预压缩的 .gz 文件变化时，原文件的压缩版本也一起失效
+ */
+void InvalidateCachedFile(const HttpServerContext &context,
+                          const std::string &resource_full_path) {
+  static constexpr ContentCoding CODINGS[] = {
+      ContentCoding::IDENTITY, ContentCoding::GZIP, ContentCoding::DEFLATE};
+  context.fd_cache->Erase(resource_full_path);
+  context.cache->Erase(resource_full_path);
+  context.cache->Erase(EncodedCacheKey(resource_full_path, ContentCoding::GZIP));
+  context.cache->Erase(
+      EncodedCacheKey(resource_full_path, ContentCoding::DEFLATE));
+  if (context.response_cache != nullptr) {
+    for (auto method : {Method::GET, Method::HEAD}) {
+      for (bool should_close : {false, true}) {
+        for (auto accepted : CODINGS) {
+          context.response_cache->Erase(ResponseCacheKey(
+              method, should_close, accepted, resource_full_path));
         }
-      } else {
-        // http static resourse request
-        if (!IsFileExists(resource_full_path)) {
-          auto response = Response::Make404Response();
-          response.Serialize(response_buf);
-          no_more_parse = true;
-        } else {
-          auto response = Response::Make200Response(request.ShouldClose(),
-                                                    resource_full_path);
-          response.Serialize(response_buf);
-          no_more_parse = request.ShouldClose();
-          std::vector<unsigned char> cache_buf;
-          if (request.GetMethod() == Method::GET) {
-            bool resource_cached =
-                cache->TryLoad(resource_full_path, cache_buf);
-            if (!resource_cached) {
-              LoadFile(resource_full_path, cache_buf);
-              cache->TryInsert(resource_full_path, cache_buf);
-            }
+      }
+    }
+  }
+  std::string_view suffix = PRECOMPRESSED_GZIP_SUFFIX;
+  if (resource_full_path.size() > suffix.size() &&
+      resource_full_path.compare(resource_full_path.size() - suffix.size(),
+                                 suffix.size(), suffix) == 0) {
+    InvalidateCachedFile(context, resource_full_path.substr(
+                                      0, resource_full_path.size() - suffix.size()));
+  }
+}
+
+/* 从fd缓存中取出已打开的文件，未命中时打开并放入缓存，文件在查询元数据之后变化过时不缓存 */
+auto OpenCachedFile(const HttpServerContext &context,
+                    const std::string &resource_full_path, uint64_t generation)
+    -> SharedFile {
+  auto file = context.fd_cache->Find(resource_full_path);
+  if (file == nullptr &&
+      (file = OpenFile::Open(resource_full_path)) != nullptr) {
+    context.file_meta->FillIfUnchanged(generation, [&]() {
+      file = context.fd_cache->Insert(resource_full_path, file);
+    });
+  }
+  return file;
+}
+
+/**
+ * 在offload线程上生成压缩后的响应体，失败(例如文件已被删除或截断)时返回nullptr
+ * gzip优先使用同一目录下不比原文件旧的预压缩文件，否则用zlib压缩原文件，原文件已在内容缓存中时不再读盘
+ */
+auto LoadEncodedBody(const HttpServerContext &context,
+                     const std::string &resource_url,
+                     const std::string &resource_full_path,
+                     const FileMeta &meta, ContentCoding coding)
+    -> SharedBlock {
+  auto encoded = std::make_shared<std::vector<unsigned char>>();
+  if (coding == ContentCoding::GZIP) {
+    auto precompressed =
+        context.file_meta->Lookup(resource_url + PRECOMPRESSED_GZIP_SUFFIX);
+    if (precompressed.exists_ && precompressed.mtime_ >= meta.mtime_) {
+      LoadFile(resource_full_path + PRECOMPRESSED_GZIP_SUFFIX, *encoded,
+               precompressed.size_);
+      if (encoded->size() == precompressed.size_) {
+        return encoded;
+      }
+      encoded->clear();
+    }
+  }
+  auto identity = context.cache->TryLoadShared(resource_full_path);
+  if (identity == nullptr || identity->size() != meta.size_) {
+    auto file = OpenCachedFile(context, resource_full_path, meta.generation_);
+    if (file == nullptr) {
+      return nullptr;
+    }
+    std::vector<unsigned char> file_buf;
+    LoadFile(file->GetFd(), file_buf, meta.size_);
+    if (file_buf.size() != meta.size_) {
+      return nullptr;
+    }
+    identity =
+        std::make_shared<const std::vector<unsigned char>>(std::move(file_buf));
+  }
+  if (!Compress(identity->data(), identity->size(), coding, *encoded)) {
+    return nullptr;
+  }
+  return encoded;
+}
+
+/**
+ * 一个请求的处理结果，与协议无关，由HTTP/1.1和HTTP/2的连接各自发送
+ * canned非空时是固定的错误响应，HTTP/1.1随后关闭连接，HTTP/2只结束这个流
+ */
+struct HttpReply {
+  std::optional<CannedResponse> canned;
+  std::optional<Response> response;
+  std::vector<BodySlice> body;
+  // 完整响应缓存中已序列化好的HTTP/1.1响应
+  SharedBlock cached;
+  // 非空时这个响应可以用这个key放入完整响应缓存
+  std::string response_key;
+  uint64_t generation{0};
+  // 非空时响应体由它逐段产生，response不带Content-Length
+  std::shared_ptr<BodyStream> stream;
+  // 流式响应体发完之前持有的并发许可
+  ConcurrencyLimiter::Permit permit;
+  // 非空时路由处理函数在等待请求体，响应在请求体收齐后由FinishRouteRequest生成
+  std::unique_ptr<PendingRoute> route;
+};
+
+/* 需要offload的请求完成后在looper线程上交回结果 */
+using ReplyCallback = std::function<void(Connection *, HttpReply)>;
+
+auto CannedReply(CannedResponse kind) -> HttpReply {
+  HttpReply reply;
+  reply.canned = kind;
+  return reply;
+}
+
+/* 静态文件的200或304响应，body为空表示HEAD请求或者没有响应体 */
+auto StaticReply(Response response, const SharedBlock &body,
+                 std::string response_key, uint64_t generation) -> HttpReply {
+  HttpReply reply;
+  reply.response = std::move(response);
+  if (body != nullptr) {
+    reply.body.push_back(BodySlice::FromBlock(body));
+  }
+  reply.response_key = std::move(response_key);
+  reply.generation = generation;
+  return reply;
+}
+
+/**
+ * 206响应，只发送请求的区间
+ * 文件已在内容缓存中时直接引用缓存块的切片，否则通过fd缓存用sendfile发送，大文件不会被读入内存
+ * 打开文件失败时返回nullopt
+ */
+auto RangeReply(const HttpServerContext &context, bool should_close,
+                const FileMeta &meta, const std::string &resource_full_path,
+                const std::vector<ByteRange> &ranges)
+    -> std::optional<HttpReply> {
+  auto block = context.cache->TryLoadShared(resource_full_path);
+  SharedFile file;
+  if (block == nullptr || block->size() != meta.size_) {
+    block = nullptr;
+    file = OpenCachedFile(context, resource_full_path, meta.generation_);
+    if (file == nullptr) {
+      return std::nullopt;
+    }
+  }
+  HttpReply reply;
+  auto add_range = [&](const ByteRange &range) {
+    reply.body.push_back(
+        block != nullptr
+            ? BodySlice::FromBlock(block, range.first_, range.Length())
+            : BodySlice::FromFile(file, range.first_, range.Length()));
+  };
+  if (ranges.size() == 1) {
+    reply.response = Response::MakePartialResponse(should_close, ranges.front(),
+                                                   meta.size_, meta.mime_);
+    reply.response->SetValidators(meta.GetETag(), meta.mtime_);
+    add_range(ranges.front());
+    return reply;
+  }
+  std::vector<std::string> part_heads;
+  reply.response = Response::MakeMultipartResponse(
+      should_close, ranges, meta.size_, meta.mime_, part_heads);
+  reply.response->SetValidators(meta.GetETag(), meta.mtime_);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    reply.body.push_back(BodySlice::FromBytes(std::move(part_heads[i])));
+    add_range(ranges[i]);
+  }
+  reply.body.push_back(BodySlice::FromBytes(std::move(part_heads.back())));
+  return reply;
+}
+
+/**
+ * 处理静态文件请求，需要从磁盘读取或压缩文件时交给offload线程池并返回nullopt，完成后通过on_reply交回结果
+ * allow_cached_response为true时(只有HTTP/1.1)查询并填充完整响应缓存
+ */
+auto HandleStaticRequest(const HttpServerContext &context,
+                         Connection *client_conn, const Request &request,
+                         const std::string &resource_full_path,
+                         ConcurrencyLimiter::Permit permit,
+                         bool allow_cached_response,
+                         const ReplyCallback &on_reply)
+    -> std::optional<HttpReply> {
+  bool should_close = request.ShouldClose();
+  auto accept_encoding = request.GetHeader(HeaderId::ACCEPT_ENCODING);
+  auto accepted = accept_encoding.has_value()
+                      ? NegotiateContentCoding(*accept_encoding)
+                      : ContentCoding::IDENTITY;
+  allow_cached_response =
+      allow_cached_response && context.response_cache != nullptr;
+  std::string response_key;
+  if (allow_cached_response) {
+    response_key = ResponseCacheKey(request.GetMethod(), should_close, accepted,
+                                    resource_full_path);
+  }
+  // 完整响应缓存中只有整个文件的200响应，区间请求和条件请求需要先查看元数据
+  bool has_range = request.GetHeader(HeaderId::RANGE).has_value();
+  bool is_conditional =
+      request.GetHeader(HeaderId::IF_NONE_MATCH).has_value() ||
+      request.GetHeader(HeaderId::IF_MODIFIED_SINCE).has_value();
+  if (allow_cached_response && !has_range && !is_conditional) {
+    // 命中时不再stat文件，也不再构造和序列化Response
+    if (auto cached = context.response_cache->TryLoadShared(response_key);
+        cached != nullptr) {
+      HttpReply reply;
+      reply.cached = std::move(cached);
+      return reply;
+    }
+  }
+  auto meta = context.file_meta->Lookup(request.GetResourceUrl());
+  if (!meta.exists_) {
+    return CannedReply(CannedResponse::NOT_FOUND);
+  }
+  // 区间总是针对原文件，带Range的请求不压缩
+  bool compressible = IsCompressible(meta.mime_, meta.size_);
+  auto coding =
+      compressible && !has_range ? accepted : ContentCoding::IDENTITY;
+  auto etag = ContentCodingETag(meta.GetETag(), coding);
+  if (is_conditional && request.IsNotModified(etag, meta.mtime_)) {
+    // 客户端的副本仍然有效，不读取文件内容
+    auto response = Response::Make304Response(should_close, etag, meta.mtime_);
+    if (compressible) {
+      response.SetContentCoding(ContentCoding::IDENTITY);
+    }
+    return StaticReply(std::move(response), nullptr, {}, meta.generation_);
+  }
+  if (has_range) {
+    std::vector<ByteRange> ranges;
+    auto range_status =
+        request.GetRanges(meta.size_, meta.GetETag(), meta.mtime_, ranges);
+    // 同一个url的响应随Accept-Encoding变化，区间响应同样要带上Vary
+    if (range_status == RangeStatus::UNSATISFIABLE) {
+      auto response = Response::Make416Response(should_close, meta.size_);
+      if (compressible) {
+        response.SetContentCoding(ContentCoding::IDENTITY);
+      }
+      return StaticReply(std::move(response), nullptr, {}, meta.generation_);
+    }
+    if (range_status == RangeStatus::SATISFIABLE) {
+      auto reply = RangeReply(context, should_close, meta, resource_full_path,
+                              ranges);
+      if (!reply.has_value()) {
+        return CannedReply(CannedResponse::NOT_FOUND);
+      }
+      if (compressible) {
+        reply->response->SetContentCoding(ContentCoding::IDENTITY);
+      }
+      return reply;
+    }
+  }
+  // 元数据来自缓存，构造响应不再stat文件
+  auto response =
+      Response::MakeFileResponse(should_close, meta.size_, meta.mime_);
+  response.SetValidators(etag, meta.mtime_);
+  if (compressible) {
+    response.SetContentCoding(coding);
+  }
+  // HEAD也需要压缩后的长度，同样要取得压缩后的响应体
+  bool is_head = request.GetMethod() == Method::HEAD;
+  bool need_body = !is_head || coding != ContentCoding::IDENTITY;
+  auto body_key = coding == ContentCoding::IDENTITY
+                      ? resource_full_path
+                      : EncodedCacheKey(resource_full_path, coding);
+  SharedBlock body;
+  if (need_body) {
+    body = context.cache->TryLoadShared(body_key);
+  }
+  if (need_body && body == nullptr) {
+    // 未命中缓存时从磁盘读取文件并压缩，交给offload线程池
+    auto loaded = std::make_shared<SharedBlock>();
+    auto shared_permit =
+        std::make_shared<ConcurrencyLimiter::Permit>(std::move(permit));
+    client_conn->GetLooper()->Offload(
+        client_conn->GetFd(),
+        [&context, resource_url = request.GetResourceUrl(), resource_full_path,
+         loaded, meta, coding]() {
+          if (coding != ContentCoding::IDENTITY) {
+            *loaded = LoadEncodedBody(context, resource_url, resource_full_path,
+                                      meta, coding);
+            return;
           }
-          response_buf.insert(response_buf.end(), cache_buf.begin(),
-                              cache_buf.end());
-        }
+          // 复用已打开的fd，不必每次open/close
+          auto file =
+              OpenCachedFile(context, resource_full_path, meta.generation_);
+          auto file_buf = std::make_shared<std::vector<unsigned char>>();
+          if (file != nullptr) {
+            LoadFile(file->GetFd(), *file_buf, meta.size_);
+          }
+          *loaded = std::move(file_buf);
+        },
+        [&context, body_key, loaded, response, response_key, shared_permit,
+         is_head, coding, on_reply, generation = meta.generation_,
+         file_size = meta.size_](Connection *conn) mutable {
+          *shared_permit = ConcurrencyLimiter::Permit();
+          if (*loaded == nullptr) {
+            // 文件在查询元数据之后被删除或截断，无法压缩
+            on_reply(conn, CannedReply(CannedResponse::NOT_FOUND));
+            return;
+          }
+          SharedBlock block = std::move(*loaded);
+          if (coding == ContentCoding::IDENTITY && block->size() != file_size) {
+            // 文件在stat之后变化了，按实际读到的内容回复，并让代数失配使它不进入缓存
+            generation = ~generation;
+          }
+          response.SetContentLength(block->size());
+          context.file_meta->FillIfUnchanged(generation, [&]() {
+            context.cache->TryInsertShared(body_key, block);
+          });
+          on_reply(conn, StaticReply(std::move(response),
+                                     is_head ? nullptr : block,
+                                     std::move(response_key), generation));
+        });
+    return std::nullopt;
+  }
+  if (body != nullptr) {
+    response.SetContentLength(body->size());
+  }
+  return StaticReply(std::move(response), is_head ? nullptr : body,
+                     std::move(response_key), meta.generation_);
+}
+
+/* 按处理函数填写的RouteResponse构造响应，流式响应体在发完之前一直持有permit */
+auto RouteReply(RouteResponse &route_response, bool should_close, bool is_head,
+                ConcurrencyLimiter::Permit permit) -> HttpReply {
+  HttpReply reply;
+  reply.response.emplace(route_response.status_, should_close, std::nullopt);
+  reply.response->SetHeader(HEADER_CONTENT_TYPE,
+                            std::move(route_response.content_type_));
+  for (auto &[key, value] : route_response.headers_) {
+    reply.response->SetHeader(key, std::move(value));
+  }
+  if (route_response.stream_ != nullptr) {
+    reply.response->SetChunked();
+    // HEAD只需要响应头，不启动生产者
+    if (!is_head) {
+      reply.stream = std::move(route_response.stream_);
+      reply.permit = std::move(permit);
+    }
+    return reply;
+  }
+  reply.response->SetContentLength(route_response.body_.size());
+  if (!is_head) {
+    reply.body.push_back(
+        BodySlice::FromBytes(std::move(route_response.body_)));
+  }
+  return reply;
+}
+
+/**
+ * 调用路由匹配到的处理函数，处理函数在reactor线程上同步执行，这时请求体还没有读取
+ * 处理函数要接收请求体时返回的reply只带有route，连接把请求体逐段交给它，收齐后再由FinishRouteRequest回复
+ */
+auto HandleRouteRequest(const Request &request, const RouteHandler &handler,
+                        const RouteParams &params,
+                        ConcurrencyLimiter::Permit permit) -> HttpReply {
+  auto route = std::make_unique<PendingRoute>();
+  handler(request, params, route->response);
+  route->should_close = request.ShouldClose();
+  route->is_head = request.GetMethod() == Method::HEAD;
+  if (route->response.on_body_ != nullptr ||
+      route->response.on_body_end_ != nullptr) {
+    route->permit = std::move(permit);
+    HttpReply reply;
+    reply.route = std::move(route);
+    return reply;
+  }
+  return RouteReply(route->response, route->should_close, route->is_head,
+                    std::move(permit));
+}
+
+/* 请求体收齐后生成等待中的路由调用的响应 */
+auto FinishRouteRequest(PendingRoute &route) -> HttpReply {
+  if (route.response.on_body_end_ != nullptr) {
+    auto on_body_end = std::move(route.response.on_body_end_);
+    on_body_end(route.response);
+  }
+  return RouteReply(route.response, route.should_close, route.is_head,
+                    std::move(route.permit));
+}
+
+/**
+ * HTTP/1.1和HTTP/2共用的请求处理，返回这个请求的响应
+ * 先匹配路由，再按 "/cgi-bin/" 前缀执行cgi程序，其余作为静态文件
+ * 需要阻塞的文件读取交给offload线程池并返回nullopt，完成后在looper线程上调用on_reply
+ * cgi程序的输出和路由给出的流式响应体放在reply.stream中，由连接逐段读取并发送
+ * 每个请求从到达到得出响应都要持有并发限制器的许可，拿不到许可时回复503，
+ * 许可从读到请求的事件算起，请求在reactor上排队(例如前面的请求在等待offload)的时间也计入延迟
+ */
+auto HandleHttpRequest(const HttpServerContext &context,
+                       Connection *client_conn, const Request &request,
+                       bool allow_cached_response, ReplyCallback on_reply)
+    -> std::optional<HttpReply> {
+  if (!request.IsValid()) {
+    return CannedReply(CannedResponse::BAD_REQUEST);
+  }
+  const auto &resource_url = request.GetResourceUrl();
+  if (context.router != nullptr) {
+    // 匹配时不分配内存，参数是路径的视图
+    RouteParams params;
+    auto match = context.router->Match(
+        request.GetMethod(),
+        std::string_view(resource_url).substr(0, resource_url.find('?')),
+        params);
+    if (match.status_ == RouteStatus::METHOD_NOT_ALLOWED) {
+      HttpReply reply;
+      reply.response = Response::Make405Response(Router::FormatAllow(match.allowed_));
+      return reply;
+    }
+    if (match.status_ == RouteStatus::MATCHED) {
+      auto permit = context.limiter->TryAcquirePermit(
+          GetConnectionState(client_conn).arrival);
+      if (!permit.IsGranted()) {
+        return CannedReply(CannedResponse::SERVICE_UNAVAILABLE);
       }
+      return HandleRouteRequest(request, *match.handler_, params,
+                                std::move(permit));
+    }
+  }
+  if (request.GetMethod() != Method::GET &&
+      request.GetMethod() != Method::HEAD) {
+    return CannedReply(CannedResponse::METHOD_NOT_ALLOWED_STATIC);
+  }
+  auto permit = context.limiter->TryAcquirePermit(
+      GetConnectionState(client_conn).arrival);
+  if (!permit.IsGranted()) {
+    return CannedReply(CannedResponse::SERVICE_UNAVAILABLE);
+  }
+  std::string resource_full_path = context.serving_dir + resource_url;
+  if (resource_url.compare(0, std::size(CGI_BIN_PREFIX) - 1,
+                           CGI_BIN_PREFIX) != 0) {
+    // http static resourse request
+    return HandleStaticRequest(context, client_conn, request,
+                               resource_full_path, std::move(permit),
+                               allow_cached_response, on_reply);
+  }
+  // dynamic cgi request
+  Cgier cgier = Cgier::ParseCgier(resource_full_path);
+  if (!cgier.IsValid()) {
+    return CannedReply(CannedResponse::BAD_REQUEST);
+  }
+  if (!IsFileExists(cgier.GetPath())) {
+    return CannedReply(CannedResponse::NOT_FOUND);
+  }
+  // 程序的输出边产生边发送，在连接的looper上非阻塞读取，HEAD不运行程序
+  // 有常驻worker的程序交给worker，排队已满时退回fork方式
+  // 可缓存的程序命中时直接发送缓存的输出，未命中时同样的调用只运行一次
+  HttpReply reply;
+  reply.response =
+      Response::Make200Response(request.ShouldClose(), std::nullopt);
+  if (request.GetMethod() == Method::HEAD) {
+    reply.response->SetChunked();
+    return reply;
+  }
+  uint64_t ttl_ms = context.cgi_cache == nullptr
+                        ? 0
+                        : context.cgi_cache->GetTtl(cgier.GetPath());
+  std::string key;
+  if (ttl_ms != 0) {
+    key = CgiResultCache::MakeKey(cgier.GetPath(), cgier.GetArguments());
+    if (auto cached = context.cgi_cache->Lookup(key); cached != nullptr) {
+      reply.response->SetContentLength(cached->size());
+      reply.body.push_back(BodySlice::FromBlock(cached));
+      return reply;
+    }
+  }
+  auto pool = context.cgi_pools.find(cgier.GetPath());
+  std::shared_ptr<CgiWorkerPool> worker_pool =
+      pool == context.cgi_pools.end() ? nullptr : pool->second;
+  auto make_stream = [worker_pool,
+                      cgier = std::move(cgier)]() -> std::shared_ptr<BodyStream> {
+    if (worker_pool != nullptr && !worker_pool->IsSaturated()) {
+      return std::make_shared<CgiWorkerStream>(worker_pool,
+                                               cgier.GetArguments());
     }
-    // 发送响应
-    client_conn->WriteToWriteBuffer(std::move(response_buf));
+    return std::make_shared<CgiStream>(cgier);
+  };
+  reply.response->SetChunked();
+  if (ttl_ms != 0) {
+    reply.stream = std::make_shared<CgiCachedStream>(
+        context.cgi_cache, std::move(key), ttl_ms, std::move(make_stream));
+  } else {
+    reply.stream = make_stream();
+  }
+  reply.permit = std::move(permit);
+  return reply;
+}
+
+/* 把响应体的一个片段排入写缓冲区，块和文件都不拷贝 */
+void QueueBodySlice(Connection *client_conn, BodySlice &&slice) {
+  if (slice.length_ == 0) {
+    return;
+  }
+  if (slice.block_ != nullptr) {
+    client_conn->WriteToWriteBuffer(std::move(slice.block_), slice.offset_,
+                                    slice.length_);
+  } else if (slice.file_ != nullptr) {
+    client_conn->WriteToWriteBuffer(std::move(slice.file_), slice.offset_,
+                                    slice.length_);
+  } else {
+    client_conn->WriteToWriteBuffer(slice.bytes_);
+  }
+}
+
+/**
+ * 把一个响应按HTTP/1.1序列化后放入写缓冲区，返回是否可以继续解析后续的请求
+ * 启用完整响应缓存时把响应头和响应体拼成一个不可变的块放入缓存，之后的请求直接发送这个块
+ * 否则响应头写入写缓冲区，响应体的片段原样排队，同样不拷贝文件内容
+ * 流式响应先发出响应头再开始读取响应体，返回false，发完后由SendStreamChunk继续处理后面的请求
+ */
+auto QueueHttpReply(const HttpServerContext &context, Connection *client_conn,
+                    HttpReply &&reply, bool should_close) -> bool {
+  std::vector<unsigned char> head;
+  if (reply.canned.has_value()) {
+    Response::SerializeCanned(*reply.canned, head);
+    return QueueHttpResponse(client_conn, std::move(head), true);
+  }
+  if (reply.cached != nullptr) {
+    QueueCachedResponse(client_conn, reply.cached);
+  } else if (!reply.response_key.empty()) {
+    std::vector<unsigned char> full_response;
+    reply.response->SerializeWithoutDate(full_response);
+    for (const auto &slice : reply.body) {
+      auto begin = slice.block_->begin() + static_cast<ptrdiff_t>(slice.offset_);
+      full_response.insert(full_response.end(), begin,
+                           begin + static_cast<ptrdiff_t>(slice.length_));
+    }
+    auto block = std::make_shared<const std::vector<unsigned char>>(
+        std::move(full_response));
+    // 文件在查询元数据之后变化过时不缓存
+    context.file_meta->FillIfUnchanged(reply.generation, [&]() {
+      context.response_cache->TryInsertShared(reply.response_key, block);
+    });
+    QueueCachedResponse(client_conn, block);
+  } else {
+    reply.response->Serialize(head);
+    client_conn->WriteToWriteBuffer(std::move(head));
+    for (auto &slice : reply.body) {
+      QueueBodySlice(client_conn, std::move(slice));
+    }
+  }
+  // 响应头声明了Connection: Close时连接必须随之关闭
+  should_close = should_close ||
+                 (reply.response.has_value() && reply.response->ShouldClose());
+  if (reply.stream != nullptr) {
+    auto &state = GetConnectionState(client_conn);
+    state.stream = std::move(reply.stream);
+    state.stream_permit = std::move(reply.permit);
+    state.stream_should_close = should_close;
+    if (FlushConnection(client_conn)) {
+      PumpBodyStream(context, client_conn);
+    }
+    return false;
+  }
+  return QueueHttpResponse(client_conn, {}, should_close);
+}
+
+/**
+ * 解析下一个请求头，数据不足时返回INCOMPLETE
+ * 请求头完整后立即返回，请求体由ReadRequestBody在处理这个请求之后逐段解码
+ * 格式错误的请求同样返回COMPLETE，它的请求体边界未知，连接在响应后关闭
+ */
+auto NextHttpRequest(Connection *client_conn, std::unique_ptr<Request> &request) -> ParseStatus {
+  auto &state = GetConnectionState(client_conn);
+  if (state.parser.Parse(client_conn->ReadAsStringView()) == ParseStatus::INCOMPLETE) {
+    return ParseStatus::INCOMPLETE;
+  }
+  request = std::make_unique<Request>(state.parser);
+  state.at_start = false;
+  // Request已拷贝需要的数据，释放请求头占用的缓冲区
+  client_conn->ConsumeReadBuffer(state.parser.Consumed());
+  state.parser.Reset();
+  if (!request->IsValid()) {
+    return ParseStatus::COMPLETE;
+  }
+  state.body = request->MakeBodyDecoder();
+  if (request->ExpectContinue() && !state.body.IsComplete()) {
+    client_conn->WriteToWriteBuffer(CONTINUE_RESPONSE);
     client_conn->Send();
-    if (no_more_parse) {
+  }
+  return ParseStatus::COMPLETE;
+}
+
+/**
+ * 解码读缓冲区中当前请求的请求体(Content-Length或chunked)，每段交给等待它的路由处理函数后即从读缓冲区中释放，
+ * 请求体不在连接中累积，大小也不受限制，没有路由等待时解码后丢弃，只为保持同一连接上后续请求的边界
+ */
+auto ReadRequestBody(Connection *client_conn) -> BodyStatus {
+  auto &state = GetConnectionState(client_conn);
+  const auto *on_body = state.route == nullptr || state.route->response.on_body_ == nullptr
+                            ? nullptr
+                            : &state.route->response.on_body_;
+  auto status = state.body.Decode(client_conn->ReadAsStringView(), [on_body](std::string_view data) {
+    if (on_body != nullptr) {
+      (*on_body)(data);
+    }
+  });
+  if (status != BodyStatus::ERROR) {
+    client_conn->ConsumeReadBuffer(state.body.Consumed());
+  }
+  return status;
+}
+
+/**
+ * Upgrade中有h2c且带有HTTP2-Settings时返回HTTP2-Settings的值
+ * 客户端的Connection是 "Upgrade, HTTP2-Settings"，升级后连接总是保持
+ */
+auto H2cUpgradeSettings(const Request &request)
+    -> std::optional<std::string_view> {
+  auto upgrade = request.GetHeader(HeaderId::UPGRADE);
+  auto settings = request.GetHeader(HeaderId::HTTP2_SETTINGS);
+  if (!upgrade.has_value() || !settings.has_value()) {
+    return std::nullopt;
+  }
+  while (!upgrade->empty()) {
+    auto comma = upgrade->find(',');
+    if (EqualsIgnoreCase(TrimView(upgrade->substr(0, comma)), "h2c")) {
+      return settings;
+    }
+    *upgrade = comma == std::string_view::npos ? std::string_view()
+                                               : upgrade->substr(comma + 1);
+  }
+  return std::nullopt;
+}
+
+/**
+ * 把http2会话待发送的数据交给连接并发出，会话结束时发完后关闭连接
+ * 返回false时连接已关闭或者正在关闭，client_conn不应再访问
+ */
+auto FlushHttp2(Connection *client_conn, Http2Session &session) -> bool {
+  for (auto &slice : session.TakeOutput()) {
+    QueueBodySlice(client_conn, std::move(slice));
+  }
+  if (session.ShouldClose()) {
+    CloseAfterWrite(client_conn);
+    return false;
+  }
+  return FlushConnection(client_conn);
+}
+
+/* 流式响应的响应头先提交，响应体由PumpBodyStream逐段追加 */
+void SubmitHttp2Reply(HttpConnectionState &state, uint32_t stream_id,
+                      HttpReply &&reply) {
+  auto &session = *state.http2;
+  if (reply.canned.has_value()) {
+    session.Submit(stream_id, Response::MakeCanned(*reply.canned), {});
+    return;
+  }
+  bool streaming = reply.stream != nullptr;
+  session.Submit(stream_id, *reply.response, std::move(reply.body),
+                 !streaming);
+  if (streaming) {
+    state.stream = std::move(reply.stream);
+    state.stream_permit = std::move(reply.permit);
+    state.stream_id = stream_id;
+  }
+}
+
+/**
+ * 把流式响应体读到的一段交给连接，HTTP/1.1编码成一个chunk，HTTP/2作为DATA帧提交
+ * 响应体结束后HTTP/1.1继续处理后面的请求或者关闭连接，HTTP/2继续处理其他流
+ * 生产者出错时截断响应：HTTP/1.1不发送结尾的空chunk并关闭连接，HTTP/2重置这个流
+ */
+void SendStreamChunk(const HttpServerContext &context, Connection *client_conn,
+                     std::string &&chunk, StreamStatus status) {
+  static constexpr std::string_view LAST_CHUNK = "0\r\n\r\n";
+  auto &state = GetConnectionState(client_conn);
+  state.stream_reading = false;
+  bool finished = status != StreamStatus::DATA;
+  if (state.http2 != nullptr) {
+    auto &session = *state.http2;
+    if (status == StreamStatus::ERROR) {
+      session.AbortStream(state.stream_id);
+    } else {
+      std::vector<BodySlice> body;
+      if (!chunk.empty()) {
+        body.push_back(BodySlice::FromBytes(std::move(chunk)));
+      }
+      // 流已被客户端重置时不再读取，生产者随流一起被销毁
+      finished = !session.SubmitData(state.stream_id, std::move(body),
+                                     finished) ||
+                 finished;
+    }
+    if (finished) {
+      EndBodyStream(state);
+    }
+    // 发出DATA帧，流结束后继续处理其他流，否则继续读取
+    ServeHttp2(context, client_conn);
+    return;
+  }
+  if (!chunk.empty() && status != StreamStatus::ERROR) {
+    char size_line[24];
+    auto *end = std::to_chars(std::begin(size_line), std::end(size_line) - 2,
+                              chunk.size(), 16)
+                    .ptr;
+    *end++ = '\r';
+    *end++ = '\n';
+    client_conn->WriteToWriteBuffer(
+        reinterpret_cast<const unsigned char *>(size_line),
+        static_cast<size_t>(end - size_line));
+    client_conn->WriteToWriteBuffer(chunk);
+    client_conn->WriteToWriteBuffer(CRLF);
+  }
+  if (!finished) {
+    if (FlushConnection(client_conn)) {
+      PumpBodyStream(context, client_conn);
+    }
+    return;
+  }
+  bool should_close =
+      state.stream_should_close || status == StreamStatus::ERROR;
+  EndBodyStream(state);
+  if (status == StreamStatus::END) {
+    client_conn->WriteToWriteBuffer(std::string(LAST_CHUNK));
+  }
+  if (should_close) {
+    CloseAfterWrite(client_conn);
+    return;
+  }
+  if (FlushConnection(client_conn)) {
+    ServeHttpRequests(context, client_conn);
+  }
+}
+
+/**
+ * 连接上积压的数据不多时在offload线程上读取流式响应体的下一段，读到后由SendStreamChunk发出并再次调用这里
+ * 非阻塞的流在looper线程上读到没有数据为止，之后由流的回调再调用这里
+ * 积压(HTTP/2还包括流量控制窗口挡住的部分)超过STREAM_HIGH_WATERMARK时停下，生产者随之阻塞，
+ * 等可写事件或者WINDOW_UPDATE到达后再继续
+ */
+void PumpBodyStream(const HttpServerContext &context,
+                    Connection *client_conn) {
+  auto &state = GetConnectionState(client_conn);
+  if (state.stream == nullptr || state.stream_reading) {
+    return;
+  }
+  auto backlog = client_conn->GetWriteBufferSize();
+  if (state.http2 != nullptr) {
+    backlog += state.http2->GetPendingSize(state.stream_id);
+  }
+  if (backlog >= STREAM_HIGH_WATERMARK) {
+    return;
+  }
+  // 非阻塞的流(cgi管道)直接在looper线程上读取，暂时没有数据时等流的回调
+  if (state.stream->IsNonBlocking()) {
+    if (!state.stream_started) {
+      state.stream_started = true;
+      auto *looper = client_conn->GetLooper();
+      auto on_readable = [&context, client_conn, looper]() {
+        // 有输出的cgi程序不会因为连接空闲而被踢掉
+        looper->RefreshConnection(client_conn->GetFd());
+        PumpBodyStream(context, client_conn);
+      };
+      if (!state.stream->Start(looper, std::move(on_readable))) {
+        SendStreamChunk(context, client_conn, {}, StreamStatus::ERROR);
+        return;
+      }
+    }
+    std::string chunk;
+    auto status = state.stream->Read(chunk, STREAM_CHUNK_SIZE);
+    if (status != StreamStatus::PENDING) {
+      SendStreamChunk(context, client_conn, std::move(chunk), status);
+    }
+    return;
+  }
+  state.stream_reading = true;
+  auto chunk = std::make_shared<std::string>();
+  auto status = std::make_shared<StreamStatus>(StreamStatus::ERROR);
+  client_conn->GetLooper()->Offload(
+      client_conn->GetFd(),
+      [stream = state.stream, chunk, status]() {
+        *status = stream->Read(*chunk, STREAM_CHUNK_SIZE);
+      },
+      [&context, chunk, status](Connection *conn) {
+        SendStreamChunk(context, conn, std::move(*chunk), *status);
+      });
+}
+
+/**
+ * 把HTTP/2流上已收到的请求体交给等待它的路由处理函数，读走的部分随后归还流量控制窗口
+ * 请求体收齐后提交响应，返回这个流是否不再等待，流已被重置时直接返回true
+ * 流式响应体发完之前不提交新的响应，收齐的流留到下次再回复
+ */
+auto ReadHttp2Body(HttpConnectionState &state, uint32_t stream_id,
+                   PendingRoute &route) -> bool {
+  const auto &on_body = route.response.on_body_;
+  auto status = state.http2->ReadBody(stream_id, [&on_body](std::string_view data) {
+    if (on_body != nullptr) {
+      on_body(data);
+    }
+  });
+  if (status == BodyStatus::ERROR) {
+    return true;
+  }
+  if (status == BodyStatus::INCOMPLETE || state.stream != nullptr) {
+    return false;
+  }
+  SubmitHttp2Reply(state, stream_id, FinishRouteRequest(route));
+  return true;
+}
+
+/**
+ * 处理HTTP/2连接上收到的帧，请求头完整的请求依次交给与HTTP/1.1相同的处理函数
+ * 同一连接上同时只有一个offload任务，需要offload的请求完成后从这里继续处理后面的流，
+ * 但各个流的响应体按DATA帧交错发送，大文件的响应不会阻塞后面的小响应
+ */
+void ServeHttp2(const HttpServerContext &context, Connection *client_conn) {
+  auto &state = GetConnectionState(client_conn);
+  auto &session = *state.http2;
+  client_conn->ConsumeReadBuffer(
+      session.Feed(client_conn->ReadAsStringView()));
+  for (auto iter = state.http2_routes.begin(); iter != state.http2_routes.end();) {
+    iter = ReadHttp2Body(state, iter->first, *iter->second)
+               ? state.http2_routes.erase(iter)
+               : std::next(iter);
+  }
+  uint32_t stream_id;
+  std::unique_ptr<Request> request;
+  // 流式响应体占用着offload，发完之前新的流留在会话中等待
+  while (state.stream == nullptr && session.NextRequest(stream_id, request)) {
+    auto reply = HandleHttpRequest(
+        context, client_conn, *request, false,
+        [&context, stream_id](Connection *conn, HttpReply async_reply) {
+          SubmitHttp2Reply(GetConnectionState(conn), stream_id,
+                           std::move(async_reply));
+          ServeHttp2(context, conn);
+        });
+    if (!reply.has_value()) {
+      // 先发出已有的响应，不让它们等待offload任务
       break;
     }
-    request_op = client_conn->FindAndPopTill("\r\n\r\n");
+    if (reply->route != nullptr) {
+      auto &route = state.http2_routes[stream_id];
+      route = std::move(reply->route);
+      if (ReadHttp2Body(state, stream_id, *route)) {
+        state.http2_routes.erase(stream_id);
+      }
+      continue;
+    }
+    SubmitHttp2Reply(state, stream_id, std::move(*reply));
+  }
+  if (FlushHttp2(client_conn, session)) {
+    PumpBodyStream(context, client_conn);
   }
+}
 
-  if (no_more_parse) {
-    client_conn->GetLooper()->DeleteConnection(from_fd);
+/**
+ * 连接上的读写事件，ET模式下写事件只在发送缓冲区从满变为可写时到达
+ * 先继续发送对端上次没收下的数据，HTTP/1.1在前面的响应发完之前不处理新的请求，请求留在读缓冲区
+ */
+void PrecessHttpRequest(const HttpServerContext &context,
+                        Connection *client_conn) {
+  // ET模式，一次性读完所有数据
+  auto [read, exit] = client_conn->Recv();
+  if (exit) {
+    LOG_INFO("client fd=" + std::to_string(client_conn->GetFd()) +
+             "has exited");
+    DeleteHttpConnection(client_conn);
     // client_conn指针被释放，不应该再访问
     return;
   }
+  auto &state = GetConnectionState(client_conn);
+  if (read > 0) {
+    state.arrival = client_conn->GetLooper()->GetEventTime();
+  }
+  if (client_conn->GetWriteBufferSize() > 0 &&
+      !FlushConnection(client_conn)) {
+    return;
+  }
+  if (state.close_after_write) {
+    client_conn->ClearReadBuffer();
+    if (client_conn->GetWriteBufferSize() == 0) {
+      DeleteHttpConnection(client_conn);
+    }
+    return;
+  }
+  if (state.http2 == nullptr && (state.stream != nullptr ||
+                                 client_conn->GetWriteBufferSize() > 0)) {
+    PumpBodyStream(context, client_conn);
+    return;
+  }
+  ServeHttpRequests(context, client_conn);
+}
+
+/**
+ * 依次处理缓冲区中的http请求，所有响应累积后在最后用一次send发出
+ * 遇到需要offload的请求时先发出已累积的响应，完成后在本looper上继续处理剩余请求
+ * 连接以HTTP/2客户端前言开始(prior knowledge)或者请求升级到h2c时转交ServeHttp2
+ */
+void ServeHttpRequests(const HttpServerContext &context,
+                       Connection *client_conn) {
+  auto &state = GetConnectionState(client_conn);
+  if (state.http2 == nullptr && state.at_start) {
+    auto data = client_conn->ReadAsStringView();
+    if (!data.empty() && IsHttp2Preface(data)) {
+      if (data.size() < HTTP2_CLIENT_PREFACE.size()) {
+        // 等待完整的前言
+        return;
+      }
+      state.http2 = std::make_unique<Http2Session>();
+      state.http2->Start();
+    }
+  }
+  if (state.http2 != nullptr) {
+    ServeHttp2(context, client_conn);
+    return;
+  }
+  // 检察是否有http请求，直接在读缓冲区上解析
+  std::unique_ptr<Request> request_ptr;
+  while (true) {
+    // 先读完上一个请求的请求体，之后的数据才是下一个请求
+    if (!state.body.IsComplete()) {
+      auto body_status = ReadRequestBody(client_conn);
+      if (body_status == BodyStatus::ERROR) {
+        state.route = nullptr;
+        QueueHttpReply(context, client_conn,
+                       CannedReply(CannedResponse::BAD_REQUEST), true);
+        // 连接正在关闭，不应该再访问client_conn
+        return;
+      }
+      if (body_status == BodyStatus::INCOMPLETE) {
+        break;
+      }
+    }
+    if (state.route != nullptr) {
+      auto route = std::move(state.route);
+      if (!QueueHttpReply(context, client_conn, FinishRouteRequest(*route),
+                          route->should_close)) {
+        return;
+      }
+    }
+    if (NextHttpRequest(client_conn, request_ptr) == ParseStatus::INCOMPLETE) {
+      break;
+    }
+    // 带请求体的升级请求按HTTP/1.1处理，它的请求体还在读缓冲区里
+    if (auto settings = H2cUpgradeSettings(*request_ptr);
+        settings.has_value() && request_ptr->IsValid() &&
+        state.body.IsComplete()) {
+      auto session = std::make_unique<Http2Session>();
+      // 升级的请求成为流1，它的响应以HTTP/2发送
+      if (session->StartUpgraded(*settings, request_ptr)) {
+        client_conn->WriteToWriteBuffer(SWITCHING_PROTOCOLS_H2C_RESPONSE);
+        state.http2 = std::move(session);
+        ServeHttp2(context, client_conn);
+        return;
+      }
+    }
+    bool should_close = request_ptr->ShouldClose();
+    auto reply = HandleHttpRequest(
+        context, client_conn, *request_ptr, true,
+        [&context, should_close](Connection *conn, HttpReply async_reply) {
+          if (QueueHttpReply(context, conn, std::move(async_reply),
+                             should_close)) {
+            ServeHttpRequests(context, conn);
+          }
+        });
+    if (!reply.has_value()) {
+      // 先发出已累积的响应，不让它们等待offload任务
+      FlushConnection(client_conn);
+      return;
+    }
+    if (reply->route != nullptr) {
+      // 响应等请求体收齐后再发送
+      state.route = std::move(reply->route);
+      continue;
+    }
+    if (!QueueHttpReply(context, client_conn, std::move(*reply),
+                        should_close)) {
+      // 连接正在关闭或者正在发送流式响应体，不应该再访问client_conn
+      return;
+    }
+  }
+  // 一次send发出本次读事件中所有请求的响应
+  FlushConnection(client_conn);
 }
 } // namespace Next::Http
 
@@ -131,11 +1204,79 @@ int main(int argc, char *argv[]) {
       }
     }
   }
-  Next::NextServer server(address);
-  auto cache = std::make_shared<Next::Cache>();
+  // 小的keep-alive响应不等待Nagle合并，只有请求数据到达才唤醒acceptor
+  Next::SocketOptions socket_options;
+  socket_options.tcp_nodelay = true;
+  socket_options.defer_accept = 1;
+  Next::NextServer server(
+      address, static_cast<int>(std::thread::hardware_concurrency()) - 1,
+      Next::DEFAULT_OFFLOAD_CONCURRENCY, socket_options);
+  auto file_meta = std::make_shared<Next::Http::FileMetaCache>(dir);
+  Next::Http::HttpServerContext context{
+      file_meta->GetServingDir(), std::make_shared<Next::Cache>(),
+      std::make_shared<Next::ConcurrencyLimiter>(),
+      std::make_shared<Next::Cache>(), file_meta,
+      std::make_shared<Next::FdCache>(), std::make_shared<Next::Http::Router>()};
+  // 与cgi-bin/add相同的计算，在进程内完成，不必fork
+  context.router->Add(
+      Next::Http::Method::GET, "/api/add/:a/:b",
+      [](const Next::Http::Request & /*request*/,
+         const Next::Http::RouteParams &params,
+         Next::Http::RouteResponse &response) {
+        auto a = std::strtol(std::string(*params.Get("a")).c_str(), nullptr, 10);
+        auto b = std::strtol(std::string(*params.Get("b")).c_str(), nullptr, 10);
+        response.body_ = "add(" + std::to_string(a) + ", " + std::to_string(b) +
+                         ") = " + std::to_string(a + b) + "\n";
+      });
+  // 逐行输出1到n，长度事先未知，以chunked编码边生成边发送
+  context.router->Add(
+      Next::Http::Method::GET, "/api/count/:n",
+      [](const Next::Http::Request & /*request*/,
+         const Next::Http::RouteParams &params,
+         Next::Http::RouteResponse &response) {
+        auto n = std::strtol(std::string(*params.Get("n")).c_str(), nullptr, 10);
+        response.stream_ = std::make_shared<Next::Http::GeneratorStream>(
+            [n, next = 1L](std::string &out, size_t max_size) mutable {
+              while (next <= n && out.size() + 24 <= max_size) {
+                out.append(std::to_string(next++)).push_back('\n');
+              }
+              return next > n ? Next::Http::StreamStatus::END
+                              : Next::Http::StreamStatus::DATA;
+            });
+      });
+  // 统计上传内容的字节数和行数，请求体边到达边统计，任意大小的上传都只占用常数内存
+  context.router->Add(
+      Next::Http::Method::POST, "/api/wc",
+      [](const Next::Http::Request & /*request*/,
+         const Next::Http::RouteParams & /*params*/,
+         Next::Http::RouteResponse &response) {
+        auto counts = std::make_shared<std::pair<size_t, size_t>>(0, 0);
+        response.on_body_ = [counts](std::string_view data) {
+          counts->first += data.size();
+          counts->second += static_cast<size_t>(
+              std::count(data.begin(), data.end(), '\n'));
+        };
+        response.on_body_end_ = [counts](Next::Http::RouteResponse &done) {
+          done.body_ = std::to_string(counts->second) + " " +
+                       std::to_string(counts->first) + "\n";
+        };
+      });
+  // cgi-bin/add支持worker协议，由常驻进程处理，不必每个请求fork和exec
+  auto add_program =
+      context.serving_dir + Next::Http::CGI_BIN_PREFIX + std::string("add");
+  if (Next::Http::IsFileExists(add_program)) {
+    context.cgi_pools[add_program] =
+        std::make_shared<Next::Http::CgiWorkerPool>(add_program);
+  }
+  // cgi-bin/add的输出只取决于参数，缓存一分钟，重复的调用不再运行程序
+  context.cgi_cache = std::make_shared<Next::Http::CgiResultCache>();
+  context.cgi_cache->SetTtl(add_program, 60 * 1000);
+  file_meta->OnInvalidate([&context](const std::string &resource_full_path) {
+    Next::Http::InvalidateCachedFile(context, resource_full_path);
+  });
   server
       .OnHandle([&](Next::Connection *client_conn) {
-        Next::Http::PrecessHttpRequest(dir, cache, client_conn);
+        Next::Http::PrecessHttpRequest(context, client_conn);
       })
       .Begin();
   return 0;
@@ -1,64 +1,193 @@
 #include "http/http_utils.h"
+#include <unistd.h>
 #include <algorithm>
+#include <cerrno>
+#include <charconv>
 #include <cassert>
+#include <ctime>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 namespace Next::Http {
 
-Method ToMethod(const std::string &str) {
-  std::string formattedStr = Format(str);
-  for (const auto &pair : METHOD_TO_STRING) {
-    if (pair.second == formattedStr) {
-      return pair.first;
-    }
-  }
-  return Method::UNSUPPORTED;
+/* 支持的方法 */
+static constexpr PerfectHashEntry<Method> METHOD_ENTRIES[] = {
+    {"GET", Method::GET},
+    {"HEAD", Method::HEAD},
+    {"POST", Method::POST},
+    {"PUT", Method::PUT},
+};
+static constexpr PerfectHashMap<Method, std::size(METHOD_ENTRIES), 16> METHOD_TABLE{METHOD_ENTRIES};
+
+/* 支持的http版本 */
+static constexpr PerfectHashEntry<Version> VERSION_ENTRIES[] = {
+    {"HTTP/1.1", Version::HTTP_1_1},
+};
+static constexpr PerfectHashMap<Version, std::size(VERSION_ENTRIES), 4> VERSION_TABLE{VERSION_ENTRIES};
+
+static constexpr PerfectHashEntry<Extension> EXTENSION_ENTRIES[] = {
+    {"HTML", Extension::HTML}, {"CSS", Extension::CSS},   {"PNG", Extension::PNG},     {"JPG", Extension::JPG},
+    {"JPEG", Extension::JPEG}, {"GIF", Extension::GIF},   {"OCTET", Extension::OCTET},
+};
+static constexpr PerfectHashMap<Extension, std::size(EXTENSION_ENTRIES), 32> EXTENSION_TABLE{EXTENSION_ENTRIES};
+
+/* 扩展名到MIME类型的注册表 */
+static constexpr PerfectHashEntry<std::string_view> MIME_ENTRIES[] = {
+    // 文本
+    {"html", "text/html"},
+    {"htm", "text/html"},
+    {"shtml", "text/html"},
+    {"css", "text/css"},
+    {"js", "text/javascript"},
+    {"mjs", "text/javascript"},
+    {"txt", "text/plain"},
+    {"text", "text/plain"},
+    {"log", "text/plain"},
+    {"csv", "text/csv"},
+    {"md", "text/markdown"},
+    {"xml", "text/xml"},
+    {"ics", "text/calendar"},
+    {"vtt", "text/vtt"},
+    {"yaml", "text/yaml"},
+    {"yml", "text/yaml"},
+    // 图片
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"jpe", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"bmp", "image/bmp"},
+    {"ico", "image/x-icon"},
+    {"svg", "image/svg+xml"},
+    {"svgz", "image/svg+xml"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"apng", "image/apng"},
+    {"tif", "image/tiff"},
+    {"tiff", "image/tiff"},
+    // 字体
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"eot", "application/vnd.ms-fontobject"},
+    // 音频
+    {"mp3", "audio/mpeg"},
+    {"wav", "audio/wav"},
+    {"ogg", "audio/ogg"},
+    {"oga", "audio/ogg"},
+    {"opus", "audio/opus"},
+    {"m4a", "audio/mp4"},
+    {"aac", "audio/aac"},
+    {"flac", "audio/flac"},
+    {"mid", "audio/midi"},
+    {"midi", "audio/midi"},
+    // 视频
+    {"mp4", "video/mp4"},
+    {"m4v", "video/mp4"},
+    {"webm", "video/webm"},
+    {"ogv", "video/ogg"},
+    {"mov", "video/quicktime"},
+    {"avi", "video/x-msvideo"},
+    {"mkv", "video/x-matroska"},
+    {"mpeg", "video/mpeg"},
+    {"mpg", "video/mpeg"},
+    {"ts", "video/mp2t"},
+    {"3gp", "video/3gpp"},
+    // 应用
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"jsonld", "application/ld+json"},
+    {"webmanifest", "application/manifest+json"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"rtf", "application/rtf"},
+    {"atom", "application/atom+xml"},
+    {"rss", "application/rss+xml"},
+    {"xhtml", "application/xhtml+xml"},
+    {"epub", "application/epub+zip"},
+    {"doc", "application/msword"},
+    {"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
+    {"xls", "application/vnd.ms-excel"},
+    {"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
+    {"ppt", "application/vnd.ms-powerpoint"},
+    {"pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
+    {"odt", "application/vnd.oasis.opendocument.text"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"tgz", "application/gzip"},
+    {"bz2", "application/x-bzip2"},
+    {"xz", "application/x-xz"},
+    {"zst", "application/zstd"},
+    {"7z", "application/x-7z-compressed"},
+    {"tar", "application/x-tar"},
+    {"rar", "application/vnd.rar"},
+    {"jar", "application/java-archive"},
+    {"apk", "application/vnd.android.package-archive"},
+    {"sh", "application/x-sh"},
+    {"swf", "application/x-shockwave-flash"},
+    {"bin", "application/octet-stream"},
+    {"exe", "application/octet-stream"},
+    {"dll", "application/octet-stream"},
+    {"iso", "application/octet-stream"},
+    {"dmg", "application/octet-stream"},
+    {"img", "application/octet-stream"},
+    {"octet", "application/octet-stream"},
+};
+static constexpr PerfectHashMap<std::string_view, std::size(MIME_ENTRIES), 2048> MIME_TABLE{MIME_ENTRIES};
+
+/* 每个线程缓存的文件MIME类型条目上限，超过后整体清空 */
+static constexpr size_t MIME_CACHE_CAPACITY = 4096;
+
+Method ToMethod(std::string_view str) noexcept {
+  const auto *method = METHOD_TABLE.Find(TrimView(str));
+  return (method == nullptr) ? Method::UNSUPPORTED : *method;
 }
 
-Version ToVersion(const std::string &str) {
-  std::string formattedStr = Format(str);
-  if (formattedStr == VERSION_TO_STRING.at(Version::HTTP_1_1)) {
-    return Version::HTTP_1_1;
-  }
-  return Version::UNSUPPORTED;
+Version ToVersion(std::string_view str) noexcept {
+  const auto *version = VERSION_TABLE.Find(TrimView(str));
+  return (version == nullptr) ? Version::UNSUPPORTED : *version;
 }
 
-Extension ToExtension(const std::string &str) {
-  std::string formattedStr = Format(str);
-  for (const auto &pair : EXTENSION_TO_STRING) {
-    if (pair.second == formattedStr) {
-      return pair.first;
-    }
-  }
-  return Extension::UNSUPPORTED;
+Extension ToExtension(std::string_view str) noexcept {
+  const auto *extension = EXTENSION_TABLE.Find(TrimView(str));
+  return (extension == nullptr) ? Extension::UNSUPPORTED : *extension;
 }
 
 auto ExtensionToMime(const Extension &extension) noexcept -> std::string {
-  if (extension == Extension::HTML) {
-    return MIME_HTML;
-  }
-  if (extension == Extension::CSS) {
-    return MIME_CSS;
-  }
-  if (extension == Extension::PNG) {
-    return MIME_PNG;
+  if (extension == Extension::UNSUPPORTED) {
+    return MIME_OCTET;
   }
-  if (extension == Extension::JPG) {
-    return MIME_JPG;
+  return std::string(ExtensionToMime(EXTENSION_TO_STRING.at(extension)));
+}
+
+auto ExtensionToMime(std::string_view extension) noexcept -> std::string_view {
+  const auto *mime = MIME_TABLE.Find(extension);
+  return (mime == nullptr) ? std::string_view(MIME_OCTET) : *mime;
+}
+
+auto FileToMime(const std::string &file_path) -> std::string_view {
+  // 每个reactor线程各自缓存，不需要加锁，值指向静态的注册表
+  thread_local std::unordered_map<std::string, std::string_view> mime_cache;
+  if (auto it = mime_cache.find(file_path); it != mime_cache.end()) {
+    return it->second;
   }
-  if (extension == Extension::JPEG) {
-    return MIME_JPEG;
+  std::string_view path = file_path;
+  std::string_view extension;
+  auto last_dot = path.find_last_of(DOT);
+  auto last_slash = path.find_last_of('/');
+  if (last_dot != std::string_view::npos && (last_slash == std::string_view::npos || last_dot > last_slash)) {
+    extension = path.substr(last_dot + 1);
   }
-  if (extension == Extension::GIF) {
-    return MIME_GIF;
+  auto mime = ExtensionToMime(extension);
+  if (mime_cache.size() >= MIME_CACHE_CAPACITY) {
+    mime_cache.clear();
   }
-  if (extension == Extension::OCTET) {
-    return MIME_OCTET;
-  }
-  return MIME_OCTET;
+  mime_cache.emplace(file_path, mime);
+  return mime;
 }
 
 auto Spilt(const std::string &str, const char *delim /* = SPACE*/) noexcept
@@ -115,6 +244,192 @@ auto Format(const std::string &str) noexcept -> std::string {
   return ToUpper(Trim(str));
 }
 
+auto TrimView(std::string_view str) noexcept -> std::string_view {
+  size_t begin = str.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  size_t end = str.find_last_not_of(" \t");
+  return str.substr(begin, end - begin + 1);
+}
+
+static constexpr char DAY_NAMES[][4] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static constexpr char MONTH_NAMES[][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                          "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+auto FormatHttpDate(time_t time, char *out) noexcept -> size_t {
+  struct tm tm_time {};
+  gmtime_r(&time, &tm_time);
+  // 不使用strftime，避免受locale影响
+  auto put_two_digits = [](char *dest, int value) {
+    dest[0] = static_cast<char>('0' + value / 10);
+    dest[1] = static_cast<char>('0' + value % 10);
+  };
+  memcpy(out, DAY_NAMES[tm_time.tm_wday], 3);
+  out[3] = ',';
+  out[4] = ' ';
+  put_two_digits(out + 5, tm_time.tm_mday);
+  out[7] = ' ';
+  memcpy(out + 8, MONTH_NAMES[tm_time.tm_mon], 3);
+  out[11] = ' ';
+  int year = tm_time.tm_year + 1900;
+  put_two_digits(out + 12, year / 100 % 100);
+  put_two_digits(out + 14, year % 100);
+  out[16] = ' ';
+  put_two_digits(out + 17, tm_time.tm_hour);
+  out[19] = ':';
+  put_two_digits(out + 20, tm_time.tm_min);
+  out[22] = ':';
+  put_two_digits(out + 23, tm_time.tm_sec);
+  memcpy(out + 25, " GMT", 4);
+  return HTTP_DATE_SIZE;
+}
+
+auto CachedHttpDate() noexcept -> std::string_view {
+  thread_local time_t cached_second = -1;
+  thread_local char cached_date[HTTP_DATE_SIZE];
+  time_t now = time(nullptr);
+  if (now != cached_second) {
+    FormatHttpDate(now, cached_date);
+    cached_second = now;
+  }
+  return {cached_date, HTTP_DATE_SIZE};
+}
+
+auto ParseHttpDate(std::string_view date, time_t &time) noexcept -> bool {
+  date = TrimView(date);
+  if (date.size() != HTTP_DATE_SIZE || date.substr(3, 2) != ", " || date.substr(25) != " GMT" || date[7] != ' ' ||
+      date[11] != ' ' || date[16] != ' ' || date[19] != ':' || date[22] != ':') {
+    return false;
+  }
+  auto get_number = [&](size_t pos, size_t length, int &value) {
+    auto [end, error] = std::from_chars(date.data() + pos, date.data() + pos + length, value);
+    return error == std::errc() && end == date.data() + pos + length;
+  };
+  struct tm tm_time {};
+  tm_time.tm_mon = -1;
+  for (int i = 0; i < 12; i++) {
+    if (date.substr(8, 3) == MONTH_NAMES[i]) {
+      tm_time.tm_mon = i;
+    }
+  }
+  int year = 0;
+  if (tm_time.tm_mon < 0 || !get_number(5, 2, tm_time.tm_mday) || !get_number(12, 4, year) ||
+      !get_number(17, 2, tm_time.tm_hour) || !get_number(20, 2, tm_time.tm_min) ||
+      !get_number(23, 2, tm_time.tm_sec)) {
+    return false;
+  }
+  tm_time.tm_year = year - 1900;
+  time = timegm(&tm_time);
+  return time != -1;
+}
+
+auto FormatETag(uint64_t inode, uint64_t size, uint64_t mtime_ns, char *out) noexcept -> size_t {
+  char *end = out;
+  *end++ = '"';
+  end = std::to_chars(end, out + MAX_ETAG_SIZE, inode, 16).ptr;
+  *end++ = '-';
+  end = std::to_chars(end, out + MAX_ETAG_SIZE, size, 16).ptr;
+  *end++ = '-';
+  end = std::to_chars(end, out + MAX_ETAG_SIZE, mtime_ns, 16).ptr;
+  *end++ = '"';
+  return static_cast<size_t>(end - out);
+}
+
+/* 去掉弱ETag的 "W/" 前缀 */
+static auto OpaqueTag(std::string_view etag) noexcept -> std::string_view {
+  if (etag.size() >= 2 && etag[0] == 'W' && etag[1] == '/') {
+    etag.remove_prefix(2);
+  }
+  return etag;
+}
+
+auto MatchesAnyETag(std::string_view if_none_match, std::string_view etag) noexcept -> bool {
+  if (TrimView(if_none_match) == "*") {
+    return true;
+  }
+  // If-None-Match使用弱比较
+  etag = OpaqueTag(etag);
+  while (!if_none_match.empty()) {
+    auto comma = if_none_match.find(',');
+    auto candidate = TrimView(if_none_match.substr(0, comma));
+    if_none_match = comma == std::string_view::npos ? std::string_view() : if_none_match.substr(comma + 1);
+    if (!candidate.empty() && OpaqueTag(candidate) == etag) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* 解析一个非负的十进制数，不允许正负号和空白 */
+static auto ParseRangeNumber(std::string_view digits, size_t &number) noexcept -> bool {
+  if (digits.empty()) {
+    return false;
+  }
+  auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), number);
+  return error == std::errc() && end == digits.data() + digits.size();
+}
+
+auto ParseRange(std::string_view value, size_t file_size,
+                std::vector<ByteRange> &ranges) noexcept -> RangeStatus {
+  static constexpr std::string_view BYTES_UNIT = "bytes=";
+  ranges.clear();
+  value = TrimView(value);
+  if (value.size() <= BYTES_UNIT.size() || !EqualsIgnoreCase(value.substr(0, BYTES_UNIT.size()), BYTES_UNIT)) {
+    return RangeStatus::NONE;
+  }
+  value.remove_prefix(BYTES_UNIT.size());
+  size_t count = 0;
+  while (!value.empty()) {
+    auto comma = value.find(',');
+    auto spec = TrimView(value.substr(0, comma));
+    value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+    if (spec.empty()) {
+      // 列表中允许空元素，例如 "bytes=0-1, ,5-6"
+      continue;
+    }
+    if (++count > MAX_RANGE_COUNT) {
+      ranges.clear();
+      return RangeStatus::NONE;
+    }
+    auto dash = spec.find('-');
+    if (dash == std::string_view::npos) {
+      ranges.clear();
+      return RangeStatus::NONE;
+    }
+    size_t first = 0;
+    size_t last = 0;
+    if (dash == 0) {
+      // 后缀区间 "-N"，最后N个字节
+      if (!ParseRangeNumber(spec.substr(1), last)) {
+        ranges.clear();
+        return RangeStatus::NONE;
+      }
+      if (last > 0 && file_size > 0) {
+        ranges.push_back({file_size - std::min(last, file_size), file_size - 1});
+      }
+      continue;
+    }
+    if (!ParseRangeNumber(spec.substr(0, dash), first)) {
+      ranges.clear();
+      return RangeStatus::NONE;
+    }
+    if (dash + 1 == spec.size()) {
+      last = file_size == 0 ? 0 : file_size - 1;
+    } else if (!ParseRangeNumber(spec.substr(dash + 1), last) || last < first) {
+      ranges.clear();
+      return RangeStatus::NONE;
+    }
+    if (first < file_size) {
+      ranges.push_back({first, std::min(last, file_size - 1)});
+    }
+  }
+  if (count == 0) {
+    return RangeStatus::NONE;
+  }
+  return ranges.empty() ? RangeStatus::UNSATISFIABLE : RangeStatus::SATISFIABLE;
+}
+
 auto IsDirectoryExists(const std::string &directory_path) noexcept -> bool {
   return std::filesystem::is_directory(directory_path);
 }
@@ -138,12 +453,35 @@ auto CheckFileSize(const std::string &file_path) noexcept -> size_t {
 
 void LoadFile(const std::string &file_path,
               std::vector<unsigned char> &buffer) noexcept {
-  size_t file_size = CheckFileSize(file_path);
+  LoadFile(file_path, buffer, CheckFileSize(file_path));
+}
+
+void LoadFile(const std::string &file_path, std::vector<unsigned char> &buffer,
+              size_t file_size) noexcept {
   size_t buffer_old_size = buffer.size();
   buffer.resize(buffer_old_size + file_size);
-  std::ifstream file(file_path);
-  assert(file.is_open());
-  file.read(reinterpret_cast<char *>(&buffer[buffer_old_size]),
+  std::ifstream file(file_path, std::ios::binary);
+  file.read(reinterpret_cast<char *>(buffer.data() + buffer_old_size),
             static_cast<std::streamsize>(file_size));
+  buffer.resize(buffer_old_size + static_cast<size_t>(file.gcount()));
+}
+
+void LoadFile(int fd, std::vector<unsigned char> &buffer,
+              size_t file_size) noexcept {
+  size_t buffer_old_size = buffer.size();
+  buffer.resize(buffer_old_size + file_size);
+  size_t offset = 0;
+  while (offset < file_size) {
+    ssize_t read = pread(fd, buffer.data() + buffer_old_size + offset,
+                         file_size - offset, static_cast<off_t>(offset));
+    if (read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (read <= 0) {
+      break;
+    }
+    offset += static_cast<size_t>(read);
+  }
+  buffer.resize(buffer_old_size + offset);
 }
 } // namespace Next::Http
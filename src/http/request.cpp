@@ -1,13 +1,19 @@
 #include "http/request.h"
 #include "http/http_utils.h"
+#include "http/request_parser.h"
 #include <algorithm>
+#include <charconv>
 
 namespace Next::Http {
   
 Request::Request(Method method, std::string resource_url, Version version,
                  const std::vector<Header> &heads) noexcept
     : method_(method), resource_url_(std::move(resource_url)),
-      version_(version), headers_(heads), is_valid_(true) {}
+      version_(version), is_valid_(true) {
+  for (const auto &header : heads) {
+    headers_.Add(header.GetKey(), header.GetValue());
+  }
+}
 
 Request::Request(const std::string &request_str) noexcept {
   auto lines = Spilt(request_str, CRLF);
@@ -28,17 +34,57 @@ Request::Request(const std::string &request_str) noexcept {
   lines.erase(lines.begin());
   // 请求行
   for (const auto &line : lines) {
-    Header header{line};
-    if (!header.IsValid()) {
+    auto colon = line.find(COLON);
+    if (colon == std::string::npos) {
       invalid_reason_ = "Fail to parse header line: " + line;
       return;
     }
-    ScanHeader(header);
-    headers_.push_back(std::move(header));
+    std::string_view line_view = line;
+    if (!AddHeader(line_view.substr(0, colon), line_view.substr(colon + 1))) {
+      return;
+    }
   }
   is_valid_ = true;
 }
 
+Request::Request(const RequestParser &parser) noexcept {
+  if (parser.GetError() != nullptr) {
+    invalid_reason_ = parser.GetError();
+    return;
+  }
+  if (!SetRequestLine(parser.GetMethod(), parser.GetUrl(), parser.GetVersion())) {
+    return;
+  }
+  for (size_t i = 0; i < parser.GetHeaderCount(); i++) {
+    auto [key, value] = parser.GetHeader(i);
+    if (!AddHeader(key, value)) {
+      return;
+    }
+  }
+  is_valid_ = true;
+}
+
+Request::Request(std::string_view method, std::string_view path,
+                 const std::vector<std::pair<std::string, std::string>> &headers) noexcept
+    : version_(Version::HTTP_2) {
+  method_ = ToMethod(method);
+  if (method_ == Method::UNSUPPORTED) {
+    invalid_reason_ = "Unsupported method: " + std::string(method);
+    return;
+  }
+  resource_url_ = path;
+  if (path.empty() || path.back() == '/') {
+    resource_url_ += DEFAULT_ROUTE;
+  }
+  for (const auto &[key, value] : headers) {
+    if (!AddHeader(key, value)) {
+      return;
+    }
+  }
+  should_close_ = false;
+  is_valid_ = true;
+}
+
 auto Request::IsValid() const noexcept -> bool { return is_valid_; }
 
 auto Request::ShouldClose() const noexcept -> bool { return should_close_; }
@@ -50,12 +96,63 @@ auto Request::GetMethod() const noexcept -> Method { return method_; }
 
 auto Request::GetVersion() const noexcept -> Version { return version_; }
 
-auto Request::GetResourceUrl() const noexcept -> std::string {
+auto Request::GetResourceUrl() const noexcept -> const std::string & {
   return resource_url_;
 }
 
 auto Request::GetHeaders() const noexcept -> std::vector<Header> {
-  return headers_;
+  return headers_.ToHeaders();
+}
+
+auto Request::GetHeader(HeaderId id) const noexcept -> std::optional<std::string_view> { return headers_.Get(id); }
+
+auto Request::GetHeaderTable() const noexcept -> const HeaderTable & { return headers_; }
+
+auto Request::HasBody() const noexcept -> bool { return chunked_ || content_length_ > 0; }
+
+auto Request::IsChunked() const noexcept -> bool { return chunked_; }
+
+auto Request::GetContentLength() const noexcept -> size_t { return content_length_; }
+
+auto Request::ExpectContinue() const noexcept -> bool { return expect_continue_; }
+
+auto Request::GetRanges(size_t file_size, std::string_view etag, time_t last_modified,
+                        std::vector<ByteRange> &ranges) const noexcept -> RangeStatus {
+  auto range = headers_.Get(HeaderId::RANGE);
+  // 只有GET请求的Range有意义
+  if (!range.has_value() || method_ != Method::GET) {
+    return RangeStatus::NONE;
+  }
+  if (auto if_range = headers_.Get(HeaderId::IF_RANGE); if_range.has_value()) {
+    auto validator = TrimView(*if_range);
+    time_t date = 0;
+    bool matched = !validator.empty() && validator.front() == '"' ? validator == etag
+                                            : ParseHttpDate(validator, date) && date == last_modified;
+    if (!matched) {
+      return RangeStatus::NONE;
+    }
+  }
+  return ParseRange(*range, file_size, ranges);
+}
+
+auto Request::IsNotModified(std::string_view etag, time_t last_modified) const noexcept -> bool {
+  if (method_ != Method::GET && method_ != Method::HEAD) {
+    return false;
+  }
+  if (auto if_none_match = headers_.Get(HeaderId::IF_NONE_MATCH); if_none_match.has_value()) {
+    return MatchesAnyETag(*if_none_match, etag);
+  }
+  time_t since = 0;
+  auto if_modified_since = headers_.Get(HeaderId::IF_MODIFIED_SINCE);
+  return if_modified_since.has_value() && ParseHttpDate(*if_modified_since, since) && last_modified <= since;
+}
+
+auto Request::MakeBodyDecoder() const noexcept -> BodyDecoder {
+  // 同时出现时Transfer-Encoding优先于Content-Length
+  if (chunked_) {
+    return BodyDecoder::MakeChunkedDecoder();
+  }
+  return BodyDecoder::MakeContentLengthDecoder(content_length_);
 }
 
 auto Request::ParseRequestLine(const std::string &request_line) -> bool {
@@ -64,33 +161,60 @@ auto Request::ParseRequestLine(const std::string &request_line) -> bool {
     invalid_reason_ = "Invalid first request headline: " + request_line;
     return false;
   }
-  method_ = ToMethod(tokens[0]);
+  return SetRequestLine(tokens[0], tokens[1], tokens[2]);
+}
+
+auto Request::SetRequestLine(std::string_view method, std::string_view url, std::string_view version) -> bool {
+  method_ = ToMethod(method);
   if (method_ == Method::UNSUPPORTED) {
-    invalid_reason_ = "Unsupported method: " + tokens[0];
+    invalid_reason_ = "Unsupported method: " + std::string(method);
     return false;
   }
-  version_ = ToVersion(tokens[2]);
+  version_ = ToVersion(version);
   if (version_ == Version::UNSUPPORTED) {
-    invalid_reason_ = "Unsupported version: " + tokens[2];
+    invalid_reason_ = "Unsupported version: " + std::string(version);
     return false;
   }
   // 默认url为index.html
-  resource_url_ =
-      (tokens[1].empty() || tokens[1].at(tokens[1].size() - 1) == '/')
-          ? tokens[1] + DEFAULT_ROUTE
-          : tokens[1];
+  resource_url_ = url;
+  if (url.empty() || url.back() == '/') {
+    resource_url_ += DEFAULT_ROUTE;
+  }
   return true;
 }
 
-void Request::ScanHeader(const Header &header) {
-  // 目前仅扫描服务后是否应关闭连接
-  auto key = Format(header.GetKey());
-  if (key == Format(HEADER_CONNECTION)) {
-    auto value = Format(header.GetValue());
-    if (value == Format(CONNECTION_KEEP_ALIVE)) {
-      should_close_ = false;
+auto Request::AddHeader(std::string_view key, std::string_view value) -> bool {
+  auto id = ToHeaderId(key);
+  value = TrimView(value);
+  // 扫描连接是否保持以及请求体的长度和编码
+  if (id == HeaderId::CONNECTION && EqualsIgnoreCase(value, CONNECTION_KEEP_ALIVE)) {
+    should_close_ = false;
+  } else if (id == HeaderId::CONTENT_LENGTH) {
+    size_t length = 0;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+    if (ec != std::errc() || end != value.data() + value.size() || value.empty() ||
+        (headers_.Has(id) && length != content_length_)) {
+      invalid_reason_ = "Invalid Content-Length: " + std::string(value);
+      return false;
+    }
+    content_length_ = length;
+  } else if (id == HeaderId::TRANSFER_ENCODING) {
+    // 只支持chunked编码，且必须是最后一个
+    auto last_coding = value.substr(value.find_last_of(',') + 1);
+    if (!EqualsIgnoreCase(TrimView(last_coding), TRANSFER_ENCODING_CHUNKED)) {
+      invalid_reason_ = "Unsupported Transfer-Encoding: " + std::string(value);
+      return false;
     }
+    chunked_ = true;
+  } else if (id == HeaderId::EXPECT) {
+    expect_continue_ = EqualsIgnoreCase(value, EXPECT_CONTINUE);
   }
+  if (id != HeaderId::UNKNOWN) {
+    headers_.Add(id, value);
+  } else {
+    headers_.Add(key, value);
+  }
+  return true;
 }
 
 auto operator<<(std::ostream &os, const Request &request) -> std::ostream & {
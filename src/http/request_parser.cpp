@@ -0,0 +1,156 @@
+#include "http/request_parser.h"
+
+namespace Next::Http {
+
+static constexpr auto IsBlank(char c) noexcept -> bool { return c == ' ' || c == '\t'; }
+
+auto RequestParser::Parse(std::string_view data) noexcept -> ParseStatus {
+  data_ = data;
+  if (state_ == State::DONE) {
+    return ParseStatus::COMPLETE;
+  }
+  if (error_ != nullptr) {
+    return ParseStatus::ERROR;
+  }
+  const size_t limit = data.size();
+  while (pos_ < limit) {
+    char c = data[pos_];
+    switch (state_) {
+      case State::METHOD:
+        if (c == ' ') {
+          if (pos_ == token_begin_) {
+            return Fail("Empty request method");
+          }
+          method_ = {static_cast<uint32_t>(token_begin_), static_cast<uint32_t>(pos_)};
+          token_begin_ = pos_ + 1;
+          state_ = State::URL;
+        } else if (c == '\r' || c == '\n') {
+          return Fail("Invalid first request headline");
+        }
+        break;
+      case State::URL:
+        if (c == ' ') {
+          url_ = {static_cast<uint32_t>(token_begin_), static_cast<uint32_t>(pos_)};
+          token_begin_ = pos_ + 1;
+          state_ = State::VERSION;
+        } else if (c == '\r' || c == '\n') {
+          return Fail("Invalid first request headline");
+        }
+        break;
+      case State::VERSION:
+        if (c == '\r') {
+          version_ = {static_cast<uint32_t>(token_begin_), static_cast<uint32_t>(pos_)};
+          state_ = State::REQUEST_LINE_LF;
+        } else if (c == ' ' || c == '\n') {
+          return Fail("Invalid first request headline");
+        }
+        break;
+      case State::REQUEST_LINE_LF:
+        if (c != '\n') {
+          return Fail("Request line is not ended with \r\n");
+        }
+        state_ = State::HEADER_LINE_START;
+        break;
+      case State::HEADER_LINE_START:
+        if (c == '\r') {
+          state_ = State::HEADERS_END_LF;
+        } else if (c == ':' || c == '\n') {
+          return Fail("Fail to parse header line");
+        } else {
+          if (header_count_ == MAX_HEADER_COUNT) {
+            return Fail("Too many header lines");
+          }
+          token_begin_ = pos_;
+          state_ = State::HEADER_KEY;
+        }
+        break;
+      case State::HEADER_KEY:
+        if (c == ':') {
+          headers_[header_count_].key_ = {static_cast<uint32_t>(token_begin_), static_cast<uint32_t>(pos_)};
+          state_ = State::HEADER_VALUE_START;
+        } else if (c == '\r' || c == '\n') {
+          return Fail("Fail to parse header line");
+        }
+        break;
+      case State::HEADER_VALUE_START:
+        if (IsBlank(c)) {
+          break;
+        }
+        token_begin_ = pos_;
+        value_end_ = pos_;
+        state_ = State::HEADER_VALUE;
+        [[fallthrough]];
+      case State::HEADER_VALUE:
+        if (c == '\r') {
+          headers_[header_count_].value_ = {static_cast<uint32_t>(token_begin_), static_cast<uint32_t>(value_end_)};
+          header_count_++;
+          state_ = State::HEADER_LINE_LF;
+        } else if (c == '\n') {
+          return Fail("Header line is not ended with \r\n");
+        } else if (!IsBlank(c)) {
+          value_end_ = pos_ + 1;
+        }
+        break;
+      case State::HEADER_LINE_LF:
+        if (c != '\n') {
+          return Fail("Header line is not ended with \r\n");
+        }
+        state_ = State::HEADER_LINE_START;
+        break;
+      case State::HEADERS_END_LF:
+        if (c != '\n') {
+          return Fail("Ending of the request is not \r\n\r\n");
+        }
+        pos_++;
+        state_ = State::DONE;
+        return ParseStatus::COMPLETE;
+      case State::DONE:
+        return ParseStatus::COMPLETE;
+    }
+    pos_++;
+  }
+  if (pos_ > MAX_REQUEST_HEAD_SIZE) {
+    return Fail("Request head is too large");
+  }
+  return ParseStatus::INCOMPLETE;
+}
+
+void RequestParser::Reset() noexcept {
+  data_ = {};
+  state_ = State::METHOD;
+  pos_ = 0;
+  token_begin_ = 0;
+  value_end_ = 0;
+  method_ = {};
+  url_ = {};
+  version_ = {};
+  header_count_ = 0;
+  error_ = nullptr;
+}
+
+auto RequestParser::Consumed() const noexcept -> size_t { return state_ == State::DONE ? pos_ : 0; }
+
+auto RequestParser::GetError() const noexcept -> const char * { return error_; }
+
+auto RequestParser::GetMethod() const noexcept -> std::string_view { return View(method_); }
+
+auto RequestParser::GetUrl() const noexcept -> std::string_view { return View(url_); }
+
+auto RequestParser::GetVersion() const noexcept -> std::string_view { return View(version_); }
+
+auto RequestParser::GetHeaderCount() const noexcept -> size_t { return header_count_; }
+
+auto RequestParser::GetHeader(size_t index) const noexcept -> HeaderSlice {
+  return {View(headers_[index].key_), View(headers_[index].value_)};
+}
+
+auto RequestParser::Fail(const char *reason) noexcept -> ParseStatus {
+  error_ = reason;
+  return ParseStatus::ERROR;
+}
+
+auto RequestParser::View(Slice slice) const noexcept -> std::string_view {
+  return data_.substr(slice.begin_, slice.end_ - slice.begin_);
+}
+
+}  // namespace Next::Http
@@ -2,36 +2,117 @@
 #include "http/header.h"
 #include "http/http_utils.h"
 #include <algorithm>
-#include <sstream>
+#include <array>
+#include <charconv>
+#include <filesystem>
+#include <random>
 #include <utility>
 
 namespace Next::Http {
+
+/* 预先渲染好的Server和Connection header块 */
+static constexpr std::string_view FIXED_HEADERS_KEEP_ALIVE =
+    "Server:Next/1.0\r\nConnection:Keep-Alive\r\n";
+static constexpr std::string_view FIXED_HEADERS_CLOSE =
+    "Server:Next/1.0\r\nConnection:Close\r\n";
+static constexpr std::string_view DATE_PREFIX = "Date:";
+
+static void AppendTo(std::vector<unsigned char> &buffer,
+                     std::string_view data) {
+  buffer.insert(buffer.end(), data.begin(), data.end());
+}
+
+/* 追加 "Date:<当前时间>\r\n" */
+static void AppendDateHeader(std::vector<unsigned char> &buffer) {
+  AppendTo(buffer, DATE_PREFIX);
+  AppendTo(buffer, CachedHttpDate());
+  AppendTo(buffer, CRLF);
+}
+
+/* "bytes first-last/size" */
+static auto FormatContentRange(const ByteRange &range, size_t file_size)
+    -> std::string {
+  return std::string(ACCEPT_RANGES_BYTES) + SPACE +
+         std::to_string(range.first_) + "-" + std::to_string(range.last_) +
+         "/" + std::to_string(file_size);
+}
+
+/* multipart/byteranges的分隔符，每个进程随机生成一次，文件内容中几乎不可能出现 */
+static auto ByteRangesBoundary() -> const std::string & {
+  static const std::string boundary = []() {
+    std::random_device device;
+    std::mt19937_64 engine(device());
+    char digits[17];
+    auto *end = std::to_chars(std::begin(digits), std::end(digits),
+                              engine() | (1ULL << 63), 16)
+                    .ptr;
+    return "NEXT_BYTERANGES_" + std::string(digits, end);
+  }();
+  return boundary;
+}
+
+auto BodySlice::FromBlock(SharedBlock block, size_t offset, size_t length)
+    -> BodySlice {
+  BodySlice slice;
+  slice.block_ = std::move(block);
+  slice.offset_ = offset;
+  slice.length_ = length;
+  return slice;
+}
+
+auto BodySlice::FromBlock(SharedBlock block) -> BodySlice {
+  auto size = block->size();
+  return FromBlock(std::move(block), 0, size);
+}
+
+auto BodySlice::FromFile(SharedFile file, size_t offset, size_t length)
+    -> BodySlice {
+  BodySlice slice;
+  slice.file_ = std::move(file);
+  slice.offset_ = offset;
+  slice.length_ = length;
+  return slice;
+}
+
+auto BodySlice::FromBytes(std::string bytes) -> BodySlice {
+  BodySlice slice;
+  slice.length_ = bytes.size();
+  slice.bytes_ = std::move(bytes);
+  return slice;
+}
+
+auto BodySlice::Sub(size_t offset, size_t length) const -> BodySlice {
+  if (block_ != nullptr) {
+    return FromBlock(block_, offset_ + offset, length);
+  }
+  if (file_ != nullptr) {
+    return FromFile(file_, offset_ + offset, length);
+  }
+  return FromBytes(bytes_.substr(offset, length));
+}
+
 Response::Response(const std::string &status_code, bool should_close,
                    std::optional<std::string> resource_url)
-    : should_close_(should_close), resource_url_(std::move(resource_url)) {
-  std::stringstream str_stream;
-  str_stream << HTTP_VERSION << SPACE << status_code;
-  status_line_ = str_stream.str();
+    : status_line_(std::string(HTTP_VERSION) + SPACE + status_code),
+      should_close_(should_close), resource_url_(std::move(resource_url)) {
   // 添加一些必要的header
-  headers_.emplace_back(HEADER_SERVER, SERVER_NEXT);
-  headers_.emplace_back(
-      HEADER_CONNECTION,
-      ((should_close_) ? CONNECTION_CLOSE : CONNECTION_KEEP_ALIVE));
-  // 响应体Body
-  if (resource_url_.has_value() && IsFileExists(resource_url_.value())) {
-    size_t content_length = CheckFileSize(resource_url_.value());
-    headers_.emplace_back(HEADER_CONTENT_LENGTH,
-                          std::to_string(content_length));
-    // 解析拓展名
-    auto last_dot = resource_url_.value().find_last_of(DOT);
-    if (last_dot != std::string::npos) {
-      auto extension_raw_str = resource_url_.value().substr(last_dot + 1);
-      auto extension = ToExtension(extension_raw_str);
-      headers_.emplace_back(HEADER_CONTENT_TYPE, ExtensionToMime(extension));
-    }
+  headers_.Set(HeaderId::SERVER, SERVER_NEXT);
+  headers_.Set(HeaderId::CONNECTION,
+               ((should_close_) ? CONNECTION_CLOSE : CONNECTION_KEEP_ALIVE));
+  // 响应体Body，只stat一次文件
+  std::error_code error;
+  size_t content_length = 0;
+  if (resource_url_.has_value()) {
+    content_length = std::filesystem::file_size(resource_url_.value(), error);
+  }
+  if (resource_url_.has_value() && !error) {
+    SetContentLength(content_length);
+    // MIME类型按文件缓存，不必每次解析扩展名
+    headers_.Set(HeaderId::CONTENT_TYPE,
+                 std::string(FileToMime(resource_url_.value())));
   } else {
     resource_url_ = std::nullopt;
-    headers_.emplace_back(HEADER_CONTENT_LENGTH, CONTENT_LENGTH_ZERO);
+    headers_.Set(HeaderId::CONTENT_LENGTH, CONTENT_LENGTH_ZERO);
   }
 }
 
@@ -40,38 +121,225 @@ auto Response::Make200Response(bool should_close,
     -> Response {
   return {RESPONSE_OK, should_close, std::move(resource_url)};
 }
+auto Response::MakeFileResponse(bool should_close, size_t content_length,
+                                std::string_view mime) -> Response {
+  Response response{RESPONSE_OK, should_close, std::nullopt};
+  response.SetContentLength(content_length);
+  response.headers_.Set(HeaderId::CONTENT_TYPE, std::string(mime));
+  response.headers_.Set(HeaderId::ACCEPT_RANGES, ACCEPT_RANGES_BYTES);
+  return response;
+}
+auto Response::MakePartialResponse(bool should_close, const ByteRange &range,
+                                   size_t file_size, std::string_view mime)
+    -> Response {
+  Response response{RESPONSE_PARTIAL_CONTENT, should_close, std::nullopt};
+  response.SetContentLength(range.Length());
+  response.headers_.Set(HeaderId::CONTENT_TYPE, std::string(mime));
+  response.headers_.Set(HeaderId::CONTENT_RANGE,
+                        FormatContentRange(range, file_size));
+  return response;
+}
+
+auto Response::MakeMultipartResponse(bool should_close,
+                                     const std::vector<ByteRange> &ranges,
+                                     size_t file_size, std::string_view mime,
+                                     std::vector<std::string> &part_heads)
+    -> Response {
+  const auto &boundary = ByteRangesBoundary();
+  Response response{RESPONSE_PARTIAL_CONTENT, should_close, std::nullopt};
+  response.headers_.Set(HeaderId::CONTENT_TYPE,
+                        "multipart/byteranges; boundary=" + boundary);
+  part_heads.clear();
+  size_t content_length = 0;
+  for (const auto &range : ranges) {
+    // 第一个分隔行前的CRLF属于preamble，一并加上让每个部分的格式相同
+    part_heads.push_back(std::string(CRLF) + "--" + boundary + CRLF +
+                         HEADER_CONTENT_TYPE + COLON + std::string(mime) +
+                         CRLF + "Content-Range" + COLON +
+                         FormatContentRange(range, file_size) + CRLF + CRLF);
+    content_length += part_heads.back().size() + range.Length();
+  }
+  part_heads.push_back(std::string(CRLF) + "--" + boundary + "--" + CRLF);
+  content_length += part_heads.back().size();
+  response.SetContentLength(content_length);
+  return response;
+}
+
+auto Response::Make416Response(bool should_close, size_t file_size)
+    -> Response {
+  Response response{RESPONSE_RANGE_NOT_SATISFIABLE, should_close, std::nullopt};
+  response.headers_.Set(HeaderId::CONTENT_RANGE,
+                        std::string(ACCEPT_RANGES_BYTES) + " */" +
+                            std::to_string(file_size));
+  return response;
+}
+
+auto Response::Make304Response(bool should_close, std::string_view etag,
+                               time_t last_modified) -> Response {
+  Response response{RESPONSE_NOT_MODIFIED, should_close, std::nullopt};
+  response.headers_.Erase(HeaderId::CONTENT_LENGTH);
+  response.SetValidators(etag, last_modified);
+  return response;
+}
+
 auto Response::Make400Response() noexcept -> Response {
   return {RESPONSE_BAD_REQUEST, true, std::nullopt};
 }
 auto Response::Make404Response() noexcept -> Response {
   return {RESPONSE_NOT_FOUND, true, std::nullopt};
 }
+auto Response::Make405Response(const std::string &allow) noexcept
+    -> Response {
+  Response response{RESPONSE_METHOD_NOT_ALLOWED, true, std::nullopt};
+  response.headers_.Set(HeaderId::ALLOW, allow);
+  return response;
+}
 auto Response::Make503Response() noexcept -> Response {
   return {RESPONSE_SERVICE_UNAVAILABLE, true, std::nullopt};
 }
 
-void Response::Serialize(std::vector<unsigned char> &buffer) {
-  std::stringstream str_stream;
-  str_stream << status_line_ << CRLF;
-  for (const auto &header : headers_) {
-    str_stream << header.Serialize();
+auto Response::Make413Response() noexcept -> Response {
+  return {RESPONSE_PAYLOAD_TOO_LARGE, true, std::nullopt};
+}
+
+auto Response::MakeCanned(CannedResponse kind) noexcept -> Response {
+  switch (kind) {
+    case CannedResponse::BAD_REQUEST:
+      return Make400Response();
+    case CannedResponse::NOT_FOUND:
+      return Make404Response();
+    case CannedResponse::METHOD_NOT_ALLOWED_STATIC:
+      return Make405Response(ALLOW_STATIC);
+    case CannedResponse::PAYLOAD_TOO_LARGE:
+      return Make413Response();
+    default:
+      return Make503Response();
   }
-  str_stream << CRLF;
-  std::string response_head = str_stream.str();
-  buffer.insert(buffer.end(), response_head.begin(), response_head.end());
 }
 
-auto Response::GetHeaders() -> std::vector<Header> { return headers_; }
+void Response::SerializeCanned(CannedResponse kind,
+                               std::vector<unsigned char> &buffer) {
+  // 除Date外的部分只渲染一次，Date放在最后一个header的位置
+  static const std::array<std::vector<unsigned char>, 5> canned_heads = []() {
+    std::array<Response, 5> responses = {
+        Make400Response(), Make404Response(), Make405Response(ALLOW_STATIC),
+        Make503Response(), Make413Response()};
+    std::array<std::vector<unsigned char>, 5> heads;
+    for (size_t i = 0; i < responses.size(); i++) {
+      responses[i].SerializeHeaders(heads[i]);
+    }
+    return heads;
+  }();
+  const auto &head = canned_heads[static_cast<size_t>(kind)];
+  buffer.insert(buffer.end(), head.begin(), head.end());
+  AppendDateHeader(buffer);
+  AppendTo(buffer, CRLF);
+}
+
+void Response::Serialize(std::vector<unsigned char> &buffer) const {
+  SerializeHeaders(buffer);
+  AppendDateHeader(buffer);
+  AppendTo(buffer, CRLF);
+}
+
+void Response::SerializeWithoutDate(std::vector<unsigned char> &buffer) const {
+  SerializeHeaders(buffer);
+  AppendTo(buffer, CRLF);
+}
+
+void Response::SerializeDateHeader(std::vector<unsigned char> &buffer) {
+  AppendDateHeader(buffer);
+}
+
+void Response::SetValidators(std::string_view etag, time_t last_modified) {
+  char date[HTTP_DATE_SIZE];
+  headers_.Set(HeaderId::ETAG, std::string(etag));
+  headers_.Set(HeaderId::LAST_MODIFIED,
+               std::string(date, FormatHttpDate(last_modified, date)));
+}
+
+void Response::SetContentCoding(ContentCoding coding) {
+  headers_.Set(HeaderId::VARY, HEADER_ACCEPT_ENCODING);
+  if (coding != ContentCoding::IDENTITY) {
+    headers_.Set(HeaderId::CONTENT_ENCODING,
+                 std::string(ContentCodingToken(coding)));
+    // 区间总是针对原文件，压缩后的表示不支持区间请求
+    headers_.Erase(HeaderId::ACCEPT_RANGES);
+  }
+}
+
+void Response::SetHeader(std::string_view key, std::string value) {
+  headers_.Set(key, std::move(value));
+}
+
+void Response::SetContentLength(size_t content_length) {
+  char digits[24];
+  auto *end =
+      std::to_chars(std::begin(digits), std::end(digits), content_length).ptr;
+  headers_.Set(HeaderId::CONTENT_LENGTH,
+               std::string(digits, static_cast<size_t>(end - digits)));
+}
+
+void Response::SetChunked() {
+  headers_.Erase(HeaderId::CONTENT_LENGTH);
+  headers_.Set(HeaderId::TRANSFER_ENCODING, TRANSFER_ENCODING_CHUNKED);
+}
+
+void Response::SerializeHeaders(std::vector<unsigned char> &buffer) const {
+  AppendTo(buffer, status_line_);
+  AppendTo(buffer, CRLF);
+  // Server和Connection保持默认值时直接使用预先渲染好的块
+  auto connection = headers_.Get(HeaderId::CONNECTION);
+  bool fixed_block = headers_.Get(HeaderId::SERVER) == SERVER_NEXT &&
+                     connection == (should_close_ ? CONNECTION_CLOSE
+                                                  : CONNECTION_KEEP_ALIVE);
+  if (fixed_block) {
+    AppendTo(buffer,
+             should_close_ ? FIXED_HEADERS_CLOSE : FIXED_HEADERS_KEEP_ALIVE);
+  }
+  headers_.ForEach([&](std::string_view key, std::string_view value) {
+    if (fixed_block && (key == HeaderIdToName(HeaderId::SERVER) ||
+                        key == HeaderIdToName(HeaderId::CONNECTION))) {
+      return;
+    }
+    AppendTo(buffer, key);
+    AppendTo(buffer, COLON);
+    AppendTo(buffer, value);
+    AppendTo(buffer, CRLF);
+  });
+}
+
+auto Response::GetHeaders() -> std::vector<Header> {
+  return headers_.ToHeaders();
+}
+
+auto Response::ShouldClose() const noexcept -> bool { return should_close_; }
+
+auto Response::GetStatusCode() const noexcept -> std::string_view {
+  // 状态行是 "HTTP/1.1 200 OK"
+  return std::string_view(status_line_).substr(std::size(HTTP_VERSION), 3);
+}
+
+auto Response::GetHeaderTable() const noexcept -> const HeaderTable & {
+  return headers_;
+}
 
 auto Response::ChangeHeader(const std::string &key,
                             const std::string &new_value) noexcept -> bool {
-  for (auto &it : headers_) {
-    if (it.GetKey() == key) {
-      it.SetValue(new_value);
-      return true;
-    }
+  if (!headers_.Has(key)) {
+    return false;
+  }
+  headers_.Set(key, new_value);
+  return true;
+}
+
+auto Response::ChangeHeader(HeaderId id, std::string new_value) noexcept
+    -> bool {
+  if (!headers_.Has(id)) {
+    return false;
   }
-  return false;
+  headers_.Set(id, std::move(new_value));
+  return true;
 }
 
 auto operator<<(std::ostream &os, Response &response) -> std::ostream & {
@@ -0,0 +1,258 @@
+#include "http/router.h"
+
+#include <algorithm>
+
+namespace Next::Http {
+
+/* 注册时使用的树，每次注册后编译成Router::Node数组 */
+struct Router::BuildNode {
+  std::string label_;
+  // 静态子节点，首字符各不相同
+  std::vector<std::unique_ptr<BuildNode>> children_;
+  std::unique_ptr<BuildNode> param_;
+  std::unique_ptr<BuildNode> catch_all_;
+  // 参数节点和 "*" 节点的参数名
+  std::string name_;
+  std::array<uint32_t, ROUTE_METHOD_COUNT> handlers_{};
+};
+
+/* 检查模式的格式，参数名不能为空或重复，"*" 只能出现在最后一段 */
+static auto IsValidPattern(std::string_view pattern) -> bool {
+  if (pattern.empty() || pattern.front() != '/') {
+    return false;
+  }
+  std::vector<std::string_view> names;
+  for (size_t start = 1; start <= pattern.size();) {
+    auto end = std::min(pattern.find('/', start), pattern.size());
+    auto segment = pattern.substr(start, end - start);
+    if (!segment.empty() && (segment.front() == ':' || segment.front() == '*')) {
+      auto name = segment.substr(1);
+      if (name.empty() || names.size() == MAX_ROUTE_PARAMS ||
+          std::find(names.begin(), names.end(), name) != names.end() ||
+          (segment.front() == '*' && end != pattern.size())) {
+        return false;
+      }
+      names.push_back(name);
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+/* 静态文本中下一个参数段开始的位置 */
+static auto FindParamSegment(std::string_view pattern, size_t pos) noexcept -> size_t {
+  for (size_t i = std::max<size_t>(pos, 1); i < pattern.size(); i++) {
+    if (pattern[i - 1] == '/' && (pattern[i] == ':' || pattern[i] == '*')) {
+      return i;
+    }
+  }
+  return pattern.size();
+}
+
+auto RouteParams::Get(std::string_view name) const noexcept -> std::optional<std::string_view> {
+  for (size_t i = 0; i < size_; i++) {
+    if (params_[i].first == name) {
+      return params_[i].second;
+    }
+  }
+  return std::nullopt;
+}
+
+auto RouteParams::Size() const noexcept -> size_t { return size_; }
+
+auto RouteParams::At(size_t index) const noexcept -> const std::pair<std::string_view, std::string_view> & {
+  return params_[index];
+}
+
+Router::Router() : root_(std::make_unique<BuildNode>()) { Compile(); }
+
+Router::~Router() = default;
+
+auto Router::Add(Method method, std::string_view pattern, RouteHandler handler) -> bool {
+  if (method == Method::UNSUPPORTED || handler == nullptr || !IsValidPattern(pattern)) {
+    return false;
+  }
+  BuildNode *node = root_.get();
+  size_t pos = 0;
+  while (pos < pattern.size()) {
+    if (pos > 0 && pattern[pos - 1] == '/' && (pattern[pos] == ':' || pattern[pos] == '*')) {
+      auto end = std::min(pattern.find('/', pos), pattern.size());
+      auto name = pattern.substr(pos + 1, end - pos - 1);
+      auto &child = pattern[pos] == ':' ? node->param_ : node->catch_all_;
+      if (child == nullptr) {
+        child = std::make_unique<BuildNode>();
+        child->name_ = name;
+      } else if (child->name_ != name) {
+        // 同一位置的参数必须同名，否则无法确定参数名
+        return false;
+      }
+      node = child.get();
+      pos = end;
+      continue;
+    }
+    // 插入静态文本，与已有节点的公共前缀不同时拆分节点
+    auto end = FindParamSegment(pattern, pos);
+    auto literal = pattern.substr(pos, end - pos);
+    pos = end;
+    while (!literal.empty()) {
+      auto iter = std::find_if(node->children_.begin(), node->children_.end(),
+                               [&](const auto &child) { return child->label_.front() == literal.front(); });
+      if (iter == node->children_.end()) {
+        node->children_.push_back(std::make_unique<BuildNode>());
+        node = node->children_.back().get();
+        node->label_ = literal;
+        break;
+      }
+      const auto &label = (*iter)->label_;
+      size_t common = 0;
+      while (common < label.size() && common < literal.size() && label[common] == literal[common]) {
+        common++;
+      }
+      if (common < label.size()) {
+        auto split = std::make_unique<BuildNode>();
+        split->label_ = label.substr(0, common);
+        (*iter)->label_.erase(0, common);
+        split->children_.push_back(std::move(*iter));
+        *iter = std::move(split);
+      }
+      node = iter->get();
+      literal.remove_prefix(common);
+    }
+  }
+  auto &slot = node->handlers_[static_cast<size_t>(method)];
+  if (slot != 0) {
+    return false;
+  }
+  handlers_.push_back(std::move(handler));
+  slot = static_cast<uint32_t>(handlers_.size());
+  Compile();
+  return true;
+}
+
+auto Router::Match(Method method, std::string_view path, RouteParams &params) const noexcept -> RouteMatch {
+  RouteMatch match;
+  params.size_ = 0;
+  MatchNode(0, method, path, params, match);
+  return match;
+}
+
+auto Router::FormatAllow(uint32_t allowed) -> std::string {
+  std::string allow;
+  for (size_t i = 0; i < ROUTE_METHOD_COUNT; i++) {
+    if ((allowed & (1U << i)) != 0) {
+      if (!allow.empty()) {
+        allow.append(", ");
+      }
+      allow.append(METHOD_TO_STRING.at(static_cast<Method>(i)));
+    }
+  }
+  return allow;
+}
+
+auto Router::Size() const noexcept -> size_t { return handlers_.size(); }
+
+void Router::Compile() {
+  nodes_.clear();
+  labels_.clear();
+  names_.clear();
+  nodes_.emplace_back();
+  CompileNode(0, *root_);
+}
+
+void Router::CompileNode(uint32_t index, const BuildNode &build) {
+  // nodes_在递归中会扩容，先填好局部的Node最后再写回
+  Node node;
+  node.label_offset_ = static_cast<uint32_t>(labels_.size());
+  node.label_length_ = static_cast<uint32_t>(build.label_.size());
+  labels_.append(build.label_);
+  node.name_ = static_cast<uint32_t>(names_.size());
+  names_.push_back(build.name_);
+  node.handlers_ = build.handlers_;
+  node.first_child_ = static_cast<uint32_t>(nodes_.size());
+  node.child_count_ = static_cast<uint32_t>(build.children_.size());
+  nodes_.resize(nodes_.size() + build.children_.size());
+  for (uint32_t i = 0; i < node.child_count_; i++) {
+    CompileNode(node.first_child_ + i, *build.children_[i]);
+  }
+  if (build.param_ != nullptr) {
+    node.param_child_ = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+    CompileNode(node.param_child_, *build.param_);
+  }
+  if (build.catch_all_ != nullptr) {
+    node.catch_all_child_ = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+    CompileNode(node.catch_all_child_, *build.catch_all_);
+  }
+  nodes_[index] = node;
+}
+
+auto Router::Resolve(const Node &node, Method method, RouteMatch &match) const noexcept -> bool {
+  auto method_index = static_cast<size_t>(method);
+  uint32_t handler = method_index < ROUTE_METHOD_COUNT ? node.handlers_[method_index] : 0;
+  if (handler == 0 && method == Method::HEAD) {
+    handler = node.handlers_[static_cast<size_t>(Method::GET)];
+  }
+  if (handler != 0) {
+    match.status_ = RouteStatus::MATCHED;
+    match.handler_ = &handlers_[handler - 1];
+    return true;
+  }
+  uint32_t allowed = 0;
+  for (size_t i = 0; i < ROUTE_METHOD_COUNT; i++) {
+    allowed |= node.handlers_[i] != 0 ? 1U << i : 0;
+  }
+  if (allowed == 0) {
+    return false;
+  }
+  if ((allowed & (1U << static_cast<size_t>(Method::GET))) != 0) {
+    allowed |= 1U << static_cast<size_t>(Method::HEAD);
+  }
+  match.status_ = RouteStatus::METHOD_NOT_ALLOWED;
+  match.allowed_ = allowed;
+  return true;
+}
+
+auto Router::MatchNode(uint32_t index, Method method, std::string_view path, RouteParams &params,
+                       RouteMatch &match) const noexcept -> bool {
+  const auto &node = nodes_[index];
+  std::string_view label(labels_.data() + node.label_offset_, node.label_length_);
+  if (path.substr(0, label.size()) != label) {
+    return false;
+  }
+  path.remove_prefix(label.size());
+  if (path.empty() && Resolve(node, method, match)) {
+    return true;
+  }
+  // 静态子节点的首字符各不相同，最多只有一个需要尝试
+  for (uint32_t i = 0; i < node.child_count_ && !path.empty(); i++) {
+    const auto &child = nodes_[node.first_child_ + i];
+    if (labels_[child.label_offset_] == path.front()) {
+      if (MatchNode(node.first_child_ + i, method, path, params, match)) {
+        return true;
+      }
+      break;
+    }
+  }
+  if (node.param_child_ != 0 && params.size_ < MAX_ROUTE_PARAMS) {
+    auto value = path.substr(0, path.find('/'));
+    if (!value.empty()) {
+      params.params_[params.size_++] = {names_[nodes_[node.param_child_].name_], value};
+      if (MatchNode(node.param_child_, method, path.substr(value.size()), params, match)) {
+        return true;
+      }
+      params.size_--;
+    }
+  }
+  if (node.catch_all_child_ != 0 && params.size_ < MAX_ROUTE_PARAMS) {
+    const auto &catch_all = nodes_[node.catch_all_child_];
+    params.params_[params.size_++] = {names_[catch_all.name_], path};
+    if (Resolve(catch_all, method, match)) {
+      return true;
+    }
+    params.size_--;
+  }
+  return false;
+}
+
+}  // namespace Next::Http
@@ -4,6 +4,7 @@
 #include <functional>
 #include <memory>
 #include <vector>
+#include "core/socket.h"
 #include "core/utils.h"
 namespace Next {
 
@@ -13,7 +14,8 @@ class Connection;
 
 class Acceptor {
  public:
-  Acceptor(Looper *listener, std::vector<Looper *> reactors, NetAddress server_address);
+  Acceptor(Looper *listener, std::vector<Looper *> reactors, NetAddress server_address,
+           SocketOptions socket_options = {});
   ~Acceptor() = default;
   NON_COPYABLE(Acceptor);
   void BaseAcceptCallback(Connection *server_conn);
@@ -30,8 +32,11 @@ class Acceptor {
 
   auto GetAcceptorConnection() noexcept -> Connection *;
 
+  auto GetSocketOptions() const noexcept -> const SocketOptions &;
+
  private:
   std::vector<Looper *> reactors_;
+  SocketOptions socket_options_;
   std::unique_ptr<Connection> acceptor_conn_;
   std::function<void(Connection *)> custom_accept_callback_{};
   std::function<void(Connection *)> custom_handle_callback_{};
@@ -1,6 +1,7 @@
 #ifndef NEXT_BUFFER_H
 #define NEXT_BUFFER_H
 
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -11,6 +12,9 @@ namespace Next {
 
 static constexpr size_t INITIAL_BUFFER_CAPACITY = 1024;
 
+/* 多个连接共享的只读数据块，例如缓存中的文件内容或完整响应，发送时不再拷贝 */
+using SharedBlock = std::shared_ptr<const std::vector<unsigned char>>;
+
 class Buffer {
 public:
     explicit Buffer(size_t initial_capacity = INITIAL_BUFFER_CAPACITY);
@@ -33,6 +37,9 @@ public:
 
     auto FindAndPopTill(const std::string &target) -> std::optional<std::string>;
 
+    /* 丢弃头部的size字节，用于原地解析完成后释放已处理的数据 */
+    void Consume(size_t size) noexcept;
+
     auto Size() const noexcept -> size_t;
 
     auto Capacity() const noexcept -> size_t;
@@ -1,16 +1,18 @@
 #ifndef NEXT_CACHE_H
 #define NEXT_CACHE_H
 
+#include "core/buffer.h"
 #include "core/utils.h"
+#include <atomic>
 #include <memory>
 #include <mutex>
-#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace Next {
 static constexpr size_t DEFAULT_CACHE_CAPACITY = 10 * 1024 * 1024;
+static constexpr size_t DEFAULT_CACHE_SEGMENTS = 16;
 auto GetTimeUtc() noexcept -> uint64_t;
 
 class Cache {
@@ -21,26 +23,35 @@ public:
   public:
     CacheNode() noexcept;
     CacheNode(std::string identifier, const std::vector<unsigned char> &data);
+    CacheNode(std::string identifier, SharedBlock data) noexcept;
     void SetIdentifier(const std::string &identifier);
     void SetData(const std::vector<unsigned char> &data);
     void Serialize(std::vector<unsigned char> &destination);
+    auto GetData() const noexcept -> const SharedBlock &;
     auto Size() const noexcept -> size_t;
     void UpdataTimeStamp() noexcept;
     auto GetTimeStamp() const noexcept -> uint64_t;
 
   private:
     std::string identifier_;
-    std::vector<unsigned char> data_;
+    // 数据块不可变，命中时把引用交给连接直接发送，节点被淘汰后数据块随最后一个引用释放
+    SharedBlock data_;
     uint64_t last_access_{0};
+    // 过期时间(毫秒)，0表示不过期
+    uint64_t expires_at_{0};
+    // 最近一次访问时的Cache::clock_
+    uint64_t tick_{0};
     CacheNode *prev_{nullptr};
     CacheNode *next_{nullptr};
   };
 
-  explicit Cache(size_t capacity = DEFAULT_CACHE_CAPACITY) noexcept;
+  explicit Cache(size_t capacity = DEFAULT_CACHE_CAPACITY,
+                 size_t segments = DEFAULT_CACHE_SEGMENTS);
   NON_MOVE_AND_COPYABLE(Cache);
 
   auto GetOccupancy() const noexcept -> size_t;
   auto GetCapacity() const noexcept -> size_t;
+  auto GetSegmentCount() const noexcept -> size_t;
 
   auto TryLoad(const std::string &resource_url,
                std::vector<unsigned char> &destination) -> bool;
@@ -48,21 +59,50 @@ public:
   auto TryInsert(const std::string &resource_url,
                  const std::vector<unsigned char> &source) -> bool;
 
+  /* 命中时返回共享的数据块而不拷贝，未命中返回nullptr，已过期的条目在这时删除并视为未命中 */
+  auto TryLoadShared(const std::string &resource_url) -> SharedBlock;
+
+  /* ttl_ms不为0时条目在ttl_ms毫秒后过期，过期前仍按lru参与淘汰 */
+  auto TryInsertShared(const std::string &resource_url, SharedBlock source,
+                       uint64_t ttl_ms = 0) -> bool;
+
   void Clear();
   void EvictOneByUrl(const std::string& url) noexcept;
+  /* 删除一个条目，不存在时返回false，用于文件变化后使缓存失效 */
+  auto Erase(const std::string &url) noexcept -> bool;
 private:
-  void EvictOne() noexcept;
-  void RemoveFromList(const std::shared_ptr<CacheNode> &node) noexcept;
-  void AppendToListTail(const std::shared_ptr<CacheNode> &node) noexcept;
+  /**
+   * 一个独立加锁的分段，url按哈希值分到各个分段，不同分段上的操作互不阻塞
+   * 命中也要移动lru链表，所以读写都持有独占锁
+   */
+  struct Segment {
+    Segment() noexcept;
+    std::mutex mtx_;
+    std::unordered_map<std::string, std::shared_ptr<CacheNode>> mapping_;
+    const std::shared_ptr<CacheNode> header_;
+    const std::shared_ptr<CacheNode> tailer_;
+  };
+
+  auto SegmentOf(const std::string &url) noexcept -> Segment &;
+  /* 命中时移到lru链表尾部，已过期时删除，调用者需持有segment的锁 */
+  auto Touch(Segment &segment, const std::string &url) noexcept
+      -> std::shared_ptr<CacheNode>;
+  /* 从segment中删除一个条目，调用者需持有segment的锁 */
+  void Remove(Segment &segment,
+              std::unordered_map<std::string,
+                                 std::shared_ptr<CacheNode>>::iterator iter) noexcept;
+  /* 淘汰所有分段中最久未使用的条目，不持有任何锁时调用，没有可淘汰的条目时返回false */
+  auto EvictOne() noexcept -> bool;
+  static void RemoveFromList(const std::shared_ptr<CacheNode> &node) noexcept;
+  static void AppendToListTail(Segment &segment,
+                               const std::shared_ptr<CacheNode> &node) noexcept;
 
-  // shared_mutex to implement read/write lock
-  std::shared_mutex mtx_;
-  // use map to fast find ptr pos
-  std::unordered_map<std::string, std::shared_ptr<CacheNode>> mapping_;
+  std::vector<std::unique_ptr<Segment>> segments_;
+  // 所有分段共用的容量预算
   const size_t capacity_{0};
-  size_t occupancy_{0};
-  const std::shared_ptr<CacheNode> header_;
-  const std::shared_ptr<CacheNode> tailer_;
+  std::atomic<size_t> occupancy_{0};
+  // 每次访问取一个递增的序号，比较各分段lru头部的序号得到全局最久未使用的条目
+  std::atomic<uint64_t> clock_{0};
 };
 
 } // namespace Next
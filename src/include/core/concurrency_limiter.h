@@ -0,0 +1,80 @@
+#ifndef NEXT_CONCURRENCY_LIMITER_H
+#define NEXT_CONCURRENCY_LIMITER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "core/utils.h"
+
+namespace Next {
+
+static constexpr int DEFAULT_INITIAL_LIMIT = 32;
+static constexpr int DEFAULT_MIN_LIMIT = 4;
+static constexpr int DEFAULT_MAX_LIMIT = 1024;
+
+/**
+ * 基于延迟梯度的自适应并发限制器(gradient2)
+ * 用长期平均延迟作为无排队时的基准，短期延迟相对它升高说明请求开始排队，按比例收缩并发上限；
+ * 延迟平稳且并发接近上限时每个样本以 sqrt(limit) 的幅度探测性地增加上限
+ * 延迟从请求到达(而不是开始处理)时算起，reactor线程忙不过来时请求在读缓冲区里等待的时间也计入样本
+ * 超过上限的请求应当被立即拒绝(例如回复503)，而不是在缓冲区里排队直到客户端超时
+ */
+class ConcurrencyLimiter {
+ public:
+  /* TryAcquirePermit得到的RAII许可，析构时归还并以持有时长作为延迟样本 */
+  class Permit {
+   public:
+    Permit() noexcept = default;
+    Permit(ConcurrencyLimiter *limiter, uint64_t start) noexcept;
+    Permit(Permit &&other) noexcept;
+    auto operator=(Permit &&other) noexcept -> Permit &;
+    ~Permit();
+    NON_COPYABLE(Permit);
+
+    auto IsGranted() const noexcept -> bool;
+
+   private:
+    ConcurrencyLimiter *limiter_{nullptr};
+    uint64_t start_{0};
+  };
+
+  explicit ConcurrencyLimiter(int initial_limit = DEFAULT_INITIAL_LIMIT, int min_limit = DEFAULT_MIN_LIMIT,
+                              int max_limit = DEFAULT_MAX_LIMIT) noexcept;
+
+  NON_MOVE_AND_COPYABLE(ConcurrencyLimiter);
+
+  /* 未达到上限时占用一个并发名额并返回true，之后必须调用Release归还 */
+  auto TryAcquire() noexcept -> bool;
+
+  /* 一个请求完成，latency为它的处理时长(ns) */
+  void Release(uint64_t latency) noexcept;
+
+  /* 同TryAcquire，成功时返回IsGranted()为true的许可，延迟从现在算起 */
+  auto TryAcquirePermit() noexcept -> Permit;
+
+  /* arrival是请求到达的时刻(NowSinceEpoch2)，之前排队等待的时间同样计入延迟样本 */
+  auto TryAcquirePermit(uint64_t arrival) noexcept -> Permit;
+
+  auto GetLimit() const noexcept -> int;
+
+  auto GetInFlight() const noexcept -> int;
+
+  auto GetRejected() const noexcept -> uint64_t;
+
+ private:
+  void Update(uint64_t latency, int in_flight) noexcept;
+
+  std::mutex mtx_;
+  const int min_limit_;
+  const int max_limit_;
+  double estimated_limit_;
+  double long_latency_{0};
+  double short_latency_{0};
+  std::atomic<int> limit_;
+  std::atomic<int> in_flight_{0};
+  std::atomic<uint64_t> rejected_{0};
+};
+
+}  // namespace Next
+#endif  // !NEXT_CONCURRENCY_LIMITER_H
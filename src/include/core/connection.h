@@ -1,9 +1,14 @@
 #ifndef NEXT_CONNECTION_H
 #define NEXT_CONNECTION_H
 #include "core/buffer.h"
+#include "core/fd_cache.h"
 #include "core/looper.h"
 #include "core/socket.h"
 #include "core/utils.h"
+#include <sys/uio.h>
+#include <any>
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -23,6 +28,9 @@ static const int TEMP_BUF_SIZE = 2048;
 
 class Connection {
 public:
+  /* 由所属Looper维护，RUNNING表示offload的job正在执行，DEFERRED表示执行期间有事件到达被推迟 */
+  enum class OffloadState : uint8_t { NONE, RUNNING, DEFERRED };
+
   explicit Connection(std::unique_ptr<Socket> socket);
   ~Connection() = default;
 
@@ -42,32 +50,75 @@ public:
   /* for Buffer */
   auto FindAndPopTill(const std::string &target) -> std::optional<std::string>;
   auto GetReadBufferSize() const noexcept -> size_t;
+  /* 待发送的字节数，包括排队的共享数据块 */
   auto GetWriteBufferSize() const noexcept -> size_t;
   void WriteToReadBuffer(const unsigned char *buf, size_t size);
   void WriteToWriteBuffer(const unsigned char *buf, size_t size);
   void WriteToReadBuffer(const std::string &str);
   void WriteToWriteBuffer(const std::string &str);
   void WriteToWriteBuffer(std::vector<unsigned char> &&other_buf);
+  /**
+   * 排队发送共享数据块[offset, offset + length)，不拷贝到写缓冲区
+   * 与写缓冲区中的数据保持写入的先后顺序，Send时和写缓冲区一起用writev发出
+   */
+  void WriteToWriteBuffer(SharedBlock block, size_t offset, size_t length);
+  void WriteToWriteBuffer(SharedBlock block);
+  /* 排队发送文件的[offset, offset + length)，Send时用sendfile发出，文件内容不进入用户态 */
+  void WriteToWriteBuffer(SharedFile file, size_t offset, size_t length);
 
   auto Read() const noexcept -> const unsigned char *;
   auto ReadAsString() const noexcept -> std::string;
+  /* 读缓冲区的视图，缓冲区被修改后失效 */
+  auto ReadAsStringView() const noexcept -> std::string_view;
+  void ConsumeReadBuffer(size_t size) noexcept;
 
   /* return std::pair<How many bytes read, whether the client exits> */
   auto Recv() -> std::pair<ssize_t, bool>;
-  void Send();
+  /**
+   * 尽量发出写缓冲区和排队的共享数据，发送出错时丢弃所有待发送的数据并返回false
+   * 非阻塞socket的发送缓冲区满时剩余部分留在队列中，GetWriteBufferSize不为0，可写事件到达后再次Send
+   */
+  auto Send() -> bool;
   void ClearReadBuffer() noexcept;
   void ClearWriteBuffer() noexcept;
   void SetLooper(Looper *looper) noexcept;
   auto GetLooper() noexcept -> Looper *;
 
+  /* 上层协议附加在连接上的状态，例如跨多次读事件的http解析器 */
+  void SetContext(std::any context);
+  auto GetContext() noexcept -> std::any &;
+
+  auto GetOffloadState() const noexcept -> OffloadState;
+  void SetOffloadState(OffloadState state) noexcept;
+  /* job仍在执行时把状态改为DEFERRED并返回true，没有offload时返回false */
+  auto DeferIfOffloaded() noexcept -> bool;
+
 private:
+  /* 排在写缓冲区第position_个字节之前发送的一段共享数据，来自数据块或者文件 */
+  struct SharedSlice {
+    size_t position_;
+    SharedBlock block_;
+    SharedFile file_;
+    size_t offset_;
+    size_t length_;
+  };
+
+  void GatherIovecs(std::vector<iovec> &iov);
+  void ConsumeWritten(size_t written);
+
   Looper *owner_looper_{nullptr};
   std::unique_ptr<Socket> socket_;
   std::unique_ptr<Buffer> read_buffer_;
   std::unique_ptr<Buffer> write_buffer_;
+  // 写缓冲区中已经发出的字节数，全部发完时才清空缓冲区
+  size_t write_offset_{0};
+  std::deque<SharedSlice> shared_slices_;
+  size_t shared_bytes_{0};
   uint32_t events_{0};
   uint32_t revents_{0};
   std::function<void()> callback_{nullptr};
+  std::any context_;
+  std::atomic<OffloadState> offload_state_{OffloadState::NONE};
 };
 
 } // namespace Next
@@ -0,0 +1,78 @@
+#ifndef NEXT_FD_CACHE_H
+#define NEXT_FD_CACHE_H
+
+#include <array>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "core/utils.h"
+
+namespace Next {
+
+static constexpr size_t DEFAULT_FD_CACHE_CAPACITY = 512;
+static constexpr size_t FD_CACHE_SHARD_COUNT = 16;
+
+/* 一个只读打开的文件，最后一个引用释放时关闭fd */
+class OpenFile {
+ public:
+  explicit OpenFile(int fd) noexcept;
+  ~OpenFile();
+  NON_MOVE_AND_COPYABLE(OpenFile);
+
+  /* 以O_RDONLY | O_CLOEXEC打开，失败时返回nullptr */
+  static auto Open(const std::string &path) -> std::shared_ptr<const OpenFile>;
+
+  auto GetFd() const noexcept -> int;
+
+ private:
+  int fd_{-1};
+};
+
+using SharedFile = std::shared_ptr<const OpenFile>;
+
+/**
+ * 以路径为key的已打开文件描述符的LRU缓存，所有reactor和offload线程共享
+ * 按路径的hash分成多个分片，每个分片有自己的锁和LRU链表，不同文件的访问很少互相等待
+ * 条目以引用计数持有，被淘汰或失效的文件在最后一个正在进行的传输结束后才关闭
+ */
+class FdCache {
+ public:
+  explicit FdCache(size_t capacity = DEFAULT_FD_CACHE_CAPACITY);
+
+  NON_MOVE_AND_COPYABLE(FdCache);
+
+  /* 命中时返回已打开的文件并更新LRU，未命中返回nullptr */
+  auto Find(const std::string &path) -> SharedFile;
+
+  /* 放入一个已打开的文件，已存在时保留原有的条目并返回它 */
+  auto Insert(const std::string &path, SharedFile file) -> SharedFile;
+
+  /* 文件变化后删除条目，正在使用它的传输不受影响 */
+  auto Erase(const std::string &path) -> bool;
+
+  auto Size() const -> size_t;
+
+  auto GetCapacity() const noexcept -> size_t;
+
+ private:
+  struct Shard {
+    std::mutex mtx_;
+    // 链表头是最近使用的
+    std::list<std::pair<std::string, SharedFile>> lru_;
+    std::unordered_map<std::string, std::list<std::pair<std::string, SharedFile>>::iterator> mapping_;
+  };
+
+  auto GetShard(const std::string &path) -> Shard &;
+
+  const size_t shard_capacity_;
+  mutable std::array<Shard, FD_CACHE_SHARD_COUNT> shards_;
+};
+
+}  // namespace Next
+
+#endif  // !NEXT_FD_CACHE_H
@@ -8,6 +8,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include "core/timer.h"
 #include "core/utils.h"
@@ -18,6 +19,9 @@ static constexpr int TIMEOUT = 3000;  // ms
 
 static constexpr uint64_t INACTIVE_TIMEOUT = 3000;  // 单位ms 一个Connection必须在这个时间内完成
 
+// busy poll时自旋预算的下限，单位us
+static constexpr uint64_t MIN_SPIN_BUDGET = 5;
+
 class Poller;
 
 class ThreadPool;
@@ -30,7 +34,7 @@ class Looper {
  public:
   explicit Looper(uint64_t timer_expiration = 0);
 
-  ~Looper() = default;
+  ~Looper();
 
   NON_COPYABLE(Looper);
 
@@ -42,20 +46,87 @@ class Looper {
 
   auto RefreshConnection(int fd) noexcept -> bool;
 
+  /* 连接在本轮事件处理完之后才销毁，同一轮中它不会再被回调，回调中删除其他连接也是安全的 */
   auto DeleteConnection(int fd) noexcept -> bool;
 
+  /**
+   * 监听连接以外的fd(例如cgi程序的管道、pidfd)，就绪时在本looper线程上调用watcher的回调
+   * watcher没有超时定时器，由looper持有直到RemoveWatcher
+   */
+  void AddWatcher(std::unique_ptr<Connection> watcher);
+
+  /* 停止监听并销毁watcher(关闭它的fd)，和DeleteConnection一样推迟到本轮事件处理完，可在watcher自己的回调中调用 */
+  auto RemoveWatcher(int fd) noexcept -> bool;
+
+  /* 将task交给本looper所在线程执行，可在任意线程调用 */
+  void RunInLoop(std::function<void()> task);
+
+  /* 设置执行阻塞任务的线程池，未设置时阻塞任务在调用线程直接执行 */
+  void SetOffloadPool(ThreadPool *offload_pool) noexcept;
+
+  /**
+   * 把阻塞的job交给offload线程池执行，完成后在本looper线程上回调on_complete
+   * job执行期间连接保持存活，它的定时器被挂起，期间到达的事件推迟到on_complete之后再处理
+   * job在其他线程运行，不应访问该Connection
+   */
+  void Offload(int fd, std::function<void()> job, std::function<void(Connection *)> on_complete);
+
+  auto IsOffloaded(int fd) noexcept -> bool;
+
+  /**
+   * 开启busy poll模式，处理完事件后以0超时的Poll自旋至多max_spin_us微秒再阻塞，max_spin_us为0时关闭
+   * 自旋期间有新事件到达则预算翻倍(不超过max_spin_us)，空转到期则预算减半，以CPU换取更低的唤醒延迟
+   */
+  void SetBusyPoll(uint64_t max_spin_us) noexcept;
+
+  /* 累计的自旋时间，单位ns */
+  auto GetSpinTime() const noexcept -> uint64_t;
+
+  /* 自旋期间捕获到事件的次数 */
+  auto GetSpinHits() const noexcept -> uint64_t;
+
+  /* 当前的自旋预算，单位us */
+  auto GetSpinBudget() const noexcept -> uint64_t;
+
+  /* 当前这批就绪事件从Poll返回的时刻(NowSinceEpoch2)，事件回调中据此计算请求在reactor上等待的时间 */
+  auto GetEventTime() const noexcept -> uint64_t;
+
   void Exit() noexcept;
 
  private:
+  void AddTimer(int fd);
+  void SuspendTimer(int fd);
+  void CompleteOffload(int fd, const std::function<void(Connection *)> &on_complete);
+  void HandleWakeup();
+  void RunPendingTasks();
+  void Dispatch(const std::vector<Connection *> &ready_connections);
+  auto IsRetired(Connection *conn) noexcept -> bool;
+  void ReleaseRetired();
+  void BusyPoll();
+
   std::unique_ptr<Poller> poller_;
   std::mutex mtx_;
+  // 连接析构时可能移除watcher，watcher要比connections_后销毁
+  std::map<int, std::unique_ptr<Connection>> watchers_;
+  // 已删除但还在本轮事件处理中的连接和watcher
+  std::vector<std::unique_ptr<Connection>> retired_;
   std::map<int, std::unique_ptr<Connection>> connections_;
   std::map<int, Timer::SingleTimer *> timers_mapping_;
   Timer timer_{};
+  std::unique_ptr<Connection> wakeup_conn_;
+  std::mutex task_mtx_;
+  std::vector<std::function<void()>> pending_tasks_;
+  ThreadPool *offload_pool_{nullptr};
+  std::atomic<uint64_t> max_spin_budget_{0};
+  std::atomic<uint64_t> spin_budget_{0};
+  std::atomic<uint64_t> spin_time_{0};
+  std::atomic<uint64_t> spin_hits_{0};
+  // 只在looper线程上读写
+  uint64_t event_time_{0};
   bool exit_{false};
   bool use_timer_{false};
   uint64_t timer_expiration_{0};
 };
 
 }  // namespace Next
-#endif
\ No newline at end of file
+#endif
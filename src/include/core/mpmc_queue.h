@@ -0,0 +1,138 @@
+#ifndef NEXT_MPMC_QUEUE_H
+#define NEXT_MPMC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "core/utils.h"
+
+namespace Next {
+
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * 有界无锁多生产者多消费者队列 (Dmitry Vyukov的环形缓冲区算法)
+ * 每个槽位带一个序号，生产者/消费者只需要在各自的位置计数上做一次CAS，
+ * 序号告诉它槽位是否已被写入/读出，因此不需要任何锁
+ * 容量向上取整为2的幂
+ */
+template <typename T>
+class MpmcQueue {
+ public:
+  explicit MpmcQueue(size_t capacity);
+
+  ~MpmcQueue() = default;
+
+  NON_MOVE_AND_COPYABLE(MpmcQueue);
+
+  /* 队列满时返回false，item保持不变 */
+  auto TryPush(T &&item) -> bool;
+
+  /* 队列空时返回false */
+  auto TryPop(T &item) -> bool;
+
+  /* 近似值，并发修改时仅供参考 */
+  auto SizeApprox() const noexcept -> size_t;
+
+  auto Capacity() const noexcept -> size_t;
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence_;
+    T data_;
+  };
+
+  static auto RoundUpToPowerOfTwo(size_t capacity) noexcept -> size_t;
+
+  const size_t mask_;
+  std::unique_ptr<Cell[]> buffer_;
+  // 生产者和消费者的位置放在不同的cache line，避免伪共享
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos_{0};
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos_{0};
+};
+
+template <typename T>
+MpmcQueue<T>::MpmcQueue(size_t capacity)
+    : mask_(RoundUpToPowerOfTwo(capacity) - 1), buffer_(std::make_unique<Cell[]>(mask_ + 1)) {
+  for (size_t i = 0; i <= mask_; i++) {
+    buffer_[i].sequence_.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+auto MpmcQueue<T>::TryPush(T &&item) -> bool {
+  Cell *cell;
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &buffer_[pos & mask_];
+    size_t seq = cell->sequence_.load(std::memory_order_acquire);
+    auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (dif == 0) {
+      // 槽位空闲，抢占这个位置
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1)) {
+        break;
+      }
+    } else if (dif < 0) {
+      // 槽位还未被消费者读走，队列满
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->data_ = std::move(item);
+  cell->sequence_.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+auto MpmcQueue<T>::TryPop(T &item) -> bool {
+  Cell *cell;
+  size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &buffer_[pos & mask_];
+    size_t seq = cell->sequence_.load(std::memory_order_acquire);
+    auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+    if (dif == 0) {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1)) {
+        break;
+      }
+    } else if (dif < 0) {
+      // 槽位还未被生产者写入，队列空
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  item = std::move(cell->data_);
+  cell->data_ = T();
+  // 序号推进一整圈，让下一轮的生产者可以使用这个槽位
+  cell->sequence_.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+auto MpmcQueue<T>::SizeApprox() const noexcept -> size_t {
+  size_t enqueue = enqueue_pos_.load();
+  size_t dequeue = dequeue_pos_.load();
+  return enqueue > dequeue ? enqueue - dequeue : 0;
+}
+
+template <typename T>
+auto MpmcQueue<T>::Capacity() const noexcept -> size_t {
+  return mask_ + 1;
+}
+
+template <typename T>
+auto MpmcQueue<T>::RoundUpToPowerOfTwo(size_t capacity) noexcept -> size_t {
+  size_t power = 2;
+  while (power < capacity) {
+    power <<= 1;
+  }
+  return power;
+}
+
+}  // namespace Next
+#endif  // !NEXT_MPMC_QUEUE_H
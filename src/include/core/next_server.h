@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <csignal>
 #include <functional>
 #include <memory>
 #include <stdexcept>
@@ -20,15 +21,24 @@
 #define NEXT_SERVER_H_
 
 namespace Next {
+/* number of threads serving blocking jobs offloaded by the reactors */
+static constexpr int DEFAULT_OFFLOAD_CONCURRENCY = 4;
+
 class NextServer {
 public:
   NextServer(NetAddress server_address,
              int concurrency =
-                 static_cast<int>(std::thread::hardware_concurrency()) - 1)
-      : pool_(std::make_unique<ThreadPool>(concurrency)),
+                 static_cast<int>(std::thread::hardware_concurrency()) - 1,
+             int offload_concurrency = DEFAULT_OFFLOAD_CONCURRENCY,
+             SocketOptions socket_options = {})
+      : offload_pool_(std::make_unique<ThreadPool>(offload_concurrency)),
+        pool_(std::make_unique<ThreadPool>(concurrency)),
         listener_(std::make_unique<Looper>()) {
+    // 客户端在响应发完之前关闭连接时，写入只返回EPIPE，不让SIGPIPE终止进程
+    signal(SIGPIPE, SIG_IGN);
     for (size_t i = 0; i < pool_->GetSize(); i++) {
       reactors_.push_back(std::make_unique<Looper>(TIMER_EXPIRATION));
+      reactors_.back()->SetOffloadPool(offload_pool_.get());
     }
     for (auto &reactor : reactors_) {
       pool_->SubmitTask([capture0 = reactor.get()]() { capture0->Loop(); });
@@ -40,7 +50,7 @@ public:
                    std::back_inserter(raw_reactors),
                    [](auto &uni_ptr) { return uni_ptr.get(); });
     acceptor_ = std::make_unique<Acceptor>(listener_.get(), raw_reactors,
-                                           server_address);
+                                           server_address, socket_options);
   }
 
   ~NextServer() = default;
@@ -56,6 +66,14 @@ public:
     return *this;
   }
 
+  /* 让所有reactor进入busy poll模式，适合独占CPU核心、对尾延迟敏感的部署 */
+  auto BusyPoll(uint64_t max_spin_us) -> NextServer & {
+    for (auto &reactor : reactors_) {
+      reactor->SetBusyPoll(max_spin_us);
+    }
+    return *this;
+  }
+
   void Begin() {
     if (!on_handle_set_) {
       throw std::logic_error(
@@ -65,11 +83,15 @@ public:
   }
 
 private:
+  // members are constructed in this order and destroyed in reverse
   bool on_handle_set_{false};
-  std::unique_ptr<Acceptor> acceptor_;
   std::vector<std::unique_ptr<Looper>> reactors_;
+  // declared after reactors_ so that in-flight jobs drain before reactors go
+  std::unique_ptr<ThreadPool> offload_pool_;
   std::unique_ptr<ThreadPool> pool_;
   std::unique_ptr<Looper> listener_;
+  // declared last so that it goes before the loopers it dispatches to
+  std::unique_ptr<Acceptor> acceptor_;
 };
 } // namespace Next
 #endif
\ No newline at end of file
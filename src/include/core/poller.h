@@ -12,6 +12,7 @@ static constexpr int DEFAULT_EVENTS_LISTEND = 1024;
 
 static constexpr unsigned POLL_ADD = EPOLL_CTL_ADD;
 static constexpr unsigned POLL_READ = EPOLLIN;
+static constexpr unsigned POLL_WRITE = EPOLLOUT;
 static constexpr unsigned POLL_ET = EPOLLET;
 
 
@@ -27,6 +28,9 @@ public:
 
     void AddConnection(Connection *conn);
 
+    /* 停止监听conn的fd，fd关闭之前调用，避免dup出去的fd还留在epoll里 */
+    void RemoveConnection(Connection *conn);
+
     auto Poll(int timeout = -1) -> std::vector<Connection *>;
 
     auto GetPollSize() const noexcept -> uint64_t;
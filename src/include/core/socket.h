@@ -10,6 +10,19 @@ class NetAddress;
 
 enum class Protocol;
 
+/**
+ * 可选的socket调优参数，值为0/false时保持内核默认
+ * 监听socket使用defer_accept/fast_open，缓冲区大小和busy_poll对监听socket和accept得到的socket都生效
+ */
+struct SocketOptions {
+  bool tcp_nodelay{false};     // 关闭Nagle算法，仅对accept得到的socket
+  int defer_accept{0};         // TCP_DEFER_ACCEPT 单位s，数据到达后才唤醒accept
+  int fast_open{0};            // TCP_FASTOPEN 的队列长度
+  int send_buffer_size{0};     // SO_SNDBUF 字节
+  int recv_buffer_size{0};     // SO_RCVBUF 字节
+  int busy_poll{0};            // SO_BUSY_POLL 单位us
+};
+
 class Socket {
  public:
   Socket() noexcept = default;
@@ -43,8 +56,43 @@ class Socket {
 
   auto GetAttr() -> int;
 
+  void SetNoDelay(bool on = true);
+
+  auto GetNoDelay() const -> bool;
+
+  void SetDeferAccept(int seconds);
+
+  auto GetDeferAccept() const -> int;
+
+  void SetFastOpen(int queue_length);
+
+  auto GetFastOpen() const -> int;
+
+  // 内核会将设置的值翻倍以容纳管理开销
+  void SetSendBufferSize(int size);
+
+  auto GetSendBufferSize() const -> int;
+
+  void SetRecvBufferSize(int size);
+
+  auto GetRecvBufferSize() const -> int;
+
+  void SetBusyPoll(int usecs);
+
+  auto GetBusyPoll() const -> int;
+
+  // 在Listen之前调用，缓冲区大小需要在listen前设置才能影响窗口缩放
+  // 连接上才用到的选项也在这里设置一次，内核不支持或者权限不足时在启动时就抛出异常
+  void ApplyListenerOptions(const SocketOptions &options);
+
+  // 用于accept得到的socket，设置失败时记录日志并继续，不抛出异常，返回是否全部设置成功
+  auto ApplyConnectionOptions(const SocketOptions &options) -> bool;
+
  private:
   void CreateByProtocol(Protocol protocol);
+  void SetIntOption(int level, int option_name, int value, const char *caller);
+  auto TrySetIntOption(int level, int option_name, int value, const char *caller) -> bool;
+  auto GetIntOption(int level, int option_name, const char *caller) const -> int;
   int fd_{-1};
 };
 
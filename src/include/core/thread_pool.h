@@ -10,13 +10,18 @@
 #include <thread>
 #include <utility>
 #include <vector>
+#include "core/mpmc_queue.h"
 #include "core/utils.h"
 namespace Next {
 static constexpr int MIN_NUM_THREADS_IN_POOL = 2;
+static constexpr size_t DEFAULT_TASK_QUEUE_CAPACITY = 4096;
+// 空闲的worker在park之前自旋尝试取任务的次数，单核机器上自旋只会抢占生产者的时间片，不自旋
+static constexpr int SPIN_BEFORE_PARK = 256;
 
 class ThreadPool {
  public:
-  explicit ThreadPool(int size = std::thread::hardware_concurrency() - 1);
+  explicit ThreadPool(int size = std::thread::hardware_concurrency() - 1,
+                      size_t queue_capacity = DEFAULT_TASK_QUEUE_CAPACITY);
 
   ~ThreadPool();
 
@@ -25,15 +30,30 @@ class ThreadPool {
   template <typename F, typename... Args>
   decltype(auto) SubmitTask(F &&new_task, Args &&...args);
 
+  /* 一次提交一批任务，只唤醒一次空闲的worker */
+  template <typename F>
+  auto SubmitBatch(std::vector<F> new_tasks) -> std::vector<std::future<std::invoke_result_t<F>>>;
+
   void Exit();
 
   auto GetSize() const noexcept -> size_t;
 
  private:
+  void Enqueue(std::function<void()> &&task);
+  auto TryDequeue(std::function<void()> &task) -> bool;
+  auto HasTask() const noexcept -> bool;
+  void WakeUp(bool all);
+  void WorkerLoop();
+
   std::vector<std::thread> threads_;
-  std::queue<std::function<void()>> tasks_;
+  // 无锁的有界任务队列，满时溢出到受mtx_保护的overflow_tasks_
+  MpmcQueue<std::function<void()>> tasks_;
+  std::queue<std::function<void()>> overflow_tasks_;
+  std::atomic<size_t> overflow_size_{0};
   std::mutex mtx_;
   std::condition_variable cv_;
+  std::atomic<int> sleepers_{0};
+  const int spin_limit_;
   std::atomic<bool> exit_{false};
 };
 
@@ -51,12 +71,26 @@ auto ThreadPool::SubmitTask(F &&new_task, Args &&...args) -> decltype(auto) {
       std::bind(std::forward<F>(new_task), std::forward<Args>(args)...));
   auto fut = packaged_new_task->get_future();
 
-  {
-    std::unique_lock<std::mutex> lock(mtx_);
-    tasks_.emplace([packaged_new_task]() { (*packaged_new_task)(); });
-  }
-  cv_.notify_one();
+  Enqueue([packaged_new_task]() { (*packaged_new_task)(); });
+  WakeUp(false);
   return fut;
 }
+
+template <typename F>
+auto ThreadPool::SubmitBatch(std::vector<F> new_tasks) -> std::vector<std::future<std::invoke_result_t<F>>> {
+  using return_type = std::invoke_result_t<F>;
+  if (exit_) {
+    throw std::runtime_error("ThreadPool: SubmitBatch() called while already exit_ being true");
+  }
+  std::vector<std::future<return_type>> futs;
+  futs.reserve(new_tasks.size());
+  for (auto &new_task : new_tasks) {
+    auto packaged_new_task = std::make_shared<std::packaged_task<return_type()>>(std::move(new_task));
+    futs.push_back(packaged_new_task->get_future());
+    Enqueue([packaged_new_task]() { (*packaged_new_task)(); });
+  }
+  WakeUp(futs.size() > 1);
+  return futs;
+}
 }  // namespace Next
-#endif
\ No newline at end of file
+#endif
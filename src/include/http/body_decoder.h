@@ -0,0 +1,80 @@
+#ifndef NEXT_BODY_DECODER_H
+#define NEXT_BODY_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace Next::Http {
+
+/* chunk大小行中的扩展部分和trailer行的最大长度 */
+static constexpr size_t MAX_CHUNK_LINE_SIZE = 4096;
+
+enum class BodyStatus { INCOMPLETE, COMPLETE, ERROR };
+
+/* 请求体数据到达时的回调，参数只在回调期间有效 */
+using BodyCallback = std::function<void(std::string_view)>;
+
+/**
+ * 可恢复的请求体解码器，支持Content-Length和Transfer-Encoding: chunked两种格式
+ * 每次Decode把已到达的请求体数据通过回调交给处理者，调用者随后从读缓冲区中丢弃Consumed()个字节，
+ * 请求体不会在读缓冲区中累积，上传大文件也只占用常数内存
+ */
+class BodyDecoder {
+ public:
+  /* 没有请求体，直接完成 */
+  BodyDecoder() noexcept = default;
+
+  static auto MakeContentLengthDecoder(size_t content_length) noexcept -> BodyDecoder;
+
+  static auto MakeChunkedDecoder() noexcept -> BodyDecoder;
+
+  /**
+   * 从data中继续解码，请求体数据通过on_data交出
+   * 返回COMPLETE时data中在Consumed()之后的字节属于下一个请求
+   */
+  auto Decode(std::string_view data, const BodyCallback &on_data) -> BodyStatus;
+
+  /* 最近一次Decode消费的字节数 */
+  auto Consumed() const noexcept -> size_t;
+
+  /* 已经交给回调的请求体字节数 */
+  auto GetReceived() const noexcept -> size_t;
+
+  auto IsComplete() const noexcept -> bool;
+
+  auto GetError() const noexcept -> const char *;
+
+ private:
+  enum class State {
+    FIXED,
+    CHUNK_SIZE,
+    CHUNK_EXTENSION,
+    CHUNK_SIZE_LF,
+    CHUNK_DATA,
+    CHUNK_DATA_CR,
+    CHUNK_DATA_LF,
+    TRAILER_LINE_START,
+    TRAILER_LINE,
+    TRAILER_LINE_LF,
+    TRAILER_END_LF,
+    DONE
+  };
+
+  auto Fail(const char *reason) noexcept -> BodyStatus;
+
+  State state_{State::DONE};
+  // FIXED和CHUNK_DATA状态下还需要交出的字节数
+  uint64_t remaining_{0};
+  size_t chunk_size_digits_{0};
+  // 当前chunk大小行或trailer行已经读取的字节数
+  size_t line_bytes_{0};
+  size_t consumed_{0};
+  size_t received_{0};
+  const char *error_{nullptr};
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_BODY_DECODER_H
@@ -0,0 +1,69 @@
+#ifndef NEXT_BODY_STREAM_H
+#define NEXT_BODY_STREAM_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace Next {
+class Looper;
+}  // namespace Next
+
+namespace Next::Http {
+
+/* 每次从流式响应体读取的最大字节数，也是HTTP/1.1一个chunk的最大长度 */
+static constexpr size_t STREAM_CHUNK_SIZE = 16 * 1024;
+
+/* 连接上没有发出的数据超过这个值时暂停读取流式响应体，对端收走数据之后再继续 */
+static constexpr size_t STREAM_HIGH_WATERMARK = 64 * 1024;
+
+/**
+ * 一次读取的结果
+ * DATA: 读到了数据(也可能为空，例如生产者暂时没有输出)，之后继续读取
+ * END: 响应体已完整结束，out中可能还有最后一段数据
+ * ERROR: 生产者出错，丢弃out，已经发出的响应被截断，连接或者流被中止
+ * PENDING: 非阻塞的流暂时没有数据，数据到达后流调用Start时给出的回调
+ */
+enum class StreamStatus { DATA, END, ERROR, PENDING };
+
+/**
+ * 长度事先未知、边生成边发送的响应体，HTTP/1.1以chunked编码发送，HTTP/2以DATA帧发送
+ * 默认Read在offload线程上调用，可以阻塞，同一个流的Read不会并发
+ * 非阻塞的流先在连接所在的looper上Start，之后Read在looper线程上调用，不占用offload线程
+ * 连接上积压的数据超过STREAM_HIGH_WATERMARK时不再调用Read，生产者随之阻塞，背压来自socket的发送速度
+ * 连接在响应结束之前关闭时流被销毁，子类在析构函数中释放生产者
+ */
+class BodyStream {
+ public:
+  virtual ~BodyStream() = default;
+
+  /* 读取下一段数据追加到out，最多max_size字节 */
+  virtual auto Read(std::string &out, size_t max_size) -> StreamStatus = 0;
+
+  /* 为true时Read不阻塞，暂时没有数据时返回PENDING */
+  virtual auto IsNonBlocking() const noexcept -> bool { return false; }
+
+  /**
+   * 非阻塞的流在第一次Read之前在looper线程上调用一次，之后有新数据可读时流在该looper上调用on_readable
+   * 启动生产者失败时返回false
+   */
+  virtual auto Start(Looper * /*looper*/, std::function<void()> /*on_readable*/) -> bool { return true; }
+};
+
+/* 由函数逐段生成的响应体，路由处理函数用它输出长度未知的内容 */
+class GeneratorStream : public BodyStream {
+ public:
+  using Generator = std::function<StreamStatus(std::string &out, size_t max_size)>;
+
+  explicit GeneratorStream(Generator generator) : generator_(std::move(generator)) {}
+
+  auto Read(std::string &out, size_t max_size) -> StreamStatus override { return generator_(out, max_size); }
+
+ private:
+  Generator generator_;
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_BODY_STREAM_H
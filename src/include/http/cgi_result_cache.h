@@ -0,0 +1,130 @@
+#ifndef NEXT_CGI_RESULT_CACHE_H
+#define NEXT_CGI_RESULT_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/buffer.h"
+#include "core/cache.h"
+#include "core/utils.h"
+#include "http/body_stream.h"
+
+namespace Next::Http {
+
+static constexpr size_t DEFAULT_CGI_CACHE_CAPACITY = 4 * 1024 * 1024;
+
+/**
+ * 幂等cgi程序的输出缓存，按程序路径和参数列表查找，只缓存通过SetTtl登记过的程序
+ * 条目存放在一个Cache中，和静态文件缓存一样按lru在字节预算内淘汰，另外在各自程序的ttl后过期
+ * 同样的调用同时到达时只有第一个(领头的)运行程序，其余的排队等它的结果，
+ * 领头的调用失败或者被放弃时排队的调用各自重新加入，其中一个成为新的领头者
+ * 所有接口都可以在任意reactor线程上调用
+ */
+class CgiResultCache {
+ public:
+  /* 排队的调用在它的looper上得到结果，领头的调用失败时参数为nullptr */
+  using OnResult = std::function<void(SharedBlock result)>;
+
+  explicit CgiResultCache(size_t capacity = DEFAULT_CGI_CACHE_CAPACITY) noexcept;
+
+  NON_COPYABLE(CgiResultCache);
+
+  /* 登记一个可缓存的程序，ttl_ms为0时取消登记 */
+  void SetTtl(const std::string &program, uint64_t ttl_ms);
+
+  /* 程序的ttl，没有登记时返回0 */
+  auto GetTtl(const std::string &program) -> uint64_t;
+
+  static auto MakeKey(const std::string &program, const std::vector<std::string> &arguments) -> std::string;
+
+  /* 只查询缓存，未命中或者已过期时返回nullptr */
+  auto Lookup(const std::string &key) -> SharedBlock;
+
+  /**
+   * 命中时返回缓存的输出
+   * 未命中且没有同样的调用在运行时返回nullptr并置leader为true，调用者运行程序并在结束后调用Complete
+   * 已有同样的调用在运行时排队并返回nullptr，它结束后在looper上调用on_result
+   */
+  auto Join(const std::string &key, Looper *looper, OnResult on_result, bool &leader) -> SharedBlock;
+
+  /* 领头的调用结束，result不为空时以ttl_ms放入缓存，然后交给所有排队的调用 */
+  void Complete(const std::string &key, SharedBlock result, uint64_t ttl_ms);
+
+  auto GetCapacity() const noexcept -> size_t;
+
+  auto GetOccupancy() noexcept -> size_t;
+
+  /* 因为同样的调用正在运行而排队的次数 */
+  auto GetCoalescedCount() const noexcept -> uint64_t;
+
+ private:
+  struct Waiter {
+    Looper *looper_;
+    OnResult on_result_;
+  };
+
+  std::mutex mtx_;
+  // 所有访问都持有mtx_
+  Cache cache_;
+  std::unordered_map<std::string, uint64_t> ttls_;
+  // 正在运行的调用和排队等待它的调用
+  std::unordered_map<std::string, std::vector<Waiter>> flights_;
+  std::atomic<uint64_t> coalesced_{0};
+};
+
+/**
+ * 可缓存的cgi调用的响应体，在looper上非阻塞读取
+ * 领头时由factory创建实际运行程序的流(CgiStream或者CgiWorkerStream)，读出的输出同时攒下，结束后放入缓存
+ * 排队时等领头的调用结束后直接读取它的结果
+ */
+class CgiCachedStream : public BodyStream {
+ public:
+  using StreamFactory = std::function<std::shared_ptr<BodyStream>()>;
+
+  CgiCachedStream(std::shared_ptr<CgiResultCache> cache, std::string key, uint64_t ttl_ms,
+                  StreamFactory factory) noexcept;
+  ~CgiCachedStream() override;
+
+  NON_COPYABLE(CgiCachedStream);
+
+  auto Read(std::string &out, size_t max_size) -> StreamStatus override;
+
+  auto IsNonBlocking() const noexcept -> bool override { return true; }
+
+  auto Start(Looper *looper, std::function<void()> on_readable) -> bool override;
+
+ private:
+  /* 加入同样的调用，成为领头者时启动程序 */
+  auto Join() -> bool;
+  /* 结束领头，交出结果 */
+  void Complete(SharedBlock result);
+
+  std::shared_ptr<CgiResultCache> cache_;
+  const std::string key_;
+  const uint64_t ttl_ms_;
+  StreamFactory factory_;
+  Looper *looper_{nullptr};
+  std::function<void()> on_readable_;
+  // 领头时实际运行程序的流
+  std::shared_ptr<BodyStream> inner_;
+  bool leading_{false};
+  // 领头时已读出的输出，超过缓存容量时放弃缓存
+  std::string output_;
+  // 缓存命中或者排队得到的结果
+  SharedBlock result_;
+  size_t result_offset_{0};
+  bool failed_{false};
+  // 排队中的回调据此判断流是否已被销毁，只在looper线程上访问
+  std::shared_ptr<bool> alive_;
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_CGI_RESULT_CACHE_H
@@ -0,0 +1,160 @@
+#ifndef NEXT_CGI_WORKER_POOL_H
+#define NEXT_CGI_WORKER_POOL_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core/utils.h"
+#include "http/body_stream.h"
+
+namespace Next::Http {
+
+/**
+ * worker协议的帧类型，与http_dir/cgi-bin/next_cgi.h一致
+ * 帧头是类型(1字节)、保留(3字节)、负载长度(4字节，网络字节序)
+ * ARGS: 一个请求，负载是以'\0'结尾的各个参数
+ * STDOUT: 一段输出
+ * END: 请求结束，负载是程序的返回值
+ */
+enum class CgiFrameType : uint8_t { ARGS = 1, STDOUT = 2, END = 3 };
+
+static constexpr size_t CGI_FRAME_HEADER_SIZE = 8;
+
+/* 超过这个长度的帧被当作协议错误 */
+static constexpr uint32_t CGI_MAX_FRAME_SIZE = 1024 * 1024;
+
+static constexpr size_t DEFAULT_CGI_WORKERS = 4;
+
+/* 所有worker都在忙时最多排队的请求数 */
+static constexpr size_t DEFAULT_CGI_QUEUE_SIZE = 256;
+
+/* 启动worker时设置的环境变量，cgi程序据此以worker方式运行 */
+static constexpr char CGI_WORKER_ENV[] = {"NEXT_CGI_WORKER=1"};
+
+/* 追加一个帧到out */
+void AppendCgiFrame(CgiFrameType type, std::string_view payload, std::string &out);
+
+/**
+ * 一个支持worker协议的cgi程序的常驻进程池，预先启动size个worker，请求复用它们而不是每次fork和exec
+ * worker的fd 0是连到服务器的unix socket，一次只处理一个请求，所有worker都在忙时请求排队，
+ * 某个worker空出来后在请求所在的looper上交给它
+ * 健康检查: 空闲的worker不应有任何输出，取用前发现它可读或者挂断说明它已退出，立即重启；
+ * 处理请求时崩溃或者响应没读完就被放弃的worker也会被杀死并重启
+ * 所有接口都可以在任意reactor线程上调用
+ */
+class CgiWorkerPool {
+ public:
+  struct Worker {
+    pid_t pid_{-1};
+    int fd_{-1};
+    bool busy_{false};
+  };
+
+  /* 排队的请求取得worker时在它的looper上回调，无法启动worker时参数为nullptr */
+  using OnAcquired = std::function<void(Worker *worker)>;
+
+  explicit CgiWorkerPool(std::string program, size_t size = DEFAULT_CGI_WORKERS,
+                         size_t max_queue = DEFAULT_CGI_QUEUE_SIZE);
+
+  ~CgiWorkerPool();
+
+  NON_COPYABLE(CgiWorkerPool);
+
+  /**
+   * 取得一个空闲的worker，都在忙时排队并返回nullptr，之后在looper上调用on_acquired
+   * 队列已满或者worker无法启动时返回nullptr、不排队并置rejected为true
+   */
+  auto Acquire(Looper *looper, OnAcquired on_acquired, bool &rejected) -> Worker *;
+
+  /* 归还worker，healthy为false时(崩溃、协议错误或者响应没读完)杀死并重启它 */
+  void Release(Worker *worker, bool healthy);
+
+  /* 排队已满，新的请求应当改用普通的fork方式 */
+  auto IsSaturated() noexcept -> bool;
+
+  auto GetProgram() const noexcept -> const std::string &;
+
+  auto GetSize() const noexcept -> size_t;
+
+  auto GetIdleCount() noexcept -> size_t;
+
+  auto GetQueueLength() noexcept -> size_t;
+
+  /* worker被重启的次数 */
+  auto GetRestartCount() const noexcept -> uint64_t;
+
+ private:
+  struct Waiter {
+    Looper *looper_;
+    OnAcquired on_acquired_;
+  };
+
+  /* 调用者需持有mtx_ */
+  auto StartWorker(Worker &worker) -> bool;
+  void StopWorker(Worker &worker);
+  auto RestartWorker(Worker &worker) -> bool;
+  static auto IsHealthy(const Worker &worker) -> bool;
+
+  const std::string program_;
+  const size_t max_queue_;
+  std::mutex mtx_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::deque<Waiter> waiters_;
+  std::atomic<uint64_t> restarts_{0};
+};
+
+/**
+ * 由常驻worker生成的cgi响应体，和CgiStream一样在looper上非阻塞读取
+ * Start时取得worker并发出请求，worker的socket注册到looper，解析出的STDOUT帧作为响应体，END帧结束响应并归还worker
+ * 没有读完就被销毁时worker处于请求中途，不能再用，由池重启
+ */
+class CgiWorkerStream : public BodyStream {
+ public:
+  CgiWorkerStream(std::shared_ptr<CgiWorkerPool> pool, std::vector<std::string> arguments) noexcept;
+  ~CgiWorkerStream() override;
+
+  NON_COPYABLE(CgiWorkerStream);
+
+  auto Read(std::string &out, size_t max_size) -> StreamStatus override;
+
+  auto IsNonBlocking() const noexcept -> bool override { return true; }
+
+  auto Start(Looper *looper, std::function<void()> on_readable) -> bool override;
+
+ private:
+  /* 发出请求并监听worker的socket */
+  auto Begin(CgiWorkerPool::Worker *worker) -> bool;
+  /* 停止监听并归还worker */
+  void Finish(bool healthy);
+
+  std::shared_ptr<CgiWorkerPool> pool_;
+  std::vector<std::string> arguments_;
+  Looper *looper_{nullptr};
+  std::function<void()> on_readable_;
+  CgiWorkerPool::Worker *worker_{nullptr};
+  // 注册到looper的是worker fd的dup，移除watcher时只关闭它
+  int watch_fd_{-1};
+  // 收到但还没有解析的数据
+  std::string input_;
+  size_t input_offset_{0};
+  // 正在读取的STDOUT帧还没有读出的负载
+  size_t stdout_remaining_{0};
+  bool ended_{false};
+  bool failed_{false};
+  // 排队中的回调据此判断流是否已被销毁，只在looper线程上访问
+  std::shared_ptr<bool> alive_;
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_CGI_WORKER_POOL_H
@@ -1,11 +1,25 @@
 #ifndef NEXT_CGIER_H
 #define NEXT_CGIER_H
 
+#include <sys/types.h>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "core/utils.h"
+#include "http/body_stream.h"
+
 namespace Next::Http {
 
+/**
+ * 用posix_spawn启动program，不复制服务器进程的页表，启动耗时不随服务器内存增长
+ * stdin_fd不为-1时接到子进程的标准输入，stdout_fd为-1时子进程的标准输出丢弃到/dev/null
+ * 子进程的SIGPIPE恢复默认处理，信号掩码清空，返回子进程的pid，失败(包括execve失败)时返回-1
+ */
+auto SpawnProcess(const char *program, char *const argv[], char *const envp[],
+                  int stdin_fd, int stdout_fd) -> pid_t;
+
 class Cgier {
 public:
   explicit Cgier(const std::string &path,
@@ -13,12 +27,20 @@ public:
   ~Cgier() = default;
   auto IsValid() const noexcept -> bool;
   auto GetPath() const noexcept -> std::string;
+  auto GetArguments() const noexcept -> const std::vector<std::string> &;
 
   static auto ParseCgier(const std::string &resource_url) noexcept -> Cgier;
   static auto MakeInvalidCgier() noexcept -> Cgier;
 
+  /* 运行cgi程序并阻塞等待，通过管道取回它的全部输出 */
   auto Run() -> std::vector<unsigned char>;
 
+  /**
+   * 启动cgi程序，它的标准输出接到一个管道
+   * 返回子进程的pid并通过read_fd交出管道的读端，失败时返回-1
+   */
+  auto Spawn(int &read_fd) -> pid_t;
+
 private:
   auto BuildArgumentList() -> char **;
   void FreeArgumentList(char **arg_list);
@@ -27,6 +49,39 @@ private:
   bool valid_{true};
 };
 
+/**
+ * cgi程序的标准输出作为流式响应体，输出一段就发送一段，不等程序结束，也不在内存中攒下全部结果
+ * 在looper上Start时启动子进程，非阻塞的管道读端注册到looper，有输出时回调，
+ * 子进程由looper通过pidfd在退出时回收，运行中的cgi程序不占用任何线程
+ * 没有Start时第一次Read才启动子进程，之后每次Read从管道阻塞读取一段，管道读完后回收子进程
+ * 没有读完就被销毁时(例如客户端断开)杀死子进程
+ */
+class CgiStream : public BodyStream {
+public:
+  explicit CgiStream(Cgier cgier) noexcept;
+  ~CgiStream() override;
+
+  NON_COPYABLE(CgiStream);
+
+  auto Read(std::string &out, size_t max_size) -> StreamStatus override;
+
+  auto IsNonBlocking() const noexcept -> bool override { return true; }
+
+  auto Start(Looper *looper, std::function<void()> on_readable)
+      -> bool override;
+
+private:
+  /* 管道读完或者流被销毁时关闭读端，注册在looper上时由looper关闭 */
+  void CloseOutput();
+
+  Cgier cgier_;
+  Looper *looper_{nullptr};
+  pid_t pid_{-1};
+  int read_fd_{-1};
+  // looper通过pidfd回收子进程后置为true，为空时由本对象waitpid回收
+  std::shared_ptr<bool> exited_;
+};
+
 } // namespace Next::Http
 
 #endif
\ No newline at end of file
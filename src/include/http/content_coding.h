@@ -0,0 +1,50 @@
+#ifndef NEXT_CONTENT_CODING_H
+#define NEXT_CONTENT_CODING_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Next::Http {
+
+/* 小于这个大小的文件压缩后省下的字节不值得多一次往返的开销 */
+static constexpr size_t MIN_COMPRESS_SIZE = 256;
+
+/* 即时压缩的文件大小上限，压缩结果要整个放进内容缓存 */
+static constexpr size_t MAX_COMPRESS_SIZE = 8 * 1024 * 1024;
+
+/* zlib的压缩级别，每个资源只压缩一次，之后从缓存发送 */
+static constexpr int COMPRESSION_LEVEL = 6;
+
+/* 预压缩文件的后缀，index.html的预压缩版本是同一目录下的index.html.gz */
+static constexpr char PRECOMPRESSED_GZIP_SUFFIX[] = {".gz"};
+
+/* 响应体的内容编码，DEFLATE按RFC 9110是zlib格式 */
+enum class ContentCoding { IDENTITY, GZIP, DEFLATE };
+
+/**
+ * 按Accept-Encoding选择响应的内容编码，支持q值
+ * gzip和deflate的q值相同时优先gzip，都不可接受或没有这个header时返回IDENTITY
+ */
+auto NegotiateContentCoding(std::string_view accept_encoding) noexcept -> ContentCoding;
+
+/* Content-Encoding中的编码名，例如 "gzip" */
+auto ContentCodingToken(ContentCoding coding) noexcept -> std::string_view;
+
+/* 这个类型和大小的文件是否会被压缩，即它的响应是否随Accept-Encoding变化 */
+auto IsCompressible(std::string_view mime, size_t size) noexcept -> bool;
+
+/* 压缩后的表示需要不同的强ETag，在引号内加上编码名，例如 "\"1a2b-400-0-gzip\"" */
+auto ContentCodingETag(std::string_view etag, ContentCoding coding) -> std::string;
+
+/**
+ * 用zlib把data压缩为coding格式，结果追加到out之后
+ * coding为IDENTITY或zlib出错时返回false
+ */
+auto Compress(const unsigned char *data, size_t size, ContentCoding coding,
+              std::vector<unsigned char> &out) -> bool;
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_CONTENT_CODING_H
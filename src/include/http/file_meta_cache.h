@@ -0,0 +1,115 @@
+#ifndef NEXT_FILE_META_CACHE_H
+#define NEXT_FILE_META_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "core/utils.h"
+#include "http/http_utils.h"
+
+namespace Next::Http {
+
+/* 元数据表默认的最大条目数，达到时淘汰最久没有访问的1/8 */
+static constexpr size_t MAX_FILE_META_ENTRIES = 65536;
+
+/* 一个静态文件的元数据，只缓存存在的文件，大量不存在的url不会占满缓存 */
+struct FileMeta {
+  bool exists_{false};
+  size_t size_{0};
+  time_t mtime_{0};
+  std::string_view mime_;
+  // 强ETag，由inode、大小和纳秒级mtime生成，文件内容替换或修改后都会改变
+  std::array<char, MAX_ETAG_SIZE> etag_{};
+  uint8_t etag_size_{0};
+  // 查询时FileMetaCache的失效代数，见FillIfUnchanged
+  uint64_t generation_{0};
+
+  auto GetETag() const noexcept -> std::string_view { return {etag_.data(), etag_size_}; }
+};
+
+/**
+ * 一个服务目录下静态文件的元数据缓存，以请求的url为key
+ * 存在的文件首次访问时stat一次，之后直接返回缓存的结果，不再有文件系统的元数据系统调用
+ * 条目数达到上限时按最近访问的先后成批淘汰，文件没有变化，不通知失效回调，其他缓存中的内容照常使用
+ * 后台线程用inotify监听服务目录及其所有子目录，文件被修改、创建、删除或移动时使对应条目失效，
+ * 并通过失效回调通知依赖这个文件的其他缓存(文件内容、完整响应)
+ * inotify不可用时退化为每次都stat
+ */
+class FileMetaCache {
+ public:
+  /* 失效回调的参数是文件的完整路径，即服务目录 + url */
+  using InvalidateCallback = std::function<void(const std::string &)>;
+
+  explicit FileMetaCache(std::string serving_dir, size_t max_entries = MAX_FILE_META_ENTRIES);
+
+  ~FileMetaCache();
+
+  NON_MOVE_AND_COPYABLE(FileMetaCache);
+
+  /* 查询url对应文件的元数据，url以 '/' 开头 */
+  auto Lookup(const std::string &url) -> FileMeta;
+
+  /* 注册失效回调，应在开始处理请求之前注册，回调在inotify线程上执行 */
+  void OnInvalidate(InvalidateCallback callback);
+
+  /**
+   * 失效代数仍是generation(来自FileMeta::generation_)时执行fill并返回true
+   * 依据Lookup结果填充其他缓存时使用，fill执行期间不会有失效回调穿插，过期的数据不会被放入缓存
+   */
+  auto FillIfUnchanged(uint64_t generation, const std::function<void()> &fill) -> bool;
+
+  /* 是否在用inotify保持缓存一致，否则Lookup每次都stat */
+  auto IsWatching() const noexcept -> bool;
+
+  /* 去掉结尾 '/' 的服务目录，与url直接拼接得到文件路径，失效回调的参数也是这样拼出的 */
+  auto GetServingDir() const noexcept -> const std::string &;
+
+  auto Size() const -> size_t;
+
+ private:
+  void AddWatchRecursive(const std::string &relative_dir);
+  void WatchLoop();
+  void HandleEvents(const char *events, size_t length);
+  /* 使url及其下的所有条目失效，is_directory时按前缀匹配 */
+  void Invalidate(const std::string &url, bool is_directory);
+  void InvalidateAll();
+  /* 淘汰最久没有访问的一批条目，调用者持有写锁 */
+  void EvictLocked();
+
+  /* 元数据和最近一次访问的序号，序号在读锁下更新 */
+  struct Entry {
+    explicit Entry(const FileMeta &meta, uint64_t last_used) noexcept : meta_(meta), last_used_(last_used) {}
+
+    FileMeta meta_;
+    std::atomic<uint64_t> last_used_;
+  };
+
+  const std::string serving_dir_;
+  const size_t max_entries_;
+  int inotify_fd_{-1};
+  // 用于通知后台线程退出
+  int wakeup_fd_{-1};
+  std::thread watcher_;
+
+  mutable std::shared_mutex mtx_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::atomic<uint64_t> access_tick_{0};
+  // 每次失效加一，stat期间发生过失效时不写入结果，防止写入过期的元数据
+  uint64_t generation_{0};
+  std::vector<InvalidateCallback> callbacks_;
+  // watch描述符到相对服务目录的子目录，构造之后只在inotify线程上访问
+  std::unordered_map<int, std::string> watch_dirs_;
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_FILE_META_CACHE_H
@@ -0,0 +1,122 @@
+#ifndef NEXT_HEADER_TABLE_H
+#define NEXT_HEADER_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Next::Http {
+class Header;
+
+/**
+ * 常用header的编号，解析时把key映射到编号，之后按编号比较而不再比较字符串
+ * 序列化时按编号顺序输出，所以响应常用的header排在前面
+ */
+enum class HeaderId : uint8_t {
+  SERVER,
+  DATE,
+  CONNECTION,
+  CONTENT_LENGTH,
+  CONTENT_TYPE,
+  CONTENT_ENCODING,
+  TRANSFER_ENCODING,
+  CACHE_CONTROL,
+  ETAG,
+  LAST_MODIFIED,
+  ACCEPT_RANGES,
+  CONTENT_RANGE,
+  VARY,
+  HOST,
+  USER_AGENT,
+  ACCEPT,
+  ACCEPT_ENCODING,
+  ACCEPT_LANGUAGE,
+  EXPECT,
+  IF_MODIFIED_SINCE,
+  IF_NONE_MATCH,
+  IF_RANGE,
+  RANGE,
+  KEEP_ALIVE,
+  UPGRADE,
+  HTTP2_SETTINGS,
+  ALLOW,
+  UNKNOWN
+};
+
+static constexpr size_t WELL_KNOWN_HEADER_COUNT = static_cast<size_t>(HeaderId::UNKNOWN);
+
+/* 大小写不敏感地把header名映射为编号，不是常用header时返回UNKNOWN，不分配内存 */
+auto ToHeaderId(std::string_view key) noexcept -> HeaderId;
+
+/* 常用header的规范写法，UNKNOWN返回空 */
+auto HeaderIdToName(HeaderId id) noexcept -> std::string_view;
+
+/**
+ * 扁平的header表
+ * 常用header存放在按编号索引的固定槽位中，其余header存放在一个小的线性表里
+ * key的比较都是大小写不敏感的，同名header再次Add时按 ", " 合并为一个值
+ */
+class HeaderTable {
+ public:
+  HeaderTable() = default;
+
+  /* 追加一个header，已存在时把值合并在后面 */
+  void Add(HeaderId id, std::string_view value);
+  void Add(std::string_view key, std::string_view value);
+
+  /* 设置一个header，已存在时覆盖 */
+  void Set(HeaderId id, std::string value);
+  void Set(std::string_view key, std::string value);
+
+  auto Get(HeaderId id) const noexcept -> std::optional<std::string_view>;
+  auto Get(std::string_view key) const noexcept -> std::optional<std::string_view>;
+
+  auto Has(HeaderId id) const noexcept -> bool;
+  auto Has(std::string_view key) const noexcept -> bool;
+
+  /* 删除一个header，返回是否存在 */
+  auto Erase(HeaderId id) noexcept -> bool;
+
+  auto Size() const noexcept -> size_t;
+
+  void Clear() noexcept;
+
+  /* 按序列化的顺序访问每个header，visitor(std::string_view key, std::string_view value) */
+  template <typename Visitor>
+  void ForEach(Visitor &&visitor) const {
+    for (size_t i = 0; i < WELL_KNOWN_HEADER_COUNT; i++) {
+      if ((present_ & (1U << i)) != 0) {
+        visitor(HeaderIdToName(static_cast<HeaderId>(i)), std::string_view(known_values_[i]));
+      }
+    }
+    for (const auto &[key, value] : others_) {
+      visitor(std::string_view(key), std::string_view(value));
+    }
+  }
+
+  /* 转换为Header列表，兼容旧的接口 */
+  auto ToHeaders() const -> std::vector<Header>;
+
+  /* 把所有header按 "key:value\r\n" 的格式追加到out */
+  void Serialize(std::string &out) const;
+
+ private:
+  auto FindOther(std::string_view key) noexcept -> std::pair<std::string, std::string> *;
+  auto FindOther(std::string_view key) const noexcept -> const std::pair<std::string, std::string> *;
+
+  std::array<std::string, WELL_KNOWN_HEADER_COUNT> known_values_;
+  // 第i位表示编号为i的header是否存在
+  uint32_t present_{0};
+  std::vector<std::pair<std::string, std::string>> others_;
+};
+
+static_assert(WELL_KNOWN_HEADER_COUNT <= 32, "present_ bitmask is too small");
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_HEADER_TABLE_H
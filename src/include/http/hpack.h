@@ -0,0 +1,125 @@
+#ifndef NEXT_HPACK_H
+#define NEXT_HPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Next::Http {
+
+/* 动态表的默认大小，也是SETTINGS_HEADER_TABLE_SIZE的初始值 */
+static constexpr size_t HPACK_DEFAULT_TABLE_SIZE = 4096;
+
+/* 动态表中每个条目在名字和值之外的开销 */
+static constexpr size_t HPACK_ENTRY_OVERHEAD = 32;
+
+/* 一个header块解码后所有header按RFC 7541计算的大小上限，防止很小的块展开成巨大的header列表 */
+static constexpr size_t HPACK_MAX_HEADER_LIST_SIZE = 64 * 1024;
+
+/* 一个解码出的header，名字是小写的 */
+using HeaderField = std::pair<std::string, std::string>;
+
+/* 追加s的Huffman编码到out，最后一个字节用EOS的前缀(全1)填充 */
+void HuffmanEncode(std::string_view s, std::string &out);
+
+/* s按Huffman编码后的字节数 */
+auto HuffmanEncodedLength(std::string_view s) noexcept -> size_t;
+
+/* 解码Huffman编码的字符串追加到out，编码错误、出现EOS或者填充不合法时返回false */
+auto HuffmanDecode(std::string_view s, std::string &out) -> bool;
+
+/**
+ * HPACK的动态表，新条目插入在最前面，总大小超过上限时从最旧的条目开始淘汰
+ * 索引从1开始，1到61是静态表，62开始是动态表
+ */
+class HpackTable {
+ public:
+  explicit HpackTable(size_t max_size = HPACK_DEFAULT_TABLE_SIZE);
+
+  /* 按索引取出条目，索引无效时返回nullptr */
+  auto Get(size_t index) const noexcept -> const HeaderField *;
+
+  /**
+   * 查找header，返回索引，找不到返回0
+   * name_only为true时表示只有名字匹配
+   */
+  auto Find(std::string_view name, std::string_view value, bool &name_only) const noexcept -> size_t;
+
+  /* 插入一个条目，比整个表还大的条目会清空表且不插入 */
+  void Insert(std::string_view name, std::string_view value);
+
+  /* 修改表的大小上限，立即淘汰超出的条目 */
+  void SetMaxSize(size_t max_size);
+
+  auto GetMaxSize() const noexcept -> size_t;
+
+  /* 当前所有条目按RFC 7541计算的大小 */
+  auto GetSize() const noexcept -> size_t;
+
+  auto GetEntryCount() const noexcept -> size_t;
+
+ private:
+  void EvictTo(size_t size);
+
+  std::deque<HeaderField> entries_;
+  size_t size_{0};
+  size_t max_size_;
+};
+
+/**
+ * HPACK解码器，每个HTTP/2连接一个，跨header块保持动态表
+ * 解码失败后动态表的状态不再可信，连接必须以COMPRESSION_ERROR关闭
+ */
+class HpackDecoder {
+ public:
+  /* settings_table_size是我们在SETTINGS中通告的动态表上限，对端的大小更新不能超过它 */
+  explicit HpackDecoder(size_t settings_table_size = HPACK_DEFAULT_TABLE_SIZE);
+
+  /* 解码一个完整的header块，header按顺序追加到headers */
+  auto Decode(std::string_view block, std::vector<HeaderField> &headers) -> bool;
+
+  auto GetTable() const noexcept -> const HpackTable &;
+
+ private:
+  auto DecodeString(std::string_view block, size_t &pos, std::string &out) -> bool;
+
+  HpackTable table_;
+  const size_t settings_table_size_;
+};
+
+/**
+ * HPACK编码器，每个HTTP/2连接一个
+ * 静态表或动态表中完全匹配时只发索引，大多数header以增量索引的方式加入动态表，
+ * 同一连接上后续响应的Server、Content-Type等只需一个字节，每个响应都不同的header不加入动态表
+ */
+class HpackEncoder {
+ public:
+  HpackEncoder() = default;
+
+  /* 对端通过SETTINGS_HEADER_TABLE_SIZE修改了动态表上限，在下一个header块的开头通知对端 */
+  void SetMaxTableSize(size_t max_size);
+
+  /* 开始一个新的header块，必要时先写入动态表大小更新 */
+  void BeginBlock(std::vector<unsigned char> &out);
+
+  /* 编码一个header，name必须是小写的 */
+  void Encode(std::string_view name, std::string_view value, std::vector<unsigned char> &out);
+
+  auto GetTable() const noexcept -> const HpackTable &;
+
+ private:
+  void EncodeString(std::string_view s, std::vector<unsigned char> &out);
+
+  HpackTable table_;
+  // 最近一次块开始之后被修改过的上限，其中的最小值也要通知对端
+  size_t pending_min_size_{SIZE_MAX};
+  bool size_update_pending_{false};
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_HPACK_H
@@ -0,0 +1,218 @@
+#ifndef NEXT_HTTP2_H
+#define NEXT_HTTP2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core/utils.h"
+#include "http/body_decoder.h"
+#include "http/hpack.h"
+#include "http/request.h"
+#include "http/response.h"
+
+namespace Next::Http {
+
+/* 客户端连接前言，prior knowledge和Upgrade之后客户端都会先发送它 */
+static constexpr std::string_view HTTP2_CLIENT_PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+static constexpr size_t HTTP2_FRAME_HEADER_SIZE = 9;
+static constexpr int64_t HTTP2_DEFAULT_WINDOW_SIZE = 65535;
+static constexpr int64_t HTTP2_MAX_WINDOW_SIZE = 0x7fffffff;
+static constexpr uint32_t HTTP2_DEFAULT_MAX_FRAME_SIZE = 16384;
+static constexpr uint32_t HTTP2_MAX_FRAME_SIZE_LIMIT = 16777215;
+
+/* 每个连接允许的并发流数，超过时新的流被REFUSED_STREAM拒绝 */
+static constexpr uint32_t HTTP2_MAX_CONCURRENT_STREAMS = 128;
+
+enum class Http2FrameType : uint8_t {
+  DATA = 0x0,
+  HEADERS = 0x1,
+  PRIORITY = 0x2,
+  RST_STREAM = 0x3,
+  SETTINGS = 0x4,
+  PUSH_PROMISE = 0x5,
+  PING = 0x6,
+  GOAWAY = 0x7,
+  WINDOW_UPDATE = 0x8,
+  CONTINUATION = 0x9
+};
+
+enum class Http2Error : uint32_t {
+  NO_ERROR = 0x0,
+  PROTOCOL_ERROR = 0x1,
+  INTERNAL_ERROR = 0x2,
+  FLOW_CONTROL_ERROR = 0x3,
+  SETTINGS_TIMEOUT = 0x4,
+  STREAM_CLOSED = 0x5,
+  FRAME_SIZE_ERROR = 0x6,
+  REFUSED_STREAM = 0x7,
+  CANCEL = 0x8,
+  COMPRESSION_ERROR = 0x9,
+  ENHANCE_YOUR_CALM = 0xb
+};
+
+/* 连接的前几个字节是否是(或可能是)客户端前言，数据不足24字节时按前缀判断 */
+auto IsHttp2Preface(std::string_view data) noexcept -> bool;
+
+/**
+ * 一个服务端HTTP/2连接的协议状态，不直接读写socket，便于和HTTP/1.1共用Connection
+ * Feed解析收到的帧，请求头完整的请求由NextRequest依次取出，请求体随后由ReadBody逐段读取，
+ * 处理者用Submit提交响应，响应体按对端的流量控制窗口切成DATA帧，多个流的DATA帧轮流发出，
+ * 一个大文件的响应不会阻塞同一连接上的其他请求，窗口用完的部分等对端的WINDOW_UPDATE到达后再发
+ * 要发送的数据由TakeOutput取出交给连接，响应体的片段不拷贝，长度未知的响应体可以分多次提交
+ * 请求体计入流和连接的接收窗口，只有被ReadBody读走后才通过WINDOW_UPDATE归还，
+ * 连接上缓存的请求体总量因此不超过连接的接收窗口，处理者读得慢时对端随之停下
+ */
+class Http2Session {
+ public:
+  Http2Session();
+
+  NON_COPYABLE(Http2Session);
+
+  /* 发送服务端的连接前言(SETTINGS帧)，不必等待客户端前言 */
+  void Start();
+
+  /**
+   * 从HTTP/1.1的Upgrade: h2c请求开始会话，调用者已回复101
+   * http2_settings是HTTP2-Settings header的值(base64url编码的SETTINGS负载)
+   * 升级的请求作为流1，已经半关闭，NextRequest会首先返回它
+   * HTTP2-Settings格式错误时返回false且不取走request，调用者应当把请求当作普通的HTTP/1.1请求
+   */
+  auto StartUpgraded(std::string_view http2_settings, std::unique_ptr<Request> &request) -> bool;
+
+  /* 处理收到的数据，返回消费的字节数，不完整的帧留给下次 */
+  auto Feed(std::string_view data) -> size_t;
+
+  /* 取出下一个请求头已完整的请求，没有时返回false */
+  auto NextRequest(uint32_t &stream_id, std::unique_ptr<Request> &request) -> bool;
+
+  /**
+   * 把流上已收到的请求体交给on_data并归还它占用的接收窗口
+   * 请求体已收齐时返回COMPLETE，流已被重置或者已经关闭时返回ERROR
+   */
+  auto ReadBody(uint32_t stream_id, const BodyCallback &on_data) -> BodyStatus;
+
+  /**
+   * 提交一个流的响应，流已被客户端重置时丢弃
+   * end_stream为false时响应体还没有结束，之后由SubmitData追加
+   * 提交之后不再读取这个流的请求体，还没到达的部分到达后直接丢弃
+   */
+  void Submit(uint32_t stream_id, const Response &response, std::vector<BodySlice> body, bool end_stream = true);
+
+  /* 追加流式响应体的一段，end_stream为true时是最后一段，流已被重置或关闭时返回false */
+  auto SubmitData(uint32_t stream_id, std::vector<BodySlice> body, bool end_stream) -> bool;
+
+  /* 流式响应体的生产者出错时以INTERNAL_ERROR重置流，客户端由此知道响应不完整 */
+  void AbortStream(uint32_t stream_id);
+
+  /* 一个流已提交但因为流量控制窗口还没有发出的响应体字节数 */
+  auto GetPendingSize(uint32_t stream_id) const noexcept -> size_t;
+
+  /* 取出待发送的数据，依次交给连接 */
+  auto TakeOutput() -> std::vector<BodySlice>;
+
+  /* 发生连接错误或者对端GOAWAY后所有流都已完成，发完输出后应关闭连接 */
+  auto ShouldClose() const noexcept -> bool;
+
+  /* 尚未完成的流的个数 */
+  auto GetStreamCount() const noexcept -> size_t;
+
+ private:
+  struct Stream {
+    // 发送窗口，对端减小INITIAL_WINDOW_SIZE时可能为负
+    int64_t send_window_{HTTP2_DEFAULT_WINDOW_SIZE};
+    // 已提交但还没有发出的响应体
+    std::deque<BodySlice> pending_;
+    size_t pending_size_{0};
+    // 流式响应体还没有结束，pending_为空时也不能结束流
+    bool body_open_{false};
+    std::unique_ptr<Request> request_;
+    // 已收到但还没有被ReadBody读走的请求体
+    std::string body_;
+    // 流的接收窗口，以及已读走但还没有通过WINDOW_UPDATE归还的字节数
+    int64_t recv_window_{HTTP2_DEFAULT_WINDOW_SIZE};
+    int64_t recv_released_{0};
+    // 对端已发送END_STREAM
+    bool remote_closed_{false};
+    bool responded_{false};
+  };
+
+  /* 帧头中的信息 */
+  struct FrameHeader {
+    uint32_t length_;
+    Http2FrameType type_;
+    uint8_t flags_;
+    uint32_t stream_id_;
+  };
+
+  auto HandleFrame(const FrameHeader &header, std::string_view payload) -> bool;
+  auto HandleData(const FrameHeader &header, std::string_view payload) -> bool;
+  auto HandleHeaders(const FrameHeader &header, std::string_view payload) -> bool;
+  auto HandleContinuation(const FrameHeader &header, std::string_view payload) -> bool;
+  auto HandleSettings(const FrameHeader &header, std::string_view payload) -> bool;
+  auto HandleWindowUpdate(const FrameHeader &header, std::string_view payload) -> bool;
+  auto ApplySettings(std::string_view payload) -> bool;
+  /* header块接收完整后解码并创建流 */
+  auto EndHeaderBlock() -> bool;
+  /* 由解码出的header构建请求，请求格式错误时返回nullptr */
+  auto MakeRequest(const std::vector<HeaderField> &fields) -> std::unique_ptr<Request>;
+  void RemoteClosed(Stream &stream);
+  /**
+   * 处理者不再需要size个接收的字节，stream为nullptr时只归还连接窗口
+   * 攒够窗口的一半才发出WINDOW_UPDATE，避免每个DATA帧都回复一个
+   */
+  void ReleaseRecvWindow(uint32_t stream_id, Stream *stream, size_t size);
+  /* 响应发完后关闭流，对端还在发送请求体时以NO_ERROR重置，请它不必再发 */
+  auto CloseStream(std::map<uint32_t, Stream>::iterator iter) -> std::map<uint32_t, Stream>::iterator;
+  /* 删除流并归还还没读取的请求体占用的连接窗口 */
+  auto EraseStream(std::map<uint32_t, Stream>::iterator iter) -> std::map<uint32_t, Stream>::iterator;
+  void WriteWindowUpdate(uint32_t stream_id, int64_t increment);
+
+  /* 在窗口允许的范围内轮流发出各个流的DATA帧 */
+  void Flush();
+
+  /* 发送GOAWAY，之后不再处理任何帧，返回false便于直接return */
+  auto ConnectionError(Http2Error error) -> bool;
+  void ResetStream(uint32_t stream_id, Http2Error error);
+
+  void WriteFrameHeader(size_t length, Http2FrameType type, uint8_t flags, uint32_t stream_id);
+  void WriteBytes(const void *data, size_t size);
+  void WriteSlice(BodySlice slice);
+
+  HpackDecoder decoder_;
+  HpackEncoder encoder_;
+  std::map<uint32_t, Stream> streams_;
+  // 已可以交给处理者的流
+  std::deque<uint32_t> ready_;
+  std::vector<BodySlice> output_;
+
+  bool preface_received_{false};
+  bool settings_received_{false};
+  bool goaway_received_{false};
+  bool closed_{false};
+  // 客户端打开过的最大流编号
+  uint32_t last_stream_id_{0};
+
+  // 正在接收的header块，CONTINUATION帧追加在后面
+  std::string header_block_;
+  uint32_t header_stream_id_{0};
+  bool header_end_stream_{false};
+
+  // 对端的设置
+  int64_t initial_window_size_{HTTP2_DEFAULT_WINDOW_SIZE};
+  uint32_t max_frame_size_{HTTP2_DEFAULT_MAX_FRAME_SIZE};
+  int64_t send_window_{HTTP2_DEFAULT_WINDOW_SIZE};
+  // 连接的接收窗口，以及已读走或丢弃但还没有归还的字节数
+  int64_t recv_window_{HTTP2_DEFAULT_WINDOW_SIZE};
+  int64_t recv_released_{0};
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_HTTP2_H
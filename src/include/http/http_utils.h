@@ -1,8 +1,12 @@
 #ifndef NEXT_HTTP_UTILS_H
 #define NEXT_HTTP_UTILS_H
 
+#include "http/perfect_hash.h"
+#include <cstdint>
+#include <ctime>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 namespace Next::Http {
 
@@ -16,7 +20,8 @@ static constexpr char CRLF[] = {"\r\n"};
 static constexpr char COLON[] = {":"};
 static constexpr char DEFAULT_ROUTE[] = {"index.html"};
 static constexpr char CGI_BIN[] = {"cgi-bin"};
-static constexpr char CGI_PREFIX[] = {"cgi_tem"};
+/* 只有这个目录下的url才作为cgi程序执行 */
+static constexpr char CGI_BIN_PREFIX[] = {"/cgi-bin/"};
 
 /* Common Header and Value */
 static constexpr char HEADER_SERVER[] = {"Server"};
@@ -25,6 +30,12 @@ static constexpr char HEADER_CONTENT_LENGTH[] = {"Content-Length"};
 static constexpr char HEADER_CONTENT_TYPE[] = {"Content-Type"};
 static constexpr char CONTENT_LENGTH_ZERO[] = {"0"};
 static constexpr char HEADER_CONNECTION[] = {"Connection"};
+static constexpr char HEADER_ALLOW[] = {"Allow"};
+static constexpr char HEADER_DATE[] = {"Date"};
+static constexpr char HEADER_ACCEPT_ENCODING[] = {"Accept-Encoding"};
+static constexpr char ALLOW_STATIC[] = {"GET, HEAD"};
+static constexpr char TRANSFER_ENCODING_CHUNKED[] = {"chunked"};
+static constexpr char EXPECT_CONTINUE[] = {"100-continue"};
 static constexpr char CONNECTION_CLOSE[] = {"Close"};
 static constexpr char CONNECTION_KEEP_ALIVE[] = {"Keep-Alive"};
 static constexpr char HTTP_VERSION[] = {"HTTP/1.1"};
@@ -39,17 +50,60 @@ static constexpr char MIME_GIF[] = {"image/gif"};
 static constexpr char MIME_OCTET[] = {"application/octet-stream"};
 
 /* Response status */
+static constexpr char RESPONSE_CONTINUE[] = {"100 Continue"};
 static constexpr char RESPONSE_OK[] = {"200 OK"};
+static constexpr char RESPONSE_CREATED[] = {"201 Created"};
+static constexpr char RESPONSE_PARTIAL_CONTENT[] = {"206 Partial Content"};
+static constexpr char RESPONSE_NOT_MODIFIED[] = {"304 Not Modified"};
 static constexpr char RESPONSE_BAD_REQUEST[] = {"400 Bad Request"};
 static constexpr char RESPONSE_NOT_FOUND[] = {"404 Not Found"};
+static constexpr char RESPONSE_METHOD_NOT_ALLOWED[] = {"405 Method Not Allowed"};
+static constexpr char RESPONSE_PAYLOAD_TOO_LARGE[] = {"413 Payload Too Large"};
+static constexpr char RESPONSE_RANGE_NOT_SATISFIABLE[] = {"416 Range Not Satisfiable"};
+static constexpr char RESPONSE_NOT_IMPLEMENTED[] = {"501 Not Implemented"};
 static constexpr char RESPONSE_SERVICE_UNAVAILABLE[] = {
     "503 Service Unavailable"};
 
-/* HTTP Method enum, only support GET/HEAD method now */
-enum class Method { GET, HEAD, UNSUPPORTED };
+/* 对Expect: 100-continue的临时响应，没有其他header */
+static constexpr char CONTINUE_RESPONSE[] = {"HTTP/1.1 100 Continue\r\n\r\n"};
 
-/* HTTP version enum, only support HTTP 1.1 now */
-enum class Version { HTTP_1_1, UNSUPPORTED };
+/* 接受Upgrade: h2c后的临时响应，之后连接上是HTTP/2的帧 */
+static constexpr char SWITCHING_PROTOCOLS_H2C_RESPONSE[] = {
+    "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n"};
+
+/* 由inode、大小和纳秒级mtime生成的强ETag的最大长度，包括引号 */
+static constexpr size_t MAX_ETAG_SIZE = 3 * 16 + 4;
+
+/* 静态文件支持的Range单位 */
+static constexpr char ACCEPT_RANGES_BYTES[] = {"bytes"};
+
+/* 一个Range请求最多包含的区间数，更多时忽略Range回复整个文件 */
+static constexpr size_t MAX_RANGE_COUNT = 16;
+
+/* IMF-fixdate格式的http日期长度，例如 "Sun, 06 Nov 1994 08:49:37 GMT" */
+static constexpr size_t HTTP_DATE_SIZE = 29;
+
+/* 闭区间[first_, last_]的字节范围 */
+struct ByteRange {
+  size_t first_;
+  size_t last_;
+
+  auto Length() const noexcept -> size_t { return last_ - first_ + 1; }
+};
+
+/**
+ * Range header的解析结果
+ * NONE: 没有Range或者格式不能识别，按RFC 9110忽略它，回复整个文件
+ * SATISFIABLE: 至少一个区间落在文件内，回复206
+ * UNSATISFIABLE: 所有区间都在文件之外，回复416
+ */
+enum class RangeStatus { NONE, SATISFIABLE, UNSATISFIABLE };
+
+/* HTTP Method enum, POST/PUT carry a request body */
+enum class Method { GET, HEAD, POST, PUT, UNSUPPORTED };
+
+/* HTTP version enum, HTTP/2 requests come from frames rather than a request line */
+enum class Version { HTTP_1_1, HTTP_2, UNSUPPORTED };
 
 /* Content Extension enum */
 enum class Extension { HTML, CSS, PNG, JPG, JPEG, GIF, OCTET, UNSUPPORTED };
@@ -57,10 +111,14 @@ enum class Extension { HTML, CSS, PNG, JPG, JPEG, GIF, OCTET, UNSUPPORTED };
 static const std::map<Method, std::string> METHOD_TO_STRING = {
     {Method::GET, "GET"},
     {Method::HEAD, "HEAD"},
+    {Method::POST, "POST"},
+    {Method::PUT, "PUT"},
     {Method::UNSUPPORTED, "UNSUPPORTED"}};
 
 static std::map<Version, std::string> VERSION_TO_STRING = {
-    {Version::HTTP_1_1, "HTTP/1.1"}, {Version::UNSUPPORTED, "UNSUPPORTED"}};
+    {Version::HTTP_1_1, "HTTP/1.1"},
+    {Version::HTTP_2, "HTTP/2"},
+    {Version::UNSUPPORTED, "UNSUPPORTED"}};
 
 static std::map<Extension, std::string> EXTENSION_TO_STRING = {
     {Extension::HTML, "HTML"},   {Extension::CSS, "CSS"},
@@ -68,14 +126,26 @@ static std::map<Extension, std::string> EXTENSION_TO_STRING = {
     {Extension::JPEG, "JPEG"},   {Extension::GIF, "GIF"},
     {Extension::OCTET, "OCTET"}, {Extension::UNSUPPORTED, "UNSUPPORTED"}};
 
-Method ToMethod(const std::string &str);
+/* 以下查找都基于编译期构建的完美哈希表，大小写不敏感且不分配内存 */
+Method ToMethod(std::string_view str) noexcept;
 
-Version ToVersion(const std::string &str);
+Version ToVersion(std::string_view str) noexcept;
 
-Extension ToExtension(const std::string &str);
+Extension ToExtension(std::string_view str) noexcept;
 
 auto ExtensionToMime(const Extension &extension) noexcept -> std::string;
 
+/**
+ * 按文件扩展名(不含'.')查找MIME类型，未知的扩展名返回application/octet-stream
+ */
+auto ExtensionToMime(std::string_view extension) noexcept -> std::string_view;
+
+/**
+ * 按文件路径的扩展名查找MIME类型
+ * 结果按路径缓存在当前线程中，同一个文件再次请求时不再解析扩展名
+ */
+auto FileToMime(const std::string &file_path) -> std::string_view;
+
 /**
  * 将一个字符串分割成许多子字符串，按指定分隔符分割
  */
@@ -104,6 +174,41 @@ auto ToUpper(std::string str) noexcept -> std::string;
  */
 auto Format(const std::string &) noexcept -> std::string;
 
+/**
+ * 去掉前后的空格和制表符，返回原字符串的一个视图
+ */
+auto TrimView(std::string_view str) noexcept -> std::string_view;
+
+/**
+ * 把UTC时间格式化为http日期(IMF-fixdate)，out至少有HTTP_DATE_SIZE个字节，返回写入的长度
+ */
+auto FormatHttpDate(time_t time, char *out) noexcept -> size_t;
+
+/**
+ * 当前时间的http日期，每个线程(即每个reactor)各自缓存，每秒最多格式化一次
+ * 返回的视图在同一线程下次调用前有效
+ */
+auto CachedHttpDate() noexcept -> std::string_view;
+
+/**
+ * 解析IMF-fixdate格式的http日期，例如If-Modified-Since的值，格式不对时返回false
+ * 已过时的RFC 850和asctime格式不支持，调用者应当忽略这样的header
+ */
+auto ParseHttpDate(std::string_view date, time_t &time) noexcept -> bool;
+
+/* 生成强ETag，例如 "\"1a2b-400-17f0c3d2e1a0b000\""，out至少有MAX_ETAG_SIZE个字节，返回写入的长度 */
+auto FormatETag(uint64_t inode, uint64_t size, uint64_t mtime_ns, char *out) noexcept -> size_t;
+
+/* If-None-Match的值是否匹配etag，"*" 匹配任何存在的文件，按弱比较忽略 "W/" 前缀 */
+auto MatchesAnyETag(std::string_view if_none_match, std::string_view etag) noexcept -> bool;
+
+/**
+ * 按文件大小解析Range header的值，例如 "bytes=0-99,200-,-50"
+ * 超出文件的区间被丢弃，末尾超出文件的区间被截断到文件末尾，可满足的区间按请求的顺序放入ranges
+ */
+auto ParseRange(std::string_view value, size_t file_size,
+                std::vector<ByteRange> &ranges) noexcept -> RangeStatus;
+
 // 文件系统函数
 /**
  * 检查指定目录是否存在
@@ -137,6 +242,20 @@ auto CheckFileSize(const std::string &file_path) noexcept -> size_t;
  */
 void LoadFile(const std::string &file_path,
               std::vector<unsigned char> &buffer) noexcept;
+
+/**
+ * Same as above, but trust the file size already known by the caller instead of
+ * checking it again. Read at most file_size bytes, less if the file shrank
+ */
+void LoadFile(const std::string &file_path, std::vector<unsigned char> &buffer,
+              size_t file_size) noexcept;
+
+/**
+ * Load file_size bytes from the start of an already opened file with pread,
+ * the file offset is untouched so the fd can be shared between threads
+ */
+void LoadFile(int fd, std::vector<unsigned char> &buffer,
+              size_t file_size) noexcept;
 } // namespace Next::Http
 
 #endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef NEXT_PERFECT_HASH_H
+#define NEXT_PERFECT_HASH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace Next::Http {
+
+/* ASCII字母转小写，其余字符不变 */
+constexpr auto ToLowerAscii(char c) noexcept -> char {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+/**
+ * 大小写不敏感地比较两个字符串，不分配内存
+ */
+constexpr auto EqualsIgnoreCase(std::string_view lhs, std::string_view rhs) noexcept -> bool {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.size(); i++) {
+    if (ToLowerAscii(lhs[i]) != ToLowerAscii(rhs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* 大小写不敏感的带种子FNV-1a哈希 */
+constexpr auto CaseInsensitiveHash(std::string_view str, uint32_t seed) noexcept -> uint32_t {
+  uint32_t hash = 2166136261U ^ (seed * 0x9E3779B9U);
+  for (char c : str) {
+    hash ^= static_cast<unsigned char>(ToLowerAscii(c));
+    hash *= 16777619U;
+  }
+  return hash ^ (hash >> 15);
+}
+
+/* 完美哈希表的一项 */
+template <typename Value>
+struct PerfectHashEntry {
+  std::string_view key_;
+  Value value_;
+};
+
+/**
+ * 编译期构建的完美哈希表，键为大小写不敏感的字符串
+ * 构造时搜索一个种子使得所有键落在不同的槽位，查找只需要一次哈希和一次比较
+ * 找不到合适的种子(比如有重复的键)时抛出异常，在常量表达式中即为编译错误
+ * SLOTS必须是2的幂，且应明显大于键的个数
+ */
+template <typename Value, size_t N, size_t SLOTS>
+class PerfectHashMap {
+  static_assert(N > 0 && N < 0xFF, "PerfectHashMap holds 1 to 254 entries");
+  static_assert((SLOTS & (SLOTS - 1)) == 0 && SLOTS >= N, "SLOTS must be a power of 2 no less than N");
+
+ public:
+  using Entry = PerfectHashEntry<Value>;
+
+  constexpr explicit PerfectHashMap(const Entry (&entries)[N]) {
+    for (size_t i = 0; i < N; i++) {
+      entries_[i] = entries[i];
+    }
+    for (uint32_t seed = 0; seed < MAX_SEED; seed++) {
+      if (TryPlace(seed)) {
+        seed_ = seed;
+        return;
+      }
+    }
+    throw std::logic_error("PerfectHashMap: fail to find a collision free seed");
+  }
+
+  /* 查找key，不存在时返回nullptr */
+  constexpr auto Find(std::string_view key) const noexcept -> const Value * {
+    auto index = slots_[CaseInsensitiveHash(key, seed_) & (SLOTS - 1)];
+    if (index == EMPTY_SLOT || !EqualsIgnoreCase(entries_[index].key_, key)) {
+      return nullptr;
+    }
+    return &entries_[index].value_;
+  }
+
+  constexpr auto Size() const noexcept -> size_t { return N; }
+
+  constexpr auto GetSeed() const noexcept -> uint32_t { return seed_; }
+
+ private:
+  static constexpr uint8_t EMPTY_SLOT = 0xFF;
+  static constexpr uint32_t MAX_SEED = 4096;
+
+  constexpr auto TryPlace(uint32_t seed) -> bool {
+    for (auto &slot : slots_) {
+      slot = EMPTY_SLOT;
+    }
+    for (size_t i = 0; i < N; i++) {
+      auto &slot = slots_[CaseInsensitiveHash(entries_[i].key_, seed) & (SLOTS - 1)];
+      if (slot != EMPTY_SLOT) {
+        return false;
+      }
+      slot = static_cast<uint8_t>(i);
+    }
+    return true;
+  }
+
+  std::array<Entry, N> entries_{};
+  std::array<uint8_t, SLOTS> slots_{};
+  uint32_t seed_{0};
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_PERFECT_HASH_H
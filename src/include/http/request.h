@@ -2,38 +2,76 @@
 #define NEXT_REQUEST_H
 
 #include "core/utils.h"
+#include "http/body_decoder.h"
 #include "http/header.h"
+#include "http/header_table.h"
+#include "http/http_utils.h"
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 namespace Next::Http {
 class Header;
+class RequestParser;
 enum class Method;
 enum class Version;
 
 /**
- * 仅限 GET/HEAD请求，HTTP
+ * 支持 GET/HEAD/POST/PUT请求，HTTP
  * 请求类包含必要的请求行功能，包括方法、http 版本、资源 url，并且由于我们支持
  * http 1.1，它还关心客户端连接是否应保持活动状态
+ * 请求体不保存在Request中，由MakeBodyDecoder得到的解码器在数据到达时流式交给处理者
  */
 class Request {
 public:
   Request(Method method, std::string resource_url, Version version,
           const std::vector<Header> &heads) noexcept;
   explicit Request(const std::string &request_str) noexcept;
+  /* 从解析完成(COMPLETE)的RequestParser构建，不再重新切分请求头 */
+  explicit Request(const RequestParser &parser) noexcept;
+  /**
+   * 从HTTP/2的:method、:path以及普通header构建，:authority应已作为Host放入headers
+   * HTTP/2的连接不会因为单个请求而关闭，ShouldClose总是false
+   */
+  Request(std::string_view method, std::string_view path,
+          const std::vector<std::pair<std::string, std::string>> &headers) noexcept;
   NON_COPYABLE(Request);
   auto IsValid() const noexcept -> bool;
   auto ShouldClose() const noexcept -> bool;
   auto GetInvalidReason() const noexcept -> std::string;
   auto GetMethod() const noexcept -> Method;
   auto GetVersion() const noexcept -> Version;
-  auto GetResourceUrl() const noexcept -> std::string;
+  auto GetResourceUrl() const noexcept -> const std::string &;
   auto GetHeaders() const noexcept -> std::vector<Header>;
+  /* 按编号查找常用header，不分配内存 */
+  auto GetHeader(HeaderId id) const noexcept -> std::optional<std::string_view>;
+  auto GetHeaderTable() const noexcept -> const HeaderTable &;
+  /* 请求是否带有请求体(Content-Length大于0或者chunked编码) */
+  auto HasBody() const noexcept -> bool;
+  auto IsChunked() const noexcept -> bool;
+  auto GetContentLength() const noexcept -> size_t;
+  /* 客户端是否在发送请求体前等待100 Continue */
+  auto ExpectContinue() const noexcept -> bool;
+  /**
+   * 按文件大小解析Range header，没有Range时返回NONE
+   * 带If-Range时只有它与文件当前的ETag(强比较)或Last-Modified一致才使用Range，否则返回NONE回复整个文件
+   */
+  auto GetRanges(size_t file_size, std::string_view etag, time_t last_modified,
+                 std::vector<ByteRange> &ranges) const noexcept -> RangeStatus;
+  /**
+   * GET/HEAD的条件请求是否可以回复304
+   * 有If-None-Match时只比较ETag，否则文件在If-Modified-Since之后没有修改过时返回true
+   */
+  auto IsNotModified(std::string_view etag, time_t last_modified) const noexcept -> bool;
+  /* 按Content-Length或chunked编码创建请求体解码器 */
+  auto MakeBodyDecoder() const noexcept -> BodyDecoder;
   friend auto operator<<(std::ostream &os, const Request &request)
       -> std::ostream &;
 
 private:
   auto ParseRequestLine(const std::string &request_line) -> bool;
-  void ScanHeader(const Header &header);
+  auto SetRequestLine(std::string_view method, std::string_view url, std::string_view version) -> bool;
+  auto AddHeader(std::string_view key, std::string_view value) -> bool;
   // htpp请求格式：
   // 请求行： 包括方法（如GET、POST等）、请求的资源路径（URL）和HTTP版本。
   // 例如:GET /index.html HTTP/1.1
@@ -44,8 +82,11 @@ private:
   Method method_;
   std::string resource_url_;
   Version version_;
-  std::vector<Header> headers_;
+  HeaderTable headers_;
   bool should_close_{true};
+  size_t content_length_{0};
+  bool chunked_{false};
+  bool expect_continue_{false};
   bool is_valid_{false};
   std::string invalid_reason_;
 };
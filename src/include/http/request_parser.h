@@ -0,0 +1,100 @@
+#ifndef NEXT_REQUEST_PARSER_H
+#define NEXT_REQUEST_PARSER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Next::Http {
+
+static constexpr size_t MAX_HEADER_COUNT = 64;
+static constexpr size_t MAX_REQUEST_HEAD_SIZE = 16 * 1024;
+
+enum class ParseStatus { INCOMPLETE, COMPLETE, ERROR };
+
+/**
+ * 可恢复的http请求头状态机解析器，直接在连接的读缓冲区上解析，不拷贝数据
+ * 请求行和各个header都只记录为缓冲区中的偏移量，数据不完整时返回INCOMPLETE并记住解析到的位置，
+ * 更多数据到达后再次调用Parse从上次停下的地方继续
+ * 通过Get*得到的string_view指向最近一次传给Parse的数据，缓冲区被修改后失效
+ */
+class RequestParser {
+ public:
+  /* 解析出的一个header，key保持原样，value去掉了前后的空白 */
+  struct HeaderSlice {
+    std::string_view key_;
+    std::string_view value_;
+  };
+
+  RequestParser() noexcept = default;
+
+  /**
+   * 从data中继续解析，data必须以上次传入的数据为前缀(缓冲区只在尾部追加)
+   * 返回COMPLETE时请求头占用data的前Consumed()个字节
+   */
+  auto Parse(std::string_view data) noexcept -> ParseStatus;
+
+  /* 清空状态以解析下一个请求 */
+  void Reset() noexcept;
+
+  auto Consumed() const noexcept -> size_t;
+
+  auto GetError() const noexcept -> const char *;
+
+  auto GetMethod() const noexcept -> std::string_view;
+
+  auto GetUrl() const noexcept -> std::string_view;
+
+  auto GetVersion() const noexcept -> std::string_view;
+
+  auto GetHeaderCount() const noexcept -> size_t;
+
+  auto GetHeader(size_t index) const noexcept -> HeaderSlice;
+
+ private:
+  enum class State {
+    METHOD,
+    URL,
+    VERSION,
+    REQUEST_LINE_LF,
+    HEADER_LINE_START,
+    HEADER_KEY,
+    HEADER_VALUE_START,
+    HEADER_VALUE,
+    HEADER_LINE_LF,
+    HEADERS_END_LF,
+    DONE
+  };
+
+  /* 相对于数据起点的一段区间 */
+  struct Slice {
+    uint32_t begin_{0};
+    uint32_t end_{0};
+  };
+
+  struct HeaderOffset {
+    Slice key_;
+    Slice value_;
+  };
+
+  auto Fail(const char *reason) noexcept -> ParseStatus;
+  auto View(Slice slice) const noexcept -> std::string_view;
+
+  std::string_view data_;
+  State state_{State::METHOD};
+  size_t pos_{0};
+  size_t token_begin_{0};
+  // value末尾的空白不属于value，记录最后一个非空白字符之后的位置
+  size_t value_end_{0};
+  Slice method_;
+  Slice url_;
+  Slice version_;
+  std::array<HeaderOffset, MAX_HEADER_COUNT> headers_{};
+  size_t header_count_{0};
+  const char *error_{nullptr};
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_REQUEST_PARSER_H
@@ -1,12 +1,49 @@
 #ifndef NEXT_RESPONSE_H
 #define NEXT_RESPONSE_H
 
+#include "core/buffer.h"
+#include "core/fd_cache.h"
+#include "http/content_coding.h"
+#include "http/header_table.h"
+#include "http/http_utils.h"
 #include <optional>
 #include <string>
 #include <vector>
 
 namespace Next::Http {
 class Header;
+
+/* 内容固定的响应，只在第一次使用时序列化一次，之后只需补上Date */
+enum class CannedResponse {
+  BAD_REQUEST,
+  NOT_FOUND,
+  METHOD_NOT_ALLOWED_STATIC,
+  SERVICE_UNAVAILABLE,
+  PAYLOAD_TOO_LARGE
+};
+
+/**
+ * 响应体的一个片段：共享块的一段、已打开文件的一段或者自带的字节
+ * 块和文件以引用计数持有，HTTP/1.1和HTTP/2的连接都把它们原样交给Connection发送，不拷贝文件内容
+ */
+struct BodySlice {
+  SharedBlock block_;
+  SharedFile file_;
+  std::string bytes_;
+  size_t offset_{0};
+  size_t length_{0};
+
+  static auto FromBlock(SharedBlock block, size_t offset, size_t length)
+      -> BodySlice;
+  static auto FromBlock(SharedBlock block) -> BodySlice;
+  static auto FromFile(SharedFile file, size_t offset, size_t length)
+      -> BodySlice;
+  static auto FromBytes(std::string bytes) -> BodySlice;
+
+  /* 片段中[offset, offset + length)的部分，用于把响应体切成HTTP/2的DATA帧 */
+  auto Sub(size_t offset, size_t length) const -> BodySlice;
+};
+
 class Response {
 public:
   Response(const std::string &status_code, bool should_close,
@@ -16,25 +53,100 @@ public:
   static auto Make200Response(bool should_close,
                               std::optional<std::string> resource_url)
       -> Response;
+  /* 200 OK response of a static file whose metadata is already known, no stat */
+  static auto MakeFileResponse(bool should_close, size_t content_length,
+                               std::string_view mime) -> Response;
+  /* 206 Partial Content response of a single range */
+  static auto MakePartialResponse(bool should_close, const ByteRange &range,
+                                  size_t file_size, std::string_view mime)
+      -> Response;
+  /**
+   * 206 Partial Content response of several ranges as multipart/byteranges
+   * part_heads[i]是第i个区间之前的分隔行和header，最后一个元素是结束分隔行，
+   * 响应体依次为 part_heads[0] range[0] part_heads[1] range[1] ... part_heads[n]
+   */
+  static auto MakeMultipartResponse(bool should_close,
+                                    const std::vector<ByteRange> &ranges,
+                                    size_t file_size, std::string_view mime,
+                                    std::vector<std::string> &part_heads)
+      -> Response;
+  /* 416 Range Not Satisfiable response with the file size in Content-Range */
+  static auto Make416Response(bool should_close, size_t file_size) -> Response;
+  /* 304 Not Modified response, carries the validators but neither body nor Content-Length */
+  static auto Make304Response(bool should_close, std::string_view etag,
+                              time_t last_modified) -> Response;
   /* 400 Bad Request response, close connection */
   static auto Make400Response() noexcept -> Response;
   /* 404 Not Found response, close connection */
   static auto Make404Response() noexcept -> Response;
+  /* 405 Method Not Allowed response with the Allow header, close connection */
+  static auto Make405Response(const std::string &allow) noexcept -> Response;
   /* 503 Service Unavailable response, close connection */
   static auto Make503Response() noexcept -> Response;
+  /* 413 Payload Too Large response, close connection */
+  static auto Make413Response() noexcept -> Response;
+
+  /* 固定响应对应的Response，HTTP/2不能使用序列化好的HTTP/1.1响应 */
+  static auto MakeCanned(CannedResponse kind) noexcept -> Response;
+
+  /* 把固定响应追加到buffer，都会关闭连接 */
+  static void SerializeCanned(CannedResponse kind,
+                              std::vector<unsigned char> &buffer);
+
+  /**
+   * no content, content should separately be loaded
+   * Server和Connection使用预先渲染好的header块，Date取自每个reactor每秒刷新一次的缓存
+   */
+  void Serialize(std::vector<unsigned char> &buffer) const;
+
+  /**
+   * 不带Date的完整响应头，用于缓存整个响应
+   * 发送缓存的响应时在结尾空行之前用SerializeDateHeader补上当前的Date
+   */
+  void SerializeWithoutDate(std::vector<unsigned char> &buffer) const;
 
-  /* no content, content should separately be loaded */
-  void Serialize(std::vector<unsigned char> &buffer); // NOLINT
+  /* 追加 "Date:<当前时间>\r\n" */
+  static void SerializeDateHeader(std::vector<unsigned char> &buffer);
+
+  /* 设置ETag和Last-Modified，客户端用它们发起条件请求 */
+  void SetValidators(std::string_view etag, time_t last_modified);
+
+  /**
+   * 可压缩文件的响应(包括206、304和416)都带上Vary: Accept-Encoding
+   * 压缩时再设置Content-Encoding并去掉Accept-Ranges
+   */
+  void SetContentCoding(ContentCoding coding);
+
+  /* 设置任意header，已有同名header时替换 */
+  void SetHeader(std::string_view key, std::string value);
+
+  /* 用std::to_chars写入Content-Length，不经过std::to_string */
+  void SetContentLength(size_t content_length);
+
+  /* 长度未知的流式响应体，去掉Content-Length，HTTP/1.1以chunked编码发送 */
+  void SetChunked();
 
   auto GetHeaders() -> std::vector<Header>;
 
+  /* 响应头是否带有Connection: Close，发送后连接必须关闭 */
+  auto ShouldClose() const noexcept -> bool;
+
+  /* 三位数字的状态码，例如 "200"，HTTP/2的:status */
+  auto GetStatusCode() const noexcept -> std::string_view;
+
+  auto GetHeaderTable() const noexcept -> const HeaderTable &;
+
   auto ChangeHeader(const std::string &key,
                     const std::string &new_value) noexcept -> bool;
+  auto ChangeHeader(HeaderId id, std::string new_value) noexcept -> bool;
 
   friend auto operator<<(std::ostream &os, Response &response)
       -> std::ostream &;
 
 private:
+  /* 状态行和除Date外的所有header，不包含结尾的空行 */
+  void SerializeHeaders(std::vector<unsigned char> &buffer) const;
+
   // http响应格式
   /**
    * 状态行：包括HTTP版本、状态码（如200、404等）和状态消息（如OK、Not
@@ -44,7 +156,7 @@ private:
    */
   std::string status_line_;
   bool should_close_;
-  std::vector<Header> headers_;
+  HeaderTable headers_;
   std::optional<std::string> resource_url_;
   std::vector<unsigned char> body_;
 };
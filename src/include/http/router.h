@@ -0,0 +1,150 @@
+#ifndef NEXT_ROUTER_H
+#define NEXT_ROUTER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "core/utils.h"
+#include "http/body_stream.h"
+#include "http/http_utils.h"
+#include "http/request.h"
+
+namespace Next::Http {
+
+/* 一个路由模式中最多的参数个数，RouteParams是定长数组，匹配时不分配内存 */
+static constexpr size_t MAX_ROUTE_PARAMS = 8;
+
+/* 路由支持的方法个数，Method::UNSUPPORTED之前的都可以注册 */
+static constexpr size_t ROUTE_METHOD_COUNT = static_cast<size_t>(Method::UNSUPPORTED);
+
+/**
+ * 匹配得到的路径参数，名字和值都是视图
+ * 名字指向Router内部，值指向被匹配的路径，只在处理这个请求期间有效，值没有经过百分号解码
+ */
+class RouteParams {
+ public:
+  /* 按名字查找参数 */
+  auto Get(std::string_view name) const noexcept -> std::optional<std::string_view>;
+
+  auto Size() const noexcept -> size_t;
+
+  /* 第index个参数，按在模式中出现的顺序 */
+  auto At(size_t index) const noexcept -> const std::pair<std::string_view, std::string_view> &;
+
+ private:
+  friend class Router;
+
+  std::array<std::pair<std::string_view, std::string_view>, MAX_ROUTE_PARAMS> params_;
+  size_t size_{0};
+};
+
+/**
+ * 处理函数填写的响应，服务器据此构造Response并补上Content-Length
+ * 设置了stream_时忽略body_，响应体由它逐段生成并以chunked编码发送
+ * 需要请求体时设置on_body_和on_body_end_，请求体不在服务器中整体缓存，大小也不受限制
+ */
+struct RouteResponse {
+  std::string status_{RESPONSE_OK};
+  std::string content_type_{"text/plain"};
+  // 其他header，例如Location、Cache-Control
+  std::vector<std::pair<std::string, std::string>> headers_;
+  std::string body_;
+  std::shared_ptr<BodyStream> stream_;
+  // 请求体(Content-Length或chunked)每解码出一段调用一次，参数只在回调期间有效
+  std::function<void(std::string_view data)> on_body_;
+  // 请求体收齐后调用，可以在这里填写响应，设置了on_body_或on_body_end_时响应要等到请求体收齐才发送
+  std::function<void(RouteResponse &response)> on_body_end_;
+};
+
+/**
+ * 进程内的请求处理函数，在reactor线程上同步执行，不应阻塞
+ * 需要阻塞或者输出很长时设置RouteResponse::stream_，它的Read在offload线程上执行
+ * 处理函数在请求头到达后立即调用，此时请求体还没有读取，由RouteResponse::on_body_逐段接收
+ */
+using RouteHandler = std::function<void(const Request &request, const RouteParams &params, RouteResponse &response)>;
+
+enum class RouteStatus { MATCHED, NOT_FOUND, METHOD_NOT_ALLOWED };
+
+struct RouteMatch {
+  RouteStatus status_{RouteStatus::NOT_FOUND};
+  // MATCHED时的处理函数，Router存活期间有效
+  const RouteHandler *handler_{nullptr};
+  // METHOD_NOT_ALLOWED时这个路径允许的方法，第i位对应static_cast<int>(Method)为i的方法
+  uint32_t allowed_{0};
+};
+
+/**
+ * 基数树(radix tree)路由，按路径模式和方法分发到进程内的处理函数
+ * 模式以 '/' 开始，每一段可以是静态文本、":name"(整段作为参数，匹配一个非空的段)
+ * 或者最后一段的 "*name"(匹配剩余的全部路径，可以为空)
+ * 例如 "/api/users/:id"，以及在 "/static/" 之后接 "*file" 的模式
+ * 同一位置静态文本优先于参数，参数优先于 "*"，不匹配时回溯尝试下一种
+ * 注册的模式编译成连续数组中的节点，Match只读这些数组，不分配内存，可以被多个reactor线程同时调用
+ * Add会重新编译，应当在服务器开始处理请求之前完成所有注册
+ */
+class Router {
+ public:
+  Router();
+  ~Router();
+
+  NON_COPYABLE(Router);
+
+  /**
+   * 注册一个路由，GET的处理函数同时处理HEAD(除非另外注册了HEAD)
+   * 模式格式错误、参数过多、与已有的参数名冲突或者重复注册时返回false
+   */
+  auto Add(Method method, std::string_view pattern, RouteHandler handler) -> bool;
+
+  /* 匹配路径(不含查询串)，参数写入params */
+  auto Match(Method method, std::string_view path, RouteParams &params) const noexcept -> RouteMatch;
+
+  /* allowed中的方法，格式为Allow header的值，例如 "GET, HEAD" */
+  static auto FormatAllow(uint32_t allowed) -> std::string;
+
+  /* 已注册的路由数 */
+  auto Size() const noexcept -> size_t;
+
+ private:
+  struct BuildNode;
+
+  /* 编译后的节点，静态子节点连续存放 */
+  struct Node {
+    uint32_t label_offset_{0};
+    uint32_t label_length_{0};
+    uint32_t first_child_{0};
+    uint32_t child_count_{0};
+    // 参数子节点和 "*" 子节点，0表示没有(根节点不会是子节点)
+    uint32_t param_child_{0};
+    uint32_t catch_all_child_{0};
+    // 参数节点的名字在names_中的下标
+    uint32_t name_{0};
+    // 每个方法的处理函数在handlers_中的下标加1，0表示没有
+    std::array<uint32_t, ROUTE_METHOD_COUNT> handlers_{};
+  };
+
+  void Compile();
+  void CompileNode(uint32_t index, const BuildNode &build);
+  /* 路径在这个节点结束，按方法选出处理函数 */
+  auto Resolve(const Node &node, Method method, RouteMatch &match) const noexcept -> bool;
+  auto MatchNode(uint32_t index, Method method, std::string_view path, RouteParams &params,
+                 RouteMatch &match) const noexcept -> bool;
+
+  std::unique_ptr<BuildNode> root_;
+  std::vector<Node> nodes_;
+  // 所有节点的静态文本
+  std::string labels_;
+  std::vector<std::string> names_;
+  std::vector<RouteHandler> handlers_;
+};
+
+}  // namespace Next::Http
+
+#endif  // !NEXT_ROUTER_H
@@ -57,4 +57,12 @@ TEST_CASE("[core/buffer]") {
     CHECK((op_str.has_value() && op_str.value() == msg));
     CHECK(buf.ToStringView() == next_msg);
   }
+  SECTION("consume drops bytes already handled in place") {
+    const std::string msg = "GET / HTTP/1.1\r\n\r\nnext";
+    buf.Append(msg);
+    buf.Consume(18);
+    CHECK(buf.ToStringView() == "next");
+    buf.Consume(100);
+    CHECK(buf.Size() == 0);
+  }
 }
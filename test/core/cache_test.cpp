@@ -9,9 +9,13 @@
 #include "catch2/catch_test_macros.hpp"
 #include <string>
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include "core/timer.h"
 /* for convenience reason */
 using Next::Cache;
+using Next::DEFAULT_CACHE_CAPACITY;
 using Next::Http::LoadFile;
 using Next::Http::IsFileExists;
 using Next::GetTimeUtc;
@@ -54,6 +58,157 @@ TEST_CASE("[core/cache]") {
   }
 }
 
+TEST_CASE("[core/cache_shared_block]") {
+  Cache cache(20);
+  auto block = std::make_shared<const std::vector<unsigned char>>(
+      std::vector<unsigned char>{'h', 'e', 'l', 'l', 'o', '!'});
+
+  SECTION("shared blocks are handed out without copying") {
+    CHECK(cache.TryLoadShared("url") == nullptr);
+    CHECK(cache.TryInsertShared("url", block));
+    CHECK(!cache.TryInsertShared("url", block));
+    CHECK(!cache.TryInsertShared("null", nullptr));
+    CHECK(cache.GetOccupancy() == block->size());
+    auto loaded = cache.TryLoadShared("url");
+    CHECK(loaded.get() == block.get());
+
+    // 拷贝接口与共享接口读写同一份数据
+    std::vector<unsigned char> read_buf;
+    CHECK(cache.TryLoad("url", read_buf));
+    CHECK(read_buf == *block);
+    CHECK(cache.TryInsert("copied", read_buf));
+    CHECK(*cache.TryLoadShared("copied") == *block);
+  }
+
+  SECTION("an evicted block stays valid for its holders") {
+    CHECK(cache.TryInsertShared("url", block));
+    auto holder = cache.TryLoadShared("url");
+    block.reset();
+    cache.EvictOneByUrl("url");
+    CHECK(cache.TryLoadShared("url") == nullptr);
+    CHECK(cache.GetOccupancy() == 0);
+    CHECK(holder->size() == 6);
+    CHECK(holder.use_count() == 1);
+  }
+
+  SECTION("entries with a ttl expire") {
+    CHECK(cache.TryInsertShared("short", block, 20));
+    CHECK(cache.TryInsertShared("forever", block));
+    CHECK(cache.TryLoadShared("short") == block);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    CHECK(cache.TryLoadShared("short") == nullptr);
+    std::vector<unsigned char> read_buf;
+    CHECK(!cache.TryLoad("short", read_buf));
+    CHECK(cache.TryLoadShared("forever") == block);
+    CHECK(cache.GetOccupancy() == block->size());
+    // 过期的条目删除后可以重新插入
+    CHECK(cache.TryInsertShared("short", block, 1000));
+  }
+}
+
+TEST_CASE("[core/cache_segments]") {
+  SECTION("the capacity budget is shared by all segments") {
+    Cache cache(60, 4);
+    CHECK(cache.GetSegmentCount() == 4);
+    auto block = std::make_shared<const std::vector<unsigned char>>(10, 'x');
+    for (int i = 0; i < 20; i++) {
+      CHECK(cache.TryInsertShared("url" + std::to_string(i), block));
+      CHECK(cache.GetOccupancy() <= cache.GetCapacity());
+    }
+    // 淘汰的总是所有分段中最久未使用的
+    for (int i = 0; i < 14; i++) {
+      CHECK(cache.TryLoadShared("url" + std::to_string(i)) == nullptr);
+    }
+    for (int i = 14; i < 20; i++) {
+      CHECK(cache.TryLoadShared("url" + std::to_string(i)) == block);
+    }
+    CHECK(cache.GetOccupancy() == 60);
+    cache.Clear();
+    CHECK(cache.GetOccupancy() == 0);
+    CHECK(cache.TryLoadShared("url19") == nullptr);
+  }
+
+  SECTION("concurrent loads, inserts and erases stay consistent") {
+    const size_t capacity = 4096;
+    Cache cache(capacity);
+    std::vector<std::thread> threads;
+    std::atomic<int> corrupted = 0;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&, t]() {
+        for (int i = 0; i < 20000; i++) {
+          // 每个url的内容是它的编号重复若干次，读到的内容能据此校验
+          auto id = static_cast<unsigned char>((i * 7 + t * 13) % 251);
+          auto url = "url" + std::to_string(id);
+          if (i % 3 == 0) {
+            cache.TryInsertShared(url, std::make_shared<const std::vector<unsigned char>>(64 + id, id));
+          } else if (i % 17 == 0) {
+            cache.Erase(url);
+          } else if (auto block = cache.TryLoadShared(url); block != nullptr) {
+            if (block->size() != 64 + static_cast<size_t>(id) || block->front() != id) {
+              corrupted++;
+            }
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    CHECK(corrupted == 0);
+    CHECK(cache.GetOccupancy() <= capacity);
+    size_t occupancy = 0;
+    for (int id = 0; id < 251; id++) {
+      if (auto block = cache.TryLoadShared("url" + std::to_string(id)); block != nullptr) {
+        occupancy += block->size();
+      }
+    }
+    CHECK(cache.GetOccupancy() == occupancy);
+  }
+}
+
+TEST_CASE("[core/cache_benchmark]", "[.benchmark]") {
+  const int operations = 200000;
+  const int hot_keys = 1024;
+  auto block = std::make_shared<const std::vector<unsigned char>>(1024, 'x');
+  std::cout << "Cache lookups with 1 insert per 16 operations, " << operations << " operations per thread" << std::endl;
+  for (size_t segments : {1, 16}) {
+    for (int thread_count : {1, 2, 4, 8}) {
+      Cache cache(DEFAULT_CACHE_CAPACITY, segments);
+      for (int i = 0; i < hot_keys; i++) {
+        cache.TryInsertShared("hot" + std::to_string(i), block);
+      }
+      std::atomic<size_t> hits = 0;
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+          size_t local_hits = 0;
+          std::string url;
+          for (int i = 0; i < operations; i++) {
+            if (i % 16 == 0) {
+              cache.TryInsertShared("cold" + std::to_string(t) + "_" + std::to_string(i), block);
+            } else {
+              url = "hot" + std::to_string((i * 31 + t) % hot_keys);
+              local_hits += cache.TryLoadShared(url) != nullptr ? 1 : 0;
+            }
+          }
+          hits += local_hits;
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      auto end = std::chrono::steady_clock::now();
+      auto micros = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+      CHECK(hits > 0);
+      CHECK(cache.GetOccupancy() <= cache.GetCapacity());
+      std::cout << segments << " segment(s), " << thread_count << " thread(s): " << micros << " us, "
+                << static_cast<double>(operations) * thread_count / static_cast<double>(micros) << " ops/us"
+                << std::endl;
+    }
+  }
+}
+
 TEST_CASE("[cache_file_test]"){
   const int capacity = 512;
   Cache cache(capacity);
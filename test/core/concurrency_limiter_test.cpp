@@ -0,0 +1,91 @@
+/**
+ * This is the unit test file for core/ConcurrencyLimiter class
+ */
+
+#include "core/concurrency_limiter.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "core/timer.h"
+
+/* for convenience reason */
+using Next::ConcurrencyLimiter;
+
+TEST_CASE("[core/concurrency_limiter]") {
+  const int initial_limit = 8;
+  ConcurrencyLimiter limiter(initial_limit, 2, 64);
+  REQUIRE(limiter.GetLimit() == initial_limit);
+  REQUIRE(limiter.GetInFlight() == 0);
+
+  // occupy every slot, then complete them all with the same latency
+  auto run_saturated_round = [&](uint64_t latency) {
+    int acquired = 0;
+    while (limiter.TryAcquire()) {
+      acquired++;
+    }
+    for (int i = 0; i < acquired; i++) {
+      limiter.Release(latency);
+    }
+  };
+
+  SECTION("requests beyond the limit are rejected") {
+    std::vector<ConcurrencyLimiter::Permit> permits;
+    for (int i = 0; i < initial_limit; i++) {
+      permits.push_back(limiter.TryAcquirePermit());
+      CHECK(permits.back().IsGranted());
+    }
+    CHECK(limiter.GetInFlight() == initial_limit);
+    auto rejected = limiter.TryAcquirePermit();
+    CHECK(!rejected.IsGranted());
+    CHECK(limiter.GetRejected() == 1);
+
+    // permit goes back on destruction
+    permits.pop_back();
+    CHECK(limiter.GetInFlight() == initial_limit - 1);
+    CHECK(limiter.TryAcquirePermit().IsGranted());
+    CHECK(limiter.GetInFlight() == initial_limit - 1);
+  }
+
+  SECTION("limit grows while latency is stable and shrinks once requests queue") {
+    const uint64_t base_latency = 1000 * 1000;  // 1ms
+    for (int round = 0; round < 20; round++) {
+      run_saturated_round(base_latency);
+    }
+    int grown_limit = limiter.GetLimit();
+    CHECK(grown_limit > initial_limit);
+
+    // latency jumps 10x as requests start to queue
+    for (int round = 0; round < 5; round++) {
+      run_saturated_round(10 * base_latency);
+    }
+    CHECK(limiter.GetLimit() < grown_limit);
+  }
+
+  SECTION("samples far below the limit do not grow it but queueing still shrinks it") {
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(limiter.TryAcquire());
+      limiter.Release(1000);
+    }
+    CHECK(limiter.GetLimit() == initial_limit);
+
+    // one request at a time, but each waited longer before being handled
+    for (int i = 0; i < 20; i++) {
+      REQUIRE(limiter.TryAcquire());
+      limiter.Release(100 * 1000);
+    }
+    CHECK(limiter.GetLimit() < initial_limit);
+  }
+
+  SECTION("time spent waiting before the permit counts as latency") {
+    for (int i = 0; i < 100; i++) {
+      CHECK(limiter.TryAcquirePermit().IsGranted());
+    }
+    const uint64_t waited = 10 * 1000 * 1000;  // 10ms
+    for (int i = 0; i < 20; i++) {
+      CHECK(limiter.TryAcquirePermit(Next::NowSinceEpoch2() - waited).IsGranted());
+    }
+    CHECK(limiter.GetLimit() < initial_limit);
+  }
+}
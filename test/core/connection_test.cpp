@@ -4,11 +4,16 @@
 
 #include "core/connection.h"
 
+#include <sys/socket.h>
 #include <unistd.h>
+#include <csignal>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "catch2/catch_test_macros.hpp"
 #include "core/net_addr.h"
@@ -66,20 +71,139 @@ TEST_CASE("[core/connection]") {
       CHECK(client_conn.ReadAsString() == std::string(server_message));
     });
 
-    client_thread.detach();
-    NetAddress client_address;
-    auto connected_sock = std::make_unique<Socket>(server_conn.GetSocket()->Accept(client_address));
-    connected_sock->SetNonBlocking();
-    CHECK(connected_sock->GetFd() != -1);
-    Connection connected_conn(std::move(connected_sock));
-    sleep(1);
-    // recv a message from client
-    auto [read, exit] = connected_conn.Recv();
-    CHECK((read == strlen(client_message) && !exit));
-    CHECK(connected_conn.GetReadBufferSize() == strlen(client_message));
-    // send a message to client
-    connected_conn.WriteToWriteBuffer(server_message);
-    connected_conn.Send();
-    sleep(1);
+    {
+      NetAddress client_address;
+      auto connected_sock = std::make_unique<Socket>(server_conn.GetSocket()->Accept(client_address));
+      connected_sock->SetNonBlocking();
+      CHECK(connected_sock->GetFd() != -1);
+      Connection connected_conn(std::move(connected_sock));
+      sleep(1);
+      // recv a message from client
+      auto [read, exit] = connected_conn.Recv();
+      CHECK((read == strlen(client_message) && !exit));
+      CHECK(connected_conn.GetReadBufferSize() == strlen(client_message));
+      // send a message to client
+      connected_conn.WriteToWriteBuffer(server_message);
+      connected_conn.Send();
+      sleep(1);
+    }
+    // 客户端线程引用了本测试中的变量，必须在测试结束前等待它退出
+    client_thread.join();
+  }
+}
+
+TEST_CASE("[core/connection_shared_block]") {
+  int fds[2];
+  REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  Connection sender(std::make_unique<Socket>(fds[0]));
+  Connection receiver(std::make_unique<Socket>(fds[1]));
+
+  SECTION("shared blocks are sent in order with the write buffer without being copied") {
+    auto block = std::make_shared<const std::vector<unsigned char>>(std::vector<unsigned char>{'0', '1', '2', '3'});
+    sender.WriteToWriteBuffer(block, 1, 2);
+    sender.WriteToWriteBuffer("-a-");
+    sender.WriteToWriteBuffer(block);
+    sender.WriteToWriteBuffer(block, 0, 0);
+    sender.WriteToWriteBuffer("-b");
+    CHECK(sender.GetWriteBufferSize() == 11);
+    sender.Send();
+    CHECK(sender.GetWriteBufferSize() == 0);
+    CHECK(block.use_count() == 1);
+
+    receiver.GetSocket()->SetNonBlocking();
+    receiver.Recv();
+    CHECK(receiver.ReadAsString() == "12-a-0123-b");
+  }
+
+  SECTION("file ranges are sent with sendfile in order") {
+    auto path = "next_connection_sendfile_" + std::to_string(getpid());
+    {
+      std::ofstream file(path);
+      file << "0123456789";
+    }
+    auto file = Next::OpenFile::Open(path);
+    REQUIRE(file != nullptr);
+    sender.WriteToWriteBuffer("[");
+    sender.WriteToWriteBuffer(file, 2, 3);
+    sender.WriteToWriteBuffer("|");
+    sender.WriteToWriteBuffer(file, 8, 2);
+    sender.WriteToWriteBuffer("]");
+    CHECK(sender.GetWriteBufferSize() == 8);
+    sender.Send();
+    CHECK(file.use_count() == 1);
+    std::remove(path.c_str());
+
+    receiver.GetSocket()->SetNonBlocking();
+    receiver.Recv();
+    CHECK(receiver.ReadAsString() == "[234|89]");
+  }
+}
+
+TEST_CASE("[core/connection_partial_send]") {
+  int fds[2];
+  REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  Connection sender(std::make_unique<Socket>(fds[0]));
+  Connection receiver(std::make_unique<Socket>(fds[1]));
+  sender.GetSocket()->SetNonBlocking();
+  receiver.GetSocket()->SetNonBlocking();
+  sender.GetSocket()->SetSendBufferSize(4096);
+
+  // 远大于发送缓冲区的数据，由缓冲区、数据块和文件区间交错组成
+  std::string expected;
+  auto block = std::make_shared<const std::vector<unsigned char>>(256 * 1024, 'b');
+  auto path = "next_connection_partial_" + std::to_string(getpid());
+  {
+    std::ofstream file(path);
+    file << std::string(300 * 1024, 'f');
+  }
+  auto file = Next::OpenFile::Open(path);
+  REQUIRE(file != nullptr);
+  std::remove(path.c_str());
+  for (int i = 0; i < 4; i++) {
+    auto head = "[" + std::to_string(i) + "]" + std::string(100 * 1024, 'a');
+    sender.WriteToWriteBuffer(head);
+    sender.WriteToWriteBuffer(block, 1, block->size() - 2);
+    sender.WriteToWriteBuffer(file, 7, 200 * 1024);
+    expected += head + std::string(block->size() - 2, 'b') + std::string(200 * 1024, 'f');
+  }
+  REQUIRE(sender.GetWriteBufferSize() == expected.size());
+
+  SECTION("data the socket cannot take stays queued and is sent in order later") {
+    REQUIRE(sender.Send());
+    CHECK(sender.GetWriteBufferSize() > 0);
+    CHECK(sender.GetWriteBufferSize() < expected.size());
+    // 对端读取后继续发送，直到全部发出
+    while (sender.GetWriteBufferSize() > 0) {
+      receiver.Recv();
+      REQUIRE(sender.Send());
+    }
+    receiver.Recv();
+    CHECK(receiver.GetReadBufferSize() == expected.size());
+    CHECK(receiver.ReadAsString() == expected);
+    CHECK(block.use_count() == 1);
+    CHECK(file.use_count() == 1);
+  }
+
+  SECTION("data queued while a send is pending goes after the pending data") {
+    REQUIRE(sender.Send());
+    REQUIRE(sender.GetWriteBufferSize() > 0);
+    sender.WriteToWriteBuffer("tail");
+    sender.WriteToWriteBuffer(block, 0, 3);
+    expected += "tailbbb";
+    while (sender.GetWriteBufferSize() > 0) {
+      receiver.Recv();
+      REQUIRE(sender.Send());
+    }
+    receiver.Recv();
+    CHECK(receiver.ReadAsString() == expected);
+  }
+
+  SECTION("a send error drops the queued data") {
+    // 与服务器一样忽略SIGPIPE，对端关闭后写入只返回EPIPE
+    signal(SIGPIPE, SIG_IGN);
+    REQUIRE(sender.Send());
+    shutdown(receiver.GetFd(), SHUT_RDWR);
+    CHECK(!sender.Send());
+    CHECK(sender.GetWriteBufferSize() == 0);
   }
 }
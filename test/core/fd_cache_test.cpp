@@ -0,0 +1,67 @@
+/**
+ * This is the unit test file for core/FdCache class
+ */
+
+#include "core/fd_cache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "catch2/catch_test_macros.hpp"
+
+/* for convenience reason */
+using Next::FdCache;
+using Next::OpenFile;
+using Next::SharedFile;
+
+static auto IsOpen(int fd) -> bool { return fcntl(fd, F_GETFD) != -1; }
+
+TEST_CASE("[core/fd_cache]") {
+  auto dir = std::filesystem::temp_directory_path() / ("next_fd_" + std::to_string(getpid()));
+  std::filesystem::create_directories(dir);
+  std::vector<std::string> paths;
+  for (int i = 0; i < 64; i++) {
+    paths.push_back((dir / ("file" + std::to_string(i))).string());
+    std::ofstream(paths.back()) << i;
+  }
+
+  SECTION("open files are found again until erased") {
+    FdCache cache;
+    CHECK(OpenFile::Open((dir / "missing").string()) == nullptr);
+    CHECK(cache.Find(paths[0]) == nullptr);
+    auto file = cache.Insert(paths[0], OpenFile::Open(paths[0]));
+    REQUIRE(file != nullptr);
+    CHECK(cache.Find(paths[0]) == file);
+    // 并发打开同一个文件时保留先放入的那个
+    CHECK(cache.Insert(paths[0], OpenFile::Open(paths[0])) == file);
+    CHECK(cache.Size() == 1);
+    CHECK(cache.Erase(paths[0]));
+    CHECK(!cache.Erase(paths[0]));
+    CHECK(cache.Find(paths[0]) == nullptr);
+    CHECK(cache.Size() == 0);
+  }
+
+  SECTION("evicted and erased fds stay open while referenced") {
+    FdCache cache(Next::FD_CACHE_SHARD_COUNT);
+    CHECK(cache.GetCapacity() == Next::FD_CACHE_SHARD_COUNT);
+    auto in_flight = cache.Insert(paths[0], OpenFile::Open(paths[0]));
+    int in_flight_fd = in_flight->GetFd();
+    for (const auto &path : paths) {
+      cache.Insert(path, OpenFile::Open(path));
+    }
+    CHECK(cache.Size() <= cache.GetCapacity());
+    CHECK(IsOpen(in_flight_fd));
+    cache.Erase(paths[0]);
+    CHECK(IsOpen(in_flight_fd));
+    char c = 0;
+    CHECK(pread(in_flight->GetFd(), &c, 1, 0) == 1);
+    CHECK(c == '0');
+    in_flight.reset();
+    CHECK(!IsOpen(in_flight_fd));
+  }
+
+  std::filesystem::remove_all(dir);
+}
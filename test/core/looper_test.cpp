@@ -4,9 +4,14 @@
 
 #include "core/looper.h"
 
+#include <fcntl.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <atomic>
+#include <csignal>
+#include <cstring>
+#include <iostream>
 #include <memory>
 #include <numeric>
 #include <thread>  // NOLINT
@@ -17,6 +22,7 @@
 #include "core/net_addr.h"
 #include "core/poller.h"
 #include "core/socket.h"
+#include "core/thread_pool.h"
 
 /* for convenience reason */
 using Next::Connection;
@@ -27,6 +33,7 @@ using Next::POLL_ET;
 using Next::POLL_READ;
 using Next::Poller;
 using Next::Socket;
+using Next::ThreadPool;
 
 TEST_CASE("[core/looper]") {
   Looper looper;
@@ -80,4 +87,133 @@ TEST_CASE("[core/looper]") {
       threads[i].join();
     }
   }
+  SECTION("offloaded job completes back on the owning looper") {
+    ThreadPool offload_pool(2);
+    looper.SetOffloadPool(&offload_pool);
+    std::thread client_thread([&host = local_host]() {
+      auto client_socket = Socket();
+      client_socket.Connect(host);
+      sleep(2);
+    });
+
+    NetAddress client_address;
+    auto client_sock = std::make_unique<Socket>(server_sock.Accept(client_address));
+    REQUIRE(client_sock->GetFd() != -1);
+    client_sock->SetNonBlocking();
+    auto client_conn = std::make_unique<Connection>(std::move(client_sock));
+    client_conn->SetEvents(POLL_READ | POLL_ET);
+    client_conn->SetCallback([](Connection *) {});
+    int fd = client_conn->GetFd();
+    looper.AddConnection(std::move(client_conn));
+
+    std::thread::id loop_thread_id;
+    std::thread::id job_thread_id;
+    std::thread::id complete_thread_id;
+    std::atomic<bool> job_done = false;
+    std::atomic<bool> completed = false;
+    std::thread runner([&]() {
+      loop_thread_id = std::this_thread::get_id();
+      looper.Loop();
+    });
+    looper.RunInLoop([&]() {
+      looper.Offload(
+          fd,
+          [&]() {
+            job_thread_id = std::this_thread::get_id();
+            usleep(100 * 1000);
+            job_done = true;
+          },
+          [&](Connection *conn) {
+            complete_thread_id = std::this_thread::get_id();
+            CHECK(job_done);
+            CHECK(conn->GetFd() == fd);
+            completed = true;
+          });
+      CHECK(looper.IsOffloaded(fd));
+    });
+    sleep(1);
+    looper.Exit();
+    runner.join();
+    client_thread.join();
+
+    CHECK(completed);
+    CHECK(!looper.IsOffloaded(fd));
+    CHECK(job_thread_id != loop_thread_id);
+    CHECK(complete_thread_id == loop_thread_id);
+  }
+  SECTION("busy poll mode spins after activity and reports spin time") {
+    const uint64_t max_spin_us = 2000;
+    looper.SetBusyPoll(max_spin_us);
+    CHECK(looper.GetSpinBudget() == max_spin_us);
+    std::thread client_thread([&host = local_host]() {
+      auto client_socket = Socket();
+      client_socket.Connect(host);
+      const char *msg = "ping";
+      for (int i = 0; i < 5; i++) {
+        send(client_socket.GetFd(), msg, strlen(msg), 0);
+        usleep(500);
+      }
+      sleep(1);
+    });
+
+    NetAddress client_address;
+    auto client_sock = std::make_unique<Socket>(server_sock.Accept(client_address));
+    REQUIRE(client_sock->GetFd() != -1);
+    client_sock->SetNonBlocking();
+    auto client_conn = std::make_unique<Connection>(std::move(client_sock));
+    client_conn->SetEvents(POLL_READ | POLL_ET);
+    std::atomic<int> handled = 0;
+    client_conn->SetCallback([&](Connection *conn) {
+      conn->Recv();
+      conn->ClearReadBuffer();
+      handled++;
+    });
+    looper.AddConnection(std::move(client_conn));
+
+    std::thread runner([&]() { looper.Loop(); });
+    sleep(2);
+    looper.Exit();
+    runner.join();
+    client_thread.join();
+
+    CHECK(handled > 0);
+    CHECK(looper.GetSpinTime() > 0);
+    CHECK(looper.GetSpinBudget() >= Next::MIN_SPIN_BUDGET);
+    CHECK(looper.GetSpinBudget() <= max_spin_us);
+    std::cout << "busy poll spun " << looper.GetSpinTime() << " ns, caught " << looper.GetSpinHits()
+              << " events while spinning" << std::endl;
+  }
+  SECTION("watchers are called on readiness until they remove themselves") {
+    int pipe_fds[2];
+    REQUIRE(pipe2(pipe_fds, O_NONBLOCK | O_CLOEXEC) == 0);
+    std::atomic<int> calls = 0;
+    auto watcher = std::make_unique<Connection>(std::make_unique<Socket>(pipe_fds[0]));
+    watcher->SetEvents(POLL_READ);
+    watcher->SetCallback([&](Connection *conn) {
+      char byte;
+      while (read(conn->GetFd(), &byte, 1) == 1) {
+      }
+      // 在自己的回调中移除自己，watcher到本轮事件处理完才销毁
+      if (++calls == 2) {
+        CHECK(looper.RemoveWatcher(conn->GetFd()));
+      }
+    });
+    looper.AddWatcher(std::move(watcher));
+
+    std::thread runner([&]() { looper.Loop(); });
+    for (int i = 0; i < 2; i++) {
+      REQUIRE(write(pipe_fds[1], "x", 1) == 1);
+      usleep(100 * 1000);
+    }
+    // 读端已随watcher一起关闭
+    signal(SIGPIPE, SIG_IGN);
+    CHECK(write(pipe_fds[1], "x", 1) == -1);
+    looper.Exit();
+    looper.RunInLoop([]() {});
+    runner.join();
+
+    CHECK(calls == 2);
+    CHECK(!looper.RemoveWatcher(pipe_fds[0]));
+    close(pipe_fds[1]);
+  }
 }
@@ -5,7 +5,9 @@
 #include "core/socket.h"
 
 #include <fcntl.h>
+#include <unistd.h>
 
+#include <stdexcept>
 #include <thread>  // NOLINT
 
 #include "catch2/catch_test_macros.hpp"
@@ -14,6 +16,7 @@
 /* for convenience reason */
 using Next::NetAddress;
 using Next::Socket;
+using Next::SocketOptions;
 
 TEST_CASE("[core/socket]") {
   NetAddress local_host("127.0.0.1", 20080);
@@ -53,4 +56,55 @@ TEST_CASE("[core/socket]") {
     client_thread.detach();
     CHECK(server_sock.Accept(client_address) != -1);
   }
+  SECTION("tuning options applied to listener and connection sockets") {
+    SocketOptions options;
+    options.tcp_nodelay = true;
+    options.defer_accept = 1;
+    options.fast_open = 16;
+    options.send_buffer_size = 64 * 1024;
+    options.recv_buffer_size = 64 * 1024;
+
+    NetAddress tuned_host("127.0.0.1", 20081);
+    Socket listener;
+    listener.Bind(tuned_host);
+    listener.ApplyListenerOptions(options);
+    listener.Listen();
+    CHECK(listener.GetDeferAccept() > 0);
+    CHECK(listener.GetFastOpen() == options.fast_open);
+    // kernel doubles the requested size for bookkeeping
+    CHECK(listener.GetSendBufferSize() >= options.send_buffer_size);
+    CHECK(listener.GetRecvBufferSize() >= options.recv_buffer_size);
+
+    Socket conn_sock;
+    conn_sock.Bind(tuned_host);
+    CHECK(!conn_sock.GetNoDelay());
+    CHECK(conn_sock.ApplyConnectionOptions(options));
+    CHECK(conn_sock.GetNoDelay());
+    CHECK(conn_sock.GetSendBufferSize() >= options.send_buffer_size);
+    conn_sock.SetNoDelay(false);
+    CHECK(!conn_sock.GetNoDelay());
+
+    // failures on an accepted socket are reported, not thrown
+    int pipe_fds[2];
+    REQUIRE(pipe(pipe_fds) == 0);
+    Socket not_a_socket(pipe_fds[0]);
+    close(pipe_fds[1]);
+    bool applied = true;
+    CHECK_NOTHROW(applied = not_a_socket.ApplyConnectionOptions(options));
+    CHECK(!applied);
+    CHECK_THROWS(not_a_socket.ApplyListenerOptions(options));
+  }
+
+  SECTION("busy poll option") {
+    Socket sock;
+    sock.Bind(local_host);
+    CHECK(sock.GetBusyPoll() == 0);
+    try {
+      sock.SetBusyPoll(50);
+      CHECK(sock.GetBusyPoll() == 50);
+    } catch (const std::logic_error &) {
+      // raising SO_BUSY_POLL requires CAP_NET_ADMIN
+      WARN("SO_BUSY_POLL not permitted for this process");
+    }
+  }
 }
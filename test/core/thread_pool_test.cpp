@@ -5,10 +5,21 @@
 #include "core/thread_pool.h"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "catch2/catch_test_macros.hpp"
+#include "core/mpmc_queue.h"
 
 /* for convenience reason */
+using Next::MpmcQueue;
 using Next::ThreadPool;
 
 TEST_CASE("[core/thread_pool]") {
@@ -27,4 +38,190 @@ TEST_CASE("[core/thread_pool]") {
     }
     CHECK(var == 3 * thread_pool_size);
   }
+
+  SECTION("submit a batch of tasks and collect their results") {
+    std::vector<std::function<int()>> tasks;
+    for (int i = 0; i < 100; i++) {
+      tasks.emplace_back([i]() { return i * i; });
+    }
+    auto futs = pool.SubmitBatch(std::move(tasks));
+    REQUIRE(futs.size() == 100);
+    for (int i = 0; i < 100; i++) {
+      CHECK(futs[i].get() == i * i);
+    }
+  }
+
+  SECTION("tasks beyond the queue capacity overflow instead of being lost") {
+    std::atomic<int> var = 0;
+    {
+      ThreadPool small_pool(2, 4);
+      std::vector<std::function<void()>> tasks(1000, [&]() { var++; });
+      small_pool.SubmitBatch(std::move(tasks));
+    }
+    CHECK(var == 1000);
+  }
+}
+
+TEST_CASE("[core/mpmc_queue]") {
+  MpmcQueue<int> queue(5);
+  REQUIRE(queue.Capacity() == 8);
+
+  SECTION("bounded fifo in a single thread") {
+    for (int i = 0; i < 8; i++) {
+      int item = i;
+      CHECK(queue.TryPush(std::move(item)));
+    }
+    int overflow = 8;
+    CHECK(!queue.TryPush(std::move(overflow)));
+    for (int i = 0; i < 8; i++) {
+      int item = -1;
+      CHECK(queue.TryPop(item));
+      CHECK(item == i);
+    }
+    int item = -1;
+    CHECK(!queue.TryPop(item));
+  }
+
+  SECTION("every item is consumed exactly once by concurrent producers and consumers") {
+    const int producers = 4;
+    const int per_producer = 20000;
+    std::atomic<long long> sum = 0;
+    std::atomic<int> consumed = 0;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+      threads.emplace_back([&, p]() {
+        for (int i = 1; i <= per_producer; i++) {
+          int item = p * per_producer + i;
+          while (!queue.TryPush(std::move(item))) {
+            std::this_thread::yield();
+          }
+        }
+      });
+      threads.emplace_back([&]() {
+        int item;
+        while (consumed < producers * per_producer) {
+          if (queue.TryPop(item)) {
+            sum += item;
+            consumed++;
+          }
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    long long n = static_cast<long long>(producers) * per_producer;
+    CHECK(consumed == n);
+    CHECK(sum == n * (n + 1) / 2);
+  }
+}
+
+/* the previous design, a std::queue guarded by one mutex and a notify per task, as the baseline */
+class LockedQueuePool {
+ public:
+  explicit LockedQueuePool(int size) {
+    for (int i = 0; i < size; i++) {
+      threads_.emplace_back([this]() {
+        while (true) {
+          std::function<void()> next_task;
+          {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this]() { return exit_ || !tasks_.empty(); });
+            if (exit_ && tasks_.empty()) {
+              return;
+            }
+            next_task = std::move(tasks_.front());
+            tasks_.pop();
+          }
+          next_task();
+        }
+      });
+    }
+  }
+  ~LockedQueuePool() {
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      exit_ = true;
+    }
+    cv_.notify_all();
+    for (auto &t : threads_) {
+      t.join();
+    }
+  }
+  auto Submit(std::function<void()> task) -> std::future<void> {
+    auto packaged_task = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    auto fut = packaged_task->get_future();
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      tasks_.emplace([packaged_task]() { (*packaged_task)(); });
+    }
+    cv_.notify_one();
+    return fut;
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool exit_{false};
+};
+
+TEST_CASE("[thread_pool_benchmark]", "[.benchmark]") {
+  const int pool_size = 4;
+  const int producers = 4;
+  const int total_tasks = 204800;
+  const int batch_size = 64;
+  std::atomic<int> done = 0;
+
+  auto measure = [&](const std::string &name, const std::function<void()> &run) {
+    done = 0;
+    auto begin = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+    CHECK(done == total_tasks);
+    std::cout << name << ": " << total_tasks << " tasks in " << micros << " us, "
+              << static_cast<double>(total_tasks) / static_cast<double>(micros) << " tasks/us" << std::endl;
+    return micros;
+  };
+  auto run_producers = [&](const std::function<void()> &produce) {
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+      threads.emplace_back(produce);
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  };
+
+  auto locked = measure("mutex queue, notify per task", [&]() {
+    LockedQueuePool pool(pool_size);
+    run_producers([&]() {
+      for (int i = 0; i < total_tasks / producers; i++) {
+        pool.Submit([&]() { done++; });
+      }
+    });
+  });
+
+  measure("lock-free queue, SubmitTask", [&]() {
+    ThreadPool pool(pool_size);
+    run_producers([&]() {
+      for (int i = 0; i < total_tasks / producers; i++) {
+        pool.SubmitTask([&]() { done++; });
+      }
+    });
+  });
+
+  auto batched = measure("lock-free queue, SubmitBatch", [&]() {
+    ThreadPool pool(pool_size);
+    run_producers([&]() {
+      for (int i = 0; i < total_tasks / producers / batch_size; i++) {
+        std::vector<std::function<void()>> tasks(batch_size, [&]() { done++; });
+        pool.SubmitBatch(std::move(tasks));
+      }
+    });
+  });
+  std::cout << "SubmitBatch is " << static_cast<double>(locked) / static_cast<double>(batched)
+            << " times faster than the mutex queue" << std::endl;
 }
@@ -0,0 +1,110 @@
+/**
+ * This is the unit test file for http/BodyDecoder class
+ */
+
+#include "http/body_decoder.h"
+
+#include <string>
+#include "catch2/catch_test_macros.hpp"
+#include "http/http_utils.h"
+#include "http/request.h"
+
+/* for convenience reason */
+using Next::Http::BodyDecoder;
+using Next::Http::BodyStatus;
+using Next::Http::Method;
+using Next::Http::Request;
+
+TEST_CASE("[http/body_decoder]") {
+  std::string body;
+  auto collect = [&](std::string_view data) { body.append(data); };
+
+  SECTION("content-length body stops at the declared size") {
+    auto decoder = BodyDecoder::MakeContentLengthDecoder(5);
+    CHECK(decoder.Decode("he", collect) == BodyStatus::INCOMPLETE);
+    CHECK(decoder.Consumed() == 2);
+    CHECK(decoder.Decode("lloGET /", collect) == BodyStatus::COMPLETE);
+    CHECK(decoder.Consumed() == 3);
+    CHECK(body == "hello");
+    CHECK(decoder.GetReceived() == 5);
+    CHECK(decoder.IsComplete());
+
+    auto empty = BodyDecoder::MakeContentLengthDecoder(0);
+    CHECK(empty.IsComplete());
+    CHECK(BodyDecoder().Decode("GET /", collect) == BodyStatus::COMPLETE);
+  }
+
+  SECTION("chunked body fed byte by byte") {
+    const std::string encoded =
+        "5;name=value\r\nhello\r\n"
+        "7\r\n, world\r\n"
+        "A\r\n0123456789\r\n"
+        "0\r\n"
+        "X-Trailer: yes\r\n"
+        "\r\n";
+    auto decoder = BodyDecoder::MakeChunkedDecoder();
+    BodyStatus status = BodyStatus::INCOMPLETE;
+    for (char c : encoded) {
+      REQUIRE(status == BodyStatus::INCOMPLETE);
+      status = decoder.Decode(std::string_view(&c, 1), collect);
+      REQUIRE(status != BodyStatus::ERROR);
+      CHECK(decoder.Consumed() == 1);
+    }
+    CHECK(status == BodyStatus::COMPLETE);
+    CHECK(body == "hello, world0123456789");
+    CHECK(decoder.GetReceived() == body.size());
+  }
+
+  SECTION("chunked body in one piece leaves the next request untouched") {
+    const std::string encoded = "3\r\nabc\r\n0\r\n\r\n";
+    auto decoder = BodyDecoder::MakeChunkedDecoder();
+    CHECK(decoder.Decode(encoded + "GET / HTTP/1.1\r\n", collect) == BodyStatus::COMPLETE);
+    CHECK(decoder.Consumed() == encoded.size());
+    CHECK(body == "abc");
+  }
+
+  SECTION("malformed chunked bodies are rejected") {
+    CHECK(BodyDecoder::MakeChunkedDecoder().Decode("\r\n", collect) == BodyStatus::ERROR);
+    CHECK(BodyDecoder::MakeChunkedDecoder().Decode("zz\r\n", collect) == BodyStatus::ERROR);
+    CHECK(BodyDecoder::MakeChunkedDecoder().Decode("3\r\nabcd\r\n", collect) == BodyStatus::ERROR);
+    CHECK(BodyDecoder::MakeChunkedDecoder().Decode("3\nabc", collect) == BodyStatus::ERROR);
+    CHECK(BodyDecoder::MakeChunkedDecoder().Decode("1000000000000000\r\n", collect) == BodyStatus::ERROR);
+    auto decoder = BodyDecoder::MakeChunkedDecoder();
+    CHECK(decoder.Decode(std::string(Next::Http::MAX_CHUNK_LINE_SIZE + 1, ' ').insert(0, "1;"), collect) ==
+          BodyStatus::ERROR);
+    CHECK(decoder.GetError() != nullptr);
+  }
+
+  SECTION("request headers select the body framing") {
+    Request put{
+        "PUT /upload.txt HTTP/1.1\r\n"
+        "Content-Length: 1024\r\n"
+        "Expect: 100-continue\r\n"
+        "\r\n"};
+    REQUIRE(put.IsValid());
+    CHECK(put.GetMethod() == Method::PUT);
+    CHECK(put.HasBody());
+    CHECK(!put.IsChunked());
+    CHECK(put.GetContentLength() == 1024);
+    CHECK(put.ExpectContinue());
+
+    Request post{
+        "POST /upload.txt HTTP/1.1\r\n"
+        "Content-Length: 10\r\n"
+        "Transfer-Encoding: gzip, chunked\r\n"
+        "\r\n"};
+    REQUIRE(post.IsValid());
+    CHECK(post.IsChunked());
+    auto decoder = post.MakeBodyDecoder();
+    CHECK(decoder.Decode("0\r\n\r\n", collect) == BodyStatus::COMPLETE);
+
+    Request get{"GET / HTTP/1.1\r\n\r\n"};
+    CHECK(!get.HasBody());
+    CHECK(get.MakeBodyDecoder().IsComplete());
+
+    CHECK(!Request("PUT / HTTP/1.1\r\nContent-Length: 12abc\r\n\r\n").IsValid());
+    CHECK(!Request("PUT / HTTP/1.1\r\nContent-Length: -1\r\n\r\n").IsValid());
+    CHECK(!Request("PUT / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n").IsValid());
+    CHECK(!Request("PUT / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n").IsValid());
+  }
+}
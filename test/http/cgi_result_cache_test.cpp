@@ -0,0 +1,277 @@
+/**
+ * This is the unit test file for http/CgiResultCache class
+ */
+
+#include "http/cgi_result_cache.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "core/looper.h"
+#include "http/cgi_worker_pool.h"
+#include "http/cgier.h"
+#include "http/http_utils.h"
+
+/* for convenience reason */
+using Next::Looper;
+using Next::Http::BodyStream;
+using Next::Http::CgiCachedStream;
+using Next::Http::Cgier;
+using Next::Http::CgiResultCache;
+using Next::Http::CgiStream;
+using Next::Http::CgiWorkerPool;
+using Next::Http::CgiWorkerStream;
+using Next::Http::IsFileExists;
+using Next::Http::StreamStatus;
+
+/* 在looper上启动一个流，每次可读时读到没有数据为止，和连接上的读取方式相同 */
+struct StreamReader {
+  explicit StreamReader(std::shared_ptr<BodyStream> stream) : stream_(std::move(stream)) {}
+
+  void Start(Looper *looper) {
+    looper->RunInLoop([this, looper]() {
+      if (!stream_->Start(looper, [this]() { ReadAvailable(); })) {
+        status_ = StreamStatus::ERROR;
+        done_ = true;
+        return;
+      }
+      ReadAvailable();
+    });
+  }
+
+  void ReadAvailable() {
+    if (done_) {
+      return;
+    }
+    StreamStatus status;
+    while ((status = stream_->Read(output_, 4)) == StreamStatus::DATA) {
+    }
+    if (status != StreamStatus::PENDING) {
+      status_ = status;
+      done_ = true;
+    }
+  }
+
+  auto Wait() -> bool {
+    for (int i = 0; i < 200 && !done_; i++) {
+      usleep(10 * 1000);
+    }
+    return done_;
+  }
+
+  std::shared_ptr<BodyStream> stream_;
+  std::string output_;
+  StreamStatus status_{StreamStatus::PENDING};
+  std::atomic<bool> done_{false};
+};
+
+/* 一直没有输出，直到Finish才一次给出全部输出的流，模拟运行中的cgi程序 */
+class GatedStream : public BodyStream {
+ public:
+  explicit GatedStream(std::string output) : output_(std::move(output)) {}
+
+  auto Read(std::string &out, size_t /*max_size*/) -> StreamStatus override {
+    if (!finished_) {
+      return StreamStatus::PENDING;
+    }
+    if (output_.empty()) {
+      return StreamStatus::END;
+    }
+    out.append(output_);
+    output_.clear();
+    return StreamStatus::DATA;
+  }
+
+  auto IsNonBlocking() const noexcept -> bool override { return true; }
+
+  auto Start(Looper *looper, std::function<void()> on_readable) -> bool override {
+    looper_ = looper;
+    on_readable_ = std::move(on_readable);
+    return true;
+  }
+
+  /* 可在任意线程调用 */
+  void Finish() {
+    looper_->RunInLoop([this]() {
+      finished_ = true;
+      on_readable_();
+    });
+  }
+
+ private:
+  std::string output_;
+  bool finished_{false};
+  Looper *looper_{nullptr};
+  std::function<void()> on_readable_;
+};
+
+TEST_CASE("[http/cgi_result_cache]") {
+  REQUIRE(IsFileExists("./add"));
+  Looper looper;
+  std::thread runner([&]() { looper.Loop(); });
+  auto cache = std::make_shared<CgiResultCache>(1024);
+
+  SECTION("keys separate program and arguments") {
+    CHECK(CgiResultCache::MakeKey("./add", {"1", "2"}) != CgiResultCache::MakeKey("./add", {"12"}));
+    CHECK(CgiResultCache::MakeKey("./add", {"1", "2"}) == CgiResultCache::MakeKey("./add", {"1", "2"}));
+    CHECK(cache->GetTtl("./add") == 0);
+    cache->SetTtl("./add", 1000);
+    CHECK(cache->GetTtl("./add") == 1000);
+    cache->SetTtl("./add", 0);
+    CHECK(cache->GetTtl("./add") == 0);
+  }
+
+  SECTION("repeated calls are served from memory") {
+    std::atomic<int> spawned = 0;
+    auto key = CgiResultCache::MakeKey("./add", {"20", "22"});
+    auto factory = [&]() -> std::shared_ptr<BodyStream> {
+      spawned++;
+      return std::make_shared<CgiStream>(Cgier("./add", {"20", "22"}));
+    };
+    for (int i = 0; i < 3; i++) {
+      StreamReader reader(std::make_shared<CgiCachedStream>(cache, key, 60 * 1000, factory));
+      reader.Start(&looper);
+      REQUIRE(reader.Wait());
+      CHECK(reader.status_ == StreamStatus::END);
+      CHECK(reader.output_ == "cgi program add(20, 22) = 42\n");
+    }
+    CHECK(spawned == 1);
+    REQUIRE(cache->Lookup(key) != nullptr);
+    CHECK(cache->GetOccupancy() == std::string("cgi program add(20, 22) = 42\n").size());
+  }
+
+  SECTION("output of persistent workers is cached") {
+    // worker的最后一段输出和END在同一次读取中返回
+    auto pool = std::make_shared<CgiWorkerPool>("./add", 1);
+    auto key = CgiResultCache::MakeKey("./add", {"3", "4"});
+    auto factory = [&]() -> std::shared_ptr<BodyStream> {
+      return std::make_shared<CgiWorkerStream>(pool, std::vector<std::string>{"3", "4"});
+    };
+    for (int i = 0; i < 2; i++) {
+      StreamReader reader(std::make_shared<CgiCachedStream>(cache, key, 60 * 1000, factory));
+      reader.Start(&looper);
+      REQUIRE(reader.Wait());
+      CHECK(reader.output_ == "cgi program add(3, 4) = 7\n");
+    }
+    auto cached = cache->Lookup(key);
+    REQUIRE(cached != nullptr);
+    CHECK(std::string(cached->begin(), cached->end()) == "cgi program add(3, 4) = 7\n");
+  }
+
+  SECTION("concurrent identical calls run the program once") {
+    std::vector<std::shared_ptr<GatedStream>> spawned;
+    auto factory = [&]() -> std::shared_ptr<BodyStream> {
+      spawned.push_back(std::make_shared<GatedStream>("result\n"));
+      return spawned.back();
+    };
+    std::vector<std::unique_ptr<StreamReader>> readers;
+    for (int i = 0; i < 5; i++) {
+      readers.push_back(
+          std::make_unique<StreamReader>(std::make_shared<CgiCachedStream>(cache, "same", 60 * 1000, factory)));
+      readers.back()->Start(&looper);
+    }
+    for (int i = 0; i < 100 && cache->GetCoalescedCount() < 4; i++) {
+      usleep(10 * 1000);
+    }
+    REQUIRE(spawned.size() == 1);
+    CHECK(cache->GetCoalescedCount() == 4);
+    spawned[0]->Finish();
+    for (auto &reader : readers) {
+      REQUIRE(reader->Wait());
+      CHECK(reader->status_ == StreamStatus::END);
+      CHECK(reader->output_ == "result\n");
+    }
+    CHECK(spawned.size() == 1);
+  }
+
+  SECTION("an abandoned leader hands over to a waiting call") {
+    std::vector<std::shared_ptr<GatedStream>> spawned;
+    std::atomic<size_t> spawn_count = 0;
+    auto factory = [&]() -> std::shared_ptr<BodyStream> {
+      spawned.push_back(std::make_shared<GatedStream>("result\n"));
+      spawn_count++;
+      return spawned.back();
+    };
+    auto leader = std::make_unique<StreamReader>(std::make_shared<CgiCachedStream>(cache, "same", 60 * 1000, factory));
+    StreamReader follower(std::make_shared<CgiCachedStream>(cache, "same", 60 * 1000, factory));
+    leader->Start(&looper);
+    follower.Start(&looper);
+    for (int i = 0; i < 100 && cache->GetCoalescedCount() < 1; i++) {
+      usleep(10 * 1000);
+    }
+    REQUIRE(spawned.size() == 1);
+    // 在looper线程上销毁领头的调用，例如客户端断开
+    std::atomic<bool> destroyed = false;
+    looper.RunInLoop([&]() {
+      leader.reset();
+      destroyed = true;
+    });
+    for (int i = 0; i < 100 && spawn_count < 2; i++) {
+      usleep(10 * 1000);
+    }
+    REQUIRE(destroyed);
+    REQUIRE(spawn_count == 2);
+    spawned[1]->Finish();
+    REQUIRE(follower.Wait());
+    CHECK(follower.status_ == StreamStatus::END);
+    CHECK(follower.output_ == "result\n");
+    CHECK(cache->Lookup("same") != nullptr);
+  }
+
+  SECTION("results expire after the ttl") {
+    std::atomic<int> spawned = 0;
+    auto factory = [&]() -> std::shared_ptr<BodyStream> {
+      spawned++;
+      return std::make_shared<CgiStream>(Cgier("./add", {"1", "1"}));
+    };
+    for (int i = 0; i < 2; i++) {
+      StreamReader reader(std::make_shared<CgiCachedStream>(cache, "short", 20, factory));
+      reader.Start(&looper);
+      REQUIRE(reader.Wait());
+      CHECK(reader.output_ == "cgi program add(1, 1) = 2\n");
+      usleep(40 * 1000);
+    }
+    CHECK(spawned == 2);
+    CHECK(cache->Lookup("short") == nullptr);
+  }
+
+  SECTION("failed and oversized results are not cached") {
+    auto failing = []() -> std::shared_ptr<BodyStream> {
+      return std::make_shared<CgiStream>(Cgier("./not_a_program", {}));
+    };
+    StreamReader failed(std::make_shared<CgiCachedStream>(cache, "failing", 60 * 1000, failing));
+    failed.Start(&looper);
+    REQUIRE(failed.Wait());
+    CHECK(failed.status_ == StreamStatus::ERROR);
+    CHECK(cache->Lookup("failing") == nullptr);
+
+    std::shared_ptr<GatedStream> large;
+    std::atomic<bool> started = false;
+    auto oversized = [&]() -> std::shared_ptr<BodyStream> {
+      large = std::make_shared<GatedStream>(std::string(2048, 'x'));
+      started = true;
+      return large;
+    };
+    StreamReader reader(std::make_shared<CgiCachedStream>(cache, "large", 60 * 1000, oversized));
+    reader.Start(&looper);
+    for (int i = 0; i < 100 && !started; i++) {
+      usleep(10 * 1000);
+    }
+    REQUIRE(started);
+    large->Finish();
+    REQUIRE(reader.Wait());
+    CHECK(reader.status_ == StreamStatus::END);
+    CHECK(reader.output_.size() == 2048);
+    CHECK(cache->Lookup("large") == nullptr);
+  }
+
+  looper.Exit();
+  looper.RunInLoop([]() {});
+  runner.join();
+}
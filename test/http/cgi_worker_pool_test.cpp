@@ -0,0 +1,176 @@
+/**
+ * This is the unit test file for http/CgiWorkerPool class
+ */
+
+#include "http/cgi_worker_pool.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <csignal>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "catch2/catch_test_macros.hpp"
+#include "core/looper.h"
+#include "http/http_utils.h"
+
+/* for convenience reason */
+using Next::Looper;
+using Next::Http::AppendCgiFrame;
+using Next::Http::CgiFrameType;
+using Next::Http::CgiWorkerPool;
+using Next::Http::CgiWorkerStream;
+using Next::Http::IsFileExists;
+using Next::Http::StreamStatus;
+
+/* 在looper上启动一个流，每次可读时读到没有数据为止，和连接上的读取方式相同 */
+struct StreamReader {
+  explicit StreamReader(std::shared_ptr<CgiWorkerStream> stream) : stream_(std::move(stream)) {}
+
+  void Start(Looper *looper) {
+    looper->RunInLoop([this, looper]() {
+      if (!stream_->Start(looper, [this]() { ReadAvailable(); })) {
+        status_ = StreamStatus::ERROR;
+        done_ = true;
+        return;
+      }
+      ReadAvailable();
+    });
+  }
+
+  void ReadAvailable() {
+    if (done_) {
+      return;
+    }
+    StreamStatus status;
+    while ((status = stream_->Read(output_, 4)) == StreamStatus::DATA) {
+    }
+    if (status != StreamStatus::PENDING) {
+      status_ = status;
+      done_ = true;
+    }
+  }
+
+  auto Wait() -> bool {
+    for (int i = 0; i < 200 && !done_; i++) {
+      usleep(10 * 1000);
+    }
+    return done_;
+  }
+
+  std::shared_ptr<CgiWorkerStream> stream_;
+  std::string output_;
+  StreamStatus status_{StreamStatus::PENDING};
+  std::atomic<bool> done_{false};
+};
+
+TEST_CASE("[http/cgi_worker_pool]") {
+  REQUIRE(IsFileExists("./add"));
+  Looper looper;
+  std::thread runner([&]() { looper.Loop(); });
+
+  SECTION("frames carry type and big-endian length") {
+    std::string frame;
+    AppendCgiFrame(CgiFrameType::ARGS, std::string("1\0" "2\0", 4), frame);
+    REQUIRE(frame.size() == Next::Http::CGI_FRAME_HEADER_SIZE + 4);
+    CHECK(frame[0] == static_cast<char>(CgiFrameType::ARGS));
+    CHECK(frame.substr(4, 4) == std::string("\0\0\0\4", 4));
+    CHECK(frame.substr(8) == std::string("1\0" "2\0", 4));
+  }
+
+  SECTION("workers are reused across requests") {
+    auto pool = std::make_shared<CgiWorkerPool>("./add", 2);
+    CHECK(pool->GetSize() == 2);
+    CHECK(pool->GetIdleCount() == 2);
+    for (int i = 0; i < 20; i++) {
+      StreamReader reader(std::make_shared<CgiWorkerStream>(pool, std::vector<std::string>{std::to_string(i), "1"}));
+      reader.Start(&looper);
+      REQUIRE(reader.Wait());
+      CHECK(reader.status_ == StreamStatus::END);
+      CHECK(reader.output_ == "cgi program add(" + std::to_string(i) + ", 1) = " + std::to_string(i + 1) + "\n");
+    }
+    CHECK(pool->GetRestartCount() == 0);
+    CHECK(pool->GetIdleCount() == 2);
+  }
+
+  SECTION("requests queue while all workers are busy") {
+    auto pool = std::make_shared<CgiWorkerPool>("./add", 1);
+    std::vector<std::unique_ptr<StreamReader>> readers;
+    for (int i = 0; i < 5; i++) {
+      readers.push_back(std::make_unique<StreamReader>(
+          std::make_shared<CgiWorkerStream>(pool, std::vector<std::string>{std::to_string(i), std::to_string(i)})));
+    }
+    for (auto &reader : readers) {
+      reader->Start(&looper);
+    }
+    for (size_t i = 0; i < readers.size(); i++) {
+      REQUIRE(readers[i]->Wait());
+      CHECK(readers[i]->status_ == StreamStatus::END);
+      CHECK(readers[i]->output_ ==
+            "cgi program add(" + std::to_string(i) + ", " + std::to_string(i) + ") = " + std::to_string(2 * i) + "\n");
+    }
+    CHECK(pool->GetQueueLength() == 0);
+    CHECK(pool->GetIdleCount() == 1);
+  }
+
+  SECTION("a crashed worker is restarted by the health check") {
+    auto pool = std::make_shared<CgiWorkerPool>("./add", 1);
+    bool rejected;
+    auto *worker = pool->Acquire(&looper, nullptr, rejected);
+    REQUIRE(worker != nullptr);
+    pid_t old_pid = worker->pid_;
+    pool->Release(worker, true);
+    kill(old_pid, SIGKILL);
+    usleep(50 * 1000);
+
+    StreamReader reader(std::make_shared<CgiWorkerStream>(pool, std::vector<std::string>{"20", "22"}));
+    reader.Start(&looper);
+    REQUIRE(reader.Wait());
+    CHECK(reader.status_ == StreamStatus::END);
+    CHECK(reader.output_ == "cgi program add(20, 22) = 42\n");
+    CHECK(pool->GetRestartCount() == 1);
+    CHECK(worker->pid_ != old_pid);
+  }
+
+  SECTION("an abandoned response restarts its worker") {
+    auto pool = std::make_shared<CgiWorkerPool>("./add", 1);
+    {
+      auto reader = std::make_unique<StreamReader>(
+          std::make_shared<CgiWorkerStream>(pool, std::vector<std::string>{"1", "2"}));
+      // 在looper线程上启动后立即销毁，不读取响应
+      std::atomic<bool> destroyed = false;
+      looper.RunInLoop([&]() {
+        CHECK(reader->stream_->Start(&looper, []() {}));
+        reader.reset();
+        destroyed = true;
+      });
+      for (int i = 0; i < 100 && !destroyed; i++) {
+        usleep(10 * 1000);
+      }
+      REQUIRE(destroyed);
+    }
+    CHECK(pool->GetRestartCount() == 1);
+    CHECK(pool->GetIdleCount() == 1);
+
+    StreamReader reader(std::make_shared<CgiWorkerStream>(pool, std::vector<std::string>{"3", "4"}));
+    reader.Start(&looper);
+    REQUIRE(reader.Wait());
+    CHECK(reader.output_ == "cgi program add(3, 4) = 7\n");
+  }
+
+  SECTION("a program without the worker protocol fails instead of hanging") {
+    auto pool = std::make_shared<CgiWorkerPool>("./helloworld", 1);
+    StreamReader reader(std::make_shared<CgiWorkerStream>(pool, std::vector<std::string>{}));
+    reader.Start(&looper);
+    REQUIRE(reader.Wait());
+    CHECK(reader.status_ == StreamStatus::ERROR);
+  }
+
+  looper.Exit();
+  looper.RunInLoop([]() {});
+  runner.join();
+}
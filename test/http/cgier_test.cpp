@@ -4,12 +4,29 @@
 
 #include "http/cgier.h"
 
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
 #include "catch2/catch_test_macros.hpp"
+#include "core/looper.h"
 #include "http/http_utils.h"
 
 /* for convenience reason */
+using Next::Looper;
 using Next::Http::Cgier;
+using Next::Http::CgiStream;
 using Next::Http::IsFileExists;
+using Next::Http::StreamStatus;
 
 TEST_CASE("[http/response]") {
   // run two sample cgi program to test result
@@ -39,4 +56,148 @@ TEST_CASE("[http/response]") {
 
     CHECK(ret_str == expected_str);
   }
+
+  SECTION("cgi output can be read as a stream") {
+    CgiStream stream(Cgier("./add", {"20", "22"}));
+    std::string output;
+    StreamStatus status;
+    // 每次最多读取4个字节，直到程序退出且管道读完
+    size_t last_size = 0;
+    while ((status = stream.Read(output, 4)) == StreamStatus::DATA) {
+      CHECK(output.size() > last_size);
+      CHECK(output.size() - last_size <= 4);
+      last_size = output.size();
+    }
+    CHECK(status == StreamStatus::END);
+    CHECK(output == "cgi program add(20, 22) = 42\n");
+    CHECK(stream.Read(output, 4) == StreamStatus::END);
+  }
+
+  SECTION("a missing cgi program fails to launch") {
+    // posix_spawn在父进程中就能得知execve失败，不再产生一个没有输出的子进程
+    int read_fd = -1;
+    CHECK(Cgier("./not_a_program", {"1"}).Spawn(read_fd) == -1);
+    CHECK(read_fd == -1);
+    CgiStream stream(Cgier("./not_a_program", {"1"}));
+    std::string output;
+    CHECK(stream.Read(output, 1024) == StreamStatus::ERROR);
+    CHECK(output.empty());
+  }
+
+  SECTION("cgi output is read from a non-blocking pipe on the looper") {
+    Looper looper;
+    CgiStream stream(Cgier("./add", {"20", "22"}));
+    std::string output;
+    std::atomic<bool> started = false;
+    std::atomic<bool> ended = false;
+    // 每次管道可读时读到没有数据为止，和连接上的读取方式相同
+    auto read_available = [&]() {
+      StreamStatus status;
+      while ((status = stream.Read(output, 4)) == StreamStatus::DATA) {
+      }
+      ended = status == StreamStatus::END;
+    };
+    std::thread runner([&]() { looper.Loop(); });
+    looper.RunInLoop([&]() {
+      started = stream.Start(&looper, read_available);
+      read_available();
+    });
+    for (int i = 0; i < 100 && !ended; i++) {
+      usleep(10 * 1000);
+    }
+    // 留给pidfd回收子进程的时间
+    usleep(100 * 1000);
+    looper.Exit();
+    looper.RunInLoop([]() {});
+    runner.join();
+
+    CHECK(started);
+    CHECK(ended);
+    CHECK(output == "cgi program add(20, 22) = 42\n");
+    // 子进程已被looper回收，不再有需要等待的子进程
+    CHECK(waitpid(-1, nullptr, WNOHANG) == -1);
+    CHECK(errno == ECHILD);
+  }
+}
+
+/* 旧的启动方式: fork之后在子进程里重定向stdout再execve */
+static auto ForkProgram(const char *program, int &read_fd) -> pid_t {
+  int pipe_fds[2];
+  if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+    return -1;
+  }
+  char *argv[] = {const_cast<char *>(program), nullptr};
+  char *envp[] = {nullptr};
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(pipe_fds[1], STDOUT_FILENO);
+    execve(program, argv, envp);
+    _exit(1);
+  }
+  close(pipe_fds[1]);
+  read_fd = pipe_fds[0];
+  return pid;
+}
+
+/* 读完子进程的输出并回收它 */
+static auto Harvest(pid_t pid, int read_fd) -> std::string {
+  std::string output;
+  char buf[4096];
+  ssize_t read_size;
+  while ((read_size = read(read_fd, buf, sizeof buf)) > 0) {
+    output.append(buf, read_size);
+  }
+  close(read_fd);
+  waitpid(pid, nullptr, 0);
+  return output;
+}
+
+static auto ResidentSetMegabytes() -> long {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) {
+      return std::stol(line.substr(6)) / 1024;
+    }
+  }
+  return -1;
+}
+
+TEST_CASE("[http/cgier_benchmark]", "[.benchmark]") {
+  REQUIRE(IsFileExists("./helloworld"));
+  const std::string expected = "Hello World from no argument cgi program\n";
+  const int rounds = 100;
+  // 逐步增大常驻内存，模拟服务器的缓存和缓冲区不断增长
+  std::vector<std::vector<char>> heap;
+  size_t allocated = 0;
+  for (size_t megabytes : {0, 64, 256, 1024}) {
+    // 构造时写入每一页，保证它们都在常驻内存中
+    heap.emplace_back((megabytes - allocated) * 1024 * 1024, 1);
+    allocated = megabytes;
+    auto rss = ResidentSetMegabytes();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      int read_fd = -1;
+      pid_t pid = ForkProgram("./helloworld", read_fd);
+      REQUIRE(pid > 0);
+      CHECK(Harvest(pid, read_fd) == expected);
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto fork_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / rounds;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      Cgier cgier("./helloworld", {});
+      int read_fd = -1;
+      pid_t pid = cgier.Spawn(read_fd);
+      REQUIRE(pid > 0);
+      CHECK(Harvest(pid, read_fd) == expected);
+    }
+    end = std::chrono::steady_clock::now();
+    auto spawn_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / rounds;
+
+    std::cout << "RSS " << rss << " MB: fork + execve " << fork_us << " us, posix_spawn " << spawn_us
+              << " us per launch" << std::endl;
+  }
 }
@@ -0,0 +1,88 @@
+/**
+ * This is the unit test file for http/content_coding
+ */
+
+#include "http/content_coding.h"
+
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include "catch2/catch_test_macros.hpp"
+
+/* for convenience reason */
+using Next::Http::ContentCoding;
+using Next::Http::NegotiateContentCoding;
+
+/* 用zlib解压，windowBits为15 + 32时自动识别gzip和zlib格式 */
+static auto Inflate(const std::vector<unsigned char> &compressed) -> std::string {
+  z_stream stream{};
+  REQUIRE(inflateInit2(&stream, 15 + 32) == Z_OK);
+  std::string out(64 * 1024, '\0');
+  stream.next_in = const_cast<Bytef *>(compressed.data());
+  stream.avail_in = static_cast<uInt>(compressed.size());
+  stream.next_out = reinterpret_cast<Bytef *>(out.data());
+  stream.avail_out = static_cast<uInt>(out.size());
+  CHECK(inflate(&stream, Z_FINISH) == Z_STREAM_END);
+  out.resize(stream.total_out);
+  inflateEnd(&stream);
+  return out;
+}
+
+TEST_CASE("[http/content_coding]") {
+  SECTION("accept-encoding negotiation honors q-values") {
+    CHECK(NegotiateContentCoding("") == ContentCoding::IDENTITY);
+    CHECK(NegotiateContentCoding("gzip") == ContentCoding::GZIP);
+    CHECK(NegotiateContentCoding("deflate, gzip") == ContentCoding::GZIP);
+    CHECK(NegotiateContentCoding("GZIP;q=0.5, deflate") == ContentCoding::DEFLATE);
+    CHECK(NegotiateContentCoding("gzip;q=0, deflate;q=0.001") == ContentCoding::DEFLATE);
+    CHECK(NegotiateContentCoding("gzip; q=0, deflate ;Q=0.000") == ContentCoding::IDENTITY);
+    CHECK(NegotiateContentCoding("br, identity") == ContentCoding::IDENTITY);
+    CHECK(NegotiateContentCoding("br, *;q=0.1") == ContentCoding::GZIP);
+    CHECK(NegotiateContentCoding("*;q=0.5, deflate;q=0.8") == ContentCoding::DEFLATE);
+    CHECK(NegotiateContentCoding("*, gzip;q=0") == ContentCoding::DEFLATE);
+    CHECK(NegotiateContentCoding("gzip;q=2") == ContentCoding::IDENTITY);
+    CHECK(NegotiateContentCoding("x-gzip") == ContentCoding::GZIP);
+  }
+
+  SECTION("only text-like files within the size limits are compressed") {
+    CHECK(Next::Http::IsCompressible("text/html", 1024));
+    CHECK(Next::Http::IsCompressible("application/json", 1024));
+    CHECK(Next::Http::IsCompressible("image/svg+xml", 1024));
+    CHECK(!Next::Http::IsCompressible("image/png", 1024));
+    CHECK(!Next::Http::IsCompressible("application/gzip", 1024));
+    CHECK(!Next::Http::IsCompressible("text/html", Next::Http::MIN_COMPRESS_SIZE - 1));
+    CHECK(!Next::Http::IsCompressible("text/html", Next::Http::MAX_COMPRESS_SIZE + 1));
+  }
+
+  SECTION("each coding has its own strong etag") {
+    CHECK(Next::Http::ContentCodingETag("\"1-2-3\"", ContentCoding::IDENTITY) == "\"1-2-3\"");
+    CHECK(Next::Http::ContentCodingETag("\"1-2-3\"", ContentCoding::GZIP) == "\"1-2-3-gzip\"");
+    CHECK(Next::Http::ContentCodingETag("\"1-2-3\"", ContentCoding::DEFLATE) == "\"1-2-3-deflate\"");
+  }
+
+  SECTION("gzip and deflate round trip through zlib") {
+    std::string text;
+    for (int i = 0; i < 1000; i++) {
+      text += "<p>hello world " + std::to_string(i % 10) + "</p>\n";
+    }
+    const auto *data = reinterpret_cast<const unsigned char *>(text.data());
+    std::vector<unsigned char> gzip{'x'};
+    REQUIRE(Next::Http::Compress(data, text.size(), ContentCoding::GZIP, gzip));
+    // 追加在原有内容之后，gzip格式以1f 8b开头
+    CHECK(gzip[0] == 'x');
+    gzip.erase(gzip.begin());
+    CHECK(gzip[0] == 0x1f);
+    CHECK(gzip[1] == 0x8b);
+    CHECK(gzip.size() * 10 < text.size());
+    CHECK(Inflate(gzip) == text);
+
+    std::vector<unsigned char> deflate;
+    REQUIRE(Next::Http::Compress(data, text.size(), ContentCoding::DEFLATE, deflate));
+    CHECK(deflate[0] == 0x78);
+    CHECK(Inflate(deflate) == text);
+
+    std::vector<unsigned char> identity;
+    CHECK(!Next::Http::Compress(data, text.size(), ContentCoding::IDENTITY, identity));
+    CHECK(identity.empty());
+  }
+}
@@ -0,0 +1,139 @@
+/**
+ * This is the unit test file for http/FileMetaCache class
+ */
+
+#include "http/file_meta_cache.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+#include "catch2/catch_test_macros.hpp"
+
+/* for convenience reason */
+using Next::Http::FileMeta;
+using Next::Http::FileMetaCache;
+
+static void WriteFile(const std::string &path, const std::string &content) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << content;
+}
+
+/* 等待inotify线程处理完事件 */
+template <typename Predicate>
+static auto WaitFor(Predicate &&predicate) -> bool {
+  for (int i = 0; i < 200; i++) {
+    if (predicate()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return predicate();
+}
+
+TEST_CASE("[http/file_meta_cache]") {
+  auto dir = std::filesystem::temp_directory_path() / ("next_meta_" + std::to_string(getpid()));
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "sub");
+  WriteFile((dir / "index.html").string(), "hello");
+  WriteFile((dir / "sub" / "app.js").string(), "let a = 1;");
+
+  FileMetaCache cache(dir.string() + "/");
+  REQUIRE(cache.IsWatching());
+  CHECK(cache.GetServingDir() == dir.string());
+  std::mutex mtx;
+  std::vector<std::string> invalidated;
+  cache.OnInvalidate([&](const std::string &path) {
+    std::lock_guard<std::mutex> lock(mtx);
+    invalidated.push_back(path);
+  });
+  auto was_invalidated = [&](const std::string &path) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return std::find(invalidated.begin(), invalidated.end(), path) != invalidated.end();
+  };
+
+  SECTION("lookups of existing files are cached") {
+    auto meta = cache.Lookup("/index.html");
+    CHECK(meta.exists_);
+    CHECK(meta.size_ == 5);
+    CHECK(meta.mime_ == "text/html");
+    CHECK(meta.mtime_ > 0);
+    CHECK(!cache.Lookup("/missing.html").exists_);
+    CHECK(!cache.Lookup("/sub").exists_);
+    CHECK(cache.Lookup("/sub/app.js").size_ == 10);
+    // 不存在的文件和目录每次都stat
+    CHECK(cache.Size() == 2);
+    // 非规范的url每次都stat，不进入缓存
+    CHECK(cache.Lookup("/sub//app.js").exists_);
+    CHECK(cache.Lookup("/sub/../index.html").exists_);
+    CHECK(cache.Size() == 2);
+  }
+
+  SECTION("the least recently used entries are evicted without invalidating other caches") {
+    FileMetaCache small(dir.string(), 8);
+    bool notified = false;
+    small.OnInvalidate([&notified](const std::string & /*path*/) { notified = true; });
+    for (int i = 0; i < 8; i++) {
+      WriteFile((dir / ("f" + std::to_string(i))).string(), "x");
+      CHECK(small.Lookup("/f" + std::to_string(i)).exists_);
+    }
+    CHECK(small.Size() == 8);
+    // 达到上限时只淘汰一批，而不是清空整个表
+    for (int i = 0; i < 4; i++) {
+      CHECK(small.Lookup("/f0").exists_);
+      CHECK(small.Lookup(i % 2 == 0 ? "/index.html" : "/sub/app.js").exists_);
+      CHECK(small.Size() == 8);
+    }
+    CHECK(!notified);
+  }
+
+  SECTION("modified, created and deleted files are invalidated") {
+    auto before = cache.Lookup("/index.html");
+    CHECK(before.size_ == 5);
+    CHECK(before.GetETag().front() == '"');
+    CHECK(!cache.Lookup("/new.html").exists_);
+    CHECK(cache.Lookup("/sub/app.js").exists_);
+
+    WriteFile((dir / "index.html").string(), "hello world");
+    WriteFile((dir / "new.html").string(), "new");
+    std::filesystem::remove(dir / "sub" / "app.js");
+
+    CHECK(WaitFor([&]() { return cache.Lookup("/index.html").size_ == 11; }));
+    CHECK(cache.Lookup("/index.html").GetETag() != before.GetETag());
+    CHECK(WaitFor([&]() { return cache.Lookup("/new.html").exists_; }));
+    CHECK(WaitFor([&]() { return !cache.Lookup("/sub/app.js").exists_; }));
+    CHECK(was_invalidated(dir.string() + "/index.html"));
+    CHECK(was_invalidated(dir.string() + "/sub/app.js"));
+  }
+
+  SECTION("new and renamed directories are watched") {
+    CHECK(!cache.Lookup("/later/page.html").exists_);
+    CHECK(cache.Lookup("/sub/app.js").exists_);
+    std::filesystem::create_directories(dir / "later");
+    WriteFile((dir / "later" / "page.html").string(), "page");
+    CHECK(WaitFor([&]() { return cache.Lookup("/later/page.html").exists_; }));
+    WriteFile((dir / "later" / "page.html").string(), "page v2");
+    CHECK(WaitFor([&]() { return cache.Lookup("/later/page.html").size_ == 7; }));
+
+    std::filesystem::rename(dir / "sub", dir / "moved");
+    CHECK(WaitFor([&]() { return !cache.Lookup("/sub/app.js").exists_; }));
+    CHECK(cache.Lookup("/moved/app.js").exists_);
+  }
+
+  SECTION("stale results are not filled into other caches") {
+    auto meta = cache.Lookup("/index.html");
+    CHECK(cache.FillIfUnchanged(meta.generation_, []() {}));
+    WriteFile((dir / "index.html").string(), "changed");
+    CHECK(WaitFor([&]() { return was_invalidated(dir.string() + "/index.html"); }));
+    bool filled = false;
+    CHECK(!cache.FillIfUnchanged(meta.generation_, [&]() { filled = true; }));
+    CHECK(!filled);
+  }
+
+  std::filesystem::remove_all(dir);
+}
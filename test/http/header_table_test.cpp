@@ -0,0 +1,100 @@
+/**
+ * This is the unit test file for http/HeaderTable class
+ */
+
+#include "http/header_table.h"
+
+#include <string>
+#include "catch2/catch_test_macros.hpp"
+#include "http/header.h"
+#include "http/http_utils.h"
+#include "http/request.h"
+
+/* for convenience reason */
+using Next::Http::HeaderId;
+using Next::Http::HeaderIdToName;
+using Next::Http::HeaderTable;
+using Next::Http::Request;
+using Next::Http::ToHeaderId;
+
+TEST_CASE("[http/header_table]") {
+  SECTION("well-known header names map to ids regardless of case") {
+    CHECK(ToHeaderId("Connection") == HeaderId::CONNECTION);
+    CHECK(ToHeaderId("connection") == HeaderId::CONNECTION);
+    CHECK(ToHeaderId("CONTENT-LENGTH") == HeaderId::CONTENT_LENGTH);
+    CHECK(ToHeaderId("content-type") == HeaderId::CONTENT_TYPE);
+    CHECK(ToHeaderId("HoSt") == HeaderId::HOST);
+    CHECK(ToHeaderId("X-Forwarded-For") == HeaderId::UNKNOWN);
+    CHECK(ToHeaderId("Content_Length") == HeaderId::UNKNOWN);
+    CHECK(ToHeaderId("") == HeaderId::UNKNOWN);
+    for (size_t i = 0; i < Next::Http::WELL_KNOWN_HEADER_COUNT; i++) {
+      auto id = static_cast<HeaderId>(i);
+      CHECK(ToHeaderId(HeaderIdToName(id)) == id);
+    }
+  }
+
+  SECTION("known headers live in slots and unknown ones in the flat list") {
+    HeaderTable table;
+    table.Add("host", "www.gxjwiki.com");
+    table.Add("X-Trace", "abc");
+    CHECK(table.Size() == 2);
+    CHECK(table.Has(HeaderId::HOST));
+    CHECK(table.Get(HeaderId::HOST).value() == "www.gxjwiki.com");
+    CHECK(table.Get("HOST").value() == "www.gxjwiki.com");
+    CHECK(table.Get("x-trace").value() == "abc");
+    CHECK(!table.Get(HeaderId::CONNECTION).has_value());
+    CHECK(!table.Get("X-Missing").has_value());
+
+    // 重复的header合并为一个值
+    table.Add("Accept", "text/html");
+    table.Add("accept", "image/png");
+    table.Add("x-trace", "def");
+    CHECK(table.Get(HeaderId::ACCEPT).value() == "text/html, image/png");
+    CHECK(table.Get("X-Trace").value() == "abc, def");
+    CHECK(table.Size() == 3);
+
+    table.Set(HeaderId::HOST, "localhost");
+    table.Set("X-TRACE", "xyz");
+    CHECK(table.Get(HeaderId::HOST).value() == "localhost");
+    CHECK(table.Get("X-Trace").value() == "xyz");
+
+    CHECK(table.Erase(HeaderId::ACCEPT));
+    CHECK(!table.Erase(HeaderId::ACCEPT));
+    CHECK(table.Size() == 2);
+
+    table.Clear();
+    CHECK(table.Size() == 0);
+    CHECK(!table.Has(HeaderId::HOST));
+  }
+
+  SECTION("serialize well-known headers first in id order") {
+    HeaderTable table;
+    table.Set("X-Custom", "1");
+    table.Set(HeaderId::CONTENT_LENGTH, "10");
+    table.Set(HeaderId::SERVER, Next::Http::SERVER_NEXT);
+    std::string out;
+    table.Serialize(out);
+    CHECK(out == "Server:Next/1.0\r\nContent-Length:10\r\nX-Custom:1\r\n");
+
+    auto headers = table.ToHeaders();
+    REQUIRE(headers.size() == 3);
+    CHECK(headers[0].GetKey() == "Server");
+    CHECK(headers[2].GetKey() == "X-Custom");
+  }
+
+  SECTION("request exposes parsed headers by id") {
+    std::string request_str =
+        "GET /hello.html HTTP/1.1\r\n"
+        "host: www.gxjwiki.com\r\n"
+        "CONNECTION:  keep-alive \r\n"
+        "X-Trace: abc\r\n"
+        "\r\n";
+    Request request{request_str};
+    REQUIRE(request.IsValid());
+    CHECK(!request.ShouldClose());
+    CHECK(request.GetHeader(HeaderId::HOST).value() == "www.gxjwiki.com");
+    CHECK(request.GetHeader(HeaderId::CONNECTION).value() == "keep-alive");
+    CHECK(request.GetHeaderTable().Get("x-trace").value() == "abc");
+    CHECK(request.GetHeaders().size() == 3);
+  }
+}
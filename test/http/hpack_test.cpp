@@ -0,0 +1,173 @@
+/**
+ * This is the unit test file for http/hpack
+ */
+
+#include "http/hpack.h"
+
+#include <string>
+#include <vector>
+#include "catch2/catch_test_macros.hpp"
+
+/* for convenience reason */
+using Next::Http::HeaderField;
+using Next::Http::HpackDecoder;
+using Next::Http::HpackEncoder;
+
+/* "8286 8441" 这样的十六进制串转为字节 */
+static auto FromHex(const std::string &hex) -> std::string {
+  std::string bytes;
+  std::string digits;
+  for (char c : hex) {
+    if (c != ' ') {
+      digits.push_back(c);
+    }
+  }
+  for (size_t i = 0; i + 1 < digits.size(); i += 2) {
+    bytes.push_back(static_cast<char>(std::stoi(digits.substr(i, 2), nullptr, 16)));
+  }
+  return bytes;
+}
+
+static auto Decode(HpackDecoder &decoder, const std::string &hex) -> std::vector<HeaderField> {
+  std::vector<HeaderField> headers;
+  REQUIRE(decoder.Decode(FromHex(hex), headers));
+  return headers;
+}
+
+TEST_CASE("[http/hpack]") {
+  SECTION("huffman coding matches RFC 7541 examples") {
+    std::string encoded;
+    Next::Http::HuffmanEncode("www.example.com", encoded);
+    CHECK(encoded == FromHex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+    CHECK(Next::Http::HuffmanEncodedLength("www.example.com") == 12);
+    std::string decoded;
+    CHECK(Next::Http::HuffmanDecode(FromHex("a8eb 1064 9cbf"), decoded));
+    CHECK(decoded == "no-cache");
+
+    std::string all;
+    for (int c = 0; c < 256; c++) {
+      all.push_back(static_cast<char>(c));
+    }
+    encoded.clear();
+    decoded.clear();
+    Next::Http::HuffmanEncode(all, encoded);
+    CHECK(Next::Http::HuffmanDecode(encoded, decoded));
+    CHECK(decoded == all);
+
+    // 填充必须是不超过7位的1
+    CHECK(!Next::Http::HuffmanDecode(FromHex("00"), decoded));
+    CHECK(!Next::Http::HuffmanDecode(FromHex("ffff"), decoded));
+    // 完整的EOS
+    CHECK(!Next::Http::HuffmanDecode(FromHex("ffff fffc"), decoded));
+  }
+
+  SECTION("request examples without huffman share the dynamic table") {
+    HpackDecoder decoder;
+    auto first = Decode(decoder, "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d");
+    REQUIRE(first.size() == 4);
+    CHECK(first[0] == HeaderField(":method", "GET"));
+    CHECK(first[2] == HeaderField(":path", "/"));
+    CHECK(first[3] == HeaderField(":authority", "www.example.com"));
+    CHECK(decoder.GetTable().GetSize() == 57);
+
+    auto second = Decode(decoder, "8286 84be 5808 6e6f 2d63 6163 6865");
+    REQUIRE(second.size() == 5);
+    CHECK(second[3] == HeaderField(":authority", "www.example.com"));
+    CHECK(second[4] == HeaderField("cache-control", "no-cache"));
+    CHECK(decoder.GetTable().GetSize() == 110);
+
+    auto third = Decode(decoder,
+                        "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65");
+    REQUIRE(third.size() == 5);
+    CHECK(third[1] == HeaderField(":scheme", "https"));
+    CHECK(third[2] == HeaderField(":path", "/index.html"));
+    CHECK(third[4] == HeaderField("custom-key", "custom-value"));
+    CHECK(decoder.GetTable().GetSize() == 164);
+  }
+
+  SECTION("request examples with huffman") {
+    HpackDecoder decoder;
+    Decode(decoder, "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff");
+    Decode(decoder, "8286 84be 5886 a8eb 1064 9cbf");
+    auto third = Decode(decoder, "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf");
+    CHECK(third[4] == HeaderField("custom-key", "custom-value"));
+    CHECK(decoder.GetTable().GetSize() == 164);
+  }
+
+  SECTION("response examples evict the oldest entries") {
+    HpackDecoder decoder(256);
+    auto first = Decode(decoder,
+                        "4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 "
+                        "303a 3133 3a32 3120 474d 546e 1768 7474 7073 3a2f 2f77 7777 2e65 7861 6d70 6c65 2e63 "
+                        "6f6d");
+    CHECK(first[0] == HeaderField(":status", "302"));
+    CHECK(first[2] == HeaderField("date", "Mon, 21 Oct 2013 20:13:21 GMT"));
+    CHECK(decoder.GetTable().GetSize() == 222);
+    auto second = Decode(decoder, "4803 3330 37c1 c0bf");
+    CHECK(second[0] == HeaderField(":status", "307"));
+    CHECK(second[3] == HeaderField("location", "https://www.example.com"));
+    CHECK(decoder.GetTable().GetEntryCount() == 4);
+    CHECK(decoder.GetTable().GetSize() == 222);
+
+    HpackDecoder huffman(256);
+    auto encoded = Decode(huffman,
+                          "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0 82a6 "
+                          "2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 e9ae 82ae 43d3");
+    CHECK(encoded == first);
+  }
+
+  SECTION("malformed blocks are rejected") {
+    std::vector<HeaderField> headers;
+    // 索引0和超出表的索引
+    CHECK(!HpackDecoder().Decode(FromHex("80"), headers));
+    CHECK(!HpackDecoder().Decode(FromHex("be"), headers));
+    // 字符串长度超出块
+    CHECK(!HpackDecoder().Decode(FromHex("400a 6375"), headers));
+    // 大小更新超过通告的上限，或者出现在header之后
+    CHECK(!HpackDecoder().Decode(FromHex("3fe2 1f"), headers));
+    CHECK(!HpackDecoder().Decode(FromHex("82 20"), headers));
+    CHECK(HpackDecoder().Decode(FromHex("20 82"), headers));
+    // 整数溢出
+    CHECK(!HpackDecoder().Decode(FromHex("ff ffff ffff ff7f"), headers));
+  }
+
+  SECTION("encoder output round trips and reuses the dynamic table") {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    std::vector<HeaderField> response = {{":status", "200"},
+                                         {"server", "Next/1.0"},
+                                         {"content-type", "text/html"},
+                                         {"content-length", "1027055"},
+                                         {"date", "Mon, 21 Oct 2013 20:13:21 GMT"}};
+    std::vector<unsigned char> first;
+    encoder.BeginBlock(first);
+    for (const auto &[name, value] : response) {
+      encoder.Encode(name, value, first);
+    }
+    std::vector<HeaderField> decoded;
+    REQUIRE(decoder.Decode(std::string(first.begin(), first.end()), decoded));
+    CHECK(decoded == response);
+    // 只有server和content-type进入动态表
+    CHECK(encoder.GetTable().GetEntryCount() == 2);
+
+    std::vector<unsigned char> second;
+    encoder.BeginBlock(second);
+    encoder.Encode("server", "Next/1.0", second);
+    encoder.Encode("content-type", "text/html", second);
+    CHECK(second.size() == 2);
+    decoded.clear();
+    REQUIRE(decoder.Decode(std::string(second.begin(), second.end()), decoded));
+    CHECK(decoded[1] == HeaderField("content-type", "text/html"));
+
+    // 对端缩小动态表后，下一个块以大小更新开头
+    encoder.SetMaxTableSize(0);
+    std::vector<unsigned char> third;
+    encoder.BeginBlock(third);
+    encoder.Encode("server", "Next/1.0", third);
+    CHECK(third[0] == 0x20);
+    decoded.clear();
+    REQUIRE(decoder.Decode(std::string(third.begin(), third.end()), decoded));
+    CHECK(decoded[0] == HeaderField("server", "Next/1.0"));
+    CHECK(decoder.GetTable().GetEntryCount() == 0);
+  }
+}
@@ -0,0 +1,513 @@
+/**
+ * This is the unit test file for http/http2
+ */
+
+#include "http/http2.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "catch2/catch_test_macros.hpp"
+
+/* for convenience reason */
+using Next::Http::BodySlice;
+using Next::Http::HpackDecoder;
+using Next::Http::HpackEncoder;
+using Next::Http::HeaderField;
+using Next::Http::HeaderId;
+using Next::Http::Http2Error;
+using Next::Http::Http2FrameType;
+using Next::Http::Http2Session;
+using Next::Http::Method;
+using Next::Http::Request;
+using Next::Http::Response;
+
+struct Frame {
+  Http2FrameType type_;
+  uint8_t flags_;
+  uint32_t stream_id_;
+  std::string payload_;
+};
+
+static auto MakeFrame(Http2FrameType type, uint8_t flags, uint32_t stream_id, const std::string &payload)
+    -> std::string {
+  std::string frame;
+  frame.push_back(static_cast<char>(payload.size() >> 16));
+  frame.push_back(static_cast<char>(payload.size() >> 8));
+  frame.push_back(static_cast<char>(payload.size()));
+  frame.push_back(static_cast<char>(type));
+  frame.push_back(static_cast<char>(flags));
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    frame.push_back(static_cast<char>(stream_id >> shift));
+  }
+  return frame + payload;
+}
+
+static auto Uint32(uint32_t value) -> std::string {
+  return {static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8),
+          static_cast<char>(value)};
+}
+
+static auto Setting(uint16_t id, uint32_t value) -> std::string {
+  return std::string{static_cast<char>(id >> 8), static_cast<char>(id)} + Uint32(value);
+}
+
+static auto Headers(HpackEncoder &encoder, const std::vector<HeaderField> &fields) -> std::string {
+  std::vector<unsigned char> block;
+  encoder.BeginBlock(block);
+  for (const auto &[name, value] : fields) {
+    encoder.Encode(name, value, block);
+  }
+  return {block.begin(), block.end()};
+}
+
+static auto GetRequest(HpackEncoder &encoder, const std::string &path) -> std::string {
+  return Headers(encoder, {{":method", "GET"}, {":scheme", "http"}, {":path", path}, {":authority", "localhost"}});
+}
+
+/* 把会话的输出拼接起来并切成帧 */
+static auto TakeFrames(Http2Session &session) -> std::vector<Frame> {
+  std::string bytes;
+  for (const auto &slice : session.TakeOutput()) {
+    if (slice.block_ != nullptr) {
+      bytes.append(reinterpret_cast<const char *>(slice.block_->data()) + slice.offset_, slice.length_);
+    } else {
+      bytes.append(slice.bytes_);
+    }
+  }
+  std::vector<Frame> frames;
+  size_t pos = 0;
+  while (pos + 9 <= bytes.size()) {
+    auto length = (static_cast<size_t>(static_cast<uint8_t>(bytes[pos])) << 16) |
+                  (static_cast<size_t>(static_cast<uint8_t>(bytes[pos + 1])) << 8) |
+                  static_cast<uint8_t>(bytes[pos + 2]);
+    uint32_t stream_id = 0;
+    for (size_t i = 5; i < 9; i++) {
+      stream_id = (stream_id << 8) | static_cast<uint8_t>(bytes[pos + i]);
+    }
+    frames.push_back({static_cast<Http2FrameType>(bytes[pos + 3]), static_cast<uint8_t>(bytes[pos + 4]), stream_id,
+                      bytes.substr(pos + 9, length)});
+    pos += 9 + length;
+  }
+  REQUIRE(pos == bytes.size());
+  return frames;
+}
+
+static auto StartSession(Http2Session &session) -> std::string {
+  session.Start();
+  return std::string(Next::Http::HTTP2_CLIENT_PREFACE) + MakeFrame(Http2FrameType::SETTINGS, 0, 0, "");
+}
+
+TEST_CASE("[http/http2]") {
+  Http2Session session;
+  HpackEncoder encoder;
+
+  SECTION("preface detection accepts partial prefixes") {
+    CHECK(Next::Http::IsHttp2Preface("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"));
+    CHECK(Next::Http::IsHttp2Preface("PRI * HT"));
+    CHECK(!Next::Http::IsHttp2Preface("POST / HTTP/1.1\r\n"));
+    CHECK(!Next::Http::IsHttp2Preface("GET / HTTP/1.1\r\n"));
+  }
+
+  SECTION("a request is handed out once its header block is complete") {
+    auto input = StartSession(session);
+    input += MakeFrame(Http2FrameType::HEADERS, 0x4, 1, GetRequest(encoder, "/docs/"));
+    CHECK(session.Feed(input) == input.size());
+    auto frames = TakeFrames(session);
+    REQUIRE(frames.size() == 2);
+    CHECK(frames[0].type_ == Http2FrameType::SETTINGS);
+    CHECK(frames[0].flags_ == 0);
+    CHECK(frames[1].type_ == Http2FrameType::SETTINGS);
+    CHECK(frames[1].flags_ == 0x1);
+
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    REQUIRE(session.NextRequest(stream_id, request));
+    CHECK(stream_id == 1);
+    CHECK(request->IsValid());
+    CHECK(request->GetMethod() == Method::GET);
+    CHECK(request->GetResourceUrl() == "/docs/index.html");
+    CHECK(request->GetHeader(HeaderId::HOST).value_or("") == "localhost");
+    CHECK(!request->ShouldClose());
+    CHECK(!session.NextRequest(stream_id, request));
+
+    std::string body;
+    auto on_data = [&body](std::string_view data) { body.append(data); };
+    CHECK(session.ReadBody(1, on_data) == Next::Http::BodyStatus::INCOMPLETE);
+    auto end_stream = MakeFrame(Http2FrameType::DATA, 0x1, 1, "done");
+    CHECK(session.Feed(end_stream) == end_stream.size());
+    CHECK(session.ReadBody(1, on_data) == Next::Http::BodyStatus::COMPLETE);
+    CHECK(body == "done");
+    CHECK(session.ReadBody(3, on_data) == Next::Http::BodyStatus::ERROR);
+  }
+
+  SECTION("request bodies hold the receive windows until they are read") {
+    auto input = StartSession(session);
+    input += MakeFrame(Http2FrameType::HEADERS, 0x4, 1, GetRequest(encoder, "/upload"));
+    input += MakeFrame(Http2FrameType::HEADERS, 0x4, 3, GetRequest(encoder, "/other"));
+    session.Feed(input);
+    TakeFrames(session);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    REQUIRE(session.NextRequest(stream_id, request));
+    REQUIRE(session.NextRequest(stream_id, request));
+    // 没有读取之前不归还任何窗口
+    std::string chunk(16384, 'x');
+    for (int i = 0; i < 3; i++) {
+      session.Feed(MakeFrame(Http2FrameType::DATA, 0, 1, chunk));
+    }
+    CHECK(TakeFrames(session).empty());
+    size_t received = 0;
+    auto on_data = [&received](std::string_view data) { received += data.size(); };
+    CHECK(session.ReadBody(1, on_data) == Next::Http::BodyStatus::INCOMPLETE);
+    CHECK(received == 3 * chunk.size());
+    // 读走超过窗口一半的数据后，流和连接的窗口一起归还
+    auto frames = TakeFrames(session);
+    REQUIRE(frames.size() == 2);
+    CHECK(frames[0].type_ == Http2FrameType::WINDOW_UPDATE);
+    CHECK(frames[0].stream_id_ == 0);
+    CHECK(frames[0].payload_ == Uint32(3 * 16384));
+    CHECK(frames[1].type_ == Http2FrameType::WINDOW_UPDATE);
+    CHECK(frames[1].stream_id_ == 1);
+    CHECK(frames[1].payload_ == Uint32(3 * 16384));
+
+    // 连接窗口按所有流读走的总量归还，窗口变得比单个流的大
+    auto feed = [&session](uint32_t id, size_t size) {
+      for (; size > 16384; size -= 16384) {
+        session.Feed(MakeFrame(Http2FrameType::DATA, 0, id, std::string(16384, 'x')));
+      }
+      session.Feed(MakeFrame(Http2FrameType::DATA, 0, id, std::string(size, 'x')));
+    };
+    feed(1, 20000);
+    feed(3, 20000);
+    CHECK(session.ReadBody(1, on_data) == Next::Http::BodyStatus::INCOMPLETE);
+    CHECK(session.ReadBody(3, on_data) == Next::Http::BodyStatus::INCOMPLETE);
+    frames = TakeFrames(session);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0].stream_id_ == 0);
+    CHECK(frames[0].payload_ == Uint32(40000));
+    // 超过流的接收窗口时只重置这个流，它还没读取的数据归还连接窗口
+    feed(1, 65535 - 20000);
+    CHECK(TakeFrames(session).empty());
+    feed(1, 1);
+    frames = TakeFrames(session);
+    REQUIRE(frames.size() == 2);
+    CHECK(frames[0].type_ == Http2FrameType::RST_STREAM);
+    CHECK(frames[0].stream_id_ == 1);
+    CHECK(frames[0].payload_ == Uint32(static_cast<uint32_t>(Http2Error::FLOW_CONTROL_ERROR)));
+    CHECK(frames[1].type_ == Http2FrameType::WINDOW_UPDATE);
+    CHECK(frames[1].stream_id_ == 0);
+    CHECK(frames[1].payload_ == Uint32(65535 - 20000 + 1));
+    CHECK(session.ReadBody(1, on_data) == Next::Http::BodyStatus::ERROR);
+    CHECK(session.ReadBody(3, on_data) == Next::Http::BodyStatus::INCOMPLETE);
+    CHECK(!session.ShouldClose());
+  }
+
+  SECTION("data beyond the connection receive window is a connection error") {
+    auto input = StartSession(session);
+    for (uint32_t stream_id = 1; stream_id <= 9; stream_id += 2) {
+      input += MakeFrame(Http2FrameType::HEADERS, 0x4, stream_id, GetRequest(encoder, "/upload"));
+    }
+    session.Feed(input);
+    TakeFrames(session);
+    // 连接上缓存的请求体总量不超过连接的接收窗口
+    std::string chunk(16384, 'x');
+    for (uint32_t stream_id = 1; stream_id <= 7; stream_id += 2) {
+      session.Feed(MakeFrame(Http2FrameType::DATA, 0, stream_id, stream_id == 7 ? chunk.substr(1) : chunk));
+    }
+    CHECK(!session.ShouldClose());
+    session.Feed(MakeFrame(Http2FrameType::DATA, 0, 9, "x"));
+    auto frames = TakeFrames(session);
+    REQUIRE(!frames.empty());
+    CHECK(frames.back().type_ == Http2FrameType::GOAWAY);
+    CHECK(frames.back().payload_.substr(4) == Uint32(static_cast<uint32_t>(Http2Error::FLOW_CONTROL_ERROR)));
+    CHECK(session.ShouldClose());
+  }
+
+  SECTION("a response sent before the request body ends stops the upload") {
+    auto input = StartSession(session);
+    input += MakeFrame(Http2FrameType::HEADERS, 0x4, 1, GetRequest(encoder, "/"));
+    input += MakeFrame(Http2FrameType::DATA, 0x8, 1, std::string(1, '\x3') + "abc" + std::string(3, '\0'));
+    session.Feed(input);
+    TakeFrames(session);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    REQUIRE(session.NextRequest(stream_id, request));
+    session.Submit(1, Response::Make404Response(), {});
+    auto frames = TakeFrames(session);
+    REQUIRE(frames.size() == 2);
+    CHECK(frames[0].type_ == Http2FrameType::HEADERS);
+    CHECK(frames[1].type_ == Http2FrameType::RST_STREAM);
+    CHECK(frames[1].payload_ == Uint32(static_cast<uint32_t>(Http2Error::NO_ERROR)));
+    CHECK(session.GetStreamCount() == 0);
+    // 之后迟到的DATA直接忽略，不再回复RST_STREAM
+    for (int i = 0; i < 2; i++) {
+      session.Feed(MakeFrame(Http2FrameType::DATA, 0, 1, std::string(16384, 'x')));
+    }
+    frames = TakeFrames(session);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0].type_ == Http2FrameType::WINDOW_UPDATE);
+    CHECK(frames[0].stream_id_ == 0);
+    CHECK(frames[0].payload_ == Uint32(2 * 16384 + 7));
+  }
+
+  SECTION("incomplete frames are left for the next read") {
+    auto input = StartSession(session) + MakeFrame(Http2FrameType::HEADERS, 0x5, 1, GetRequest(encoder, "/"));
+    CHECK(session.Feed(input.substr(0, 10)) == 0);
+    auto consumed = session.Feed(input.substr(0, input.size() - 3));
+    CHECK(consumed < input.size());
+    CHECK(session.Feed(input.substr(consumed)) == input.size() - consumed);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    CHECK(session.NextRequest(stream_id, request));
+  }
+
+  SECTION("responses are split by the flow control windows and interleaved") {
+    // 流的初始窗口为0，提交时一个字节也不发
+    auto input = std::string(Next::Http::HTTP2_CLIENT_PREFACE) +
+                 MakeFrame(Http2FrameType::SETTINGS, 0, 0, Setting(0x4, 0));
+    input += MakeFrame(Http2FrameType::HEADERS, 0x5, 1, GetRequest(encoder, "/a"));
+    input += MakeFrame(Http2FrameType::HEADERS, 0x5, 3, GetRequest(encoder, "/b"));
+    session.Start();
+    session.Feed(input);
+    TakeFrames(session);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    auto body = std::make_shared<const std::vector<unsigned char>>(40000, 'x');
+    auto response = Response::MakeFileResponse(false, body->size(), "text/plain");
+    while (session.NextRequest(stream_id, request)) {
+      session.Submit(stream_id, response, {BodySlice::FromBlock(body)});
+    }
+    for (const auto &frame : TakeFrames(session)) {
+      CHECK(frame.type_ == Http2FrameType::HEADERS);
+    }
+    session.Feed(MakeFrame(Http2FrameType::SETTINGS, 0, 0, Setting(0x4, 65535)));
+    // 连接窗口65535，两个流各40000字节
+    size_t sent[4] = {0, 0, 0, 0};
+    std::vector<uint32_t> order;
+    for (const auto &frame : TakeFrames(session)) {
+      if (frame.type_ == Http2FrameType::DATA) {
+        CHECK(frame.payload_.size() <= Next::Http::HTTP2_DEFAULT_MAX_FRAME_SIZE);
+        sent[frame.stream_id_] += frame.payload_.size();
+        order.push_back(frame.stream_id_);
+      }
+    }
+    CHECK(sent[1] + sent[3] == 65535);
+    REQUIRE(order.size() >= 2);
+    CHECK(order[0] == 1);
+    CHECK(order[1] == 3);
+    CHECK(session.GetStreamCount() == 2);
+
+    // 连接窗口补充后剩下的部分发出，流结束
+    auto update = MakeFrame(Http2FrameType::WINDOW_UPDATE, 0, 0, Uint32(100000));
+    session.Feed(update);
+    bool ended[4] = {false, false, false, false};
+    for (const auto &frame : TakeFrames(session)) {
+      if (frame.type_ == Http2FrameType::DATA) {
+        sent[frame.stream_id_] += frame.payload_.size();
+        ended[frame.stream_id_] = (frame.flags_ & 0x1) != 0;
+      }
+    }
+    CHECK(sent[1] == 40000);
+    CHECK(sent[3] == 40000);
+    CHECK(ended[1]);
+    CHECK(ended[3]);
+    CHECK(session.GetStreamCount() == 0);
+  }
+
+  SECTION("streamed response bodies are submitted piece by piece") {
+    auto input = StartSession(session);
+    input += MakeFrame(Http2FrameType::HEADERS, 0x5, 1, GetRequest(encoder, "/a"));
+    input += MakeFrame(Http2FrameType::HEADERS, 0x5, 3, GetRequest(encoder, "/b"));
+    session.Feed(input);
+    TakeFrames(session);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    REQUIRE(session.NextRequest(stream_id, request));
+    auto response = Response::Make200Response(false, std::nullopt);
+    response.SetChunked();
+    session.Submit(1, response, {BodySlice::FromBytes("first")}, false);
+    auto frames = TakeFrames(session);
+    REQUIRE(frames.size() == 2);
+    // 响应体没有结束，HEADERS和DATA都不带END_STREAM
+    CHECK(frames[0].type_ == Http2FrameType::HEADERS);
+    CHECK(frames[0].flags_ == 0x4);
+    CHECK(frames[1].type_ == Http2FrameType::DATA);
+    CHECK(frames[1].flags_ == 0);
+    CHECK(frames[1].payload_ == "first");
+    HpackDecoder decoder;
+    std::vector<HeaderField> fields;
+    REQUIRE(decoder.Decode(frames[0].payload_, fields));
+    for (const auto &[name, value] : fields) {
+      CHECK(name != "transfer-encoding");
+      CHECK(name != "content-length");
+    }
+
+    CHECK(session.SubmitData(1, {BodySlice::FromBytes("second")}, false));
+    CHECK(session.SubmitData(1, {}, false));
+    frames = TakeFrames(session);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0].payload_ == "second");
+    CHECK(frames[0].flags_ == 0);
+    CHECK(session.GetStreamCount() == 2);
+
+    // 最后一段没有数据时用空的DATA帧结束流
+    CHECK(session.SubmitData(1, {}, true));
+    frames = TakeFrames(session);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0].type_ == Http2FrameType::DATA);
+    CHECK(frames[0].flags_ == 0x1);
+    CHECK(frames[0].payload_.empty());
+    CHECK(!session.SubmitData(1, {BodySlice::FromBytes("late")}, true));
+    CHECK(session.GetStreamCount() == 1);
+
+    // 流量控制窗口挡住的部分计入待发送的大小，客户端重置后不再接受数据
+    REQUIRE(session.NextRequest(stream_id, request));
+    session.Submit(3, response, {}, false);
+    CHECK(session.SubmitData(3, {BodySlice::FromBytes(std::string(70000, 'x'))}, false));
+    // 连接窗口已被流1用掉11个字节
+    CHECK(session.GetPendingSize(3) == 70000 - (65535 - 11));
+    session.Feed(MakeFrame(Http2FrameType::RST_STREAM, 0, 3, Uint32(static_cast<uint32_t>(Http2Error::CANCEL))));
+    CHECK(!session.SubmitData(3, {BodySlice::FromBytes("more")}, false));
+    CHECK(session.GetPendingSize(3) == 0);
+    CHECK(session.GetStreamCount() == 0);
+  }
+
+  SECTION("a failed stream is reset with internal error") {
+    auto input = StartSession(session) + MakeFrame(Http2FrameType::HEADERS, 0x5, 1, GetRequest(encoder, "/"));
+    session.Feed(input);
+    TakeFrames(session);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    REQUIRE(session.NextRequest(stream_id, request));
+    session.Submit(1, Response::Make200Response(false, std::nullopt), {}, false);
+    session.AbortStream(1);
+    auto frames = TakeFrames(session);
+    REQUIRE(frames.size() == 2);
+    CHECK(frames[1].type_ == Http2FrameType::RST_STREAM);
+    CHECK(frames[1].payload_ == Uint32(static_cast<uint32_t>(Http2Error::INTERNAL_ERROR)));
+    CHECK(session.GetStreamCount() == 0);
+    CHECK(!session.ShouldClose());
+  }
+
+  SECTION("response headers are encoded with hpack") {
+    auto input = StartSession(session) + MakeFrame(Http2FrameType::HEADERS, 0x5, 1, GetRequest(encoder, "/"));
+    session.Feed(input);
+    TakeFrames(session);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    REQUIRE(session.NextRequest(stream_id, request));
+    session.Submit(stream_id, Response::Make404Response(), {});
+    auto frames = TakeFrames(session);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0].type_ == Http2FrameType::HEADERS);
+    // 没有响应体时END_STREAM在HEADERS上
+    CHECK(frames[0].flags_ == 0x5);
+    HpackDecoder decoder;
+    std::vector<HeaderField> fields;
+    REQUIRE(decoder.Decode(frames[0].payload_, fields));
+    REQUIRE(!fields.empty());
+    CHECK(fields[0] == HeaderField{":status", "404"});
+    for (const auto &[name, value] : fields) {
+      CHECK(name != "connection");
+    }
+    CHECK(session.GetStreamCount() == 0);
+  }
+
+  SECTION("malformed requests reset only their stream") {
+    auto input = StartSession(session);
+    input += MakeFrame(Http2FrameType::HEADERS, 0x5, 1, Headers(encoder, {{":method", "GET"}, {":scheme", "http"}}));
+    input += MakeFrame(Http2FrameType::HEADERS, 0x5, 3,
+                       Headers(encoder, {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {"Upper", "x"}}));
+    input += MakeFrame(
+        Http2FrameType::HEADERS, 0x5, 5,
+        Headers(encoder, {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {"connection", "close"}}));
+    input += MakeFrame(Http2FrameType::HEADERS, 0x5, 7, GetRequest(encoder, "/ok"));
+    session.Feed(input);
+    std::vector<uint32_t> reset;
+    for (const auto &frame : TakeFrames(session)) {
+      if (frame.type_ == Http2FrameType::RST_STREAM) {
+        CHECK(frame.payload_ == Uint32(static_cast<uint32_t>(Http2Error::PROTOCOL_ERROR)));
+        reset.push_back(frame.stream_id_);
+      }
+    }
+    CHECK(reset == std::vector<uint32_t>{1, 3, 5});
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    REQUIRE(session.NextRequest(stream_id, request));
+    CHECK(stream_id == 7);
+    CHECK(!session.ShouldClose());
+  }
+
+  SECTION("header blocks can span continuation frames") {
+    auto block = GetRequest(encoder, "/split");
+    auto input = StartSession(session);
+    input += MakeFrame(Http2FrameType::HEADERS, 0x1, 1, block.substr(0, 5));
+    input += MakeFrame(Http2FrameType::CONTINUATION, 0, 1, block.substr(5, 5));
+    input += MakeFrame(Http2FrameType::CONTINUATION, 0x4, 1, block.substr(10));
+    session.Feed(input);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> request;
+    REQUIRE(session.NextRequest(stream_id, request));
+    CHECK(request->GetResourceUrl() == "/split");
+  }
+
+  SECTION("connection errors send goaway") {
+    SECTION("bad preface") { session.Feed("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"); }
+    SECTION("first frame is not settings") {
+      session.Feed(std::string(Next::Http::HTTP2_CLIENT_PREFACE) +
+                   MakeFrame(Http2FrameType::PING, 0, 0, std::string(8, '\0')));
+    }
+    SECTION("even stream id") {
+      session.Feed(StartSession(session) + MakeFrame(Http2FrameType::HEADERS, 0x5, 2, GetRequest(encoder, "/")));
+    }
+    SECTION("interrupted header block") {
+      session.Feed(StartSession(session) + MakeFrame(Http2FrameType::HEADERS, 0x1, 1, "") +
+                   MakeFrame(Http2FrameType::PING, 0, 0, std::string(8, '\0')));
+    }
+    SECTION("zero window increment") {
+      session.Feed(StartSession(session) + MakeFrame(Http2FrameType::WINDOW_UPDATE, 0, 0, Uint32(0)));
+    }
+    SECTION("invalid hpack") {
+      session.Feed(StartSession(session) + MakeFrame(Http2FrameType::HEADERS, 0x5, 1, "\xff\xff\xff\xff\xff\xff"));
+    }
+    auto frames = TakeFrames(session);
+    REQUIRE(!frames.empty());
+    CHECK(frames.back().type_ == Http2FrameType::GOAWAY);
+    CHECK(session.ShouldClose());
+  }
+
+  SECTION("ping is acknowledged") {
+    session.Feed(StartSession(session) + MakeFrame(Http2FrameType::PING, 0, 0, "12345678"));
+    auto frames = TakeFrames(session);
+    REQUIRE(!frames.empty());
+    CHECK(frames.back().type_ == Http2FrameType::PING);
+    CHECK(frames.back().flags_ == 0x1);
+    CHECK(frames.back().payload_ == "12345678");
+  }
+
+  SECTION("an upgraded request becomes stream 1") {
+    auto request = std::make_unique<Request>("GET /up HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    REQUIRE(!session.StartUpgraded("AAMAAABkAAQCAAAAAAIAAAAA!", request));
+    CHECK(request != nullptr);
+    // SETTINGS_INITIAL_WINDOW_SIZE为32MB
+    REQUIRE(session.StartUpgraded("AAMAAABkAAQCAAAAAAIAAAAA", request));
+    CHECK(request == nullptr);
+    uint32_t stream_id = 0;
+    std::unique_ptr<Request> upgraded;
+    REQUIRE(session.NextRequest(stream_id, upgraded));
+    CHECK(stream_id == 1);
+    CHECK(upgraded->GetResourceUrl() == "/up");
+    session.Feed(std::string(Next::Http::HTTP2_CLIENT_PREFACE) + MakeFrame(Http2FrameType::SETTINGS, 0, 0, "") +
+                 MakeFrame(Http2FrameType::WINDOW_UPDATE, 0, 0, Uint32(1 << 20)));
+    TakeFrames(session);
+    auto body = std::make_shared<const std::vector<unsigned char>>(100000, 'y');
+    session.Submit(stream_id, Response::MakeFileResponse(false, body->size(), "text/plain"),
+                   {BodySlice::FromBlock(body)});
+    size_t sent = 0;
+    for (const auto &frame : TakeFrames(session)) {
+      sent += frame.type_ == Http2FrameType::DATA ? frame.payload_.size() : 0;
+    }
+    CHECK(sent == 100000);
+  }
+}
@@ -0,0 +1,103 @@
+/**
+ * This is the unit test file for http/PerfectHashMap and the lookups built on it
+ */
+
+#include "http/perfect_hash.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "catch2/catch_test_macros.hpp"
+#include "http/http_utils.h"
+
+/* for convenience reason */
+using Next::Http::Extension;
+using Next::Http::ExtensionToMime;
+using Next::Http::FileToMime;
+using Next::Http::Method;
+using Next::Http::PerfectHashEntry;
+using Next::Http::PerfectHashMap;
+using Next::Http::Version;
+
+/* 构建和查找都可以在编译期完成 */
+static constexpr PerfectHashEntry<int> NUMBER_ENTRIES[] = {{"one", 1}, {"two", 2}, {"three", 3}, {"four", 4}};
+static constexpr PerfectHashMap<int, std::size(NUMBER_ENTRIES), 16> NUMBER_TABLE{NUMBER_ENTRIES};
+static_assert(*NUMBER_TABLE.Find("three") == 3);
+static_assert(*NUMBER_TABLE.Find("FOUR") == 4);
+static_assert(NUMBER_TABLE.Find("five") == nullptr);
+
+TEST_CASE("[http/perfect_hash]") {
+  SECTION("lookup is case insensitive and rejects unknown keys") {
+    CHECK(*NUMBER_TABLE.Find("One") == 1);
+    CHECK(*NUMBER_TABLE.Find("tWo") == 2);
+    CHECK(NUMBER_TABLE.Find("") == nullptr);
+    CHECK(NUMBER_TABLE.Find("on") == nullptr);
+    CHECK(NUMBER_TABLE.Find("ones") == nullptr);
+    CHECK(NUMBER_TABLE.Size() == 4);
+  }
+
+  SECTION("methods, versions and extensions") {
+    CHECK(Next::Http::ToMethod("GET") == Method::GET);
+    CHECK(Next::Http::ToMethod(" head ") == Method::HEAD);
+    CHECK(Next::Http::ToMethod("PUNCH") == Method::UNSUPPORTED);
+    CHECK(Next::Http::ToVersion("HTTP/1.1") == Version::HTTP_1_1);
+    CHECK(Next::Http::ToVersion("HTTP/2.0") == Version::UNSUPPORTED);
+    CHECK(Next::Http::ToExtension("html") == Extension::HTML);
+    CHECK(Next::Http::ToExtension("Jpeg") == Extension::JPEG);
+    CHECK(Next::Http::ToExtension("exe") == Extension::UNSUPPORTED);
+    CHECK(ExtensionToMime(Extension::CSS) == "text/css");
+    CHECK(ExtensionToMime(Extension::UNSUPPORTED) == Next::Http::MIME_OCTET);
+  }
+
+  SECTION("mime registry") {
+    CHECK(ExtensionToMime(std::string_view("html")) == "text/html");
+    CHECK(ExtensionToMime(std::string_view("JS")) == "text/javascript");
+    CHECK(ExtensionToMime(std::string_view("woff2")) == "font/woff2");
+    CHECK(ExtensionToMime(std::string_view("wasm")) == "application/wasm");
+    CHECK(ExtensionToMime(std::string_view("svg")) == "image/svg+xml");
+    CHECK(ExtensionToMime(std::string_view("unknown")) == Next::Http::MIME_OCTET);
+    CHECK(ExtensionToMime(std::string_view("")) == Next::Http::MIME_OCTET);
+  }
+
+  SECTION("mime of a file path") {
+    CHECK(FileToMime("../http_dir/index.html") == "text/html");
+    CHECK(FileToMime("../http_dir/index.html") == "text/html");
+    CHECK(FileToMime("/var/www/app.min.js") == "text/javascript");
+    CHECK(FileToMime("/var/www/v1.2/README") == Next::Http::MIME_OCTET);
+    CHECK(FileToMime("/var/www/archive.tar.gz") == "application/gzip");
+  }
+}
+
+TEST_CASE("[http/perfect_hash_benchmark]", "[.benchmark]") {
+  const std::string extensions[] = {"html", "css", "png", "jpg", "gif", "js", "woff2", "json"};
+  const int rounds = 200000;
+
+  // 旧实现: Format分配两次，再在std::map里逐个比较字符串
+  auto start = std::chrono::steady_clock::now();
+  size_t hits = 0;
+  for (int i = 0; i < rounds; i++) {
+    auto formatted = Next::Http::Format(extensions[i % std::size(extensions)]);
+    for (const auto &pair : Next::Http::EXTENSION_TO_STRING) {
+      if (pair.second == formatted) {
+        hits++;
+        break;
+      }
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto map_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+  start = std::chrono::steady_clock::now();
+  size_t mime_size = 0;
+  for (int i = 0; i < rounds; i++) {
+    mime_size += ExtensionToMime(std::string_view(extensions[i % std::size(extensions)])).size();
+  }
+  end = std::chrono::steady_clock::now();
+  auto hash_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+  CHECK(hits > 0);
+  CHECK(mime_size > 0);
+  std::cout << "Looking up " << rounds << " extensions" << std::endl;
+  std::cout << "Format + std::map scan: " << map_us << " us" << std::endl;
+  std::cout << "constexpr perfect hash: " << hash_us << " us" << std::endl;
+}
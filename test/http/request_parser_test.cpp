@@ -0,0 +1,171 @@
+/**
+ * This is the unit test file for http/RequestParser class
+ */
+
+#include "http/request_parser.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "catch2/catch_test_macros.hpp"
+#include "http/http_utils.h"
+#include "http/request.h"
+
+/* for convenience reason */
+using Next::Http::Method;
+using Next::Http::ParseStatus;
+using Next::Http::Request;
+using Next::Http::RequestParser;
+using Next::Http::Version;
+
+TEST_CASE("[http/request_parser]") {
+  const std::string request_str =
+      "GET /hello.html HTTP/1.1\r\n"
+      "User-Agent:  Mozilla/4.0 \r\n"
+      "Host: www.gxjwiki.com\r\n"
+      "Connection: Keep-Alive\r\n"
+      "\r\n";
+
+  SECTION("parse a complete request in one shot") {
+    RequestParser parser;
+    std::string buf = request_str + "GET /next";
+    REQUIRE(parser.Parse(buf) == ParseStatus::COMPLETE);
+    CHECK(parser.Consumed() == request_str.size());
+    CHECK(parser.GetMethod() == "GET");
+    CHECK(parser.GetUrl() == "/hello.html");
+    CHECK(parser.GetVersion() == "HTTP/1.1");
+    REQUIRE(parser.GetHeaderCount() == 3);
+    // value去掉了前后空白
+    CHECK(parser.GetHeader(0).key_ == "User-Agent");
+    CHECK(parser.GetHeader(0).value_ == "Mozilla/4.0");
+    CHECK(parser.GetHeader(2).key_ == "Connection");
+    CHECK(parser.GetHeader(2).value_ == "Keep-Alive");
+
+    Request request{parser};
+    CHECK(request.IsValid());
+    CHECK(request.GetMethod() == Method::GET);
+    CHECK(request.GetVersion() == Version::HTTP_1_1);
+    CHECK(request.GetResourceUrl() == "/hello.html");
+    CHECK(!request.ShouldClose());
+    CHECK(request.GetHeaders().size() == 3);
+
+    // 下一个请求还不完整
+    parser.Reset();
+    CHECK(parser.Parse(std::string_view(buf).substr(request_str.size())) == ParseStatus::INCOMPLETE);
+    CHECK(parser.Consumed() == 0);
+  }
+
+  SECTION("parse a request fed byte by byte") {
+    RequestParser parser;
+    for (size_t i = 1; i < request_str.size(); i++) {
+      REQUIRE(parser.Parse(std::string_view(request_str).substr(0, i)) == ParseStatus::INCOMPLETE);
+    }
+    REQUIRE(parser.Parse(request_str) == ParseStatus::COMPLETE);
+    CHECK(parser.Consumed() == request_str.size());
+    CHECK(parser.GetUrl() == "/hello.html");
+    CHECK(parser.GetHeader(1).value_ == "www.gxjwiki.com");
+    // 完成后重复调用保持COMPLETE
+    CHECK(parser.Parse(request_str) == ParseStatus::COMPLETE);
+  }
+
+  SECTION("default route is appended to a directory url") {
+    RequestParser parser;
+    REQUIRE(parser.Parse("GET / HTTP/1.1\r\n\r\n") == ParseStatus::COMPLETE);
+    CHECK(parser.GetHeaderCount() == 0);
+    Request request{parser};
+    CHECK(request.IsValid());
+    CHECK(request.GetResourceUrl() == std::string("/") + Next::Http::DEFAULT_ROUTE);
+    CHECK(request.ShouldClose());
+  }
+
+  SECTION("malformed requests are rejected") {
+    RequestParser parser;
+    CHECK(parser.Parse("GET /hello.html\r\n\r\n") == ParseStatus::ERROR);
+    CHECK(parser.GetError() != nullptr);
+    CHECK(!Request(parser).IsValid());
+
+    parser.Reset();
+    CHECK(parser.Parse("GET /hello.html HTTP/1.1\nHost: a\r\n\r\n") == ParseStatus::ERROR);
+
+    parser.Reset();
+    CHECK(parser.Parse("GET /hello.html HTTP/1.1\r\nHost a\r\n\r\n") == ParseStatus::ERROR);
+
+    parser.Reset();
+    CHECK(parser.Parse("GET /hello.html HTTP/1.1\r\n: a\r\n\r\n") == ParseStatus::ERROR);
+
+    // 请求行合法但方法或版本不支持时由Request判定
+    parser.Reset();
+    REQUIRE(parser.Parse("PUNCH /hello.html HTTP/1.1\r\n\r\n") == ParseStatus::COMPLETE);
+    CHECK(!Request(parser).IsValid());
+
+    parser.Reset();
+    REQUIRE(parser.Parse("GET /hello.html HTTP/2.0\r\n\r\n") == ParseStatus::COMPLETE);
+    CHECK(!Request(parser).IsValid());
+  }
+
+  SECTION("oversized heads are rejected") {
+    RequestParser parser;
+    std::string huge = "GET /" + std::string(Next::Http::MAX_REQUEST_HEAD_SIZE, 'a');
+    CHECK(parser.Parse(huge) == ParseStatus::ERROR);
+
+    parser.Reset();
+    std::string many = "GET / HTTP/1.1\r\n";
+    for (size_t i = 0; i <= Next::Http::MAX_HEADER_COUNT; i++) {
+      many += "X-Header-" + std::to_string(i) + ": v\r\n";
+    }
+    many += "\r\n";
+    CHECK(parser.Parse(many) == ParseStatus::ERROR);
+  }
+}
+
+TEST_CASE("[http/request_parser_benchmark]", "[.benchmark]") {
+  const std::string request_str =
+      "GET /hello.html HTTP/1.1\r\n"
+      "Host: www.gxjwiki.com\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9\r\n"
+      "Accept-Encoding: gzip, deflate\r\n"
+      "Accept-Language: en-US,en;q=0.9\r\n"
+      "Connection: Keep-Alive\r\n"
+      "\r\n";
+  const int rounds = 100000;
+  int valid = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    // 旧路径: 查找请求头结尾并拷贝出缓冲区，再按行切分
+    std::string head = request_str.substr(0, request_str.find("\r\n\r\n") + 4);
+    Request request{head};
+    valid += request.IsValid() ? 1 : 0;
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto string_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+  RequestParser parser;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    parser.Reset();
+    parser.Parse(request_str);
+    Request request{parser};
+    valid += request.IsValid() ? 1 : 0;
+  }
+  end = std::chrono::steady_clock::now();
+  auto parser_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+  start = std::chrono::steady_clock::now();
+  size_t header_count = 0;
+  for (int i = 0; i < rounds; i++) {
+    parser.Reset();
+    parser.Parse(request_str);
+    header_count += parser.GetHeaderCount();
+  }
+  end = std::chrono::steady_clock::now();
+  auto parse_only_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+  CHECK(valid == 2 * rounds);
+  CHECK(header_count == 6 * static_cast<size_t>(rounds));
+  std::cout << "Parsing " << rounds << " requests" << std::endl;
+  std::cout << "Request(std::string): " << string_us << " us" << std::endl;
+  std::cout << "RequestParser + Request(parser): " << parser_us << " us" << std::endl;
+  std::cout << "RequestParser only: " << parse_only_us << " us" << std::endl;
+}
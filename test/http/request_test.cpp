@@ -10,7 +10,9 @@
 #include "http/http_utils.h"
 
 /* for convenience reason */
+using Next::Http::ByteRange;
 using Next::Http::Method;
+using Next::Http::RangeStatus;
 using Next::Http::Request;
 using Next::Http::Version;
 
@@ -89,4 +91,80 @@ TEST_CASE("[http/request]") {
     Request request_6{request_6_str};
     CHECK(!request_6.ShouldClose());
   }
+
+  SECTION("range header is parsed against the file size") {
+    std::vector<ByteRange> ranges;
+    auto parse = [&](std::string_view value, size_t size) { return Next::Http::ParseRange(value, size, ranges); };
+    CHECK(parse("bytes=0-99", 1000) == RangeStatus::SATISFIABLE);
+    CHECK((ranges.size() == 1 && ranges[0].first_ == 0 && ranges[0].last_ == 99));
+    CHECK(parse("bytes=900-", 1000) == RangeStatus::SATISFIABLE);
+    CHECK((ranges[0].first_ == 900 && ranges[0].last_ == 999));
+    CHECK(parse("bytes=-100", 1000) == RangeStatus::SATISFIABLE);
+    CHECK((ranges[0].first_ == 900 && ranges[0].Length() == 100));
+    CHECK(parse("bytes=-5000", 1000) == RangeStatus::SATISFIABLE);
+    CHECK(ranges[0].first_ == 0);
+    CHECK(parse("Bytes=0-1, 990-2000 ,,5000-", 1000) == RangeStatus::SATISFIABLE);
+    CHECK(ranges.size() == 2);
+    CHECK((ranges[1].first_ == 990 && ranges[1].last_ == 999));
+
+    CHECK(parse("bytes=1000-", 1000) == RangeStatus::UNSATISFIABLE);
+    CHECK(parse("bytes=-0", 1000) == RangeStatus::UNSATISFIABLE);
+    CHECK(parse("bytes=0-0", 0) == RangeStatus::UNSATISFIABLE);
+    CHECK(parse("bytes=5-1", 1000) == RangeStatus::NONE);
+    CHECK(parse("bytes=a-b", 1000) == RangeStatus::NONE);
+    CHECK(parse("bytes=+1-2", 1000) == RangeStatus::NONE);
+    CHECK(parse("items=0-1", 1000) == RangeStatus::NONE);
+    CHECK(parse("bytes=", 1000) == RangeStatus::NONE);
+    std::string many = "bytes=0-0";
+    for (size_t i = 1; i <= Next::Http::MAX_RANGE_COUNT; i++) {
+      many += "," + std::to_string(i) + "-" + std::to_string(i);
+    }
+    CHECK(parse(many, 1000) == RangeStatus::NONE);
+
+    Request get{"GET /video.mp4 HTTP/1.1\r\nRange: bytes=10-19\r\n\r\n"};
+    CHECK(get.GetRanges(100, "\"v1\"", 0, ranges) == RangeStatus::SATISFIABLE);
+    CHECK(ranges[0].Length() == 10);
+    Request head{"HEAD /video.mp4 HTTP/1.1\r\nRange: bytes=10-19\r\n\r\n"};
+    CHECK(head.GetRanges(100, "\"v1\"", 0, ranges) == RangeStatus::NONE);
+  }
+
+  SECTION("conditional requests are checked against the validators") {
+    const time_t modified = 784111777;  // Sun, 06 Nov 1994 08:49:37 GMT
+    time_t parsed = 0;
+    CHECK(Next::Http::ParseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", parsed));
+    CHECK(parsed == modified);
+    char formatted[Next::Http::HTTP_DATE_SIZE];
+    CHECK(Next::Http::ParseHttpDate(std::string_view(formatted, Next::Http::FormatHttpDate(1700000000, formatted)),
+                                    parsed));
+    CHECK(parsed == 1700000000);
+    CHECK(!Next::Http::ParseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT", parsed));
+    CHECK(!Next::Http::ParseHttpDate("Sun, 06 Foo 1994 08:49:37 GMT", parsed));
+
+    char etag[Next::Http::MAX_ETAG_SIZE];
+    auto etag_size = Next::Http::FormatETag(0x1a2b, 1024, UINT64_MAX, etag);
+    CHECK(std::string_view(etag, etag_size) == "\"1a2b-400-ffffffffffffffff\"");
+    CHECK(Next::Http::MatchesAnyETag("\"a\", W/\"1a2b-400-ffffffffffffffff\"", std::string_view(etag, etag_size)));
+    CHECK(Next::Http::MatchesAnyETag(" * ", "\"b\""));
+    CHECK(!Next::Http::MatchesAnyETag("\"a\", \"c\"", "\"b\""));
+
+    Request none_match{"GET / HTTP/1.1\r\nIf-None-Match: \"v1\"\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n"};
+    CHECK(none_match.IsNotModified("\"v1\"", modified + 100));
+    // 有If-None-Match时忽略If-Modified-Since
+    CHECK(!none_match.IsNotModified("\"v2\"", modified));
+    Request since{"HEAD / HTTP/1.1\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n"};
+    CHECK(since.IsNotModified("\"v1\"", modified));
+    CHECK(since.IsNotModified("\"v1\"", modified - 1));
+    CHECK(!since.IsNotModified("\"v1\"", modified + 1));
+    Request plain{"GET / HTTP/1.1\r\n\r\n"};
+    CHECK(!plain.IsNotModified("\"v1\"", modified));
+
+    std::vector<ByteRange> ranges;
+    Request if_range{"GET /video.mp4 HTTP/1.1\r\nRange: bytes=10-19\r\nIf-Range: \"v1\"\r\n\r\n"};
+    CHECK(if_range.GetRanges(100, "\"v1\"", modified, ranges) == RangeStatus::SATISFIABLE);
+    CHECK(if_range.GetRanges(100, "\"v2\"", modified, ranges) == RangeStatus::NONE);
+    Request if_range_date{
+        "GET /video.mp4 HTTP/1.1\r\nRange: bytes=10-19\r\nIf-Range: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n"};
+    CHECK(if_range_date.GetRanges(100, "\"v1\"", modified, ranges) == RangeStatus::SATISFIABLE);
+    CHECK(if_range_date.GetRanges(100, "\"v1\"", modified + 1, ranges) == RangeStatus::NONE);
+  }
 }
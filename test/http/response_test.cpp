@@ -9,7 +9,10 @@
 #include "http/header.h"
 #include "http/http_utils.h"
 /* for convenience reason */
+using Next::Http::ByteRange;
+using Next::Http::CannedResponse;
 using Next::Http::Header;
+using Next::Http::HeaderId;
 using Next::Http::HEADER_CONTENT_LENGTH;
 using Next::Http::Response;
 using Next::Http::RESPONSE_OK;
@@ -42,4 +45,130 @@ TEST_CASE("[http/response]") {
     CHECK(value == new_val);
     std::cout << response << std::endl;
   }
+
+  SECTION("http dates are formatted as IMF-fixdate") {
+    char date[Next::Http::HTTP_DATE_SIZE];
+    CHECK(std::string(date, Next::Http::FormatHttpDate(784111777, date)) == "Sun, 06 Nov 1994 08:49:37 GMT");
+    CHECK(std::string(date, Next::Http::FormatHttpDate(0, date)) == "Thu, 01 Jan 1970 00:00:00 GMT");
+    auto cached = Next::Http::CachedHttpDate();
+    CHECK(cached.size() == Next::Http::HTTP_DATE_SIZE);
+    CHECK(cached.substr(cached.size() - 4) == " GMT");
+  }
+
+  SECTION("serialize uses the fixed header block and appends Date") {
+    Response response{RESPONSE_OK, false, std::nullopt};
+    response.SetContentLength(1234567);
+    std::vector<unsigned char> buf;
+    response.Serialize(buf);
+    std::string head(buf.begin(), buf.end());
+    CHECK(head.rfind("HTTP/1.1 200 OK\r\nServer:Next/1.0\r\nConnection:Keep-Alive\r\nContent-Length:1234567\r\n",
+                     0) == 0);
+    CHECK(head.find("Date:") != std::string::npos);
+    CHECK(head.substr(head.size() - 4) == "\r\n\r\n");
+    // Server只出现一次
+    CHECK(head.find("Server:") == head.rfind("Server:"));
+
+    // 修改过的固定header不使用预渲染块
+    CHECK(response.ChangeHeader(HeaderId::CONNECTION, "Upgrade"));
+    buf.clear();
+    response.Serialize(buf);
+    head.assign(buf.begin(), buf.end());
+    CHECK(head.find("Connection:Upgrade\r\n") != std::string::npos);
+    CHECK(head.find("Keep-Alive") == std::string::npos);
+    CHECK(head.find("Server:Next/1.0\r\n") != std::string::npos);
+  }
+
+  SECTION("canned responses match the freshly built ones") {
+    std::vector<unsigned char> canned;
+    Response::SerializeCanned(CannedResponse::NOT_FOUND, canned);
+    std::vector<unsigned char> built;
+    Response::Make404Response().Serialize(built);
+    // Date可能恰好跨秒，只比较Date之前的部分
+    std::string canned_str(canned.begin(), canned.end());
+    std::string built_str(built.begin(), built.end());
+    CHECK(canned_str.size() == built_str.size());
+    CHECK(canned_str.substr(0, canned_str.find("Date:")) == built_str.substr(0, built_str.find("Date:")));
+
+    canned.clear();
+    Response::SerializeCanned(CannedResponse::METHOD_NOT_ALLOWED_STATIC, canned);
+    std::string head(canned.begin(), canned.end());
+    CHECK(head.rfind("HTTP/1.1 405 Method Not Allowed\r\n", 0) == 0);
+    CHECK(head.find("Allow:GET, HEAD\r\n") != std::string::npos);
+    CHECK(head.find("Connection:Close\r\n") != std::string::npos);
+  }
+
+  SECTION("partial content responses") {
+    std::vector<unsigned char> buf;
+    Response::MakePartialResponse(false, ByteRange{10, 19}, 100, "video/mp4").Serialize(buf);
+    std::string head(buf.begin(), buf.end());
+    CHECK(head.rfind("HTTP/1.1 206 Partial Content\r\n", 0) == 0);
+    CHECK(head.find("Content-Length:10\r\n") != std::string::npos);
+    CHECK(head.find("Content-Range:bytes 10-19/100\r\n") != std::string::npos);
+
+    buf.clear();
+    Response::Make416Response(false, 100).Serialize(buf);
+    head.assign(buf.begin(), buf.end());
+    CHECK(head.rfind("HTTP/1.1 416 Range Not Satisfiable\r\n", 0) == 0);
+    CHECK(head.find("Content-Range:bytes */100\r\n") != std::string::npos);
+    CHECK(head.find("Content-Length:0\r\n") != std::string::npos);
+
+    // Content-Length等于各部分的header、区间和结束分隔行的总长度
+    std::vector<ByteRange> ranges = {{0, 4}, {50, 99}};
+    std::vector<std::string> part_heads;
+    buf.clear();
+    Response::MakeMultipartResponse(true, ranges, 100, "text/plain", part_heads).Serialize(buf);
+    head.assign(buf.begin(), buf.end());
+    REQUIRE(part_heads.size() == 3);
+    auto boundary_begin = head.find("boundary=") + 9;
+    auto boundary = head.substr(boundary_begin, head.find("\r\n", boundary_begin) - boundary_begin);
+    CHECK(part_heads[0] == "\r\n--" + boundary + "\r\nContent-Type:text/plain\r\nContent-Range:bytes 0-4/100\r\n\r\n");
+    CHECK(part_heads[2] == "\r\n--" + boundary + "--\r\n");
+    auto expected = part_heads[0].size() + 5 + part_heads[1].size() + 50 + part_heads[2].size();
+    CHECK(head.find("Content-Length:" + std::to_string(expected) + "\r\n") != std::string::npos);
+    CHECK(head.find("Content-Type:multipart/byteranges; boundary=") != std::string::npos);
+
+    buf.clear();
+    Response::MakeFileResponse(false, 100, "text/plain").Serialize(buf);
+    head.assign(buf.begin(), buf.end());
+    CHECK(head.find("Accept-Ranges:bytes\r\n") != std::string::npos);
+  }
+
+  SECTION("validators and 304 responses") {
+    std::vector<unsigned char> buf;
+    auto response = Response::MakeFileResponse(false, 100, "text/plain");
+    response.SetValidators("\"1-64-0\"", 784111777);
+    response.Serialize(buf);
+    std::string head(buf.begin(), buf.end());
+    CHECK(head.find("ETag:\"1-64-0\"\r\n") != std::string::npos);
+    CHECK(head.find("Last-Modified:Sun, 06 Nov 1994 08:49:37 GMT\r\n") != std::string::npos);
+
+    buf.clear();
+    Response::Make304Response(false, "\"1-64-0\"", 784111777).Serialize(buf);
+    head.assign(buf.begin(), buf.end());
+    CHECK(head.rfind("HTTP/1.1 304 Not Modified\r\n", 0) == 0);
+    CHECK(head.find("ETag:\"1-64-0\"\r\n") != std::string::npos);
+    CHECK(head.find("Content-Length") == std::string::npos);
+    CHECK(head.find("Connection:Keep-Alive\r\n") != std::string::npos);
+  }
+
+  SECTION("compressed responses carry content-encoding and vary") {
+    std::vector<unsigned char> buf;
+    auto response = Response::MakeFileResponse(false, 100, "text/html");
+    response.SetContentCoding(Next::Http::ContentCoding::GZIP);
+    response.Serialize(buf);
+    std::string head(buf.begin(), buf.end());
+    CHECK(head.find("Content-Encoding:gzip\r\n") != std::string::npos);
+    CHECK(head.find("Vary:Accept-Encoding\r\n") != std::string::npos);
+    // 压缩后的表示不支持区间请求
+    CHECK(head.find("Accept-Ranges") == std::string::npos);
+
+    buf.clear();
+    response = Response::MakeFileResponse(false, 100, "text/html");
+    response.SetContentCoding(Next::Http::ContentCoding::IDENTITY);
+    response.Serialize(buf);
+    head.assign(buf.begin(), buf.end());
+    CHECK(head.find("Content-Encoding") == std::string::npos);
+    CHECK(head.find("Vary:Accept-Encoding\r\n") != std::string::npos);
+    CHECK(head.find("Accept-Ranges:bytes\r\n") != std::string::npos);
+  }
 }
@@ -0,0 +1,124 @@
+/**
+ * This is the unit test file for http/Router class
+ */
+
+#include "http/router.h"
+
+#include <string>
+#include "catch2/catch_test_macros.hpp"
+
+/* for convenience reason */
+using Next::Http::Method;
+using Next::Http::Request;
+using Next::Http::RouteHandler;
+using Next::Http::RouteMatch;
+using Next::Http::RouteParams;
+using Next::Http::Router;
+using Next::Http::RouteResponse;
+using Next::Http::RouteStatus;
+
+/* 处理函数把自己的名字写入响应体，用来区分匹配到的是哪个路由 */
+static auto Named(const std::string &name) -> RouteHandler {
+  return [name](const Request & /*request*/, const RouteParams & /*params*/, RouteResponse &response) {
+    response.body_ = name;
+  };
+}
+
+static auto MatchedName(const RouteMatch &match) -> std::string {
+  if (match.status_ != RouteStatus::MATCHED) {
+    return "";
+  }
+  Request request("GET / HTTP/1.1\r\n\r\n");
+  RouteParams params;
+  RouteResponse response;
+  (*match.handler_)(request, params, response);
+  return response.body_;
+}
+
+TEST_CASE("[http/router]") {
+  Router router;
+  RouteParams params;
+
+  SECTION("static routes share prefixes") {
+    REQUIRE(router.Add(Method::GET, "/api/users", Named("users")));
+    REQUIRE(router.Add(Method::GET, "/api/user", Named("user")));
+    REQUIRE(router.Add(Method::GET, "/api/posts", Named("posts")));
+    REQUIRE(router.Add(Method::GET, "/", Named("root")));
+    CHECK(router.Size() == 4);
+    CHECK(MatchedName(router.Match(Method::GET, "/api/users", params)) == "users");
+    CHECK(MatchedName(router.Match(Method::GET, "/api/user", params)) == "user");
+    CHECK(MatchedName(router.Match(Method::GET, "/api/posts", params)) == "posts");
+    CHECK(MatchedName(router.Match(Method::GET, "/", params)) == "root");
+    CHECK(router.Match(Method::GET, "/api/use", params).status_ == RouteStatus::NOT_FOUND);
+    CHECK(router.Match(Method::GET, "/api/users/", params).status_ == RouteStatus::NOT_FOUND);
+    CHECK(router.Match(Method::GET, "/api", params).status_ == RouteStatus::NOT_FOUND);
+    CHECK(params.Size() == 0);
+  }
+
+  SECTION("parameters capture one segment") {
+    REQUIRE(router.Add(Method::GET, "/users/:id", Named("user")));
+    REQUIRE(router.Add(Method::GET, "/users/:id/posts/:post", Named("post")));
+    CHECK(MatchedName(router.Match(Method::GET, "/users/42", params)) == "user");
+    CHECK(params.Size() == 1);
+    CHECK(params.Get("id") == "42");
+    CHECK(MatchedName(router.Match(Method::GET, "/users/7/posts/abc", params)) == "post");
+    CHECK(params.Size() == 2);
+    CHECK(params.Get("id") == "7");
+    CHECK(params.Get("post") == "abc");
+    CHECK(params.At(1).first == "post");
+    CHECK(!params.Get("missing").has_value());
+    CHECK(router.Match(Method::GET, "/users/", params).status_ == RouteStatus::NOT_FOUND);
+    CHECK(router.Match(Method::GET, "/users/7/posts", params).status_ == RouteStatus::NOT_FOUND);
+  }
+
+  SECTION("static beats parameter beats catch-all, with backtracking") {
+    REQUIRE(router.Add(Method::GET, "/files/new", Named("new")));
+    REQUIRE(router.Add(Method::GET, "/files/:name", Named("name")));
+    REQUIRE(router.Add(Method::GET, "/files/:name/raw", Named("raw")));
+    REQUIRE(router.Add(Method::GET, "/files/*path", Named("path")));
+    CHECK(MatchedName(router.Match(Method::GET, "/files/new", params)) == "new");
+    CHECK(MatchedName(router.Match(Method::GET, "/files/newer", params)) == "name");
+    CHECK(params.Get("name") == "newer");
+    // "new" 的静态分支走不通，回溯到参数
+    CHECK(MatchedName(router.Match(Method::GET, "/files/new/raw", params)) == "raw");
+    CHECK(params.Get("name") == "new");
+    CHECK(MatchedName(router.Match(Method::GET, "/files/a/b/c", params)) == "path");
+    CHECK(params.Size() == 1);
+    CHECK(params.Get("path") == "a/b/c");
+    CHECK(MatchedName(router.Match(Method::GET, "/files/", params)) == "path");
+    CHECK(params.Get("path") == "");
+  }
+
+  SECTION("methods are filtered, HEAD falls back to GET") {
+    REQUIRE(router.Add(Method::GET, "/items", Named("list")));
+    REQUIRE(router.Add(Method::POST, "/items", Named("create")));
+    REQUIRE(router.Add(Method::PUT, "/items/:id", Named("update")));
+    CHECK(MatchedName(router.Match(Method::GET, "/items", params)) == "list");
+    CHECK(MatchedName(router.Match(Method::HEAD, "/items", params)) == "list");
+    CHECK(MatchedName(router.Match(Method::POST, "/items", params)) == "create");
+    auto match = router.Match(Method::PUT, "/items", params);
+    CHECK(match.status_ == RouteStatus::METHOD_NOT_ALLOWED);
+    CHECK(Router::FormatAllow(match.allowed_) == "GET, HEAD, POST");
+    match = router.Match(Method::GET, "/items/3", params);
+    CHECK(match.status_ == RouteStatus::METHOD_NOT_ALLOWED);
+    CHECK(Router::FormatAllow(match.allowed_) == "PUT");
+    REQUIRE(router.Add(Method::HEAD, "/items", Named("head")));
+    CHECK(MatchedName(router.Match(Method::HEAD, "/items", params)) == "head");
+  }
+
+  SECTION("invalid and conflicting patterns are rejected") {
+    CHECK(!router.Add(Method::GET, "", Named("x")));
+    CHECK(!router.Add(Method::GET, "no-slash", Named("x")));
+    CHECK(!router.Add(Method::GET, "/a/:", Named("x")));
+    CHECK(!router.Add(Method::GET, "/a/*rest/b", Named("x")));
+    CHECK(!router.Add(Method::GET, "/a/:id/:id", Named("x")));
+    CHECK(!router.Add(Method::GET, "/:a/:b/:c/:d/:e/:f/:g/:h/:i", Named("x")));
+    CHECK(!router.Add(Method::UNSUPPORTED, "/a", Named("x")));
+    CHECK(!router.Add(Method::GET, "/a", nullptr));
+    REQUIRE(router.Add(Method::GET, "/a/:id", Named("x")));
+    CHECK(!router.Add(Method::GET, "/a/:id", Named("y")));
+    CHECK(!router.Add(Method::GET, "/a/:name/b", Named("y")));
+    CHECK(router.Size() == 1);
+    CHECK(MatchedName(router.Match(Method::GET, "/a/1", params)) == "x");
+  }
+}